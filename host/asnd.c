@@ -0,0 +1,143 @@
+/*===========================================
+        WakeMii - Host ASND
+
+        One voice and a thread that plays its buffers by sleeping for as
+        long as each would take, then calls the voice's callback like
+        the DSP interrupt does once it's moved on to the next buffer.
+============================================*/
+#include <gccore.h>
+#include <asndlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define OUTPUT_LIMIT (8*1024*1024)		// stereo samples kept, over three minutes at 44.1kHz
+
+struct host_buffer {
+	s16 *data;
+	u32 count;
+};
+
+double asndHostSpeed = 1.0;
+s16 *asndHostOutput;
+u32 asndHostOutputCount;
+
+static pthread_mutex_t voiceMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t voiceCond = PTHREAD_COND_INITIALIZER;
+static pthread_t dspThread;
+static int started;
+static struct host_buffer playing;
+static struct host_buffer next;
+static u32 rate;
+static u32 generation;					// bumped on every stop, so a buffer in flight gets dropped
+static ASNDVoiceCallback callback;
+
+static void* dspMain(void *arg) {
+	pthread_mutex_lock(&voiceMutex);
+	while(1) {
+		if(!playing.data) {
+			pthread_cond_wait(&voiceCond, &voiceMutex);
+			continue;
+		}
+		struct host_buffer buffer = playing;
+		u32 gen = generation;
+		u32 us = (u32)((u64)buffer.count * 1000000 / rate / asndHostSpeed);
+		pthread_mutex_unlock(&voiceMutex);
+		usleep(us);
+		pthread_mutex_lock(&voiceMutex);
+		if(gen != generation) {
+			continue;
+		}
+		u32 keep = MIN(buffer.count, OUTPUT_LIMIT - asndHostOutputCount);
+		memcpy(asndHostOutput + asndHostOutputCount * 2, buffer.data, keep * 4);
+		asndHostOutputCount += keep;
+		playing = next;
+		next.data = NULL;
+		ASNDVoiceCallback cb = callback;
+		pthread_mutex_unlock(&voiceMutex);
+		if(cb) {
+			u32 level = IRQ_Disable();
+			cb(0);
+			IRQ_Restore(level);
+		}
+		pthread_mutex_lock(&voiceMutex);
+		if(gen == generation && !playing.data && next.data) {
+			playing = next;
+			next.data = NULL;
+		}
+	}
+	return NULL;
+}
+
+void ASND_Init(void) {
+	if(!started) {
+		started = 1;
+		asndHostOutput = malloc(OUTPUT_LIMIT * 4);
+		pthread_create(&dspThread, NULL, dspMain, NULL);
+	}
+}
+
+void ASND_End(void) {
+	ASND_StopVoice(0);
+}
+
+void ASND_Pause(s32 paused) {
+}
+
+s32 ASND_SetVoice(s32 voice, s32 format, s32 pitch, s32 delay, void *snd, s32 size_snd, s32 volume_l, s32 volume_r, ASNDVoiceCallback cb) {
+	if(voice != 0 || format != VOICE_STEREO_16BIT || pitch <= 0) {
+		return SND_INVALID;
+	}
+	pthread_mutex_lock(&voiceMutex);
+	generation++;
+	playing.data = snd;
+	playing.count = size_snd / 4;
+	next.data = NULL;
+	rate = pitch;
+	callback = cb;
+	pthread_cond_signal(&voiceCond);
+	pthread_mutex_unlock(&voiceMutex);
+	return SND_OK;
+}
+
+s32 ASND_AddVoice(s32 voice, void *snd, s32 size_snd) {
+	s32 ret = SND_OK;
+	pthread_mutex_lock(&voiceMutex);
+	if(voice != 0 || !playing.data) {
+		ret = SND_INVALID;
+	}
+	else if(next.data) {
+		ret = SND_BUSY;
+	}
+	else {
+		next.data = snd;
+		next.count = size_snd / 4;
+	}
+	pthread_mutex_unlock(&voiceMutex);
+	return ret;
+}
+
+s32 ASND_StopVoice(s32 voice) {
+	pthread_mutex_lock(&voiceMutex);
+	generation++;
+	playing.data = next.data = NULL;
+	pthread_mutex_unlock(&voiceMutex);
+	return SND_OK;
+}
+
+s32 ASND_StatusVoice(s32 voice) {
+	pthread_mutex_lock(&voiceMutex);
+	s32 status = playing.data ? SND_WORKING : SND_UNUSED;
+	pthread_mutex_unlock(&voiceMutex);
+	return status;
+}
+
+s32 ASND_ChangeVolumeVoice(s32 voice, s32 volume_l, s32 volume_r) {
+	return SND_OK;
+}
+
+// Forgets everything played so far.
+void asndHostReset(void) {
+	pthread_mutex_lock(&voiceMutex);
+	asndHostOutputCount = 0;
+	pthread_mutex_unlock(&voiceMutex);
+}
@@ -0,0 +1,235 @@
+/*===========================================
+        WakeMii - Host GX and GRRLIB
+
+        Textures are laid out in the same 4x4 RGBA8 tiles GRRLIB uses so
+        code that pokes texels directly can be checked against
+        GRRLIB_GetPixelFromtexImg. Drawing goes nowhere, GX only keeps
+        count of what it was sent in gxStats and where the vertices ended
+        up in gxVertices. GRRLIB_Printf and GRRLIB_DrawTile do what
+        GRRLIB's own do, for text.c to be checked against.
+============================================*/
+#include <gccore.h>
+#include <grrlib.h>
+#include <math.h>
+#include <stdarg.h>
+#include <png.h>
+
+struct gx_stats gxStats;
+struct gx_vertex gxVertices[GX_HOST_VERTICES];
+GRRLIB_drawSettings GRRLIB_Settings;
+Mtx GXmodelView2D = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}};
+static Mtx posMtx = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}};
+
+void gxStatsReset(void) {
+	memset(&gxStats, 0, sizeof(gxStats));
+}
+
+static struct gx_vertex* lastVertex() {
+	u32 n = gxStats.vertices;
+	return n && n <= GX_HOST_VERTICES ? &gxVertices[n - 1] : NULL;
+}
+
+static void mtxConcat(Mtx a, Mtx b, Mtx ab) {
+	Mtx tmp;
+	for(int i = 0; i < 3; i++) {
+		for(int j = 0; j < 4; j++) {
+			tmp[i][j] = a[i][0] * b[0][j] + a[i][1] * b[1][j] + a[i][2] * b[2][j] + (j == 3 ? a[i][3] : 0);
+		}
+	}
+	memcpy(ab, tmp, sizeof(Mtx));
+}
+
+void GX_InitTexObj(GXTexObj *obj, void *img_ptr, u16 wd, u16 ht, u8 fmt, u8 wrap_s, u8 wrap_t, u8 mipmap) {}
+void GX_InitTexObjLOD(GXTexObj *obj, u8 minfilt, u8 magfilt, f32 minlod, f32 maxlod, f32 lodbias, u8 biasclamp, u8 edgelod, u8 maxaniso) {}
+void GX_SetTevOp(u8 tevstage, u8 mode) {}
+void GX_SetVtxDesc(u8 attr, u8 type) {}
+void GX_LoadPosMtxImm(Mtx mt, u32 pnidx) {
+	memcpy(posMtx, mt, sizeof(Mtx));
+}
+
+void GX_LoadTexObj(GXTexObj *obj, u8 mapid) {
+	gxStats.texLoads++;
+}
+
+void GX_Begin(u8 primitve, u8 vtxfmt, u16 vtxcnt) {
+	gxStats.begins++;
+}
+
+void GX_Position3f32(f32 x, f32 y, f32 z) {
+	gxStats.vertices++;
+	struct gx_vertex *v = lastVertex();
+	if(v) {
+		v->x = posMtx[0][0] * x + posMtx[0][1] * y + posMtx[0][2] * z + posMtx[0][3];
+		v->y = posMtx[1][0] * x + posMtx[1][1] * y + posMtx[1][2] * z + posMtx[1][3];
+	}
+}
+
+void GX_Color1u32(u32 clr) {
+	struct gx_vertex *v = lastVertex();
+	if(v) {
+		v->color = clr;
+	}
+}
+
+void GX_TexCoord2f32(f32 s, f32 t) {
+	struct gx_vertex *v = lastVertex();
+	if(v) {
+		v->s = s;
+		v->t = t;
+	}
+}
+
+GRRLIB_texImg* GRRLIB_CreateEmptyTexture(const u32 width, const u32 height) {
+	GRRLIB_texImg *tex = calloc(1, sizeof(GRRLIB_texImg));
+	if(!tex) {
+		return NULL;
+	}
+	tex->data = memalign(32, width * height * 4);
+	if(!tex->data) {
+		free(tex);
+		return NULL;
+	}
+	memset(tex->data, 0, width * height * 4);
+	tex->w = width;
+	tex->h = height;
+	return tex;
+}
+
+void GRRLIB_FreeTexture(GRRLIB_texImg *tex) {
+	if(tex) {
+		free(tex->data);
+		free(tex);
+	}
+}
+
+void GRRLIB_FlushTex(GRRLIB_texImg *tex) {}
+
+void GRRLIB_InitTileSet(GRRLIB_texImg *tex, const u32 tilew, const u32 tileh, const u32 tilestart) {
+	tex->tilew = tilew;
+	tex->tileh = tileh;
+	tex->nbtilew = tex->w / tilew;
+	tex->nbtileh = tex->h / tileh;
+	tex->tilestart = tilestart;
+	tex->tiledtex = true;
+	tex->ofnormaltexx = 1.0f / tex->nbtilew;
+	tex->ofnormaltexy = 1.0f / tex->nbtileh;
+}
+
+// A 4x4 block is 32 bytes of AR pairs then 32 of GB pairs
+static u32 texelOffset(const int x, const int y, const GRRLIB_texImg *tex) {
+	return (((y >> 2) * (tex->w >> 2) + (x >> 2)) << 6) + ((((y & 3) << 2) + (x & 3)) << 1);
+}
+
+u32 GRRLIB_GetPixelFromtexImg(const int x, const int y, const GRRLIB_texImg *tex) {
+	const u8 *truc = tex->data;
+	u32 offset = texelOffset(x, y, tex);
+	return ((u32)truc[offset + 1] << 24) | ((u32)truc[offset + 32] << 16) | ((u32)truc[offset + 33] << 8) | truc[offset];
+}
+
+void GRRLIB_SetPixelTotexImg(const int x, const int y, GRRLIB_texImg *tex, const u32 color) {
+	u8 *truc = tex->data;
+	u32 offset = texelOffset(x, y, tex);
+	truc[offset] = color & 0xFF;
+	truc[offset + 1] = color >> 24;
+	truc[offset + 32] = (color >> 16) & 0xFF;
+	truc[offset + 33] = (color >> 8) & 0xFF;
+}
+
+// PNGs only, which is all coverload.c hands it on the host (BMPs and interlaced PNGs)
+GRRLIB_texImg* GRRLIB_LoadTextureFromFile(const char *filename) {
+	png_image image;
+	memset(&image, 0, sizeof(image));
+	image.version = PNG_IMAGE_VERSION;
+	if(!png_image_begin_read_from_file(&image, filename)) {
+		return NULL;
+	}
+	image.format = PNG_FORMAT_RGBA;
+	u8 *pixels = malloc(PNG_IMAGE_SIZE(image));
+	if(!pixels || !png_image_finish_read(&image, NULL, pixels, 0, NULL)) {
+		free(pixels);
+		png_image_free(&image);
+		return NULL;
+	}
+	GRRLIB_texImg *tex = GRRLIB_CreateEmptyTexture(image.width, image.height);
+	for(u32 y = 0; tex && y < image.height; y++) {
+		for(u32 x = 0; x < image.width; x++) {
+			const u8 *px = pixels + (y * image.width + x) * 4;
+			GRRLIB_SetPixelTotexImg(x, y, tex, ((u32)px[0] << 24) | (px[1] << 16) | (px[2] << 8) | px[3]);
+		}
+	}
+	free(pixels);
+	return tex;
+}
+
+void GRRLIB_Rectangle(const f32 x, const f32 y, const f32 width, const f32 height, const u32 color, const bool filled) {
+	GX_Begin(filled ? GX_QUADS : GX_LINES, GX_VTXFMT0, filled ? 4 : 5);
+	gxStats.vertices += filled ? 4 : 5;
+}
+
+void GRRLIB_Line(const f32 x1, const f32 y1, const f32 x2, const f32 y2, const u32 color) {
+	GX_Begin(GX_LINES, GX_VTXFMT0, 2);
+	gxStats.vertices += 2;
+}
+
+// GRRLIB 4.5's, with guMtxScaleApply/guMtxRotAxisDeg/guMtxTransApply written out
+void GRRLIB_DrawTile(const f32 xpos, const f32 ypos, const GRRLIB_texImg *tex, const f32 degrees, const f32 scaleX, const f32 scaleY, const u32 color, const int frame) {
+	GXTexObj texObj;
+	Mtx m, mv;
+	if(tex == NULL || tex->data == NULL) {
+		return;
+	}
+	// The 0.001f/x is the frame correction formula by spiffen
+	f32 s1 = (((frame % tex->nbtilew)) * tex->tilew) / (f32)tex->w + 0.001f / tex->w;
+	f32 s2 = (((frame % tex->nbtilew) + 1) * tex->tilew) / (f32)tex->w - 0.001f / tex->w;
+	f32 t1 = (((int)(frame / tex->nbtilew)) * tex->tileh) / (f32)tex->h + 0.001f / tex->h;
+	f32 t2 = (((int)(frame / tex->nbtilew) + 1) * tex->tileh) / (f32)tex->h - 0.001f / tex->h;
+	GX_InitTexObj(&texObj, tex->data, tex->w, tex->h, GX_TF_RGBA8, GX_CLAMP, GX_CLAMP, GX_FALSE);
+	GX_LoadTexObj(&texObj, GX_TEXMAP0);
+	GX_SetTevOp(GX_TEVSTAGE0, GX_MODULATE);
+	GX_SetVtxDesc(GX_VA_TEX0, GX_DIRECT);
+	f32 width = tex->tilew * 0.5f;
+	f32 height = tex->tileh * 0.5f;
+	f32 rad = degrees * M_PI / 180;
+	memset(m, 0, sizeof(Mtx));
+	m[0][0] = cosf(rad) * scaleX;
+	m[0][1] = -sinf(rad) * scaleY;
+	m[1][0] = sinf(rad) * scaleX;
+	m[1][1] = cosf(rad) * scaleY;
+	m[2][2] = 1;
+	m[0][3] = xpos + width + tex->handlex - tex->offsetx + (scaleX * (-tex->handley * sinf(-rad) - tex->handlex * cosf(-rad)));
+	m[1][3] = ypos + height + tex->handley - tex->offsety + (scaleY * (tex->handlex * sinf(-rad) - tex->handley * cosf(-rad)));
+	mtxConcat(GXmodelView2D, m, mv);
+	GX_LoadPosMtxImm(mv, GX_PNMTX0);
+	GX_Begin(GX_QUADS, GX_VTXFMT0, 4);
+	GX_Position3f32(-width, -height, 0);
+	GX_Color1u32(color);
+	GX_TexCoord2f32(s1, t1);
+	GX_Position3f32(width, -height, 0);
+	GX_Color1u32(color);
+	GX_TexCoord2f32(s2, t1);
+	GX_Position3f32(width, height, 0);
+	GX_Color1u32(color);
+	GX_TexCoord2f32(s2, t2);
+	GX_Position3f32(-width, height, 0);
+	GX_Color1u32(color);
+	GX_TexCoord2f32(s1, t2);
+	GX_End();
+	GX_LoadPosMtxImm(GXmodelView2D, GX_PNMTX0);
+	GX_SetTevOp(GX_TEVSTAGE0, GX_PASSCLR);
+	GX_SetVtxDesc(GX_VA_TEX0, GX_NONE);
+}
+
+void GRRLIB_Printf(const f32 xpos, const f32 ypos, const GRRLIB_texImg *tex, const u32 color, const f32 zoom, const char *text, ...) {
+	if(tex == NULL || tex->data == NULL) {
+		return;
+	}
+	char tmp[1024];
+	f32 offset = tex->tilew * zoom;
+	va_list argp;
+	va_start(argp, text);
+	const int size = vsnprintf(tmp, sizeof(tmp), text, argp);
+	va_end(argp);
+	for(int i = 0; i < size && i < sizeof(tmp) - 1; i++) {
+		GRRLIB_DrawTile(xpos + i * offset, ypos, tex, 0, zoom, zoom, color, tmp[i] - tex->tilestart);
+	}
+}
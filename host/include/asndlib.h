@@ -0,0 +1,48 @@
+/*===========================================
+        WakeMii - Host ASND
+
+        libogc's ASND voice calls, voice 0 only, played in real time (or
+        asndHostSpeed times faster) by a thread standing in for the DSP.
+        Everything the voice plays, silence included, lands in
+        asndHostOutput for tests to look at.
+============================================*/
+#ifndef __ASNDLIB_H__
+#define __ASNDLIB_H__
+
+#include <gccore.h>
+
+#define SND_OK 0
+#define SND_INVALID -1
+#define SND_ISNOTASONGVOICE -2
+#define SND_BUSY 1
+
+#define SND_UNUSED 0
+#define SND_WORKING 1
+#define SND_WAITING 2
+
+#define VOICE_MONO_8BIT 0
+#define VOICE_MONO_16BIT 1
+#define VOICE_STEREO_8BIT 2
+#define VOICE_STEREO_16BIT 3
+
+#define MIN_VOLUME 0
+#define MID_VOLUME 127
+#define MAX_VOLUME 255
+
+typedef void (*ASNDVoiceCallback)(s32 voice);
+
+void ASND_Init(void);
+void ASND_End(void);
+void ASND_Pause(s32 paused);
+s32 ASND_SetVoice(s32 voice, s32 format, s32 pitch, s32 delay, void *snd, s32 size_snd, s32 volume_l, s32 volume_r, ASNDVoiceCallback callback);
+s32 ASND_AddVoice(s32 voice, void *snd, s32 size_snd);
+s32 ASND_StopVoice(s32 voice);
+s32 ASND_StatusVoice(s32 voice);
+s32 ASND_ChangeVolumeVoice(s32 voice, s32 volume_l, s32 volume_r);
+
+extern double asndHostSpeed;
+extern s16 *asndHostOutput;				// interleaved stereo
+extern u32 asndHostOutputCount;			// stereo samples in it
+void asndHostReset(void);
+
+#endif
@@ -0,0 +1,143 @@
+/*===========================================
+        WakeMii - Host platform shim
+
+        Just enough of libogc for the console independent parts of WakeMii
+        to build and run natively (see Makefile.host). Types and constants
+        match libogc, the LWP threads, mutexes and conditions are pthreads
+        underneath (host/shim.c) and GX calls only count what was sent.
+============================================*/
+#ifndef __GCCORE_H__
+#define __GCCORE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <malloc.h>
+#include <sys/stat.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef float f32;
+typedef double f64;
+
+#define ATTRIBUTE_ALIGN(v) __attribute__((aligned(v)))
+
+#ifndef MIN
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+#endif
+
+#ifndef _IFDIR
+#define _IFDIR S_IFDIR
+#endif
+
+// Threads, mutexes and conditions are handles like libogc's, 0 is never a valid one
+typedef u32 lwp_t;
+typedef u32 mutex_t;
+typedef u32 cond_t;
+
+#define LWP_THREAD_NULL 0xffffffff
+#define LWP_MUTEX_NULL 0xffffffff
+#define LWP_COND_NULL 0xffffffff
+#define LWP_PRIO_IDLE 0
+#define LWP_PRIO_HIGHEST 127
+
+s32 LWP_CreateThread(lwp_t *thethread, void* (*entry)(void *), void *arg, void *stackbase, u32 stack_size, u8 prio);
+s32 LWP_JoinThread(lwp_t thethread, void **value_ptr);
+void LWP_YieldThread(void);
+s32 LWP_MutexInit(mutex_t *mutex, bool use_recursive);
+s32 LWP_MutexDestroy(mutex_t mutex);
+s32 LWP_MutexLock(mutex_t mutex);
+s32 LWP_MutexUnlock(mutex_t mutex);
+s32 LWP_CondInit(cond_t *cond);
+s32 LWP_CondDestroy(cond_t cond);
+s32 LWP_CondWait(cond_t cond, mutex_t mutex);
+// Like libogc the timeout is relative, not a time of day
+s32 LWP_CondTimedWait(cond_t cond, mutex_t mutex, const struct timespec *reltime);
+s32 LWP_CondSignal(cond_t cond);
+s32 LWP_CondBroadcast(cond_t cond);
+
+// A 24MB arena, what a Wii has left once WakeMii's loaded
+u32 SYS_GetArena1Hi(void);
+u32 SYS_GetArena1Lo(void);
+
+static inline void DCFlushRange(void *startaddress, u32 len) {}
+
+// Holds off host/asnd.c's stand in for the audio interrupt
+u32 IRQ_Disable(void);
+void IRQ_Restore(u32 level);
+
+// Everything the USB Gecko would have been sent, log lines and send_gecko() records
+// alike, kept while geckoHostCapture is set for tests to look at
+extern int geckoHostCapture;
+extern u8 *geckoHostOutput;
+extern u32 geckoHostOutputLen;
+void geckoHostReset(void);
+
+// GX, enough for text.c and profile.c to draw nowhere
+typedef f32 Mtx[3][4];
+typedef struct {
+	u32 val[8];
+} GXTexObj;
+
+#define GX_FALSE 0
+#define GX_TRUE 1
+#define GX_QUADS 0x80
+#define GX_LINES 0xA8
+#define GX_VTXFMT0 0
+#define GX_TF_RGBA8 0x6
+#define GX_CLAMP 0
+#define GX_NEAR 0
+#define GX_ANISO_1 0
+#define GX_TEXMAP0 0
+#define GX_TEVSTAGE0 0
+#define GX_MODULATE 0
+#define GX_PASSCLR 4
+#define GX_VA_TEX0 13
+#define GX_NONE 0
+#define GX_DIRECT 1
+#define GX_PNMTX0 0
+
+// What's been sent since the last gxStatsReset(), for tests to look at. The first
+// GX_HOST_VERTICES vertices are kept, positions through the loaded matrix.
+#define GX_HOST_VERTICES 65536
+struct gx_vertex {
+	f32 x, y;
+	u32 color;
+	f32 s, t;
+};
+struct gx_stats {
+	u32 begins;
+	u32 vertices;
+	u32 texLoads;
+};
+extern struct gx_stats gxStats;
+extern struct gx_vertex gxVertices[GX_HOST_VERTICES];
+void gxStatsReset(void);
+
+void GX_InitTexObj(GXTexObj *obj, void *img_ptr, u16 wd, u16 ht, u8 fmt, u8 wrap_s, u8 wrap_t, u8 mipmap);
+void GX_InitTexObjLOD(GXTexObj *obj, u8 minfilt, u8 magfilt, f32 minlod, f32 maxlod, f32 lodbias, u8 biasclamp, u8 edgelod, u8 maxaniso);
+void GX_LoadTexObj(GXTexObj *obj, u8 mapid);
+void GX_SetTevOp(u8 tevstage, u8 mode);
+void GX_SetVtxDesc(u8 attr, u8 type);
+void GX_LoadPosMtxImm(Mtx mt, u32 pnidx);
+void GX_Begin(u8 primitve, u8 vtxfmt, u16 vtxcnt);
+void GX_Position3f32(f32 x, f32 y, f32 z);
+void GX_Color1u32(u32 clr);
+void GX_TexCoord2f32(f32 s, f32 t);
+static inline void GX_End(void) {}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef __GRRLIB_H__
+#define __GRRLIB_H__
+
+// The bits of GRRLIB WakeMii uses, textures are real (same RGBA8 tiles as on
+// the console) and drawing goes to the counting GX in host/gx.c
+#include <gccore.h>
+
+#define GRRLIB_WHITE 0xFFFFFFFF
+
+typedef struct GRRLIB_texImg {
+	u32 w;
+	u32 h;
+	int handlex;
+	int handley;
+	int offsetx;
+	int offsety;
+	bool tiledtex;
+	u32 tilew;
+	u32 tileh;
+	u32 nbtilew;
+	u32 nbtileh;
+	u32 tilestart;
+	f32 ofnormaltexx;
+	f32 ofnormaltexy;
+	void *data;
+} GRRLIB_texImg;
+
+typedef struct GRRLIB_drawSettings {
+	bool antialias;
+	int blend;
+} GRRLIB_drawSettings;
+
+extern GRRLIB_drawSettings GRRLIB_Settings;
+extern Mtx GXmodelView2D;
+
+GRRLIB_texImg* GRRLIB_CreateEmptyTexture(const u32 width, const u32 height);
+void GRRLIB_FreeTexture(GRRLIB_texImg *tex);
+GRRLIB_texImg* GRRLIB_LoadTextureFromFile(const char *filename);
+void GRRLIB_FlushTex(GRRLIB_texImg *tex);
+void GRRLIB_InitTileSet(GRRLIB_texImg *tex, const u32 tilew, const u32 tileh, const u32 tilestart);
+u32 GRRLIB_GetPixelFromtexImg(const int x, const int y, const GRRLIB_texImg *tex);
+void GRRLIB_SetPixelTotexImg(const int x, const int y, GRRLIB_texImg *tex, const u32 color);
+void GRRLIB_DrawTile(const f32 xpos, const f32 ypos, const GRRLIB_texImg *tex, const f32 degrees, const f32 scaleX, const f32 scaleY, const u32 color, const int frame);
+void GRRLIB_Printf(const f32 xpos, const f32 ypos, const GRRLIB_texImg *tex, const u32 color, const f32 zoom, const char *text, ...);
+void GRRLIB_Rectangle(const f32 x, const f32 y, const f32 width, const f32 height, const u32 color, const bool filled);
+void GRRLIB_Line(const f32 x1, const f32 y1, const f32 x2, const f32 y2, const u32 color);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef __LWP_WATCHDOG_H__
+#define __LWP_WATCHDOG_H__
+
+#include <gccore.h>
+
+// The Wii's timebase rate, so tick maths comes out the same as on the console
+#define TB_TIMER_CLOCK 60750
+
+#define ticks_to_secs(ticks) (((u64)(ticks)/(u64)(TB_TIMER_CLOCK*1000)))
+#define ticks_to_millisecs(ticks) (((u64)(ticks)/(u64)(TB_TIMER_CLOCK)))
+#define ticks_to_microsecs(ticks) ((((u64)(ticks)*8)/(u64)(TB_TIMER_CLOCK/125)))
+#define ticks_to_nanosecs(ticks) ((((u64)(ticks)*8000)/(u64)(TB_TIMER_CLOCK/125)))
+#define secs_to_ticks(sec) ((u64)(sec)*(TB_TIMER_CLOCK*1000))
+#define millisecs_to_ticks(msec) ((u64)(msec)*(TB_TIMER_CLOCK))
+#define microsecs_to_ticks(usec) (((u64)(usec)*(TB_TIMER_CLOCK/125))/8)
+
+// Monotonic, in timebase ticks
+u64 gettime(void);
+u32 gettick(void);
+u32 diff_sec(u64 start, u64 end);
+u32 diff_msec(u64 start, u64 end);
+u32 diff_usec(u64 start, u64 end);
+u64 diff_ticks(u64 start, u64 end);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef __SYS_DIR_H__
+#define __SYS_DIR_H__
+
+// libogc's pulls in both of these
+#include <dirent.h>
+#include <sys/stat.h>
+
+#endif
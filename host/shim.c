@@ -0,0 +1,210 @@
+/*===========================================
+        WakeMii - Host platform shim
+
+        LWP threads, mutexes and conditions on top of pthreads, interrupts
+        being disabled as a lock host/asnd.c's callbacks run under, the
+        timebase on CLOCK_MONOTONIC, and logging to stderr (set
+        WAKEMII_LOG to 0, 1 or 2 for errors, info or debug) instead of
+        the Gecko, with what the Gecko would have got captured for tests
+        that ask. Handles index fixed tables, nothing is ever freed,
+        which is plenty for a test or benchmark run.
+============================================*/
+#include <gccore.h>
+#include <ogc/lwp_watchdog.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <errno.h>
+#include "gecko.h"
+
+#define MAX_HANDLES 256
+
+static pthread_t threads[MAX_HANDLES];
+static pthread_mutex_t mutexes[MAX_HANDLES];
+static pthread_cond_t conds[MAX_HANDLES];
+static u32 numThreads, numMutexes, numConds;
+
+static u32 newHandle(u32 *count) {
+	u32 handle = __sync_add_and_fetch(count, 1);
+	if(handle >= MAX_HANDLES) {
+		fprintf(stderr, "host shim: out of handles\n");
+		abort();
+	}
+	return handle;
+}
+
+s32 LWP_CreateThread(lwp_t *thethread, void* (*entry)(void *), void *arg, void *stackbase, u32 stack_size, u8 prio) {
+	u32 handle = newHandle(&numThreads);
+	if(pthread_create(&threads[handle], NULL, entry, arg)) {
+		return -1;
+	}
+	*thethread = handle;
+	return 0;
+}
+
+s32 LWP_JoinThread(lwp_t thethread, void **value_ptr) {
+	return pthread_join(threads[thethread], value_ptr);
+}
+
+void LWP_YieldThread(void) {
+	sched_yield();
+}
+
+s32 LWP_MutexInit(mutex_t *mutex, bool use_recursive) {
+	u32 handle = newHandle(&numMutexes);
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, use_recursive ? PTHREAD_MUTEX_RECURSIVE : PTHREAD_MUTEX_NORMAL);
+	pthread_mutex_init(&mutexes[handle], &attr);
+	pthread_mutexattr_destroy(&attr);
+	*mutex = handle;
+	return 0;
+}
+
+s32 LWP_MutexDestroy(mutex_t mutex) {
+	return 0;
+}
+
+s32 LWP_MutexLock(mutex_t mutex) {
+	return pthread_mutex_lock(&mutexes[mutex]);
+}
+
+s32 LWP_MutexUnlock(mutex_t mutex) {
+	return pthread_mutex_unlock(&mutexes[mutex]);
+}
+
+s32 LWP_CondInit(cond_t *cond) {
+	u32 handle = newHandle(&numConds);
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&conds[handle], &attr);
+	pthread_condattr_destroy(&attr);
+	*cond = handle;
+	return 0;
+}
+
+s32 LWP_CondDestroy(cond_t cond) {
+	return 0;
+}
+
+s32 LWP_CondWait(cond_t cond, mutex_t mutex) {
+	return pthread_cond_wait(&conds[cond], &mutexes[mutex]);
+}
+
+s32 LWP_CondTimedWait(cond_t cond, mutex_t mutex, const struct timespec *reltime) {
+	struct timespec abstime;
+	clock_gettime(CLOCK_MONOTONIC, &abstime);
+	abstime.tv_sec += reltime->tv_sec;
+	abstime.tv_nsec += reltime->tv_nsec;
+	if(abstime.tv_nsec >= 1000000000) {
+		abstime.tv_sec++;
+		abstime.tv_nsec -= 1000000000;
+	}
+	int ret = pthread_cond_timedwait(&conds[cond], &mutexes[mutex], &abstime);
+	return ret == ETIMEDOUT ? ETIMEDOUT : ret;
+}
+
+s32 LWP_CondSignal(cond_t cond) {
+	return pthread_cond_signal(&conds[cond]);
+}
+
+s32 LWP_CondBroadcast(cond_t cond) {
+	return pthread_cond_broadcast(&conds[cond]);
+}
+
+static pthread_mutex_t irqMutex = PTHREAD_MUTEX_INITIALIZER;
+
+u32 IRQ_Disable(void) {
+	pthread_mutex_lock(&irqMutex);
+	return 1;
+}
+
+void IRQ_Restore(u32 level) {
+	pthread_mutex_unlock(&irqMutex);
+}
+
+u32 SYS_GetArena1Lo(void) {
+	return 0x80000000;
+}
+
+u32 SYS_GetArena1Hi(void) {
+	return 0x80000000 + 24*1024*1024;
+}
+
+u64 gettime(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return secs_to_ticks(now.tv_sec) + (u64)now.tv_nsec * (TB_TIMER_CLOCK/125) / 8000;
+}
+
+u32 gettick(void) {
+	return (u32)gettime();
+}
+
+u64 diff_ticks(u64 start, u64 end) {
+	return end - start;
+}
+
+u32 diff_sec(u64 start, u64 end) {
+	return ticks_to_secs(diff_ticks(start, end));
+}
+
+u32 diff_msec(u64 start, u64 end) {
+	return ticks_to_millisecs(diff_ticks(start, end));
+}
+
+u32 diff_usec(u64 start, u64 end) {
+	return ticks_to_microsecs(diff_ticks(start, end));
+}
+
+int geckoHostCapture;
+u8 *geckoHostOutput;
+u32 geckoHostOutputLen;
+static u32 geckoHostOutputSize;
+static pthread_mutex_t geckoMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void geckoCapture(const void *data, u32 len) {
+	pthread_mutex_lock(&geckoMutex);
+	if(geckoHostOutputLen + len > geckoHostOutputSize) {
+		geckoHostOutputSize = MAX(geckoHostOutputSize * 2, geckoHostOutputLen + len + 4096);
+		geckoHostOutput = realloc(geckoHostOutput, geckoHostOutputSize);
+	}
+	memcpy(geckoHostOutput + geckoHostOutputLen, data, len);
+	geckoHostOutputLen += len;
+	pthread_mutex_unlock(&geckoMutex);
+}
+
+void geckoHostReset(void) {
+	pthread_mutex_lock(&geckoMutex);
+	geckoHostOutputLen = 0;
+	pthread_mutex_unlock(&geckoMutex);
+}
+
+void logPrint(int level, const char* fmt, ...) {
+	static int logLevel = -2;
+	if(logLevel == -2) {
+		const char *env = getenv("WAKEMII_LOG");
+		logLevel = env ? atoi(env) : -1;
+	}
+	va_list arglist;
+	if(geckoHostCapture) {
+		char line[256];
+		va_start(arglist, fmt);
+		int len = vsnprintf(line, sizeof(line), fmt, arglist);
+		va_end(arglist);
+		geckoCapture(line, MIN(MAX(len, 0), sizeof(line) - 1));
+	}
+	if(level > logLevel) {
+		return;
+	}
+	va_start(arglist, fmt);
+	vfprintf(stderr, fmt, arglist);
+	va_end(arglist);
+}
+
+void send_gecko(const void *data, int len) {
+	if(geckoHostCapture && len > 0) {
+		geckoCapture(data, len);
+	}
+}
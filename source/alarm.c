@@ -0,0 +1,271 @@
+/*===========================================
+        WakeMii - Alarm scheduling
+
+        Works out when the alarms, snooze and hourly chime are next due
+        and sleeps on a condition until the earliest of them, rather than
+        the main loop comparing the time every frame. Each time it wakes it
+        looks at everything that came due since it last looked, so a stalled
+        thread or a clock that jumped forward still fires what it passed
+        over (unless it's too late to be worth it), and a clock that jumped
+        back doesn't fire the same alarm twice. What happened is left for
+        the main loop to pick up with alarmTakeEvents().
+
+        Times are seconds from time(), the console clock is local time so
+        there's no time zone to apply.
+============================================*/
+#include <gccore.h>
+#include <time.h>
+#include <ogc/lwp_watchdog.h>
+#include "alarm.h"
+#include "settings.h"
+#include "library.h"
+#include "gecko.h"
+
+#define SCHEDULER_PRIORITY 72
+#define SCHEDULER_STACK_SIZE (16*1024)
+#define SECS_PER_DAY (24*60*60)
+#define SECS_PER_HOUR (60*60)
+
+int alarmGoingOff = 0;
+int hourlyGoingOff = 0;
+int alarmArmed = 0;
+
+static mutex_t schedMutex;
+static cond_t schedCond;
+static cond_t eventCond;
+static lwp_t schedThread = LWP_THREAD_NULL;
+static volatile int pendingEvents;
+static int rescheduled;			// look again now rather than at the deadline
+
+// All in time() seconds, 0 for none
+static time_t lastLook;
+static time_t firedAt[MAX_ALARMS];	// the last time each alarm went off, never twice for the same one
+static time_t ringUntil;
+static time_t chimeUntil;
+static time_t snoozeUntil;
+static time_t armedFor;
+static int ringing;
+static int chiming;
+
+static int weekday(time_t t) {
+	return (t / SECS_PER_DAY + 4) % 7;	// 1970-01-01 was a Thursday
+}
+
+// First time alarm is due after after, 0 if it's not on any day.
+static time_t nextAlarm(struct alarm_setting *alarm, time_t after) {
+	time_t day = after - after % SECS_PER_DAY;
+	for(int i = 0; i < 8; i++, day += SECS_PER_DAY) {
+		time_t due = day + (alarm->hrs * 60 + alarm->mins) * 60;
+		if(due > after && (alarm->days & (1 << weekday(day)))) {
+			return due;
+		}
+	}
+	return 0;
+}
+
+// The next time any alarm or the snooze goes off after after.
+static time_t nextRing(time_t after) {
+	time_t next = snoozeUntil > after ? snoozeUntil : 0;
+	for(int i = 0; i < MAX_ALARMS; i++) {
+		if(!alarms[i].on) {
+			continue;
+		}
+		time_t due = nextAlarm(&alarms[i], after);
+		if(due && due == firedAt[i]) {
+			// Already went off, the clock's been put back over it
+			due = nextAlarm(&alarms[i], due);
+		}
+		if(due && (!next || due < next)) {
+			next = due;
+		}
+	}
+	return next;
+}
+
+static int chimesOn() {
+	return num_hourly && hourlyAlarmOn && !continuousPlayOn;
+}
+
+static time_t earliest(time_t a, time_t b) {
+	if(!a) {
+		return b;
+	}
+	return b && b < a ? b : a;
+}
+
+// Fires whatever came due in (lastLook, now], returns when to look again.
+static time_t schedule(time_t now) {
+	int events = 0;
+	if(!lastLook) {
+		// Booting during the alarm's minute still sets it off
+		lastLook = now - now % 60 - 1;
+	}
+	else if(now < lastLook) {
+		// The clock went back, what already went off won't go off again
+		lastLook = now;
+	}
+
+	// Alarms and the snooze, anything the clock jumped well past is let go
+	int due = 0;
+	time_t from = now - lastLook > ALARM_LATE_SECS ? now - ALARM_LATE_SECS : lastLook;
+	for(int i = 0; i < MAX_ALARMS; i++) {
+		if(!alarms[i].on) {
+			continue;
+		}
+		time_t missed = nextAlarm(&alarms[i], lastLook);
+		if(missed && missed <= from) {
+			print_gecko("Alarm %i missed by %i seconds, the clock must have jumped\r\n", i + 1, (int)(now - missed));
+		}
+		time_t at = nextAlarm(&alarms[i], from);
+		if(at && at <= now && at != firedAt[i]) {
+			firedAt[i] = at;
+			due = 1;
+		}
+	}
+	if(snoozeUntil && snoozeUntil <= now) {
+		snoozeUntil = 0;
+		due = 1;
+	}
+	if(due && !ringing) {
+		print_gecko("Alarm triggered!\r\n");
+		ringing = 1;
+		events |= ALARM_STARTED;
+	}
+	if(due) {
+		ringUntil = now + ALARM_RING_SECS;
+		armedFor = 0;
+	}
+	if(ringing && now >= ringUntil) {
+		ringing = 0;
+		events |= ALARM_ENDED;
+	}
+
+	// Hourly chime, unless an alarm's going off instead
+	time_t hour = lastLook - lastLook % SECS_PER_HOUR + SECS_PER_HOUR;
+	if(hour <= now && now - hour < HOURLY_CHIME_SECS && chimesOn() && !ringing && !chiming) {
+		print_gecko("Hourly alarm triggered!\r\n");
+		chiming = 1;
+		chimeUntil = hour + HOURLY_CHIME_SECS;
+		events |= HOURLY_STARTED;
+	}
+	if(chiming && now >= chimeUntil) {
+		chiming = 0;
+		events |= HOURLY_ENDED;
+	}
+
+	// Arm shortly before the next alarm, disarm if that's changed since
+	time_t next = nextRing(now);
+	if(armedFor && armedFor != next) {
+		armedFor = 0;
+		events |= ALARM_DISARMED;
+	}
+	if(next && next - now <= ALARM_PREARM_SECS && !armedFor && !ringing) {
+		print_gecko("Alarm armed, %i seconds to go\r\n", (int)(next - now));
+		armedFor = next;
+		events |= ALARM_ARMED;
+	}
+
+	lastLook = now;
+	if(events) {
+		pendingEvents |= events;
+		LWP_CondBroadcast(eventCond);
+	}
+
+	// Look again at the next thing due
+	time_t wake = earliest(next, hour + (hour <= now ? SECS_PER_HOUR : 0));
+	if(next && next - ALARM_PREARM_SECS > now) {
+		wake = earliest(wake, next - ALARM_PREARM_SECS);
+	}
+	if(ringing) {
+		wake = earliest(wake, ringUntil);
+	}
+	if(chiming) {
+		wake = earliest(wake, chimeUntil);
+	}
+	return earliest(wake, now + SCHEDULER_RESYNC_SECS);
+}
+
+static void* schedulerThread(void *arg) {
+	LWP_MutexLock(schedMutex);
+	while(1) {
+		time_t now = time(NULL);
+		time_t wake = schedule(now);
+		// Sleep until the tick that's due, only a settings change or snooze wakes us any sooner
+		u64 deadline = gettime() + secs_to_ticks(wake - now);
+		rescheduled = 0;
+		while(!rescheduled) {
+			u64 ticks = gettime();
+			if(ticks >= deadline) {
+				break;
+			}
+			u64 left = deadline - ticks;
+			struct timespec timeout;
+			timeout.tv_sec = ticks_to_secs(left);
+			timeout.tv_nsec = (ticks_to_microsecs(left) % 1000000) * 1000;
+			LWP_CondTimedWait(schedCond, schedMutex, &timeout);
+		}
+	}
+	LWP_MutexUnlock(schedMutex);
+	return NULL;
+}
+
+void alarmInit() {
+	LWP_MutexInit(&schedMutex, false);
+	LWP_CondInit(&schedCond);
+	LWP_CondInit(&eventCond);
+	LWP_CreateThread(&schedThread, schedulerThread, NULL, NULL, SCHEDULER_STACK_SIZE, SCHEDULER_PRIORITY);
+}
+
+// Call after changing any alarm settings so the scheduler looks again now.
+void alarmScheduleChanged() {
+	LWP_MutexLock(schedMutex);
+	rescheduled = 1;
+	LWP_CondSignal(schedCond);
+	LWP_MutexUnlock(schedMutex);
+}
+
+// Returns a mask of ALARM_* / HOURLY_* events since the last call, and updates
+// alarmGoingOff and friends to match. Nothing to do most frames.
+int alarmTakeEvents() {
+	if(!pendingEvents) {
+		return 0;
+	}
+	LWP_MutexLock(schedMutex);
+	int events = pendingEvents;
+	pendingEvents = 0;
+	alarmGoingOff = ringing;
+	hourlyGoingOff = chiming;
+	alarmArmed = armedFor != 0;
+	LWP_MutexUnlock(schedMutex);
+	return events;
+}
+
+// Sleeps until there are events to take or ms have gone by, returns whether there are.
+int alarmWaitEvents(u32 ms) {
+	LWP_MutexLock(schedMutex);
+	if(!pendingEvents) {
+		struct timespec timeout;
+		timeout.tv_sec = ms / 1000;
+		timeout.tv_nsec = (ms % 1000) * 1000000;
+		LWP_CondTimedWait(eventCond, schedMutex, &timeout);
+	}
+	int waiting = pendingEvents != 0;
+	LWP_MutexUnlock(schedMutex);
+	return waiting;
+}
+
+// Stops the alarm going off for snoozeMins, returns 0 if it wasn't going off.
+int alarmSnooze() {
+	LWP_MutexLock(schedMutex);
+	int snoozed = ringing;
+	if(ringing) {
+		ringing = 0;
+		alarmGoingOff = 0;
+		snoozeUntil = time(NULL) + snoozeMins * 60;
+		print_gecko("Snoozing for %i minutes\r\n", snoozeMins);
+		rescheduled = 1;
+		LWP_CondSignal(schedCond);
+	}
+	LWP_MutexUnlock(schedMutex);
+	return snoozed;
+}
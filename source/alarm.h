@@ -0,0 +1,35 @@
+#ifndef __ALARM_H__
+#define __ALARM_H__
+
+#include <gccore.h>
+#include <time.h>
+
+// What alarmTakeEvents() reports happened
+#define ALARM_STARTED	(1<<0)
+#define ALARM_ENDED		(1<<1)
+#define HOURLY_STARTED	(1<<2)
+#define HOURLY_ENDED	(1<<3)
+#define ALARM_ARMED		(1<<4)
+#define ALARM_DISARMED	(1<<5)
+
+// How long before it's due the alarm track gets picked, opened and read in
+#define ALARM_PREARM_SECS 45
+// How long the alarm and hourly chime count as going off for
+#define ALARM_RING_SECS 60
+#define HOURLY_CHIME_SECS 60
+// An alarm the clock jumped past still goes off if it's no later than this
+#define ALARM_LATE_SECS 120
+// Look at the clock at least this often in case it's been changed
+#define SCHEDULER_RESYNC_SECS 60
+
+extern int alarmGoingOff;
+extern int hourlyGoingOff;
+extern int alarmArmed;
+
+void alarmInit();
+void alarmScheduleChanged();
+int alarmTakeEvents();
+int alarmWaitEvents(u32 ms);
+int alarmSnooze();
+
+#endif
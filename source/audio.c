@@ -0,0 +1,208 @@
+/*===========================================
+        WakeMii - Audio output
+
+        One ASND voice streaming from a ring of buffers that the player's
+        thread fills. Whenever the voice wants more, its callback hands
+        over the next full buffer, or a short stretch of silence if the
+        player hasn't got one ready, so the voice never stops mid stream
+        and every bit of silence that gets played is accounted for. The
+        player works out the gap between two tracks from that.
+============================================*/
+#include <gccore.h>
+#include <string.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <asndlib.h>
+#include "audio.h"
+
+#define AUDIO_VOICE 0
+#define AUDIO_WAIT_US 4000				// how often a full ring or a drain gets looked at again
+
+static s16 *buffers;
+static u32 bufferCounts[AUDIO_BUFFERS];	// samples in each one, once it's full
+static s16 *silence;
+static volatile u32 filled;				// buffers ever filled, by the player's thread
+static volatile u32 handed;				// buffers ever handed to the voice, by the callback
+static volatile u32 silent;				// samples of silence the callback has handed over
+static volatile u32 silentBefore[AUDIO_HISTORY];	// what silent was when each buffer was handed over
+static u32 padded;						// samples of silence buffers were padded out with
+static u32 paddedBefore[AUDIO_HISTORY];	// what padded was before each buffer
+static u32 filling;						// samples in the buffer being filled
+static volatile int draining;			// let the voice run out instead of padding it with silence
+static volatile int stopped;
+static int voiceOn;
+static u32 rate;
+static u32 volume = MAX_VOLUME;
+
+static s16* bufferAt(u32 n) {
+	return buffers + (n % AUDIO_BUFFERS) * AUDIO_BUFFER_SAMPLES * 2;
+}
+
+// Hands the voice the next full buffer if there is one and it has room for it.
+static int audioFeed(s32 voice) {
+	u32 n = handed;
+	if(n == filled || ASND_AddVoice(voice, bufferAt(n), bufferCounts[n % AUDIO_BUFFERS] * 4) != SND_OK) {
+		return 0;
+	}
+	silentBefore[n % AUDIO_HISTORY] = silent;
+	handed = n + 1;
+	return 1;
+}
+
+// Called from the audio interrupt whenever the voice moves on, mustn't block.
+static void audioCallback(s32 voice) {
+	if(handed == filled && !draining && !stopped) {
+		if(ASND_AddVoice(voice, silence, AUDIO_SILENCE_SAMPLES * 4) == SND_OK) {
+			silent += AUDIO_SILENCE_SAMPLES;
+		}
+	}
+	else {
+		audioFeed(voice);
+	}
+}
+
+static void audioStartVoice() {
+	u32 n = handed;
+	silentBefore[n % AUDIO_HISTORY] = silent;
+	handed = n + 1;
+	voiceOn = 1;
+	u32 level = IRQ_Disable();
+	ASND_SetVoice(AUDIO_VOICE, VOICE_STEREO_16BIT, rate, 0, bufferAt(n), bufferCounts[n % AUDIO_BUFFERS] * 4, volume, volume, audioCallback);
+	audioFeed(AUDIO_VOICE);
+	IRQ_Restore(level);
+}
+
+// Finishes off the buffer being filled. The voice starts once there are two, so it has the
+// second to go on to, after that the callback keeps it going.
+static void audioCommit() {
+	u32 n = filled;
+	s16 *buffer = bufferAt(n);
+	// ASND only takes whole 32 byte blocks
+	u32 count = (filling + 7) & ~7;
+	memset(buffer + filling * 2, 0, (count - filling) * 4);
+	bufferCounts[n % AUDIO_BUFFERS] = count;
+	paddedBefore[n % AUDIO_HISTORY] = padded;
+	padded += count - filling;
+	DCFlushRange(buffer, count * 4);
+	filling = 0;
+	filled = n + 1;
+	if(!voiceOn) {
+		if(filled - handed >= 2) {
+			audioStartVoice();
+		}
+	}
+	else {
+		u32 level = IRQ_Disable();
+		audioFeed(AUDIO_VOICE);
+		IRQ_Restore(level);
+	}
+}
+
+void audioInit() {
+	buffers = memalign(32, AUDIO_BUFFERS * AUDIO_BUFFER_SAMPLES * 4);
+	silence = memalign(32, AUDIO_SILENCE_SAMPLES * 4);
+	memset(silence, 0, AUDIO_SILENCE_SAMPLES * 4);
+	DCFlushRange(silence, AUDIO_SILENCE_SAMPLES * 4);
+	ASND_Init();
+	ASND_Pause(0);
+}
+
+// Gets ready for a new stream, on the thread that's going to write it.
+void audioStart() {
+	ASND_StopVoice(AUDIO_VOICE);
+	voiceOn = 0;
+	filled = handed = 0;
+	filling = 0;
+	silent = 0;
+	padded = 0;
+	draining = 0;
+	stopped = 0;
+}
+
+// Queues count stereo samples, waiting while all the buffers are full. 0 once audioStop() was called.
+int audioWrite(const s16 *samples, u32 count, u32 sampleRate) {
+	if(voiceOn && sampleRate != rate) {
+		// Whatever's queued was meant for the old rate, so it has to play out first
+		audioDrain();
+	}
+	rate = sampleRate;
+	while(count && !stopped) {
+		if(!filling) {
+			// Two buffers can be with the voice, the one playing and the one after
+			while(filled - handed >= AUDIO_BUFFERS - 2 && !stopped) {
+				usleep(AUDIO_WAIT_US);
+			}
+			if(stopped) {
+				break;
+			}
+		}
+		u32 n = MIN(count, AUDIO_BUFFER_SAMPLES - filling);
+		memcpy(bufferAt(filled) + filling * 2, samples, n * 4);
+		filling += n;
+		samples += n * 2;
+		count -= n;
+		if(filling == AUDIO_BUFFER_SAMPLES) {
+			audioCommit();
+		}
+	}
+	return !stopped;
+}
+
+// Sends off the buffer being filled as it is, for when nothing more is coming for a while.
+// Otherwise the end of what's been written would wait behind any silence the voice needs.
+void audioFlush() {
+	if(filling) {
+		audioCommit();
+	}
+}
+
+// Plays out everything that's been written and lets the voice stop.
+void audioDrain() {
+	audioFlush();
+	if(!voiceOn && handed != filled) {
+		audioStartVoice();
+	}
+	draining = 1;
+	while(voiceOn && !stopped && (handed != filled || ASND_StatusVoice(AUDIO_VOICE) != SND_UNUSED)) {
+		usleep(AUDIO_WAIT_US);
+	}
+	ASND_StopVoice(AUDIO_VOICE);
+	voiceOn = 0;
+	draining = 0;
+}
+
+// Silences the output straight away, from any thread. audioWrite() and audioDrain() return.
+void audioStop() {
+	stopped = 1;
+	ASND_StopVoice(AUDIO_VOICE);
+}
+
+// The buffer the last sample written went in.
+u32 audioLastBuffer() {
+	return filling ? filled : filled - 1;
+}
+
+// The buffer the next sample written goes in.
+u32 audioNextBuffer() {
+	return filled;
+}
+
+// Silence played between the start of buffer from and the start of buffer to. 0 if to
+// hasn't got to the voice yet, -1 if from is too long ago to say.
+int audioSilenceBetween(u32 from, u32 to, u32 *samples) {
+	u32 n = handed;
+	if(n - from > AUDIO_HISTORY) {
+		return -1;
+	}
+	if(n <= to) {
+		return 0;
+	}
+	*samples = silentBefore[to % AUDIO_HISTORY] - silentBefore[from % AUDIO_HISTORY];
+	*samples += paddedBefore[to % AUDIO_HISTORY] - paddedBefore[from % AUDIO_HISTORY];
+	return 1;
+}
+
+void audioVolume(u32 vol) {
+	volume = MIN(vol, MAX_VOLUME);
+	ASND_ChangeVolumeVoice(AUDIO_VOICE, volume, volume);
+}
@@ -0,0 +1,22 @@
+#ifndef __AUDIO_H__
+#define __AUDIO_H__
+
+#include <gccore.h>
+
+#define AUDIO_BUFFER_SAMPLES 2048		// stereo samples per output buffer, about 46ms at 44.1kHz
+#define AUDIO_BUFFERS 6
+#define AUDIO_SILENCE_SAMPLES 256		// played whenever the buffers run dry mid stream
+#define AUDIO_HISTORY 64				// buffers the silence before each is remembered for
+
+void audioInit();
+void audioStart();
+int audioWrite(const s16 *samples, u32 count, u32 sampleRate);
+void audioFlush();
+void audioDrain();
+void audioStop();
+u32 audioLastBuffer();
+u32 audioNextBuffer();
+int audioSilenceBetween(u32 from, u32 to, u32 *samples);
+void audioVolume(u32 volume);
+
+#endif
@@ -0,0 +1,577 @@
+/*===========================================
+        WakeMii - Cover decoding
+
+        Large covers are scaled down while they're decoded (the JPEG IDCT
+        does the power of two part, a box filter does the rest, one row at
+        a time) so the full size bitmap never has to sit in memory. The
+        result is written into GRRLIB's GX RGBA8 tile layout directly and
+        saved to /wakemii/cache, the next load is then a single read
+        straight into the texture with no decoding at all.
+
+        Art embedded in a track's ID3 tag is decoded the same way, read
+        straight out of the track from where the picture starts. Neither
+        decoder is let near the whole image at once: libjpeg gets a memory
+        cap (only progressive JPEGs need the whole image, those over it are
+        given up on) and libpng a size limit. An interlaced PNG is only
+        decoded whole if that fits in the same cap, a bigger one is scaled
+        from its last pass (every pixel of the odd rows). BMPs are read a
+        row at a time here rather than by GRRLIB.
+============================================*/
+#include <grrlib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <sys/stat.h>
+#include <png.h>
+#include <jpeglib.h>
+#include "coverload.h"
+#include "tags.h"
+#include "gecko.h"
+
+#define COVER_TEX_MAGIC 0x57435458	// "WCTX"
+#define COVER_TEX_VERSION 1
+
+struct cover_tex_header {
+	u32 magic;
+	u32 version;
+	u32 src_size;		// the cover file this was made from
+	u32 src_mtime;
+	u16 width;
+	u16 height;
+	u32 data_size;		// GX RGBA8 tiles, exactly as GRRLIB keeps them in memory
+};
+
+struct box_scaler {
+	u32 srcW;
+	u32 srcH;
+	u32 outW;
+	u32 outH;
+	u32 *acc;			// r,g,b,a sums and pixel count for each column of the output row being built
+	u16 *colMap;		// output column for each source column
+	u32 outRow;
+	GRRLIB_texImg *tex;
+};
+
+// Only the cover worker decodes, these are static so they survive a longjmp out of libpng/libjpeg
+static struct box_scaler scaler;
+static u8 *decodeRow;
+
+static void setTexel(GRRLIB_texImg *tex, u32 x, u32 y, u8 r, u8 g, u8 b, u8 a) {
+	u8 *data = tex->data;
+	u32 offs = (((y >> 2) << 4) * tex->w) + ((x >> 2) << 6) + ((((y & 3) << 2) + (x & 3)) << 1);
+	data[offs] = a;
+	data[offs+1] = r;
+	data[offs+32] = g;
+	data[offs+33] = b;
+}
+
+// Fits the box covers are drawn in, never scales up. GX tiles want multiples of 4.
+static void coverOutSize(u32 srcW, u32 srcH, u32 *outW, u32 *outH) {
+	float scale = MIN((float)COVER_MAX_W/(float)srcW, (float)COVER_MAX_H/(float)srcH);
+	if(scale > 1.0f) {
+		scale = 1.0f;
+	}
+	*outW = MAX(4, ((u32)(srcW * scale)) & ~3);
+	*outH = MAX(4, ((u32)(srcH * scale)) & ~3);
+}
+
+static void scalerFree(struct box_scaler *sc) {
+	free(sc->acc);
+	free(sc->colMap);
+	if(sc->tex) {
+		GRRLIB_FreeTexture(sc->tex);
+	}
+	memset(sc, 0, sizeof(struct box_scaler));
+}
+
+static int scalerInit(struct box_scaler *sc, u32 srcW, u32 srcH) {
+	memset(sc, 0, sizeof(struct box_scaler));
+	sc->srcW = srcW;
+	sc->srcH = srcH;
+	coverOutSize(srcW, srcH, &sc->outW, &sc->outH);
+	sc->acc = calloc(sc->outW * 5, sizeof(u32));
+	sc->colMap = malloc(srcW * sizeof(u16));
+	sc->tex = GRRLIB_CreateEmptyTexture(sc->outW, sc->outH);
+	if(!sc->acc || !sc->colMap || !sc->tex) {
+		scalerFree(sc);
+		return 0;
+	}
+	for(u32 x = 0; x < srcW; x++) {
+		sc->colMap[x] = (u16)(((u64)x * sc->outW) / srcW);
+	}
+	return 1;
+}
+
+static void scalerFlushRow(struct box_scaler *sc) {
+	for(u32 ox = 0; ox < sc->outW; ox++) {
+		u32 *px = &sc->acc[ox*5];
+		if(px[4]) {
+			setTexel(sc->tex, ox, sc->outRow, px[0]/px[4], px[1]/px[4], px[2]/px[4], px[3]/px[4]);
+		}
+	}
+	memset(sc->acc, 0, sc->outW * 5 * sizeof(u32));
+}
+
+// Adds source row y (RGB or RGBA, bpp 3 or 4) into the output, rows must come in order
+// (top down or bottom up).
+static void scalerRow(struct box_scaler *sc, u32 y, const u8 *row, int bpp) {
+	u32 oy = (u32)(((u64)y * sc->outH) / sc->srcH);
+	if(oy >= sc->outH) {
+		return;
+	}
+	if(oy != sc->outRow) {
+		scalerFlushRow(sc);
+		sc->outRow = oy;
+	}
+	for(u32 x = 0; x < sc->srcW; x++, row += bpp) {
+		u32 *px = &sc->acc[sc->colMap[x]*5];
+		px[0] += row[0];
+		px[1] += row[1];
+		px[2] += row[2];
+		px[3] += bpp == 4 ? row[3] : 0xFF;
+		px[4]++;
+	}
+}
+
+static GRRLIB_texImg* scalerFinish(struct box_scaler *sc) {
+	scalerFlushRow(sc);
+	GRRLIB_texImg *tex = sc->tex;
+	sc->tex = NULL;
+	scalerFree(sc);
+	GRRLIB_FlushTex(tex);
+	return tex;
+}
+
+struct jpeg_error {
+	struct jpeg_error_mgr mgr;
+	jmp_buf jmp;
+};
+
+static void jpegErrorExit(j_common_ptr cinfo) {
+	longjmp(((struct jpeg_error*)cinfo->err)->jmp, 1);
+}
+
+static GRRLIB_texImg* decodeJpeg(FILE *fp) {
+	struct jpeg_decompress_struct cinfo;
+	struct jpeg_error err;
+	cinfo.err = jpeg_std_error(&err.mgr);
+	err.mgr.error_exit = jpegErrorExit;
+	if(setjmp(err.jmp)) {
+		error_gecko("Cover JPEG decode failed\r\n");
+		jpeg_destroy_decompress(&cinfo);
+		free(decodeRow);
+		decodeRow = NULL;
+		scalerFree(&scaler);
+		return NULL;
+	}
+	jpeg_create_decompress(&cinfo);
+	cinfo.mem->max_memory_to_use = COVER_DECODE_MAX_MEM;
+	jpeg_stdio_src(&cinfo, fp);
+	jpeg_read_header(&cinfo, TRUE);
+	cinfo.out_color_space = JCS_RGB;
+	// Let the IDCT do as much of the downscaling as it can without going under the final size
+	u32 outW, outH;
+	coverOutSize(cinfo.image_width, cinfo.image_height, &outW, &outH);
+	cinfo.scale_num = 1;
+	cinfo.scale_denom = 1;
+	while(cinfo.scale_denom < 8 && cinfo.image_width / (cinfo.scale_denom*2) >= outW
+		&& cinfo.image_height / (cinfo.scale_denom*2) >= outH) {
+		cinfo.scale_denom *= 2;
+	}
+	jpeg_start_decompress(&cinfo);
+	debug_gecko("Cover JPEG %ix%i decoding at 1/%i\r\n", cinfo.image_width, cinfo.image_height, cinfo.scale_denom);
+	decodeRow = malloc(cinfo.output_width * cinfo.output_components);
+	if(!decodeRow || !scalerInit(&scaler, cinfo.output_width, cinfo.output_height)) {
+		longjmp(err.jmp, 1);
+	}
+	while(cinfo.output_scanline < cinfo.output_height) {
+		u32 y = cinfo.output_scanline;
+		jpeg_read_scanlines(&cinfo, &decodeRow, 1);
+		scalerRow(&scaler, y, decodeRow, 3);
+	}
+	jpeg_finish_decompress(&cinfo);
+	jpeg_destroy_decompress(&cinfo);
+	free(decodeRow);
+	decodeRow = NULL;
+	return scalerFinish(&scaler);
+}
+
+static GRRLIB_texImg* decodePng(FILE *fp) {
+	png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	png_infop info = png ? png_create_info_struct(png) : NULL;
+	if(!info) {
+		png_destroy_read_struct(&png, NULL, NULL);
+		return NULL;
+	}
+	if(setjmp(png_jmpbuf(png))) {
+		error_gecko("Cover PNG decode failed\r\n");
+		png_destroy_read_struct(&png, &info, NULL);
+		free(decodeRow);
+		decodeRow = NULL;
+		scalerFree(&scaler);
+		return NULL;
+	}
+	png_set_user_limits(png, COVER_DECODE_MAX_DIM, COVER_DECODE_MAX_DIM);
+	png_init_io(png, fp);
+	png_read_info(png, info);
+	// Everything comes out as 8 bit RGBA
+	png_set_expand(png);
+	png_set_strip_16(png);
+	png_set_gray_to_rgb(png);
+	png_set_filler(png, 0xFF, PNG_FILLER_AFTER);
+	u32 w = png_get_image_width(png, info);
+	u32 h = png_get_image_height(png, info);
+	int interlaced = png_get_interlace_type(png, info) != PNG_INTERLACE_NONE;
+	int whole = interlaced && (u64)w * h * 4 <= COVER_DECODE_MAX_MEM;
+	if(whole) {
+		// libpng puts the passes back together
+		png_set_interlace_handling(png);
+	}
+	png_read_update_info(png, info);
+	u32 rowBytes = png_get_rowbytes(png, info);
+	debug_gecko("Cover PNG %ix%i%s\r\n", w, h, interlaced ? (whole ? ", interlaced" : ", interlaced, from its last pass") : "");
+	decodeRow = malloc(whole ? rowBytes * h : rowBytes);
+	if(!decodeRow || !scalerInit(&scaler, w, h)) {
+		png_error(png, "out of memory");
+	}
+	if(whole) {
+		for(int pass = 0; pass < 7; pass++) {
+			for(u32 y = 0; y < h; y++) {
+				png_read_row(png, decodeRow + y * rowBytes, NULL);
+			}
+		}
+		for(u32 y = 0; y < h; y++) {
+			scalerRow(&scaler, y, decodeRow + y * rowBytes, 4);
+		}
+	}
+	else if(interlaced) {
+		// The earlier passes are read past, each odd row stands in for the even one above it too
+		for(int pass = 0; pass < 7; pass++) {
+			u32 rows = PNG_PASS_COLS(w, pass) ? PNG_PASS_ROWS(h, pass) : 0;
+			for(u32 r = 0; r < rows; r++) {
+				png_read_row(png, decodeRow, NULL);
+				if(pass == 6) {
+					scalerRow(&scaler, r * 2, decodeRow, 4);
+					scalerRow(&scaler, r * 2 + 1, decodeRow, 4);
+				}
+			}
+		}
+		if(h & 1) {
+			scalerRow(&scaler, h - 1, decodeRow, 4);
+		}
+	}
+	else {
+		for(u32 y = 0; y < h; y++) {
+			png_read_row(png, decodeRow, NULL);
+			scalerRow(&scaler, y, decodeRow, 4);
+		}
+	}
+	png_read_end(png, NULL);
+	png_destroy_read_struct(&png, &info, NULL);
+	free(decodeRow);
+	decodeRow = NULL;
+	return scalerFinish(&scaler);
+}
+
+static u32 le16(const u8 *b) {
+	return b[0] | (b[1] << 8);
+}
+
+static u32 le32(const u8 *b) {
+	return b[0] | (b[1] << 8) | (b[2] << 16) | ((u32)b[3] << 24);
+}
+
+// Where a bitfield mask's channel sits and how to get it to 8 bits
+struct bmp_channel {
+	u32 mask;
+	u32 shift;
+	u32 max;
+};
+
+static void bmpChannel(struct bmp_channel *c, u32 mask) {
+	c->mask = mask;
+	c->shift = 0;
+	c->max = 0;
+	if(!mask) {
+		return;
+	}
+	while(!(mask & 1)) {
+		mask >>= 1;
+		c->shift++;
+	}
+	c->max = mask;
+}
+
+static u8 bmpValue(const struct bmp_channel *c, u32 px, u8 none) {
+	return c->max ? (((px & c->mask) >> c->shift) * 255 + c->max / 2) / c->max : none;
+}
+
+// Uncompressed BMPs, 1/4/8 bit paletted or 16/24/32 bit with or without bitfield masks.
+// Rows are read in the order they're stored, bottom up unless the height's negative.
+static GRRLIB_texImg* decodeBmp(FILE *fp) {
+	long base = ftell(fp);
+	u8 hdr[14 + 56];
+	memset(hdr, 0, sizeof(hdr));
+	if(fread(hdr, 1, 18, fp) != 18 || hdr[0] != 'B' || hdr[1] != 'M') {
+		return NULL;
+	}
+	u32 dataOffset = le32(hdr + 10);
+	u32 infoSize = le32(hdr + 14);
+	if(infoSize < 12 || fread(hdr + 18, 1, MIN(infoSize, 56) - 4, fp) != MIN(infoSize, 56) - 4) {
+		return NULL;
+	}
+	const u8 *info = hdr + 14;
+	s32 w, h;
+	u32 bpp, compression = 0, numColours = 0;
+	if(infoSize == 12) {
+		w = le16(info + 4);
+		h = (s16)le16(info + 6);
+		bpp = le16(info + 10);
+	}
+	else {
+		w = le32(info + 4);
+		h = le32(info + 8);
+		bpp = le16(info + 14);
+		compression = le32(info + 16);
+		numColours = le32(info + 32);
+	}
+	int topDown = h < 0;
+	h = abs(h);
+	if(w <= 0 || h <= 0 || w > COVER_DECODE_MAX_DIM || h > COVER_DECODE_MAX_DIM) {
+		return NULL;
+	}
+	// BI_RGB, or BI_BITFIELDS/BI_ALPHABITFIELDS for 16 and 32 bit
+	struct bmp_channel r, g, b, a;
+	u8 masks[16];
+	memset(masks, 0, sizeof(masks));
+	if((compression == 3 || compression == 6) && (bpp == 16 || bpp == 32)) {
+		if(infoSize >= 52) {
+			memcpy(masks, info + 40, infoSize >= 56 ? 16 : 12);
+		}
+		else if(fseek(fp, base + 14 + infoSize, SEEK_SET) || fread(masks, 1, compression == 6 ? 16 : 12, fp) != (compression == 6 ? 16 : 12)) {
+			return NULL;
+		}
+	}
+	else if(compression) {
+		error_gecko("Cover BMP compression %u isn't supported\r\n", compression);
+		return NULL;
+	}
+	else if(bpp == 16) {
+		memcpy(masks, "\x00\x7C\0\0\xE0\x03\0\0\x1F\0\0\0", 12);
+	}
+	else if(bpp == 32 || bpp == 24) {
+		memcpy(masks, "\0\0\xFF\0\0\xFF\0\0\xFF\0\0\0", 12);
+	}
+	bmpChannel(&r, le32(masks));
+	bmpChannel(&g, le32(masks + 4));
+	bmpChannel(&b, le32(masks + 8));
+	bmpChannel(&a, le32(masks + 12));
+
+	u8 palette[256 * 4];
+	if(bpp == 1 || bpp == 4 || bpp == 8) {
+		u32 entrySize = infoSize == 12 ? 3 : 4;
+		u32 count = numColours && numColours <= (1u << bpp) ? numColours : 1u << bpp;
+		memset(palette, 0, sizeof(palette));
+		if(fseek(fp, base + 14 + infoSize + (compression ? 12 : 0), SEEK_SET)
+			|| fread(palette, entrySize, count, fp) != count) {
+			return NULL;
+		}
+		if(entrySize == 3) {
+			for(int i = count - 1; i >= 0; i--) {
+				memmove(palette + i * 4, palette + i * 3, 3);
+			}
+		}
+	}
+	else if(bpp != 16 && bpp != 24 && bpp != 32) {
+		error_gecko("Cover BMP at %u bits per pixel isn't supported\r\n", bpp);
+		return NULL;
+	}
+
+	u32 stride = ((w * bpp + 31) / 32) * 4;
+	debug_gecko("Cover BMP %ix%i, %u bit\r\n", w, h, bpp);
+	decodeRow = malloc(stride + w * 4);
+	if(!decodeRow || !scalerInit(&scaler, w, h) || fseek(fp, base + dataOffset, SEEK_SET)) {
+		free(decodeRow);
+		decodeRow = NULL;
+		scalerFree(&scaler);
+		return NULL;
+	}
+	u8 *rgba = decodeRow + stride;
+	for(s32 n = 0; n < h; n++) {
+		if(fread(decodeRow, 1, stride, fp) != stride) {
+			error_gecko("Cover BMP is cut short\r\n");
+			free(decodeRow);
+			decodeRow = NULL;
+			scalerFree(&scaler);
+			return NULL;
+		}
+		for(s32 x = 0; x < w; x++) {
+			u8 *out = rgba + x * 4;
+			if(bpp <= 8) {
+				u32 bit = x * bpp;
+				u32 index = (decodeRow[bit / 8] >> (8 - bpp - bit % 8)) & ((1 << bpp) - 1);
+				const u8 *c = palette + index * 4;
+				out[0] = c[2];
+				out[1] = c[1];
+				out[2] = c[0];
+				out[3] = 0xFF;
+			}
+			else {
+				const u8 *p = decodeRow + x * (bpp / 8);
+				u32 px = bpp == 16 ? le16(p) : bpp == 24 ? (p[0] | (p[1] << 8) | (p[2] << 16)) : le32(p);
+				out[0] = bmpValue(&r, px, 0);
+				out[1] = bmpValue(&g, px, 0);
+				out[2] = bmpValue(&b, px, 0);
+				out[3] = bmpValue(&a, px, 0xFF);
+			}
+		}
+		scalerRow(&scaler, topDown ? n : h - 1 - n, rgba, 4);
+	}
+	free(decodeRow);
+	decodeRow = NULL;
+	return scalerFinish(&scaler);
+}
+
+static void getCachePath(char *cachePath, const char *cacheKey) {
+	u32 hash = 0x811C9DC5;	// FNV-1a
+	for(const char *c = cacheKey; *c; c++) {
+		hash ^= (u8)*c;
+		hash *= 0x01000193;
+	}
+	sprintf(cachePath, "%s/%08X.tex", COVER_CACHE_DIR, hash);
+}
+
+static GRRLIB_texImg* readCoverCache(const char *cachePath, struct stat *src) {
+	FILE *fp = fopen(cachePath, "rb");
+	if(!fp) {
+		return NULL;
+	}
+	struct cover_tex_header hdr;
+	GRRLIB_texImg *tex = NULL;
+	if(fread(&hdr, 1, sizeof(struct cover_tex_header), fp) == sizeof(struct cover_tex_header)
+		&& hdr.magic == COVER_TEX_MAGIC && hdr.version == COVER_TEX_VERSION
+		&& hdr.src_size == (u32)src->st_size && hdr.src_mtime == (u32)src->st_mtime
+		&& hdr.data_size == (u32)hdr.width * hdr.height * 4) {
+		tex = GRRLIB_CreateEmptyTexture(hdr.width, hdr.height);
+		if(tex && fread(tex->data, 1, hdr.data_size, fp) == hdr.data_size) {
+			GRRLIB_FlushTex(tex);
+		}
+		else if(tex) {
+			GRRLIB_FreeTexture(tex);
+			tex = NULL;
+		}
+	}
+	fclose(fp);
+	return tex;
+}
+
+static void writeCoverCache(const char *cachePath, struct stat *src, GRRLIB_texImg *tex) {
+	struct cover_tex_header hdr;
+	memset(&hdr, 0, sizeof(struct cover_tex_header));
+	hdr.magic = COVER_TEX_MAGIC;
+	hdr.version = COVER_TEX_VERSION;
+	hdr.src_size = src->st_size;
+	hdr.src_mtime = src->st_mtime;
+	hdr.width = tex->w;
+	hdr.height = tex->h;
+	hdr.data_size = tex->w * tex->h * 4;
+	FILE *fp = fopen(cachePath, "wb");
+	if(!fp) {
+		error_gecko("%s failed to create\r\n", cachePath);
+		return;
+	}
+	if(fwrite(&hdr, 1, sizeof(struct cover_tex_header), fp) != sizeof(struct cover_tex_header)
+		|| fwrite(tex->data, 1, hdr.data_size, fp) != hdr.data_size) {
+		error_gecko("%s failed to write\r\n", cachePath);
+		fclose(fp);
+		remove(cachePath);
+		return;
+	}
+	fclose(fp);
+}
+
+void coverLoadInit() {
+	mkdir(COVER_CACHE_DIR, 0777);
+}
+
+// Loads the cover at path, from the converted copy in the cache if it's still up to date.
+GRRLIB_texImg* loadCoverTexture(const char *path, const char *cacheKey) {
+	struct stat src;
+	if(stat(path, &src)) {
+		return NULL;
+	}
+	char cachePath[256];
+	getCachePath(cachePath, cacheKey);
+	GRRLIB_texImg *tex = readCoverCache(cachePath, &src);
+	if(tex) {
+		debug_gecko("Cover %s came from %s\r\n", path, cachePath);
+		return tex;
+	}
+
+	size_t len = strlen(path);
+	if(len < 4) {
+		return NULL;
+	}
+	FILE *fp = fopen(path, "rb");
+	if(!fp) {
+		return NULL;
+	}
+	if(!strcasecmp(path + len - 4, ".jpg")) {
+		tex = decodeJpeg(fp);
+	}
+	else if(!strcasecmp(path + len - 4, ".png")) {
+		tex = decodePng(fp);
+	}
+	else if(!strcasecmp(path + len - 4, ".bmp")) {
+		tex = decodeBmp(fp);
+	}
+	fclose(fp);
+	if(tex) {
+		writeCoverCache(cachePath, &src, tex);
+	}
+	return tex;
+}
+
+// Loads the art embedded in the track at path, NULL if it hasn't got any that can be streamed.
+GRRLIB_texImg* loadEmbeddedCover(const char *path, const char *cacheKey) {
+	struct stat src;
+	if(stat(path, &src)) {
+		return NULL;
+	}
+	char cachePath[256];
+	getCachePath(cachePath, cacheKey);
+	GRRLIB_texImg *tex = readCoverCache(cachePath, &src);
+	if(tex) {
+		debug_gecko("Embedded cover %s came from %s\r\n", path, cachePath);
+		return tex;
+	}
+
+	FILE *fp = fopen(path, "rb");
+	if(!fp) {
+		return NULL;
+	}
+	u32 size = 0;
+	u32 offset = tagsFindPicture(fp, &size);
+	u8 magic[4];
+	if(!offset || size < sizeof(magic) || fseek(fp, offset, SEEK_SET) || fread(magic, 1, sizeof(magic), fp) != sizeof(magic)
+		|| fseek(fp, offset, SEEK_SET)) {
+		fclose(fp);
+		return NULL;
+	}
+	debug_gecko("Embedded cover in %s, %u bytes at %u\r\n", path, size, offset);
+	if(magic[0] == 0xFF && magic[1] == 0xD8) {
+		tex = decodeJpeg(fp);
+	}
+	else if(!memcmp(magic, "\x89PNG", 4)) {
+		tex = decodePng(fp);
+	}
+	else if(magic[0] == 'B' && magic[1] == 'M') {
+		tex = decodeBmp(fp);
+	}
+	fclose(fp);
+	if(tex) {
+		writeCoverCache(cachePath, &src, tex);
+	}
+	return tex;
+}
@@ -0,0 +1,21 @@
+#ifndef __COVERLOAD_H__
+#define __COVERLOAD_H__
+
+#include <grrlib.h>
+#include "paths.h"
+
+#define COVER_CACHE_DIR WAKEMII_DIR "/cache"
+
+// Covers are scaled down on load to fit the box they're drawn in
+#define COVER_MAX_W 500
+#define COVER_MAX_H 360
+
+// What a decode can use besides the texture, a 12 megapixel progressive JPEG would want ~36MB
+#define COVER_DECODE_MAX_MEM (2*1024*1024)
+#define COVER_DECODE_MAX_DIM 8192
+
+void coverLoadInit();
+GRRLIB_texImg* loadCoverTexture(const char *path, const char *cacheKey);
+GRRLIB_texImg* loadEmbeddedCover(const char *path, const char *cacheKey);
+
+#endif
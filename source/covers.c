@@ -0,0 +1,283 @@
+/*===========================================
+        WakeMii - Album cover texture cache
+
+        Covers (the art embedded in an album's first track, or its cover
+        file) are decoded on a worker thread and kept in a small LRU cache
+        with a memory budget, the covers either side of the one on screen
+        (and whatever continuous play has queued up) are decoded ahead of
+        time so flipping albums doesn't stall a frame. The cache itself is
+        only touched from the main thread, the worker just hands back
+        finished textures which get picked up after GRRLIB_Render().
+============================================*/
+#include <grrlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "covers.h"
+#include "profile.h"
+#include "coverload.h"
+#include "library.h"
+#include "gecko.h"
+
+#define COVER_CACHE_ENTRIES 16
+#define COVER_CACHE_MAX_BUDGET (8*1024*1024)
+#define COVER_WANTED 4
+#define COVER_WORKER_PRIORITY 30
+#define COVER_WORKER_STACK_SIZE (64*1024)
+
+struct cover_entry {
+	int albumNum;			// -1 when the slot is free
+	GRRLIB_texImg* tex;		// NULL if the cover failed to load, so it isn't retried
+	u32 size;
+	u32 lastUse;
+};
+
+static struct cover_entry cache[COVER_CACHE_ENTRIES];
+static u32 cacheBytes;
+static u32 cacheBudget;
+static u32 useCounter;
+static u32 hits;
+static u32 misses;
+static int shownAlbum = -1;
+
+// Shared with the worker
+static mutex_t coverMutex;
+static cond_t coverCond;
+static int wanted[COVER_WANTED];		// albums to decode, most important first, -1 for none
+static int decoding = -1;
+static struct {
+	int albumNum;
+	GRRLIB_texImg* tex;
+} ready[COVER_WANTED];
+static int num_ready;
+static lwp_t coverThread = LWP_THREAD_NULL;
+
+char* getCoverExtensionFromType(enum cover_type_t coverType) {
+	switch(coverType) {
+		case COVER_PNG:
+			return "png";
+		case COVER_JPG:
+			return "jpg";
+		case COVER_BMP:
+			return "bmp";
+		default:
+			return NULL;
+	}
+	return NULL;
+}
+
+static GRRLIB_texImg* getCoverFromIdx(int albumNum) {
+	char *coverExt = getCoverExtensionFromType(albumCoverType(albumNum));
+	const char *firstTrack = albumTrackName(albumNum, 0);
+	GRRLIB_texImg* cover = NULL;
+	char absPath[1024];
+	memset(absPath, 0, 1024);
+	u64 profileStart = profileBegin();
+	// Art embedded in the album's first track, then the album's cover file
+	if(firstTrack != NULL) {
+		sprintf(absPath, "%s/%s/%s", ALBUMS_DIR, albumName(albumNum), firstTrack);
+		cover = loadEmbeddedCover(absPath, absPath);
+	}
+	if(cover == NULL && coverExt != NULL) {
+		debug_gecko("Attempting to load the album cover\r\n");
+		sprintf(absPath, "%s/%s/cover.%s", ALBUMS_DIR, albumName(albumNum), coverExt);
+		cover = loadCoverTexture(absPath, albumName(albumNum));
+	}
+	profileEnd(PROF_COVER_LOAD, profileStart);
+	debug_gecko("cover %s ptr %p\r\n", absPath, cover);
+	if(cover != NULL) {
+		debug_gecko("Cover Loaded with width %i height %i\r\n", cover->w, cover->h);
+	}
+	return cover;
+}
+
+static void* coverWorker(void *arg) {
+	LWP_MutexLock(coverMutex);
+	while(1) {
+		int albumNum = -1;
+		for(int i = 0; i < COVER_WANTED; i++) {
+			if(wanted[i] != -1) {
+				albumNum = wanted[i];
+				wanted[i] = -1;
+				break;
+			}
+		}
+		if(albumNum == -1 || num_ready == COVER_WANTED) {
+			LWP_CondWait(coverCond, coverMutex);
+			continue;
+		}
+		decoding = albumNum;
+		LWP_MutexUnlock(coverMutex);
+		GRRLIB_texImg *tex = getCoverFromIdx(albumNum);
+		LWP_MutexLock(coverMutex);
+		decoding = -1;
+		ready[num_ready].albumNum = albumNum;
+		ready[num_ready].tex = tex;
+		num_ready++;
+	}
+	LWP_MutexUnlock(coverMutex);
+	return NULL;
+}
+
+static struct cover_entry* findCached(int albumNum) {
+	for(int i = 0; i < COVER_CACHE_ENTRIES; i++) {
+		if(cache[i].albumNum == albumNum) {
+			return &cache[i];
+		}
+	}
+	return NULL;
+}
+
+// Must be called with coverMutex held
+static int isPending(int albumNum) {
+	if(decoding == albumNum) {
+		return 1;
+	}
+	for(int i = 0; i < num_ready; i++) {
+		if(ready[i].albumNum == albumNum) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// Must be called with coverMutex held
+static void addWanted(int albumNum) {
+	if(albumNum < 0 || albumNum >= num_albums || findCached(albumNum) || isPending(albumNum)) {
+		return;
+	}
+	for(int i = 0; i < COVER_WANTED; i++) {
+		if(wanted[i] == albumNum) {
+			return;
+		}
+		if(wanted[i] == -1) {
+			wanted[i] = albumNum;
+			return;
+		}
+	}
+}
+
+void coverCacheInit() {
+	// A quarter of what was free at boot
+	cacheBudget = MIN((SYS_GetArena1Hi()-SYS_GetArena1Lo())/4, COVER_CACHE_MAX_BUDGET);
+	print_gecko("Cover cache budget: %iKb\r\n", cacheBudget/1024);
+	for(int i = 0; i < COVER_CACHE_ENTRIES; i++) {
+		cache[i].albumNum = -1;
+	}
+	for(int i = 0; i < COVER_WANTED; i++) {
+		wanted[i] = -1;
+	}
+	coverLoadInit();
+	LWP_MutexInit(&coverMutex, false);
+	LWP_CondInit(&coverCond);
+	LWP_CreateThread(&coverThread, coverWorker, NULL, NULL, COVER_WORKER_STACK_SIZE, COVER_WORKER_PRIORITY);
+}
+
+// The album now on screen, its cover is decoded first then the albums either side of it.
+void coverShow(int albumNum) {
+	if(albumNum == shownAlbum) {
+		return;
+	}
+	shownAlbum = albumNum;
+	if(albumNum < 0) {
+		return;
+	}
+	if(findCached(albumNum)) {
+		hits++;
+	}
+	else {
+		misses++;
+	}
+	print_gecko("Cover cache hits %u misses %u\r\n", hits, misses);
+	LWP_MutexLock(coverMutex);
+	for(int i = 0; i < COVER_WANTED; i++) {
+		wanted[i] = -1;
+	}
+	addWanted(albumNum);
+	addWanted(albumNum + 1 < num_albums ? albumNum + 1 : 0);
+	addWanted(albumNum > 0 ? albumNum - 1 : num_albums - 1);
+	LWP_CondSignal(coverCond);
+	LWP_MutexUnlock(coverMutex);
+}
+
+// Decode an album's cover ahead of time, e.g. the album of the next queued track.
+void coverPrefetch(int albumNum) {
+	LWP_MutexLock(coverMutex);
+	addWanted(albumNum);
+	LWP_CondSignal(coverCond);
+	LWP_MutexUnlock(coverMutex);
+}
+
+// Never blocks, NULL until the cover has been decoded (or if there isn't one).
+GRRLIB_texImg* coverGet(int albumNum) {
+	struct cover_entry *entry = findCached(albumNum);
+	if(albumNum < 0 || !entry) {
+		return NULL;
+	}
+	entry->lastUse = ++useCounter;
+	return entry->tex;
+}
+
+static void freeEntry(struct cover_entry *entry) {
+	if(entry->tex) {
+		GRRLIB_FreeTexture(entry->tex);
+	}
+	cacheBytes -= entry->size;
+	entry->albumNum = -1;
+	entry->tex = NULL;
+	entry->size = 0;
+}
+
+static void insertCover(int albumNum, GRRLIB_texImg *tex) {
+	u32 size = tex ? tex->w * tex->h * 4 : 0;
+	struct cover_entry *slot;
+	// Make room, least recently drawn goes first but never the one on screen
+	while(1) {
+		slot = NULL;
+		struct cover_entry *oldest = NULL;
+		for(int i = 0; i < COVER_CACHE_ENTRIES; i++) {
+			if(cache[i].albumNum == -1) {
+				slot = &cache[i];
+			}
+			else if(cache[i].albumNum != shownAlbum && (!oldest || cache[i].lastUse < oldest->lastUse)) {
+				oldest = &cache[i];
+			}
+		}
+		if((slot && cacheBytes + size <= cacheBudget) || !oldest) {
+			break;
+		}
+		print_gecko("Cover cache evicting album %i\r\n", oldest->albumNum);
+		freeEntry(oldest);
+	}
+	if(!slot || (cacheBytes + size > cacheBudget && albumNum != shownAlbum)) {
+		// Doesn't fit at all, only the cover on screen gets to bust the budget
+		if(tex) {
+			GRRLIB_FreeTexture(tex);
+		}
+		return;
+	}
+	slot->albumNum = albumNum;
+	slot->tex = tex;
+	slot->size = size;
+	slot->lastUse = ++useCounter;
+	cacheBytes += size;
+}
+
+// Picks up covers the worker has finished. Call once a frame after GRRLIB_Render()
+// when no evicted texture can still be in use by the GPU.
+void coverCacheUpdate() {
+	if(!num_ready) {
+		return;
+	}
+	LWP_MutexLock(coverMutex);
+	for(int i = 0; i < num_ready; i++) {
+		insertCover(ready[i].albumNum, ready[i].tex);
+	}
+	num_ready = 0;
+	LWP_CondSignal(coverCond);
+	LWP_MutexUnlock(coverMutex);
+}
+
+void coverCacheStats(u32 *hits_out, u32 *misses_out) {
+	*hits_out = hits;
+	*misses_out = misses;
+}
@@ -0,0 +1,13 @@
+#ifndef __COVERS_H__
+#define __COVERS_H__
+
+#include <grrlib.h>
+
+void coverCacheInit();
+void coverShow(int albumNum);
+void coverPrefetch(int albumNum);
+GRRLIB_texImg* coverGet(int albumNum);
+void coverCacheUpdate();
+void coverCacheStats(u32 *hits, u32 *misses);
+
+#endif
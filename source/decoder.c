@@ -0,0 +1,199 @@
+/*===========================================
+        WakeMii - Decoder backends
+
+        Everything that turns the MP3 stream into PCM sits behind a
+        struct decoder_backend, picked by the Decoder setting at boot.
+        player.c drives whichever it is the same way: it opens one on a
+        reader callback pulling from the read-ahead stream, asks it for
+        a frame of stereo samples at a time and seeks it back to the
+        start whenever the stream starts again, the audio output is
+        player.c's (audio.c).
+
+        A new backend goes in its own file and gets a row in backends[]
+        and a name in settings.c, in the same order. NO_LIBMAD leaves
+        libmad's out, for host builds without it.
+============================================*/
+#include <gccore.h>
+#include <stdlib.h>
+#include <string.h>
+#include "decoder.h"
+#include "mp3lite.h"
+#include "settings.h"
+
+#ifndef NO_LIBMAD
+#include <mad.h>
+
+#define MAD_INPUT_SIZE (8*1024)			// comfortably more than the biggest frame
+#define MAD_DELAY 529					// libmad's synthesis filter delay
+
+// libmad, driven directly
+struct mad_state {
+	struct mad_stream stream;
+	struct mad_frame frame;
+	struct mad_synth synth;
+	decoder_reader_t reader;
+	void *cbdata;
+	u32 consumed;						// bytes the reader has handed over
+	u32 inputPos;						// stream position of input[0]
+	int eof;
+	u8 input[MAD_INPUT_SIZE + MAD_BUFFER_GUARD];
+};
+
+static void* madOpen(decoder_reader_t reader, void *cbdata) {
+	struct mad_state *dec = malloc(sizeof(struct mad_state));
+	if(!dec) {
+		return NULL;
+	}
+	memset(dec, 0, sizeof(struct mad_state));
+	mad_stream_init(&dec->stream);
+	mad_frame_init(&dec->frame);
+	mad_synth_init(&dec->synth);
+	dec->reader = reader;
+	dec->cbdata = cbdata;
+	return dec;
+}
+
+static void madClose(void *state) {
+	struct mad_state *dec = state;
+	if(!dec) {
+		return;
+	}
+	mad_synth_finish(&dec->synth);
+	mad_frame_finish(&dec->frame);
+	mad_stream_finish(&dec->stream);
+	free(dec);
+}
+
+// Drops whatever libmad was part way through, the next frame it sees is the first.
+static void madSeek(void *state, u32 streamPos) {
+	struct mad_state *dec = state;
+	mad_synth_finish(&dec->synth);
+	mad_frame_finish(&dec->frame);
+	mad_stream_finish(&dec->stream);
+	mad_stream_init(&dec->stream);
+	mad_frame_init(&dec->frame);
+	mad_synth_init(&dec->synth);
+	dec->consumed = dec->inputPos = streamPos;
+	dec->eof = 0;
+}
+
+// Keeps whatever libmad hasn't got to yet and tops the rest of the input up from the reader.
+static int madFill(struct mad_state *dec) {
+	u32 keep = 0;
+	if(dec->eof) {
+		return 0;
+	}
+	if(dec->stream.next_frame) {
+		keep = dec->stream.bufend - dec->stream.next_frame;
+		memmove(dec->input, dec->stream.next_frame, keep);
+	}
+	dec->inputPos = dec->consumed - keep;
+	s32 got = dec->reader(dec->cbdata, dec->input + keep, MAD_INPUT_SIZE - keep);
+	u32 len = keep;
+	if(got <= 0) {
+		// Zeros after the last frame so libmad decodes it rather than waiting for more
+		memset(dec->input + keep, 0, MAD_BUFFER_GUARD);
+		len += MAD_BUFFER_GUARD;
+		dec->eof = 1;
+	}
+	else {
+		len += got;
+		dec->consumed += got;
+	}
+	mad_stream_buffer(&dec->stream, dec->input, len);
+	dec->stream.error = MAD_ERROR_NONE;
+	return 1;
+}
+
+// The Xing/Info or VBRI frame at the top of a track carries no sound, only the tag.
+static int madIsTagFrame(struct mad_state *dec) {
+	const u8 *f = dec->stream.this_frame;
+	const struct mad_header *h = &dec->frame.header;
+	if(h->layer != MAD_LAYER_III) {
+		return 0;
+	}
+	u32 side;
+	if(h->flags & MAD_FLAG_LSF_EXT) {
+		side = h->mode == MAD_MODE_SINGLE_CHANNEL ? 9 : 17;
+	}
+	else {
+		side = h->mode == MAD_MODE_SINGLE_CHANNEL ? 17 : 32;
+	}
+	const u8 *xing = f + 4 + ((h->flags & MAD_FLAG_PROTECTION) ? 2 : 0) + side;
+	if(xing + 4 <= dec->stream.bufend && (!memcmp(xing, "Xing", 4) || !memcmp(xing, "Info", 4))) {
+		return 1;
+	}
+	return f + 40 <= dec->stream.bufend && !memcmp(f + 36, "VBRI", 4);
+}
+
+// Rounds libmad's fixed point down to 16 bits.
+static s16 madScale(mad_fixed_t sample) {
+	sample += (1L << (MAD_F_FRACBITS - 16));
+	if(sample >= MAD_F_ONE) {
+		sample = MAD_F_ONE - 1;
+	}
+	else if(sample < -MAD_F_ONE) {
+		sample = -MAD_F_ONE;
+	}
+	return sample >> (MAD_F_FRACBITS + 1 - 16);
+}
+
+static int madDecode(void *state, struct decoder_pcm *pcm) {
+	struct mad_state *dec = state;
+	while(1) {
+		if(!dec->stream.buffer || dec->stream.error == MAD_ERROR_BUFLEN) {
+			if(!madFill(dec)) {
+				return 0;
+			}
+		}
+		if(mad_frame_decode(&dec->frame, &dec->stream)) {
+			if(dec->stream.error == MAD_ERROR_BUFLEN || MAD_RECOVERABLE(dec->stream.error)) {
+				continue;
+			}
+			return 0;
+		}
+		if(madIsTagFrame(dec)) {
+			continue;
+		}
+		pcm->streamPos = dec->inputPos + (dec->stream.this_frame - dec->input);
+		mad_synth_frame(&dec->synth, &dec->frame);
+		const struct mad_pcm *out = &dec->synth.pcm;
+		const mad_fixed_t *left = out->samples[0];
+		const mad_fixed_t *right = out->samples[out->channels > 1 ? 1 : 0];
+		u32 count = MIN(out->length, DECODER_MAX_SAMPLES);
+		for(u32 i = 0; i < count; i++) {
+			pcm->samples[i*2] = madScale(left[i]);
+			pcm->samples[i*2 + 1] = madScale(right[i]);
+		}
+		pcm->count = count;
+		pcm->sampleRate = out->samplerate;
+		return 1;
+	}
+}
+
+static const struct decoder_backend madBackend = {
+	"libmad",
+	MAD_DELAY,
+	madOpen,
+	madDecode,
+	madSeek,
+	madClose
+};
+#endif
+
+static const struct decoder_backend *backends[] = {
+#ifndef NO_LIBMAD
+	[DECODER_LIBMAD] = &madBackend,
+#endif
+	[DECODER_LITE] = &liteBackend
+};
+
+#define NUM_BACKENDS (sizeof(backends) / sizeof(backends[0]))
+
+// The backend for a Decoder setting, the first one built in if it's not one that is.
+const struct decoder_backend* decoderGet(int which) {
+	if(which < 0 || which >= NUM_BACKENDS || !backends[which]) {
+		for(which = 0; !backends[which]; which++);
+	}
+	return backends[which];
+}
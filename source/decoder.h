@@ -0,0 +1,29 @@
+#ifndef __DECODER_H__
+#define __DECODER_H__
+
+#include <gccore.h>
+
+#define DECODER_MAX_SAMPLES 1152		// per frame, MPEG-1 layer III
+
+// Fills dst with up to size bytes of the MP3 stream, 0 once it's finished. Called on the player's thread.
+typedef s32 (*decoder_reader_t)(void *cbdata, void *dst, s32 size);
+
+struct decoder_pcm {
+	s16 samples[DECODER_MAX_SAMPLES * 2];	// interleaved stereo, mono is doubled up
+	u32 count;							// stereo samples in this frame
+	u32 sampleRate;
+	u32 streamPos;						// where the frame starts in the stream, counting from the first byte read
+};
+
+struct decoder_backend {
+	const char *name;
+	u32 delay;							// samples the output lags the stream by
+	void* (*open)(decoder_reader_t reader, void *cbdata);
+	int (*decode)(void *dec, struct decoder_pcm *pcm);	// 0 once the stream has run out
+	void (*seek)(void *dec, u32 streamPos);	// the reader's been moved to streamPos, start again from there
+	void (*close)(void *dec);
+};
+
+const struct decoder_backend* decoderGet(int which);
+
+#endif
@@ -0,0 +1,63 @@
+/*===========================================
+        WakeMii - Single pass directory iteration
+
+        File/dir classification comes from the readdir result itself
+        (d_type, filled in by libfat) so a scan doesn't cost a stat()
+        and another path lookup per entry. stat() is only used as a
+        fallback for devices that report DT_UNKNOWN.
+============================================*/
+#include <gccore.h>
+#include <stdio.h>
+#include <string.h>
+#include "dirscan.h"
+
+static int entryIsDir(dir_scan* scan, struct dirent* entry) {
+#ifdef DT_DIR
+	if(entry->d_type == DT_DIR) {
+		return 1;
+	}
+	if(entry->d_type != DT_UNKNOWN) {
+		return 0;
+	}
+#endif
+	char absPath[1024];
+	struct stat fstat;
+	snprintf(absPath, sizeof(absPath), "%s/%s", scan->path, entry->d_name);
+	if(stat(absPath, &fstat)) {
+		return 0;
+	}
+	return (fstat.st_mode & _IFDIR) ? 1 : 0;
+}
+
+int dirScanOpen(dir_scan* scan, const char* path, int flags) {
+	scan->path = path;
+	scan->flags = flags;
+	scan->dp = opendir(path);
+	return scan->dp != NULL;
+}
+
+// Returns the next entry wanted by the scan, or NULL once the dir is exhausted.
+struct dirent* dirScanNext(dir_scan* scan, int* isDir) {
+	struct dirent *entry;
+	while((entry = readdir(scan->dp)) != NULL) {
+		if(!strcmp(entry->d_name, "..") || !strcmp(entry->d_name, ".")) {
+			continue;
+		}
+		int dir = entryIsDir(scan, entry);
+		if((dir && !(scan->flags & DIRSCAN_DIRS)) || (!dir && !(scan->flags & DIRSCAN_FILES))) {
+			continue;
+		}
+		if(isDir) {
+			*isDir = dir;
+		}
+		return entry;
+	}
+	return NULL;
+}
+
+void dirScanClose(dir_scan* scan) {
+	if(scan->dp) {
+		closedir(scan->dp);
+		scan->dp = NULL;
+	}
+}
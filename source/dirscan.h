@@ -0,0 +1,20 @@
+#ifndef __DIRSCAN_H__
+#define __DIRSCAN_H__
+
+#include <sys/dir.h>
+
+// What dirScanNext should hand back
+#define DIRSCAN_FILES 1
+#define DIRSCAN_DIRS 2
+
+typedef struct {
+	DIR* dp;
+	const char* path;
+	int flags;
+} dir_scan;
+
+int dirScanOpen(dir_scan* scan, const char* path, int flags);
+struct dirent* dirScanNext(dir_scan* scan, int* isDir);
+void dirScanClose(dir_scan* scan);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef __GECKO_H__
+#define __GECKO_H__
+
+// Log levels, anything above LOG_LEVEL isn't compiled in at all.
+// Build with -DLOG_LEVEL=LOG_DEBUG for the per-file scanner chatter.
+#define LOG_ERROR 0
+#define LOG_INFO 1
+#define LOG_DEBUG 2
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_INFO
+#endif
+
+// Queues a line for USB Gecko and the log file, never blocks (see log.c)
+void logPrint(int level, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+#define LOG_AT(level, ...) do { if((level) <= LOG_LEVEL) logPrint(level, __VA_ARGS__); } while(0)
+#define error_gecko(...) LOG_AT(LOG_ERROR, __VA_ARGS__)
+#define print_gecko(...) LOG_AT(LOG_INFO, __VA_ARGS__)
+#define debug_gecko(...) LOG_AT(LOG_DEBUG, __VA_ARGS__)
+
+// Raw bytes for USB Gecko only, for the profiler's binary records
+void send_gecko(const void *data, int len);
+
+#endif
@@ -0,0 +1,655 @@
+/*===========================================
+        WakeMii - Play history
+
+        When every track was last played, how often, and whether it's a
+        favourite, kept in /wakemii/history.dat as one fixed size record per
+        track so a play only rewrites its own record. The alarm and hourly
+        chime picks are weighted by it as set by "Alarm Pick":
+
+          random        every track is as likely
+          least recent  weighted by how long since the track last played
+          favourites    favourites are HISTORY_FAV_WEIGHT times as likely
+
+        and "Alarm Skip Last" keeps the last N played out of it altogether.
+
+        A track's weight is mult * (now - last_played + 1) in least recent
+        mode, otherwise just mult, where mult is 0 for the skipped ones and
+        carries the favourite weighting. Two Fenwick trees hold the sums of
+        mult and of mult * last_played, which is enough to get the summed
+        weight of any tree node for whatever now is, so a pick is one walk
+        down the trees and a play or favourite is one walk up them, both
+        O(log n). Costs ~25 bytes per track while loaded.
+
+        Loading (reading history.dat, matching it to the library and
+        building the trees) is done on a worker thread once the library
+        scan is done and again whenever the library changes, the main
+        thread picks up the result the next time it asks for anything.
+        Until then there's no history to go by and picks fall back to
+        the shuffle, as before it was ever written.
+============================================*/
+#include <gccore.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <ogc/lwp_watchdog.h>
+#include "history.h"
+#include "library.h"
+#include "playlist.h"
+#include "settings.h"
+#include "rng.h"
+#include "gecko.h"
+
+#define HISTORY_WORKER_PRIORITY 25
+#define HISTORY_WORKER_STACK_SIZE (16*1024)
+#define HISTORY_MAGIC 0x574D4853	// "WMHS"
+#define HISTORY_VERSION 1
+#define HISTORY_FAVOURITE 0x01
+
+struct history_file_header {
+	u32 magic;
+	u32 version;
+	u32 num_album_tracks;
+	u32 num_hourly;
+};
+
+// The album tracks in library order then the hourly chimes, as in memory.
+struct history_record {
+	u32 key;			// hash of the album and track name, finds the record again if the library moves around
+	u32 last_played;	// minutes since 1970, 0 for never
+	u16 play_count;
+	u8 flags;
+	u8 pad;
+};
+
+struct pick_pool {
+	u32 first;			// record of the pool's first track
+	struct history_record *recs;	// records + first
+	u32 size;
+	u32 topBit;			// highest power of two <= size
+	u8 *mult;
+	u32 *treeMult;		// Fenwick sums (1 based) of mult
+	u64 *treeMultLast;	// and of mult * last_played
+	u32 recent[HISTORY_MAX_SKIP];	// most recently played first
+	int numRecent;
+	int builtMode;		// what mult was worked out for
+	int builtSkip;
+};
+
+enum {
+	POOL_ALBUMS,
+	POOL_HOURLY,
+	NUM_POOLS
+};
+
+static struct history_record *records;
+static u32 numRecords;
+static struct pick_pool pools[NUM_POOLS];
+static int loaded;
+static u32 loadedGeneration;	// library numbering the records follow
+static int loadedHourly;
+static u32 latestPlayed;		// newest last_played anywhere, now never goes back past it
+static struct rng_state rng;
+
+// A load of the history for one layout of the library, done by the worker
+struct history_load {
+	u32 generation;
+	int numAlbums;
+	u32 albumTracks;
+	u32 hourlyTracks;
+	struct history_record *records;	// NULL if it failed
+	struct pick_pool pools[NUM_POOLS];
+	u32 latestPlayed;
+	int rewriteAll;
+};
+
+enum {
+	LOAD_IDLE,
+	LOAD_WANTED,
+	LOAD_READING,
+	LOAD_DONE
+};
+
+// Shared with the worker
+static mutex_t historyMutex;
+static cond_t historyCond;
+static struct history_load load;
+static int loadState = LOAD_IDLE;
+static lwp_t historyThread = LWP_THREAD_NULL;
+static u32 triedGeneration = 0xFFFFFFFF;	// a load that failed isn't asked for again until the library changes
+static int triedHourly;
+
+static u32 dirty[HISTORY_FLUSH_BATCH];
+static int numDirty;
+static long long firstDirtyTime;
+static int rewriteAll;			// the file's layout is out of date, write all of it next time
+
+static u32 hashName(u32 hash, const char *name) {
+	while(*name) {
+		hash ^= (u8)*name++;	// FNV-1a
+		hash *= 0x01000193;
+	}
+	return hash;
+}
+
+// A clash just means two tracks share their history should the library change.
+static u32 trackKey(int albumNum, int trackNum) {
+	const char *track = albumTrackName(albumNum, trackNum);
+	if(albumNum == HOURLY_ALBUM) {
+		return hashName(0x484F5552, track ? track : "");
+	}
+	u32 hash = hashName(0x811C9DC5, albumName(albumNum));
+	hash = hashName(hash, "/");
+	return hashName(hash, track ? track : "");
+}
+
+static u32 nowMinutes() {
+	u32 now = time(NULL) / 60;
+	return now > latestPlayed ? now : latestPlayed;
+}
+
+static int poolSkip(struct pick_pool *pool) {
+	int skip = MIN(alarmSkipLast, HISTORY_MAX_SKIP);
+	if(skip > (int)pool->size - 1) {
+		skip = pool->size - 1;
+	}
+	return MAX(skip, 0);
+}
+
+static u8 wantMult(struct pick_pool *pool, u32 item, int skipped) {
+	if(skipped) {
+		return 0;
+	}
+	if(alarmPickMode == ALARM_PICK_FAVOURITES && (pool->recs[item].flags & HISTORY_FAVOURITE)) {
+		return HISTORY_FAV_WEIGHT;
+	}
+	return 1;
+}
+
+// Summed weight of the items under one tree node
+static u64 nodeWeight(struct pick_pool *pool, u32 node, u32 now) {
+	if(pool->builtMode == ALARM_PICK_LEAST_RECENT) {
+		return (u64)(now + 1) * pool->treeMult[node] - pool->treeMultLast[node];
+	}
+	return pool->treeMult[node];
+}
+
+// Sets an item's mult and last_played, keeping the trees up to date.
+static void poolUpdate(struct pick_pool *pool, u32 item, u8 mult, u32 lastPlayed) {
+	struct history_record *rec = &pool->recs[item];
+	u32 deltaMult = (u32)mult - pool->mult[item];	// these wrap round when going down, same result
+	u64 deltaLast = (u64)mult * lastPlayed - (u64)pool->mult[item] * rec->last_played;
+	for(u32 i = item + 1; i <= pool->size; i += i & -i) {
+		pool->treeMult[i] += deltaMult;
+		pool->treeMultLast[i] += deltaLast;
+	}
+	pool->mult[item] = mult;
+	rec->last_played = lastPlayed;
+}
+
+static void buildPool(struct pick_pool *pool) {
+	int skip = poolSkip(pool);
+	pool->builtMode = alarmPickMode;
+	pool->builtSkip = skip;
+	memset(pool->treeMult, 0, (pool->size + 1) * sizeof(u32));
+	memset(pool->treeMultLast, 0, (pool->size + 1) * sizeof(u64));
+	for(u32 i = 0; i < pool->size; i++) {
+		pool->mult[i] = wantMult(pool, i, 0);
+	}
+	for(int i = 0; i < skip && i < pool->numRecent; i++) {
+		pool->mult[pool->recent[i]] = 0;
+	}
+	for(u32 i = 0; i < pool->size; i++) {
+		pool->treeMult[i+1] += pool->mult[i];
+		pool->treeMultLast[i+1] += (u64)pool->mult[i] * pool->recs[i].last_played;
+		u32 parent = (i + 1) + ((i + 1) & -(i + 1));
+		if(parent <= pool->size) {
+			pool->treeMult[parent] += pool->treeMult[i+1];
+			pool->treeMultLast[parent] += pool->treeMultLast[i+1];
+		}
+	}
+}
+
+static void freePool(struct pick_pool *pool) {
+	free(pool->mult);
+	free(pool->treeMult);
+	free(pool->treeMultLast);
+	memset(pool, 0, sizeof(struct pick_pool));
+}
+
+static int initPool(struct pick_pool *pool, struct history_record *recs, u32 first, u32 size) {
+	pool->first = first;
+	pool->recs = recs + first;
+	pool->size = size;
+	for(pool->topBit = 1; pool->topBit <= size / 2; pool->topBit <<= 1);
+	pool->mult = calloc(size + 1, 1);
+	pool->treeMult = malloc((size + 1) * sizeof(u32));
+	pool->treeMultLast = malloc((size + 1) * sizeof(u64));
+	if(!pool->mult || !pool->treeMult || !pool->treeMultLast) {
+		freePool(pool);
+		return 0;
+	}
+	// What was played most recently, from the records
+	pool->numRecent = 0;
+	for(u32 i = 0; i < size; i++) {
+		u32 lastPlayed = pool->recs[i].last_played;
+		if(!lastPlayed || (pool->numRecent == HISTORY_MAX_SKIP && lastPlayed <= pool->recs[pool->recent[HISTORY_MAX_SKIP-1]].last_played)) {
+			continue;
+		}
+		int at = MIN(pool->numRecent, HISTORY_MAX_SKIP-1);
+		while(at > 0 && pool->recs[pool->recent[at-1]].last_played < lastPlayed) {
+			pool->recent[at] = pool->recent[at-1];
+			at--;
+		}
+		pool->recent[at] = i;
+		pool->numRecent = MIN(pool->numRecent + 1, HISTORY_MAX_SKIP);
+	}
+	buildPool(pool);
+	return 1;
+}
+
+static int compareKeys(const void *a, const void *b) {
+	u32 keyA = ((const struct history_record*)a)->key;
+	u32 keyB = ((const struct history_record*)b)->key;
+	return keyA < keyB ? -1 : keyA > keyB;
+}
+
+// Keys for every track, in the order playlist.c numbers them. The library can be read
+// from any thread, 0 if it changed from what the load was asked for in the meantime.
+static int keyTracks(struct history_load *ld, struct history_record *recs) {
+	u32 global = 0;
+	for(int albumNum = 0; albumNum < ld->numAlbums; albumNum++) {
+		int numEntries = albumNumEntries(albumNum);
+		if(global + numEntries > ld->albumTracks) {
+			return 0;
+		}
+		for(int trackNum = 0; trackNum < numEntries; trackNum++) {
+			recs[global++].key = trackKey(albumNum, trackNum);
+		}
+	}
+	for(u32 i = 0; i < ld->hourlyTracks; i++) {
+		recs[global + i].key = trackKey(HOURLY_ALBUM, i);
+	}
+	return global == ld->albumTracks;
+}
+
+// Reads history.dat into the layout of the library ld asks for, on the worker.
+static void loadHistory(struct history_load *ld) {
+	u32 albumTracks = ld->albumTracks;
+	u32 hourlyTracks = ld->hourlyTracks;
+	u32 total = albumTracks + hourlyTracks;
+	ld->records = NULL;
+	if(!total) {
+		return;
+	}
+	struct history_record *newRecords = calloc(total, sizeof(struct history_record));
+	if(!newRecords) {
+		error_gecko("Not enough memory for the play history\r\n");
+		return;
+	}
+	if(!keyTracks(ld, newRecords)) {
+		print_gecko("Library changed while the play history loaded\r\n");
+		free(newRecords);
+		return;
+	}
+
+	ld->rewriteAll = 1;
+	FILE *fp = fopen(HISTORY_FILE, "rb");
+	if(fp) {
+		struct history_file_header hdr;
+		struct history_record *old = NULL;
+		u32 numOld = 0;
+		if(fread(&hdr, 1, sizeof(hdr), fp) == sizeof(hdr) && hdr.magic == HISTORY_MAGIC && hdr.version == HISTORY_VERSION) {
+			numOld = hdr.num_album_tracks + hdr.num_hourly;
+			old = malloc(numOld * sizeof(struct history_record));
+			if(old && fread(old, sizeof(struct history_record), numOld, fp) != numOld) {
+				free(old);
+				old = NULL;
+			}
+		}
+		fclose(fp);
+		if(old) {
+			// Same library as last time, the records just line up
+			int same = hdr.num_album_tracks == albumTracks && hdr.num_hourly == hourlyTracks;
+			for(u32 i = 0; same && i < total; i++) {
+				same = old[i].key == newRecords[i].key;
+			}
+			if(same) {
+				memcpy(newRecords, old, total * sizeof(struct history_record));
+				ld->rewriteAll = 0;
+			}
+			else {
+				print_gecko("Library changed, matching the play history back up\r\n");
+				qsort(old, numOld, sizeof(struct history_record), compareKeys);
+				for(u32 i = 0; i < total; i++) {
+					struct history_record *found = bsearch(&newRecords[i], old, numOld, sizeof(struct history_record), compareKeys);
+					if(found) {
+						newRecords[i] = *found;
+					}
+				}
+			}
+			free(old);
+		}
+		else {
+			error_gecko("history.dat is unreadable, starting again\r\n");
+		}
+	}
+
+	ld->latestPlayed = 0;
+	for(u32 i = 0; i < total; i++) {
+		ld->latestPlayed = MAX(ld->latestPlayed, newRecords[i].last_played);
+	}
+	if(!initPool(&ld->pools[POOL_ALBUMS], newRecords, 0, albumTracks) || !initPool(&ld->pools[POOL_HOURLY], newRecords, albumTracks, hourlyTracks)) {
+		error_gecko("Not enough memory for the play history\r\n");
+		freePool(&ld->pools[POOL_ALBUMS]);
+		free(newRecords);
+		return;
+	}
+	ld->records = newRecords;
+	print_gecko("Play history for %u tracks loaded\r\n", total);
+}
+
+static void* historyWorker(void *arg) {
+	LWP_MutexLock(historyMutex);
+	while(1) {
+		if(loadState != LOAD_WANTED) {
+			LWP_CondWait(historyCond, historyMutex);
+			continue;
+		}
+		loadState = LOAD_READING;
+		struct history_load ld = load;
+		LWP_MutexUnlock(historyMutex);
+		loadHistory(&ld);
+		LWP_MutexLock(historyMutex);
+		load = ld;
+		loadState = LOAD_DONE;
+	}
+	LWP_MutexUnlock(historyMutex);
+	return NULL;
+}
+
+// Swaps in what the worker loaded if it's for the library as it is now, otherwise asks for
+// a load of that. Never blocks, 1 once the history's there to use.
+static int takeLoaded(int numAlbums, u32 albumTracks, u32 generation) {
+	int taken = 0;
+	LWP_MutexLock(historyMutex);
+	if(loadState == LOAD_DONE) {
+		loadState = LOAD_IDLE;
+		if(load.generation == generation && load.hourlyTracks == num_hourly && load.records) {
+			free(records);
+			freePool(&pools[POOL_ALBUMS]);
+			freePool(&pools[POOL_HOURLY]);
+			records = load.records;
+			numRecords = load.albumTracks + load.hourlyTracks;
+			memcpy(pools, load.pools, sizeof(pools));
+			latestPlayed = MAX(latestPlayed, load.latestPlayed);
+			rewriteAll = load.rewriteAll;
+			numDirty = 0;
+			loadedGeneration = generation;
+			loadedHourly = load.hourlyTracks;
+			taken = 1;
+		}
+		else if(load.records) {
+			// For a library that's changed since
+			free(load.records);
+			freePool(&load.pools[POOL_ALBUMS]);
+			freePool(&load.pools[POOL_HOURLY]);
+		}
+		else if(load.generation == generation && load.hourlyTracks == num_hourly) {
+			triedGeneration = generation;
+			triedHourly = num_hourly;
+		}
+	}
+	if(!taken && loadState == LOAD_IDLE && (triedGeneration != generation || triedHourly != num_hourly)) {
+		memset(&load, 0, sizeof(load));
+		load.generation = generation;
+		load.numAlbums = numAlbums;
+		load.albumTracks = albumTracks;
+		load.hourlyTracks = num_hourly;
+		loadState = LOAD_WANTED;
+		LWP_CondSignal(historyCond);
+	}
+	LWP_MutexUnlock(historyMutex);
+	return taken;
+}
+
+static void writeHistory() {
+	FILE *fp = NULL;
+	if(!rewriteAll) {
+		fp = fopen(HISTORY_FILE, "r+b");
+	}
+	if(fp) {
+		// Only what changed, in file order
+		for(int i = 1; i < numDirty; i++) {
+			u32 rec = dirty[i];
+			int at = i;
+			while(at > 0 && dirty[at-1] > rec) {
+				dirty[at] = dirty[at-1];
+				at--;
+			}
+			dirty[at] = rec;
+		}
+		for(int i = 0; i < numDirty; i++) {
+			fseek(fp, sizeof(struct history_file_header) + dirty[i] * sizeof(struct history_record), SEEK_SET);
+			if(fwrite(&records[dirty[i]], 1, sizeof(struct history_record), fp) != sizeof(struct history_record)) {
+				error_gecko("history.dat failed to write\r\n");
+				rewriteAll = 1;
+				fclose(fp);
+				return;
+			}
+		}
+		fclose(fp);
+	}
+	else {
+		fp = fopen(HISTORY_FILE, "wb");
+		if(!fp) {
+			error_gecko("history.dat failed to create\r\n");
+			return;
+		}
+		struct history_file_header hdr;
+		hdr.magic = HISTORY_MAGIC;
+		hdr.version = HISTORY_VERSION;
+		hdr.num_album_tracks = pools[POOL_ALBUMS].size;
+		hdr.num_hourly = pools[POOL_HOURLY].size;
+		if(fwrite(&hdr, 1, sizeof(hdr), fp) != sizeof(hdr)
+			|| fwrite(records, sizeof(struct history_record), numRecords, fp) != numRecords) {
+			error_gecko("history.dat failed to write\r\n");
+			fclose(fp);
+			return;
+		}
+		fclose(fp);
+		rewriteAll = 0;
+	}
+	numDirty = 0;
+}
+
+// Writes out what's changed once enough has or it's been waiting long enough.
+void historyFlush(int force) {
+	if(!loaded || !numDirty) {
+		return;
+	}
+	if(force || numDirty >= HISTORY_FLUSH_BATCH || diff_sec(firstDirtyTime, gettime()) >= HISTORY_FLUSH_SECS) {
+		writeHistory();
+	}
+}
+
+static void markDirty(u32 rec) {
+	for(int i = 0; i < numDirty; i++) {
+		if(dirty[i] == rec) {
+			return;
+		}
+	}
+	if(!numDirty) {
+		firstDirtyTime = gettime();
+	}
+	if(numDirty < HISTORY_FLUSH_BATCH) {
+		dirty[numDirty++] = rec;
+	}
+	else {
+		// Writes have been failing, the lot goes when they work again
+		rewriteAll = 1;
+	}
+	historyFlush(0);
+}
+
+// Loads the history once the library is complete, and again if it changes.
+static int syncHistory() {
+	if(libraryScanState != LIBRARY_SCAN_DONE) {
+		return 0;
+	}
+	int numAlbums;
+	u32 generation;
+	u32 albumTracks = playlistMapTracks(&numAlbums, &generation);
+	if(loaded && (generation != loadedGeneration || num_hourly != loadedHourly)) {
+		// What's changed goes out in the old layout, then gets matched back up
+		historyFlush(1);
+		loaded = 0;
+	}
+	if(!loaded) {
+		loaded = takeLoaded(numAlbums, albumTracks, generation);
+	}
+	if(!loaded) {
+		return 0;
+	}
+	for(int i = 0; i < NUM_POOLS; i++) {
+		if(pools[i].builtMode != alarmPickMode || pools[i].builtSkip != poolSkip(&pools[i])) {
+			buildPool(&pools[i]);
+		}
+	}
+	return 1;
+}
+
+// Which pool and item in it a track is, 0 if it's not one we know about.
+static int findItem(int albumNum, int trackNum, struct pick_pool **pool, u32 *item) {
+	if(!syncHistory() || trackNum < 0) {
+		return 0;
+	}
+	if(albumNum == HOURLY_ALBUM) {
+		*pool = &pools[POOL_HOURLY];
+		*item = trackNum;
+	}
+	else {
+		int numAlbums;
+		playlistMapTracks(&numAlbums, NULL);
+		if(albumNum < 0 || albumNum >= numAlbums || trackNum >= albumNumEntries(albumNum)) {
+			return 0;
+		}
+		*pool = &pools[POOL_ALBUMS];
+		*item = playlistEntryToGlobal(albumNum, trackNum);
+	}
+	return *item < (*pool)->size;
+}
+
+void historyInit() {
+	rngSeed(&rng, gettick());
+	LWP_MutexInit(&historyMutex, false);
+	LWP_CondInit(&historyCond);
+	LWP_CreateThread(&historyThread, historyWorker, NULL, NULL, HISTORY_WORKER_STACK_SIZE, HISTORY_WORKER_PRIORITY);
+}
+
+void historyPlayed(int albumNum, int trackNum) {
+	struct pick_pool *pool;
+	u32 item;
+	if(!findItem(albumNum, trackNum, &pool, &item)) {
+		return;
+	}
+	struct history_record *rec = &pool->recs[item];
+	u32 now = nowMinutes();
+	latestPlayed = now;
+	if(rec->play_count < 0xFFFF) {
+		rec->play_count++;
+	}
+	// To the front of the recently played
+	int at = 0;
+	while(at < pool->numRecent && pool->recent[at] != item) {
+		at++;
+	}
+	if(at == pool->numRecent && pool->numRecent < HISTORY_MAX_SKIP) {
+		pool->numRecent++;
+	}
+	at = MIN(at, HISTORY_MAX_SKIP-1);
+	memmove(&pool->recent[1], &pool->recent[0], at * sizeof(u32));
+	pool->recent[0] = item;
+	poolUpdate(pool, item, pool->mult[item], now);
+	// It's skipped now, and whatever got pushed past the skipped ones isn't any more
+	int skip = pool->builtSkip;
+	for(int i = 0; i <= skip && i < pool->numRecent; i++) {
+		u32 recentItem = pool->recent[i];
+		poolUpdate(pool, recentItem, wantMult(pool, recentItem, i < skip), pool->recs[recentItem].last_played);
+	}
+	markDirty(pool->first + item);
+}
+
+// Returns whether the track is a favourite now, or -1 if there's no history for it yet.
+int historyToggleFavourite(int albumNum, int trackNum) {
+	struct pick_pool *pool;
+	u32 item;
+	if(!findItem(albumNum, trackNum, &pool, &item)) {
+		return -1;
+	}
+	struct history_record *rec = &pool->recs[item];
+	rec->flags ^= HISTORY_FAVOURITE;
+	if(pool->mult[item]) {
+		poolUpdate(pool, item, wantMult(pool, item, 0), rec->last_played);
+	}
+	markDirty(pool->first + item);
+	return rec->flags & HISTORY_FAVOURITE ? 1 : 0;
+}
+
+int historyIsFavourite(int albumNum, int trackNum) {
+	struct pick_pool *pool;
+	u32 item;
+	if(!findItem(albumNum, trackNum, &pool, &item)) {
+		return 0;
+	}
+	return pool->recs[item].flags & HISTORY_FAVOURITE ? 1 : 0;
+}
+
+// Walks down the trees to the item the random weight lands on.
+static int pickFromPool(struct pick_pool *pool, u32 *item) {
+	if(!pool->size) {
+		return 0;
+	}
+	u32 now = nowMinutes();
+	u64 total = 0;
+	for(u32 i = pool->size; i; i -= i & -i) {
+		total += nodeWeight(pool, i, now);
+	}
+	if(!total) {
+		return 0;
+	}
+	// 64 random bits, the modulo bias is nothing next to total
+	u64 r = (((u64)rngNext(&rng) << 32) | rngNext(&rng)) % total;
+	u32 pos = 0;
+	for(u32 step = pool->topBit; step; step >>= 1) {
+		if(pos + step <= pool->size) {
+			u64 weight = nodeWeight(pool, pos + step, now);
+			if(weight <= r) {
+				pos += step;
+				r -= weight;
+			}
+		}
+	}
+	*item = MIN(pos, pool->size - 1);
+	return 1;
+}
+
+// Picks the track the alarm should go off with, 0 if there's no history to go by yet.
+int historyPickAlarm(int *albumNum, int *trackNum) {
+	u32 item;
+	if(!syncHistory() || !pickFromPool(&pools[POOL_ALBUMS], &item)) {
+		return 0;
+	}
+	playlistGlobalToEntry(item, albumNum, trackNum);
+	print_gecko("History picked track %u of %u\r\n", item, pools[POOL_ALBUMS].size);
+	return 1;
+}
+
+int historyPickHourly(int *trackNum) {
+	u32 item;
+	if(!syncHistory() || !pickFromPool(&pools[POOL_HOURLY], &item)) {
+		return 0;
+	}
+	*trackNum = item;
+	return 1;
+}
@@ -0,0 +1,25 @@
+#ifndef __HISTORY_H__
+#define __HISTORY_H__
+
+#include <gccore.h>
+#include "paths.h"
+
+#define HISTORY_FILE WAKEMII_DIR "/history.dat"
+
+// Most recently played tracks "Alarm Skip Last" can keep out of the picks
+#define HISTORY_MAX_SKIP 64
+// Favourites are this many times as likely to be picked in favourites mode
+#define HISTORY_FAV_WEIGHT 8
+// Plays are written out once this many tracks have changed, or after a while
+#define HISTORY_FLUSH_BATCH 16
+#define HISTORY_FLUSH_SECS 300
+
+void historyInit();
+void historyPlayed(int albumNum, int trackNum);
+int historyToggleFavourite(int albumNum, int trackNum);
+int historyIsFavourite(int albumNum, int trackNum);
+int historyPickAlarm(int *albumNum, int *trackNum);
+int historyPickHourly(int *trackNum);
+void historyFlush(int force);
+
+#endif
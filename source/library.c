@@ -0,0 +1,676 @@
+/*===========================================
+        WakeMii - Album library scanning and the on-disk library index
+
+        The index (/wakemii/library.idx) remembers every album directory
+        along with its mtime, cover type and track file names so that a
+        boot only has to rescan the directories that actually changed.
+============================================*/
+#include <gccore.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/dir.h>
+#include <ogc/lwp_watchdog.h>
+#include "library.h"
+#include "profile.h"
+#include "dirscan.h"
+#include "gecko.h"
+
+#define LIBRARY_INDEX_MAGIC 0x574D4958	// "WMIX"
+#define LIBRARY_INDEX_VERSION 1
+#define LIBRARY_INDEX_MAX_SIZE (16*1024*1024)
+
+// File layout: header, then num_dirs records each followed by the
+// NUL terminated dir name and the track table (both padded to 4 bytes).
+struct index_header {
+	u32 magic;
+	u32 version;
+	u32 num_dirs;
+	u32 data_size;
+	u32 checksum;
+};
+
+struct index_dir {
+	u32 mtime;
+	u32 num_entries;
+	u32 name_size;
+	u32 tracks_size;
+	u8 cover_type;
+	u8 is_hourly;
+	u8 pad[2];
+};
+
+// One row of the album table, copied in and out of the chunks
+struct album {
+	u32 name;			// string pool offsets
+	u32 first_track;	// the album's tracks are num_entries consecutive entries of the track table from here
+	u32 num_entries;
+	u32 mtime;
+	u8 cover_type;
+};
+
+// Struct of arrays, the fields the main loop walks sit together
+struct album_chunk {
+	u32 name[ALBUM_CHUNK_SIZE];
+	u32 first_track[ALBUM_CHUNK_SIZE];
+	u32 num_entries[ALBUM_CHUNK_SIZE];
+	u32 mtime[ALBUM_CHUNK_SIZE];
+	u8 cover_type[ALBUM_CHUNK_SIZE];
+};
+
+#define POOL_BLOCK_SIZE (1 << POOL_BLOCK_SHIFT)
+#define POOL_NONE 0xFFFFFFFF
+
+static struct album_chunk* albumChunks[MAX_ALBUM_CHUNKS];
+static u32* trackChunks[MAX_TRACK_CHUNKS];		// string pool offset of every track name
+static u32 trackTableUsed;
+static char* poolBlocks[MAX_POOL_BLOCKS];
+static u32 poolUsed;
+static mutex_t poolMutex;						// the scanner and the main thread both add to the pool and track table
+static mutex_t libraryMutex;					// held while a published album is rewritten or the index is saved
+static struct album hourly;
+
+volatile int num_albums;
+volatile int num_hourly;
+volatile int num_tracks;
+volatile int libraryScanState = LIBRARY_SCANNING;
+
+// What library.idx said, only kept around while the scan runs
+struct indexed_dir {
+	char* name;
+	char* tracks;		// num_entries NUL terminated names, back to back
+	u32 num_entries;
+	u32 mtime;
+	u8 cover_type;
+};
+static u8* indexData;					// the whole index file, indexed names/tracks point in here
+static struct indexed_dir* indexedDirs;
+static int num_indexedDirs;
+static int indexCursor;
+static int num_indexedUsed;
+static struct indexed_dir* indexedHourly;
+static int libraryDirty;
+
+// Reused while a dir is being read, one for the scanner and one for the main thread
+struct scratch_buf {
+	char* buf;
+	u32 used;
+	u32 size;
+};
+static struct scratch_buf scanScratch;
+static struct scratch_buf touchScratch;
+static int lastTouched = -2;
+
+#define SCANNER_PRIORITY 20
+#define SCANNER_STACK_SIZE (16*1024)
+static lwp_t scannerThread = LWP_THREAD_NULL;
+
+char *endsWith(char *str, char *end) {
+	size_t len_str = strlen(str);
+	size_t len_end = strlen(end);
+	if(len_str < len_end)
+		return NULL;
+	str += len_str - len_end;
+	return !strcasecmp(str, end) ? str : NULL;
+}
+
+static u32 indexChecksum(const u8* data, u32 len) {
+	u32 hash = 0x811C9DC5;	// FNV-1a
+	for(u32 i = 0; i < len; i++) {
+		hash ^= data[i];
+		hash *= 0x01000193;
+	}
+	return hash;
+}
+
+static u32 pad4(u32 len) {
+	return (len + 3) & ~3;
+}
+
+static char* poolStr(u32 offset) {
+	return poolBlocks[offset >> POOL_BLOCK_SHIFT] + (offset & (POOL_BLOCK_SIZE - 1));
+}
+
+// Must be called with poolMutex held. Strings never straddle two blocks.
+static u32 poolAdd(const char *str) {
+	u32 len = strlen(str) + 1;
+	if(len > POOL_BLOCK_SIZE) {
+		return POOL_NONE;
+	}
+	if((poolUsed & (POOL_BLOCK_SIZE - 1)) + len > POOL_BLOCK_SIZE) {
+		poolUsed = (poolUsed + POOL_BLOCK_SIZE) & ~(POOL_BLOCK_SIZE - 1);
+	}
+	u32 block = poolUsed >> POOL_BLOCK_SHIFT;
+	if(block >= MAX_POOL_BLOCKS) {
+		error_gecko("Library string pool is full\r\n");
+		return POOL_NONE;
+	}
+	if(!poolBlocks[block]) {
+		poolBlocks[block] = malloc(POOL_BLOCK_SIZE);
+		if(!poolBlocks[block]) {
+			return POOL_NONE;
+		}
+	}
+	u32 offset = poolUsed;
+	memcpy(poolStr(offset), str, len);
+	poolUsed += len;
+	return offset;
+}
+
+// Must be called with poolMutex held
+static int trackAdd(u32 nameOffset) {
+	u32 chunk = trackTableUsed / TRACK_CHUNK_SIZE;
+	if(chunk >= MAX_TRACK_CHUNKS) {
+		error_gecko("Library track table is full\r\n");
+		return 0;
+	}
+	if(!trackChunks[chunk]) {
+		trackChunks[chunk] = malloc(TRACK_CHUNK_SIZE * sizeof(u32));
+		if(!trackChunks[chunk]) {
+			return 0;
+		}
+	}
+	trackChunks[chunk][trackTableUsed % TRACK_CHUNK_SIZE] = nameOffset;
+	trackTableUsed++;
+	return 1;
+}
+
+static char* trackName(u32 track) {
+	return poolStr(trackChunks[track / TRACK_CHUNK_SIZE][track % TRACK_CHUNK_SIZE]);
+}
+
+static void getAlbum(int albumNum, struct album *album) {
+	if(albumNum == HOURLY_ALBUM) {
+		*album = hourly;
+		return;
+	}
+	struct album_chunk *chunk = albumChunks[albumNum / ALBUM_CHUNK_SIZE];
+	int i = albumNum % ALBUM_CHUNK_SIZE;
+	album->name = chunk->name[i];
+	album->first_track = chunk->first_track[i];
+	album->num_entries = chunk->num_entries[i];
+	album->mtime = chunk->mtime[i];
+	album->cover_type = chunk->cover_type[i];
+}
+
+static int setAlbum(int albumNum, struct album *album) {
+	if(albumNum == HOURLY_ALBUM) {
+		hourly = *album;
+		return 1;
+	}
+	struct album_chunk **chunk = &albumChunks[albumNum / ALBUM_CHUNK_SIZE];
+	if(!*chunk) {
+		*chunk = malloc(sizeof(struct album_chunk));
+		if(!*chunk) {
+			return 0;
+		}
+	}
+	int i = albumNum % ALBUM_CHUNK_SIZE;
+	(*chunk)->name[i] = album->name;
+	(*chunk)->first_track[i] = album->first_track;
+	(*chunk)->num_entries[i] = album->num_entries;
+	(*chunk)->mtime[i] = album->mtime;
+	(*chunk)->cover_type[i] = album->cover_type;
+	return 1;
+}
+
+const char* albumName(int albumNum) {
+	if(albumNum == HOURLY_ALBUM) {
+		return poolStr(hourly.name);
+	}
+	return poolStr(albumChunks[albumNum / ALBUM_CHUNK_SIZE]->name[albumNum % ALBUM_CHUNK_SIZE]);
+}
+
+int albumNumEntries(int albumNum) {
+	if(albumNum == HOURLY_ALBUM) {
+		return hourly.num_entries;
+	}
+	return albumChunks[albumNum / ALBUM_CHUNK_SIZE]->num_entries[albumNum % ALBUM_CHUNK_SIZE];
+}
+
+// A track's name as of the last scan, without going to the card. NULL if it's not there.
+const char* albumTrackName(int albumNum, int entryNum) {
+	u32 first, count;
+	if(albumNum == HOURLY_ALBUM) {
+		first = hourly.first_track;
+		count = hourly.num_entries;
+	}
+	else {
+		// Just the two columns, not the whole row
+		struct album_chunk *chunk = albumChunks[albumNum / ALBUM_CHUNK_SIZE];
+		first = chunk->first_track[albumNum % ALBUM_CHUNK_SIZE];
+		count = chunk->num_entries[albumNum % ALBUM_CHUNK_SIZE];
+	}
+	if(entryNum < 0 || entryNum >= count) {
+		return NULL;
+	}
+	return trackName(first + entryNum);
+}
+
+enum cover_type_t albumCoverType(int albumNum) {
+	if(albumNum == HOURLY_ALBUM) {
+		return COVER_NONE;
+	}
+	return albumChunks[albumNum / ALBUM_CHUNK_SIZE]->cover_type[albumNum % ALBUM_CHUNK_SIZE];
+}
+
+// Copies num_entries NUL separated track names into the pool and track table,
+// they all go in one go so an album's tracks stay next to each other.
+static int storeTracks(struct album *album, const char *tracks) {
+	int ok = 1;
+	LWP_MutexLock(poolMutex);
+	album->first_track = trackTableUsed;
+	for(u32 i = 0; i < album->num_entries && ok; i++) {
+		u32 offset = poolAdd(tracks);
+		ok = offset != POOL_NONE && trackAdd(offset);
+		tracks += strlen(tracks) + 1;
+	}
+	LWP_MutexUnlock(poolMutex);
+	return ok;
+}
+
+static int storeAlbum(struct album *album, const char *name, const char *tracks) {
+	LWP_MutexLock(poolMutex);
+	album->name = poolAdd(name);
+	LWP_MutexUnlock(poolMutex);
+	return album->name != POOL_NONE && storeTracks(album, tracks);
+}
+
+static void loadLibraryIndex() {
+	FILE *fp = fopen(LIBRARY_INDEX_FILE, "rb");
+	if(!fp) {
+		error_gecko("library.idx not found, doing a full scan\r\n");
+		return;
+	}
+	fseek(fp, 0L, SEEK_END);
+	size_t size = ftell(fp);
+	fseek(fp, 0L, SEEK_SET);
+	if(size < sizeof(struct index_header) || size > LIBRARY_INDEX_MAX_SIZE) {
+		error_gecko("library.idx has a bad size (%zu)\r\n", size);
+		fclose(fp);
+		return;
+	}
+	// One sequential read for the whole thing
+	u8 *data = malloc(size);
+	size_t ret = data ? fread(data, 1, size, fp) : 0;
+	fclose(fp);
+	if(ret != size) {
+		error_gecko("library.idx failed to read (expected %zu got %zu)\r\n", size, ret);
+		free(data);
+		return;
+	}
+
+	struct index_header *hdr = (struct index_header*)data;
+	if(hdr->magic != LIBRARY_INDEX_MAGIC || hdr->version != LIBRARY_INDEX_VERSION
+		|| hdr->data_size != size - sizeof(struct index_header)
+		|| hdr->checksum != indexChecksum(data + sizeof(struct index_header), hdr->data_size)) {
+		error_gecko("library.idx is stale or corrupt, ignoring it\r\n");
+		free(data);
+		return;
+	}
+
+	indexedDirs = calloc(hdr->num_dirs ? hdr->num_dirs : 1, sizeof(struct indexed_dir));
+	u32 pos = sizeof(struct index_header);
+	for(u32 i = 0; i < hdr->num_dirs; i++) {
+		if(pos + sizeof(struct index_dir) > size) break;
+		struct index_dir *dir = (struct index_dir*)(data + pos);
+		pos += sizeof(struct index_dir);
+		if(pos + pad4(dir->name_size) + pad4(dir->tracks_size) > size) break;
+		struct indexed_dir *indexed = &indexedDirs[num_indexedDirs];
+		indexed->name = (char*)(data + pos);
+		pos += pad4(dir->name_size);
+		indexed->tracks = (char*)(data + pos);
+		pos += pad4(dir->tracks_size);
+		indexed->num_entries = dir->num_entries;
+		indexed->cover_type = dir->cover_type;
+		indexed->mtime = dir->mtime;
+		if(dir->is_hourly) {
+			indexedHourly = indexed;
+		}
+		num_indexedDirs++;
+	}
+	indexData = data;
+	print_gecko("library.idx loaded, %i dirs\r\n", num_indexedDirs);
+}
+
+static void freeLibraryIndex() {
+	free(indexedDirs);
+	free(indexData);
+	indexedDirs = NULL;
+	indexData = NULL;
+	indexedHourly = NULL;
+	num_indexedDirs = 0;
+}
+
+// Index entries are written in readdir order, so the next expected entry is checked first.
+static struct indexed_dir* findIndexedDir(char *dirName, time_t mtime) {
+	for(int i = 0; i < num_indexedDirs; i++) {
+		int idx = (indexCursor + i) % num_indexedDirs;
+		struct indexed_dir *indexed = &indexedDirs[idx];
+		if(indexed != indexedHourly && !strcmp(indexed->name, dirName)) {
+			indexCursor = idx + 1;
+			if(indexed->mtime != mtime) {
+				print_gecko("%s changed since the last scan\r\n", dirName);
+				return NULL;
+			}
+			num_indexedUsed++;
+			return indexed;
+		}
+	}
+	return NULL;
+}
+
+static void appendTrack(struct scratch_buf *scratch, char *name) {
+	u32 len = strlen(name) + 1;
+	if(scratch->used + len > scratch->size) {
+		scratch->size = (scratch->size + len) * 2;
+		scratch->buf = realloc(scratch->buf, scratch->size);
+	}
+	memcpy(scratch->buf + scratch->used, name, len);
+	scratch->used += len;
+}
+
+// Walks a dir once, collecting the track names (in readdir order) in scratch and the cover type.
+static void readAlbumDir(char *path, struct album *album, struct scratch_buf *scratch) {
+	debug_gecko("Attempting to parse dir %s\r\n", path);
+	struct dirent *entry;
+	dir_scan scan;
+	album->num_entries = 0;
+	album->cover_type = COVER_NONE;
+	scratch->used = 0;
+	if(!dirScanOpen(&scan, path, DIRSCAN_FILES)) {
+		return;
+	}
+	while((entry = dirScanNext(&scan, NULL)) != NULL ) {
+		debug_gecko("Looking at file %s/%s\r\n", path, entry->d_name);
+		if(endsWith(entry->d_name, ".mp3")) {
+			album->num_entries++;
+			appendTrack(scratch, entry->d_name);
+			debug_gecko("detected usable entry %s\r\n", entry->d_name);
+		}
+		else if(!strcasecmp(entry->d_name, "cover.png")) {
+			album->cover_type = COVER_PNG;
+		}
+		else if(!strcasecmp(entry->d_name, "cover.bmp")) {
+			album->cover_type = COVER_BMP;
+		}
+		else if(!strcasecmp(entry->d_name, "cover.jpg")) {
+			album->cover_type = COVER_JPG;
+		}
+	}
+	dirScanClose(&scan);
+}
+
+// Fills in album from the dir at path, only succeeds if it has tracks.
+static int parseDirForAlbum(char *path, char *dirName, struct album *album) {
+	readAlbumDir(path, album, &scanScratch);
+	return album->num_entries > 0 && storeAlbum(album, dirName, scanScratch.buf);
+}
+
+// Albums are only ever appended, the count is bumped once the album is fully
+// written so the main loop can use albums 0..num_albums-1 without locking.
+static void publishAlbum(struct album *album) {
+	if(!setAlbum(num_albums, album)) {
+		return;
+	}
+	__sync_synchronize();
+	num_albums++;
+	// touchAlbum() changes it from the main thread while the scan's going
+	__sync_fetch_and_add(&num_tracks, album->num_entries);
+}
+
+// Fills the album table from the index, only rescanning album dirs whose mtime changed.
+// Dirs with no .mp3 files aren't indexed and get rescanned every time.
+static int scanAlbums() {
+	dir_scan scan;
+	if(!dirScanOpen(&scan, ALBUMS_DIR, DIRSCAN_DIRS)) {
+		return 0;
+	}
+	struct dirent *entry;
+	struct stat fstat;
+	while( (entry = dirScanNext(&scan, NULL)) != NULL ){
+		// Only album dirs get a stat, for their mtime
+		char absPath[1024];
+		memset(absPath, 0, 1024);
+		sprintf(absPath, "%s/%s", ALBUMS_DIR, entry->d_name);
+		if(stat(absPath,&fstat)) {
+			continue;
+		}
+		if(num_albums == MAX_ALBUMS) {
+			print_gecko("Too many albums, ignoring the rest\r\n");
+			break;
+		}
+		struct album album;
+		int found = 0;
+		struct indexed_dir *indexed = findIndexedDir(entry->d_name, fstat.st_mtime);
+		if(indexed != NULL) {
+			album.num_entries = indexed->num_entries;
+			album.cover_type = indexed->cover_type;
+			found = storeAlbum(&album, indexed->name, indexed->tracks);
+		}
+		else {
+			found = parseDirForAlbum(absPath, entry->d_name, &album);
+			libraryDirty |= found;
+		}
+		if(found) {
+			album.mtime = fstat.st_mtime;
+			publishAlbum(&album);
+		}
+	}
+	dirScanClose(&scan);
+	// Something was deleted
+	if(num_indexedUsed != num_indexedDirs - (indexedHourly ? 1 : 0)) {
+		libraryDirty = 1;
+	}
+	return 1;
+}
+
+static int scanHourly() {
+	struct stat fstat;
+	if(stat(HOURLY_DIR, &fstat) || !(fstat.st_mode & _IFDIR)) {
+		return 0;
+	}
+	struct album album;
+	int found = 0;
+	if(indexedHourly && indexedHourly->mtime == fstat.st_mtime) {
+		album.num_entries = indexedHourly->num_entries;
+		album.cover_type = COVER_NONE;
+		found = storeAlbum(&album, "hourly", indexedHourly->tracks);
+	}
+	else {
+		found = parseDirForAlbum(HOURLY_DIR, "hourly", &album);
+		if(found || indexedHourly != NULL) {
+			libraryDirty = 1;
+		}
+	}
+	if(found) {
+		album.mtime = fstat.st_mtime;
+		setAlbum(HOURLY_ALBUM, &album);
+		__sync_synchronize();
+		num_hourly = album.num_entries;
+	}
+	return 1;
+}
+
+static void writeIndexDir(FILE *fp, int albumNum) {
+	static const u8 zeros[4] = {0};
+	struct album album;
+	getAlbum(albumNum, &album);
+	struct index_dir dir;
+	memset(&dir, 0, sizeof(struct index_dir));
+	dir.mtime = album.mtime;
+	dir.num_entries = album.num_entries;
+	dir.name_size = strlen(poolStr(album.name)) + 1;
+	for(u32 i = 0; i < album.num_entries; i++) {
+		dir.tracks_size += strlen(trackName(album.first_track + i)) + 1;
+	}
+	dir.cover_type = album.cover_type;
+	dir.is_hourly = albumNum == HOURLY_ALBUM;
+	fwrite(&dir, 1, sizeof(struct index_dir), fp);
+	fwrite(poolStr(album.name), 1, dir.name_size, fp);
+	fwrite(zeros, 1, pad4(dir.name_size) - dir.name_size, fp);
+	for(u32 i = 0; i < album.num_entries; i++) {
+		char *name = trackName(album.first_track + i);
+		fwrite(name, 1, strlen(name) + 1, fp);
+	}
+	fwrite(zeros, 1, pad4(dir.tracks_size) - dir.tracks_size, fp);
+}
+
+// Rewrites library.idx if anything differed from what was on disk.
+static void saveLibraryIndex() {
+	LWP_MutexLock(libraryMutex);
+	if(!libraryDirty) {
+		LWP_MutexUnlock(libraryMutex);
+		return;
+	}
+	char *indexBuf = NULL;
+	size_t len = 0;
+	FILE *fp = open_memstream(&indexBuf, &len);
+	if(!fp) {
+		LWP_MutexUnlock(libraryMutex);
+		return;
+	}
+
+	struct index_header hdr;
+	memset(&hdr, 0, sizeof(struct index_header));
+	fwrite(&hdr, 1, sizeof(struct index_header), fp);
+	for(int i = 0; i < num_albums; i++) {
+		writeIndexDir(fp, i);
+	}
+	if(num_hourly) {
+		writeIndexDir(fp, HOURLY_ALBUM);
+	}
+	fclose(fp);
+
+	struct index_header *hdrPtr = (struct index_header*)indexBuf;
+	hdrPtr->magic = LIBRARY_INDEX_MAGIC;
+	hdrPtr->version = LIBRARY_INDEX_VERSION;
+	hdrPtr->num_dirs = num_albums + (num_hourly ? 1 : 0);
+	hdrPtr->data_size = len - sizeof(struct index_header);
+	hdrPtr->checksum = indexChecksum((u8*)indexBuf + sizeof(struct index_header), hdrPtr->data_size);
+
+	libraryDirty = 0;
+	LWP_MutexUnlock(libraryMutex);
+
+	fp = fopen(LIBRARY_INDEX_FILE, "wb");
+	if(!fp) {
+		error_gecko("library.idx failed to create\r\n");
+		free(indexBuf);
+		return;
+	}
+	size_t res = fwrite(indexBuf, 1, len, fp);
+	fclose(fp);
+	free(indexBuf);
+	if(res != len) {
+		error_gecko("library.idx failed to write (expected to write %zu wrote %zu)\r\n", len, res);
+		remove(LIBRARY_INDEX_FILE);
+		return;
+	}
+	print_gecko("library.idx saved, %zu bytes\r\n", len);
+}
+
+static void* scanLibrary(void *arg) {
+	u64 startTime = gettime();
+	loadLibraryIndex();
+	// Hourly first, it's a single dir
+	if(!scanHourly()) {
+		error_gecko("wakemii/hourly dir not found!\r\n");
+	}
+	print_gecko("Found %i hourly chimes\r\n", num_hourly);
+	if(!scanAlbums()) {
+		error_gecko("wakemii/albums dir not found!\r\n");
+		freeLibraryIndex();
+		libraryScanState = LIBRARY_NOT_FOUND;
+		return NULL;
+	}
+	freeLibraryIndex();
+	print_gecko("Found %i albums, %i tracks in %ums (%uKb of names)\r\n", num_albums, num_tracks,
+		diff_msec(startTime, gettime()), poolUsed/1024);
+	saveLibraryIndex();
+	libraryScanState = LIBRARY_SCAN_DONE;
+	return NULL;
+}
+
+// Kicks off library discovery on a low priority thread, albums show up as
+// num_albums grows and libraryScanState says when it's finished.
+void startLibraryScan() {
+	LWP_MutexInit(&poolMutex, false);
+	LWP_MutexInit(&libraryMutex, false);
+	libraryScanState = LIBRARY_SCANNING;
+	LWP_CreateThread(&scannerThread, scanLibrary, NULL, NULL, SCANNER_STACK_SIZE, SCANNER_PRIORITY);
+}
+
+// If the album's dir has changed since it was scanned, rereads it first. The
+// old track names are simply abandoned in the pool.
+static int touchAlbum(int albumNum, char *dirPath) {
+	if(albumNum != lastTouched) {
+		struct stat fstat;
+		struct album album;
+		lastTouched = albumNum;
+		getAlbum(albumNum, &album);
+		if(!stat(dirPath, &fstat) && fstat.st_mtime != album.mtime) {
+			print_gecko("%s changed, rereading it\r\n", dirPath);
+			u32 oldEntries = album.num_entries;
+			readAlbumDir(dirPath, &album, &touchScratch);
+			if(album.num_entries > 0 && !storeTracks(&album, touchScratch.buf)) {
+				album.num_entries = 0;
+			}
+			album.mtime = fstat.st_mtime;
+			LWP_MutexLock(libraryMutex);
+			setAlbum(albumNum, &album);
+			libraryDirty = 1;
+			LWP_MutexUnlock(libraryMutex);
+			if(albumNum == HOURLY_ALBUM) {
+				num_hourly = album.num_entries;
+			}
+			else {
+				__sync_fetch_and_add(&num_tracks, (int)album.num_entries - (int)oldEntries);
+			}
+			// The scanner saves once it's done otherwise
+			if(libraryScanState == LIBRARY_SCAN_DONE) {
+				saveLibraryIndex();
+			}
+		}
+	}
+	return albumNumEntries(albumNum);
+}
+
+static FILE* openEntry(int albumNum, int entryNum, char* entryName) {
+	char dirPath[1024];
+	memset(dirPath, 0, 1024);
+	if(albumNum != HOURLY_ALBUM) {
+		sprintf(dirPath, "%s/%s", ALBUMS_DIR, albumName(albumNum));
+	}
+	else if(num_hourly) {
+		strcpy(dirPath, HOURLY_DIR);
+	}
+	else {
+		return NULL;
+	}
+	if(!touchAlbum(albumNum, dirPath)) {
+		return NULL;
+	}
+	struct album album;
+	getAlbum(albumNum, &album);
+	// The dir may have lost tracks since the caller picked this one, or all of them
+	if(album.num_entries <= 0 || entryNum < 0) {
+		return NULL;
+	}
+	if(entryNum >= album.num_entries) {
+		entryNum = album.num_entries - 1;
+	}
+	char *name = trackName(album.first_track + entryNum);
+	debug_gecko("Opening entry %i (%s) from %s\r\n", entryNum, name, dirPath);
+	strcpy(entryName, name);
+	char absPath[1024];
+	memset(absPath, 0, 1024);
+	sprintf(absPath, "%s/%s", dirPath, name);
+	return fopen(absPath, "rb");
+}
+
+FILE* getEntryFromIndex(int albumNum, int entryNum, char* entryName) {
+	u64 profileStart = profileBegin();
+	FILE *fp = openEntry(albumNum, entryNum, entryName);
+	profileEnd(PROF_ENTRY_OPEN, profileStart);
+	return fp;
+}
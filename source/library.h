@@ -0,0 +1,56 @@
+#ifndef __LIBRARY_H__
+#define __LIBRARY_H__
+
+#include <gccore.h>
+#include <stdio.h>
+#include <time.h>
+#include "paths.h"
+
+#define ALBUMS_DIR WAKEMII_DIR "/albums"
+#define HOURLY_DIR WAKEMII_DIR "/hourly"
+#define LIBRARY_INDEX_FILE WAKEMII_DIR "/library.idx"
+
+// Album number getEntryFromIndex() and friends take for the hourly chimes
+#define HOURLY_ALBUM -1
+
+// The library grows in fixed size chunks that never move once allocated, so the
+// main thread can keep reading while the scanner adds to it. Memory use is about
+// 17 bytes per album plus 4 bytes per track, plus every album and track name
+// (and its NUL) once in the string pool, e.g. ~7MB for 20k albums / 200k tracks
+// with 25 character names. These are hard limits, not what's allocated up front.
+#define ALBUM_CHUNK_SIZE 1024
+#define MAX_ALBUM_CHUNKS 128			// 131072 albums
+#define TRACK_CHUNK_SIZE 16384
+#define MAX_TRACK_CHUNKS 128			// 2097152 tracks
+#define POOL_BLOCK_SHIFT 16				// 64KB string pool blocks
+#define MAX_POOL_BLOCKS 1024			// 64MB of names
+#define MAX_ALBUMS (ALBUM_CHUNK_SIZE * MAX_ALBUM_CHUNKS)
+
+enum cover_type_t {
+	COVER_NONE,
+	COVER_PNG,
+	COVER_BMP,
+	COVER_JPG
+};
+
+enum library_scan_state_t {
+	LIBRARY_SCANNING,
+	LIBRARY_SCAN_DONE,
+	LIBRARY_NOT_FOUND
+};
+
+// Filled in by the scanner thread, albums 0..num_albums-1 can be used without locking
+extern volatile int num_albums;
+extern volatile int num_hourly;
+extern volatile int num_tracks;
+extern volatile int libraryScanState;
+
+char *endsWith(char *str, char *end);
+void startLibraryScan();
+const char* albumName(int albumNum);
+int albumNumEntries(int albumNum);
+const char* albumTrackName(int albumNum, int entryNum);
+enum cover_type_t albumCoverType(int albumNum);
+FILE* getEntryFromIndex(int albumNum, int entryNum, char* entryName);
+
+#endif
@@ -0,0 +1,252 @@
+/*===========================================
+        WakeMii - Logging
+
+        print_gecko and friends format straight into a slot of a lock-free
+        ring, so logging from the main loop or any worker costs a
+        vsnprintf and never waits on the Gecko. Each slot's sequence number
+        says whose turn it is: a writer claims the slot at head with a
+        compare-and-swap, fills it and bumps the sequence to hand it to the
+        drain thread, which hands it back a lap later once it's sent.
+
+        The drain thread wakes every LOG_DRAIN_MS and sends whatever's
+        waiting to USB Gecko in batches of up to LOG_SEND_BATCH, and
+        appends the text to LOG_FILE (when "Debug Log" is on) in writes of
+        LOG_FILE_FLUSH_BYTES or every LOG_FILE_FLUSH_SECS. If the ring is
+        full lines are counted and dropped rather than waited for.
+============================================*/
+#include <gccore.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <ogc/lwp_watchdog.h>
+#include "log.h"
+#include "gecko.h"
+
+#define LOG_PRIORITY 21					// just above the scanner, so its chatter can't back up behind it
+#define LOG_STACK_SIZE (8*1024)
+#define LOG_RAW 0xFF					// binary, for the Gecko only
+
+struct log_slot {
+	volatile u32 seq;					// ring position pos is free to claim at pos, drainable at pos+1
+	u16 len;
+	u8 level;
+	u8 pad;
+	char data[LOG_SLOT_SIZE - 8];
+};
+
+static struct log_slot ring[LOG_SLOTS];
+static volatile u32 head;				// next position to claim, shared by every writer
+static u32 tail;						// next position to drain, the drain thread's alone
+static volatile u32 dropped;
+static volatile int enabled;
+
+static int gecko;
+static FILE *logFile;
+static char sendBuf[LOG_SEND_BATCH];
+static int sendLen;
+static char fileBuf[LOG_FILE_FLUSH_BYTES];
+static int fileLen;
+static u64 fileWritten;
+
+static mutex_t drainMutex;
+static cond_t drainCond;
+static lwp_t drainThread = LWP_THREAD_NULL;
+static int stopping;
+
+// Claims the slot at head, NULL if the ring's full.
+static struct log_slot* claimSlot(u32 *pos) {
+	u32 claim = head;
+	while(1) {
+		struct log_slot *slot = &ring[claim & (LOG_SLOTS-1)];
+		s32 turn = (s32)(slot->seq - claim);
+		if(turn == 0) {
+			if(__sync_bool_compare_and_swap(&head, claim, claim + 1)) {
+				*pos = claim;
+				return slot;
+			}
+		}
+		else if(turn < 0) {
+			// Still holding a line from a lap ago
+			__sync_fetch_and_add(&dropped, 1);
+			return NULL;
+		}
+		claim = head;
+	}
+}
+
+static void publishSlot(struct log_slot *slot, u32 pos) {
+	__sync_synchronize();
+	slot->seq = pos + 1;
+}
+
+void logPrint(int level, const char* fmt, ...) {
+	if(!enabled) {
+		return;
+	}
+	u32 pos;
+	struct log_slot *slot = claimSlot(&pos);
+	if(!slot) {
+		return;
+	}
+	va_list arglist;
+	va_start(arglist, fmt);
+	int len = vsnprintf(slot->data, sizeof(slot->data), fmt, arglist);
+	va_end(arglist);
+	if(len < 0) {
+		len = 0;
+	}
+	else if(len >= sizeof(slot->data)) {
+		// Cut short, but still end the line
+		len = sizeof(slot->data) - 1;
+		slot->data[len-2] = '\r';
+		slot->data[len-1] = '\n';
+	}
+	slot->len = len;
+	slot->level = level;
+	publishSlot(slot, pos);
+}
+
+void send_gecko(const void *data, int len) {
+	if(!enabled || !gecko) {
+		return;
+	}
+	const u8 *bytes = data;
+	while(len > 0) {
+		u32 pos;
+		struct log_slot *slot = claimSlot(&pos);
+		if(!slot) {
+			return;
+		}
+		int chunk = len < sizeof(slot->data) ? len : sizeof(slot->data);
+		memcpy(slot->data, bytes, chunk);
+		slot->len = chunk;
+		slot->level = LOG_RAW;
+		publishSlot(slot, pos);
+		bytes += chunk;
+		len -= chunk;
+	}
+}
+
+static void sendBatch() {
+	if(sendLen) {
+		usb_sendbuffer_safe(1, sendBuf, sendLen);
+		sendLen = 0;
+	}
+}
+
+static void writeFile() {
+	if(fileLen && logFile) {
+		if(fwrite(fileBuf, 1, fileLen, logFile) != fileLen || fflush(logFile)) {
+			fclose(logFile);
+			logFile = NULL;
+			enabled = gecko;
+			error_gecko("debug.log failed to write, not logging to it any more\r\n");
+		}
+	}
+	fileLen = 0;
+	fileWritten = gettime();
+}
+
+static void output(const char *data, int len, int level) {
+	if(gecko) {
+		if(sendLen + len > LOG_SEND_BATCH) {
+			sendBatch();
+		}
+		memcpy(sendBuf + sendLen, data, len);
+		sendLen += len;
+	}
+	if(logFile && level != LOG_RAW) {
+		if(fileLen + len > LOG_FILE_FLUSH_BYTES) {
+			writeFile();
+		}
+		memcpy(fileBuf + fileLen, data, len);
+		fileLen += len;
+	}
+}
+
+// Empties the ring, the file is only written when there's enough for it or force.
+static void drain(int force) {
+	while(1) {
+		struct log_slot *slot = &ring[tail & (LOG_SLOTS-1)];
+		if(slot->seq != tail + 1) {
+			break;
+		}
+		__sync_synchronize();
+		output(slot->data, slot->len, slot->level);
+		__sync_synchronize();
+		slot->seq = tail + LOG_SLOTS;
+		tail++;
+	}
+	u32 lost = dropped;
+	if(lost) {
+		__sync_fetch_and_sub(&dropped, lost);
+		char note[48];
+		int len = sprintf(note, "[%u log lines dropped]\r\n", lost);
+		output(note, len, LOG_ERROR);
+	}
+	sendBatch();
+	if(logFile && (force || diff_sec(fileWritten, gettime()) >= LOG_FILE_FLUSH_SECS)) {
+		writeFile();
+	}
+}
+
+static void* drainLoop(void *arg) {
+	LWP_MutexLock(drainMutex);
+	while(!stopping) {
+		struct timespec timeout;
+		timeout.tv_sec = 0;
+		timeout.tv_nsec = LOG_DRAIN_MS * 1000000;
+		LWP_CondTimedWait(drainCond, drainMutex, &timeout);
+		drain(0);
+	}
+	LWP_MutexUnlock(drainMutex);
+	return NULL;
+}
+
+// Looks for a USB Gecko and starts the drain thread, nothing's logged before this.
+void logInit() {
+	for(u32 i = 0; i < LOG_SLOTS; i++) {
+		ring[i].seq = i;
+	}
+	if(usb_isgeckoalive(1)) {
+		usb_flush(1);
+		gecko = 1;
+	}
+	fileWritten = gettime();
+	LWP_MutexInit(&drainMutex, false);
+	LWP_CondInit(&drainCond);
+	LWP_CreateThread(&drainThread, drainLoop, NULL, NULL, LOG_STACK_SIZE, LOG_PRIORITY);
+	enabled = gecko;
+}
+
+// Also logs to path from now on, starting it afresh.
+void logOpenFile(const char *path) {
+	FILE *fp = fopen(path, "wb");
+	if(!fp) {
+		error_gecko("%s failed to create\r\n", path);
+		return;
+	}
+	LWP_MutexLock(drainMutex);
+	logFile = fp;
+	enabled = 1;
+	LWP_MutexUnlock(drainMutex);
+}
+
+// Sends and writes everything still queued, call before exiting or powering off.
+void logShutdown() {
+	if(drainThread == LWP_THREAD_NULL) {
+		return;
+	}
+	LWP_MutexLock(drainMutex);
+	stopping = 1;
+	LWP_CondSignal(drainCond);
+	LWP_MutexUnlock(drainMutex);
+	LWP_JoinThread(drainThread, NULL);
+	drainThread = LWP_THREAD_NULL;
+	drain(1);
+	if(logFile) {
+		fclose(logFile);
+		logFile = NULL;
+	}
+	enabled = 0;
+}
@@ -0,0 +1,19 @@
+#ifndef __LOG_H__
+#define __LOG_H__
+
+#include "paths.h"
+
+#define LOG_FILE WAKEMII_DIR "/debug.log"
+
+#define LOG_SLOTS 256				// lines the ring holds, must be a power of two
+#define LOG_SLOT_SIZE 256			// bytes per line including the slot header, longer lines are cut short
+#define LOG_DRAIN_MS 20				// how often the drain thread empties the ring
+#define LOG_SEND_BATCH (4*1024)		// bytes per USB Gecko send
+#define LOG_FILE_FLUSH_BYTES (8*1024)	// the log file is written once this much is waiting,
+#define LOG_FILE_FLUSH_SECS 5		// or it's been this long
+
+void logInit();
+void logOpenFile(const char *path);
+void logShutdown();
+
+#endif
@@ -12,7 +12,6 @@
 #include <fat.h>
 #include <stdarg.h>
 #include <stdio.h>
-#include <mp3player.h>
 #ifdef HW_RVL
 #include <wiiuse/wpad.h>
 #else
@@ -32,6 +31,22 @@ static DISC_INTERFACE* gcloader = &__io_gcode;
 #include "helpqr_jpg.h"
 #include "ocean_bmf.h"
 #include "frontal_bmf.h"
+#include "library.h"
+#include "gecko.h"
+#include "player.h"
+#include "covers.h"
+#include "text.h"
+#include "settings.h"
+#include "playlist.h"
+#include "alarm.h"
+#include "shuffle.h"
+#include "history.h"
+#include "standby.h"
+#include "profile.h"
+#include "log.h"
+#include "resume.h"
+#include "seek.h"
+#include "tags.h"
 
 
 // RGBA Colors
@@ -79,27 +94,7 @@ static DISC_INTERFACE* gcloader = &__io_gcode;
 #define BTN_CANCEL (PAD_BUTTON_B)
 #endif
 
-#define MAX_ALBUMS 4096
-
-enum cover_type_t {
-	COVER_NONE,
-	COVER_PNG,
-	COVER_BMP,
-	COVER_JPG
-};
-
-struct album {
-	char* name;
-	int num_entries;
-	enum cover_type_t cover_type;
-};
-
-static struct album* albums[MAX_ALBUMS];
-static int num_albums;
-static int num_hourly;
-
 // General stuff
-static int print_usb;
 static int scrWidth;
 static int scrHeight;
 
@@ -129,164 +124,16 @@ static int msgBoxTimer = 0;
 static char* msgBoxTitle = NULL;
 static char* msgBoxMsg = NULL;
 
-#define CONT_PLAY_TYPE_SEQUENTIAL 0
-#define CONT_PLAY_TYPE_SHUFFLE 1
-
-// Alarm stuff
-static int continuousPlayOn = 1;
-static int continuousPlayType = CONT_PLAY_TYPE_SEQUENTIAL;
-static int alarmOn = 0;
-static int alarmHrs = 7;
-static int alarmMins = 0;
-static int hourlyAlarmOn = 0;
-static int alarmGoingOff = 0;
-static int hourlyGoingOff = 0;
-static int shutdownAfterAlarm = 0;
-
-char* getCoverExtensionFromType(enum cover_type_t coverType) {
-	switch(coverType) {
-		case COVER_PNG:
-			return "png";
-		case COVER_JPG:
-			return "jpg";
-		case COVER_BMP:
-			return "bmp";
-		default:
-			return NULL;
-	}
-	return NULL;
-}
-
-void print_gecko(const char* fmt, ...)
-{
-	if(print_usb) {
-		char tempstr[2048];
-		va_list arglist;
-		va_start(arglist, fmt);
-		vsprintf(tempstr, fmt, arglist);
-		va_end(arglist);
-		usb_sendbuffer_safe(1,tempstr,strlen(tempstr));
-	}
-}
-
-static u8 CalculateFrameRate(void);
-
-s32 mp3Reader(void *cbdata, void *dst, s32 size) {
-	FILE *file = cbdata;
-	return fread(dst, 1, size, file);
-}
+// Why the screen needs drawing again, nothing is sent to the GPU until something changes
+#define REDRAW_INPUT	(1<<0)
+#define REDRAW_TRACK	(1<<1)
+#define REDRAW_CLOCK	(1<<2)
+#define REDRAW_VOLUME	(1<<3)
+#define REDRAW_MENU		(1<<4)
+#define REDRAW_LIBRARY	(1<<5)
+#define REDRAW_PROFILER	(1<<6)
 
-char *endsWith(char *str, char *end) {
-	size_t len_str = strlen(str);
-	size_t len_end = strlen(end);
-	if(len_str < len_end)
-		return NULL;
-	str += len_str - len_end;
-	return !strcasecmp(str, end) ? str : NULL;
-}
-
-struct album* parseDirForAlbum(char *path, char *dirName) {
-	print_gecko("Attempting to parse dir %s\r\n", path);
-	struct dirent *entry;
-	struct stat fstat;
-	struct album *newAlbum = calloc(1, sizeof(struct album));
-	DIR* dp = opendir(path);
-	while((entry = readdir(dp)) != NULL ) {
-		if(!strcasecmp(entry->d_name, "..") || !strcasecmp(entry->d_name, ".")) {
-			continue;
-		}
-		
-		char absPath[1024];
-		memset(absPath, 0, 1024);
-		newAlbum->name = calloc(1, strlen(dirName)+1);
-		strcpy(newAlbum->name, dirName);
-		sprintf(absPath, "%s/%s", path, entry->d_name);
-		stat(absPath,&fstat);
-		if(!(fstat.st_mode & _IFDIR)) {
-			print_gecko("Looking at file %s\r\n", absPath);
-			if(endsWith(entry->d_name, ".mp3")) {
-				newAlbum->num_entries++;
-				print_gecko("detected usable entry %s\r\n", entry->d_name);
-			}
-			else if(!strcasecmp(entry->d_name, "cover.png")) {
-				newAlbum->cover_type = COVER_PNG;
-			}
-			else if(!strcasecmp(entry->d_name, "cover.bmp")) {
-				newAlbum->cover_type = COVER_BMP;
-			}
-			else if(!strcasecmp(entry->d_name, "cover.jpg")) {
-				newAlbum->cover_type = COVER_JPG;
-			}
-		}
-	}
-	closedir(dp);
-	if(newAlbum->num_entries > 0) {
-		return newAlbum;
-	}
-	free(newAlbum);
-	return NULL;
-}
-
-FILE* getEntryFromIndex(int albumNum, int entryNum, char* entryName) {
-	char dirPath[1024];
-	memset(dirPath, 0, 1024);
-	if(albumNum != -1) {
-		sprintf(dirPath, "/wakemii/albums/%s", albums[albumNum]->name);
-	}
-	else {
-		// Hourly
-		strcpy(dirPath, "/wakemii/hourly");
-	}
-	print_gecko("Attempting to parse dir for random entry %s %i\r\n", dirPath, entryNum);
-	struct dirent *entry;
-	struct stat fstat;
-	DIR* dp = opendir(dirPath);
-	int i = 0;
-	while((entry = readdir(dp)) != NULL ) {
-		if(!strcasecmp(entry->d_name, "..") || !strcasecmp(entry->d_name, ".")) {
-			continue;
-		}
-		char absPath[1024];
-		memset(absPath, 0, 1024);
-		sprintf(absPath, "%s/%s", dirPath, entry->d_name);
-		stat(absPath,&fstat);
-		if(!(fstat.st_mode & _IFDIR)) {
-			print_gecko("Looking at file %s\r\n", absPath);
-			if(endsWith(entry->d_name, ".mp3")) {
-				if(i == entryNum) {
-					strcpy(entryName, entry->d_name);
-					closedir(dp);
-					return fopen(absPath, "rb");
-				}
-				i++;
-			}
-		}
-	}
-	closedir(dp);
-	return NULL;
-}
-
-GRRLIB_texImg* getCoverFromIdx(int randAlbumNum, float* coverScaledW, float* coverScaledH, int* coverStartX, int* coverStartY) {
-	char *coverExt = getCoverExtensionFromType(albums[randAlbumNum]->cover_type);
-	GRRLIB_texImg* cover = NULL;
-	if(coverExt != NULL) {
-		print_gecko("Attempting to load the album cover\r\n");
-		char absPath[1024];
-		memset(absPath, 0, 1024);
-		sprintf(absPath, "/wakemii/albums/%s/cover.%s", albums[randAlbumNum]->name, coverExt);
-		cover = GRRLIB_LoadTextureFromFile(absPath);
-		print_gecko("cover %s ptr %08X\r\n", absPath, cover);
-		if(cover != NULL) {
-			print_gecko("Cover Loaded with width %i height %i\r\n", cover->w, cover->h);
-			*coverScaledW = 500.0f/(float)cover->w;
-			*coverScaledH = 360.0f/(float)cover->h;
-			*coverStartX = (scrWidth / 2) - (int)((*coverScaledW*(float)cover->w)/2);
-			*coverStartY = (scrHeight / 2) - (int)((*coverScaledH*(float)cover->h)/2);
-			print_gecko("Cover scaled width %.2f height %.2f\r\n", *coverScaledW, *coverScaledH);
-		}
-	}
-	return cover;
-}
+static void CalculateFrameRate(int rendered, u8 *fps, u8 *drawnFps);
 
 static int shutdown = 0;
 #ifdef HW_RVL
@@ -295,97 +142,6 @@ void ShutdownWii() {
 }
 #endif
 
-void loadSettings() {
-	FILE *fp = fopen("/wakemii/settings.cfg", "rb");
-	if(!fp) {
-		print_gecko("settings.cfg not found\r\n");
-		return;
-	}
-	fseek(fp, 0L, SEEK_END);
-	size_t size = ftell(fp);
-	fseek(fp, 0L, SEEK_SET);
-	if(size > 1024*1024) {
-		print_gecko("settings.cfg is too large!\r\n");
-		return;
-	}
-	char *fileContentsBuffer = calloc(1, size);
-	size_t ret = fread(fileContentsBuffer, 1, size, fp);
-	fclose(fp);
-	if(ret != size) {
-		print_gecko("settings.cfg failed to read (expected %d got %d)\r\n", size, ret);
-		return;
-	}
-	
-	// parse back to our vars
-	char *line, *linectx = NULL;
-	line = strtok_r( fileContentsBuffer, "\r\n", &linectx );
-	while( line != NULL ) {
-		//print_gecko("Line [%s]\r\n", line);
-		if(line[0] != '#') {
-			char *name, *value = NULL;
-			name = strtok_r(line, "=", &value);
-			
-			if(value != NULL) {
-				//print_gecko("Name [%s] Value [%s]\r\n", name, value);
-				if(!strcmp("Continuous Play", name)) {
-					continuousPlayOn = !strcmp("yes", value);
-				}
-				else if(!strcmp("Alarm On", name)) {
-					alarmOn = !strcmp("yes", value);
-				}
-				else if(!strcmp("Hourly Alarm On", name)) {
-					hourlyAlarmOn = !strcmp("yes", value);
-				}
-				else if(!strcmp("Shutdown after alarm", name)) {
-					shutdownAfterAlarm = !strcmp("yes", value);
-				}
-				else if(!strcmp("Alarm Hour", name)) {
-					alarmHrs = atoi(value);
-				}
-				else if(!strcmp("Alarm Minute", name)) {
-					alarmMins = atoi(value);
-				}
-				else if(!strcmp("Continuous Play Type", name)) {
-					continuousPlayType = !strcmp("shuffle", value) ? CONT_PLAY_TYPE_SHUFFLE : CONT_PLAY_TYPE_SEQUENTIAL;
-				}
-			}
-		}
-		// And round we go again
-		line = strtok_r( NULL, "\r\n", &linectx);
-	}
-}
-
-bool saveSettings() {
-	char *configString = NULL;
-	size_t len = 0;
-	FILE *fp = open_memstream(&configString, &len);
-	if(!fp) return false;
-
-	// Write in a format we can parse later
-	fprintf(fp, "# WakeMii configuration file, do not edit anything unless you know what you're doing!\r\n");
-	fprintf(fp, "Continuous Play=%s\r\n", continuousPlayOn ? "yes":"no");
-	fprintf(fp, "Continuous Play Type=%s\r\n", continuousPlayType == CONT_PLAY_TYPE_SHUFFLE ? "shuffle":"sequential");
-	fprintf(fp, "Alarm On=%s\r\n", alarmOn ? "yes":"no");
-	fprintf(fp, "Alarm Hour=%02d\r\n", alarmHrs);
-	fprintf(fp, "Alarm Minute=%02d\r\n", alarmMins);
-	fprintf(fp, "Hourly Alarm On=%s\r\n", hourlyAlarmOn ? "yes":"no");
-	fprintf(fp, "Shutdown after alarm=%s\r\n", shutdownAfterAlarm ? "yes":"no");
-	fclose(fp);
-	
-	fp = fopen("/wakemii/settings.cfg", "wb");
-	if(!fp) {
-		print_gecko("settings.cfg failed to create\r\n");
-		return false;
-	}
-	int res = fwrite(configString, 1, len, fp);
-	if(res != len) {
-		print_gecko("settings.cfg failed to write (expected to write %d wrote %d)\r\n", len, res);
-		return false;
-	}
-	fclose(fp);
-	return true;
-}
-
 #ifndef HW_RVL
 char *getDeviceName() {
 	struct statvfs buf;
@@ -453,23 +209,28 @@ void drawErrorAndExit(GRRLIB_texImg *tex_titleFont, GRRLIB_texImg *tex_NormFont,
 		GRRLIB_Printf(440, 380, tex_NormFont, GRRLIB_MAROON, 1, "Exiting in 15 seconds.");
 		GRRLIB_Render();
 	}
+	logShutdown();
 	exit(0);
 }
 
 int main() {
 	
 	PAD_Init();
-	if(usb_isgeckoalive(1)) {
-		usb_flush(1);
-		print_usb = 1;
-	}
+	logInit();
 	print_gecko("WakeMii\r\n");
 	print_gecko("Arena Size: %iKb\r\n",(SYS_GetArena1Hi()-SYS_GetArena1Lo())/1024);
 	
     u8 FPS = 0; 
+	u8 drawnFPS = 0;
 	int vol = 192, vol_updated = 0;
+	int seek_updated = 0, seekSteps = 0, seekAlbum = -1, seekTrack = 0;
+	u32 seekShownMs = 0, seekLengthMs = 0;
+	s32 seekTargetMs = 0;
+	u64 seekHeldSince = 0;
 
     GRRLIB_Init();
+	standbyInit();
+	profileInit();
 	GXRModeObj* videoMode = VIDEO_GetPreferredMode(NULL);
 	scrWidth = videoMode->viWidth;
 	scrHeight = videoMode->viHeight;
@@ -506,108 +267,86 @@ int main() {
 	print_gecko("Device name: %s\r\n", deviceName);
 #endif
 	
-	// Parse the wakemii album dir for valid directories.
-	DIR* dp = opendir( "/wakemii/albums" );
-	if(!dp) {
-		print_gecko("wakemii/albums dir not found!\r\n");
-		drawErrorAndExit(tex_BMfont3, tex_BMfont5, "/wakemii/albums not found, please read the setup guide.");
-		return -1;
-	}
-	struct dirent *entry;
-	struct stat fstat;
-	while( (entry = readdir(dp)) != NULL ){
-		if(!strcasecmp(entry->d_name, "..") || !strcasecmp(entry->d_name, ".")) {
-			continue;
-		}
-		char absPath[1024];
-		memset(absPath, 0, 1024);
-		sprintf(absPath, "/wakemii/albums/%s", entry->d_name);
-		stat(absPath,&fstat);
-		if(fstat.st_mode & _IFDIR) {
-			struct album* ret = parseDirForAlbum(absPath, entry->d_name);
-			if(ret != NULL) {
-				albums[num_albums] = ret;
-				num_albums++;
-			}
-		}
-	}
-	closedir(dp);
-	
-	// Print all album info
-	print_gecko("Found %i albums\r\n", num_albums);
-	for(int i = 0; i < num_albums; i++) {
-		print_gecko("Album: %s. %i tracks. Cover Type: %i\r\n", albums[i]->name, albums[i]->num_entries, albums[i]->cover_type);
-	}
-	
-	// Parse the wakemii hourly dir for mp3 files.
-	dp = opendir( "/wakemii/hourly" );
-	if(!dp) {
-		print_gecko("wakemii/hourly dir not found!\r\n");
-		return -1;
-	}
-
-	while( (entry = readdir(dp)) != NULL ){
-		if(!strcasecmp(entry->d_name, "..") || !strcasecmp(entry->d_name, ".")) {
-			continue;
-		}
-		char absPath[1024];
-		memset(absPath, 0, 1024);
-		sprintf(absPath, "/wakemii/hourly/%s", entry->d_name);
-		stat(absPath,&fstat);
-		if(!(fstat.st_mode & _IFDIR)) {
-			if(endsWith(entry->d_name, ".mp3")) {
-				num_hourly++;
-			}
-		}
-	}
-	closedir(dp);
-	print_gecko("Found %i hourly chimes\r\n", num_hourly);
+	// Find albums and hourly chimes in the background, using library.idx where possible.
+	startLibraryScan();
 	
 	// Load settings
 	loadSettings();
-	if(!num_hourly && hourlyAlarmOn) {
-		hourlyAlarmOn = 0;
+	if(debugLogOn) {
+		logOpenFile(LOG_FILE);
 	}
+	shuffleInit();
+	historyInit();
+	alarmInit();
+	resumeInit();
 	
-	// Pick a random album + display its artwork
+	// A random album + its artwork gets picked as soon as the scanner has found one
 	srand(gettick());
-	int randAlbumNum = rand() % num_albums;
-	int randTrackFromAlbum = rand() % albums[randAlbumNum]->num_entries;
+	int randAlbumNum = -1;
+	int randTrackFromAlbum = 0;
 	
-	float coverScaledW = 1.0f;
-	float coverScaledH = 1.0f;
-	int coverStartX = 0;
-	int coverStartY = 0;
-	GRRLIB_texImg* cover = getCoverFromIdx(randAlbumNum, &coverScaledW, &coverScaledH, &coverStartX, &coverStartY);
+	int coverAlbumNum = -1;
+	coverCacheInit();
+	tagsInit();
+	seekInit();
 	
 	char entryName[1024];
 	memset(entryName, 0, 1024);
 	char* entryNamePtr = &entryName[0];
 	
-	MP3Player_Init();
-	FILE *mp3File = NULL;
-	if(continuousPlayOn) {
-		mp3File = getEntryFromIndex(randAlbumNum, randTrackFromAlbum, entryNamePtr);
-		print_gecko("mp3File ptr %08X\r\n", mp3File);
-		if(mp3File != NULL) {
-			MP3Player_PlayFile(mp3File, &mp3Reader, NULL);
-		}
+	playerInit();
+	if(resumeVolume(&vol)) {
+		playerVolume(vol);
 	}
 	
+	// What continuous play moves on to next, opened ahead of time for a gapless change
+	int queue_next = 0;
+	int queuedAlbumNum = 0;
+	int queuedTrackFromAlbum = 0;
+	int queuedFromShuffle = 0;
+	char queuedEntryName[1024];
+	memset(queuedEntryName, 0, 1024);
+	
+	// The alarm track, picked and read in before the alarm goes off so it starts straight away
+	int armedValid = 0;
+	int armedAlbumNum = 0;
+	int armedTrackFromAlbum = 0;
+	char armedEntryName[1024];
+	memset(armedEntryName, 0, 1024);
+	
 	char timeLine[256];
 	memset(timeLine, 0, 256);
 	time_t curtime;	
 
 	int change_entry = 0;
-	int change_entry_rand = 0;
+	int change_entry_rand = continuousPlayOn;
 	int change_album = 0;
-	int alarmSongHandled = 0;
 	int change_entry_rand_hourly = 0;
-	int hourlyChimeHandled = 0;
+	int pick_for_alarm = 0;
+	
+	// Boot carries on with what was playing last time, instead of a random pick
+	int resuming = continuousPlayOn;
+	int resumeAlbumNum = 0;
+	int resumeTrackFromAlbum = 0;
+	u32 resumeOffset = 0;
+	
+	// What the last drawn frame showed, anything different means it's stale
+	u32 redraw = REDRAW_INPUT;
+	time_t drawnTime = 0;
+	GRRLIB_texImg* drawnCover = NULL;
+	int drawnPlaying = 0;
+	int drawnAlbums = -1;
+	int drawnTracks = -1;
+	int drawnHourly = -1;
+	int drawnScanState = -1;
 	
     while(1) {
 		if(shutdown) {
-			MP3Player_Stop();
+			resumeFlush();
+			playerStop();
+			historyFlush(1);
+			shuffleFlush(1);
+			logShutdown();
 #ifdef HW_RVL
 			SYS_ResetSystem(SYS_POWEROFF, 0, 0);
 #else
@@ -620,106 +359,143 @@ int main() {
 			change_entry_rand = 0;
 			change_album = 0;
 		}
-		// Trigger a song for the alarm.
-		if(alarmGoingOff && !alarmSongHandled) {
-			alarmSongHandled = 1;
-			change_entry_rand = 1;
+		if(libraryScanState == LIBRARY_NOT_FOUND) {
+			drawErrorAndExit(tex_BMfont3, tex_BMfont5, "/wakemii/albums not found, please read the setup guide.");
 		}
-		// Trigger a song for the hourly alarm.
-		if(hourlyGoingOff && !hourlyChimeHandled) {
-			hourlyChimeHandled = 1;
-			change_entry_rand_hourly = 1;
+		// Nothing to move around in until the scanner has found an album, random picks wait for one.
+		if(!num_albums) {
+			change_entry = 0;
+			change_album = 0;
+		}
+		// Resuming waits for the scanner to get to the album, unless something else is asked for first
+		int resumed = 0;
+		if(resuming && (change_entry || change_album || change_entry_rand_hourly || pick_for_alarm)) {
+			resuming = 0;
+		}
+		else if(resuming && change_entry_rand && num_albums) {
+			int found = resumeFind(&resumeAlbumNum, &resumeTrackFromAlbum, &resumeOffset);
+			resuming = found == RESUME_WAIT;
+			resumed = found == RESUME_FOUND;
 		}
 		
 		// Change in track was requested, handle it.
 		if(change_entry || change_entry_rand || change_album || change_entry_rand_hourly) {
 			if(change_entry_rand_hourly) {
-				MP3Player_Stop();
-				if(mp3File) {
-					fclose(mp3File);
-				}
+				playerStop();
 				memset(entryName, 0, 1024);
-				mp3File = getEntryFromIndex(-1, rand() % num_hourly, entryNamePtr);
-				print_gecko("mp3File ptr %08X\r\n", mp3File);
+				int hourlyTrack;
+				if(!historyPickHourly(&hourlyTrack)) {
+					hourlyTrack = rand() % num_hourly;
+				}
+				FILE *mp3File = getEntryFromIndex(HOURLY_ALBUM, hourlyTrack, entryNamePtr);
+				debug_gecko("mp3File ptr %p\r\n", mp3File);
 				if(mp3File != NULL) {
-					MP3Player_PlayFile(mp3File, &mp3Reader, NULL);
+					playerPlay(mp3File);
+					historyPlayed(HOURLY_ALBUM, hourlyTrack);
 				}
 				
-				if(cover) {
-					GRRLIB_FreeTexture(cover);
-					cover = NULL;
-				}
+				coverAlbumNum = -1;
+				redraw |= REDRAW_TRACK;
 				
 				change_entry_rand_hourly = 0;
 			}
-			else {
+			else if(num_albums && !resuming) {
 				// determine new album/track
 				int prevRandAlbumNum = randAlbumNum;
-				if(change_entry_rand) {
-					// Random
-					randAlbumNum = rand() % num_albums;
-					randTrackFromAlbum = rand() % albums[randAlbumNum]->num_entries;
+				if(resumed) {
+					randAlbumNum = resumeAlbumNum;
+					randTrackFromAlbum = resumeTrackFromAlbum;
+				}
+				else if(pick_for_alarm && historyPickAlarm(&randAlbumNum, &randTrackFromAlbum)) {
+					// The alarm goes by the play history as set by Alarm Pick
+				}
+				else if(change_entry_rand || randAlbumNum < 0) {
+					// Random, taken from the shuffle so nothing repeats until everything's had a go
+					if(!shuffleNext(&randAlbumNum, &randTrackFromAlbum) && randAlbumNum < 0) {
+						randAlbumNum = 0;
+						randTrackFromAlbum = 0;
+					}
 				}
 				else {
 					if(change_album) {
-						// Sequential movement amongst albums, always going to the first entry in the destination album
-						if(randAlbumNum + change_album < 0) {
-							randAlbumNum = num_albums-1;
-						}
-						else if (randAlbumNum + change_album > num_albums-1) {
-							randAlbumNum = 0;
+						stepAlbum(change_album, &randAlbumNum, &randTrackFromAlbum);
+					}
+					else if(change_entry && continuousPlayType == CONT_PLAY_TYPE_SHUFFLE) {
+						// Next/prev follow the shuffled order, prev with nothing before it restarts the track
+						if(change_entry > 0) {
+							shuffleNext(&randAlbumNum, &randTrackFromAlbum);
 						}
 						else {
-							randAlbumNum += change_album;
+							shufflePrev(&randAlbumNum, &randTrackFromAlbum);
 						}
-						// Enter the album at the start
-						randTrackFromAlbum = 0;
 					}
 					else if(change_entry) {
-						// Sequential movement amongst entries, potentially moving into other albums
-						if(randTrackFromAlbum + change_entry < 0 || randTrackFromAlbum + change_entry > albums[randAlbumNum]->num_entries-1) {
-							// Go to the next/prev album cause we've reached the end of this one
-							if(randAlbumNum + change_entry < 0) {
-								randAlbumNum = num_albums-1;
-							}
-							else if (randAlbumNum + change_entry > num_albums-1) {
-								randAlbumNum = 0;
-							}
-							else {
-								randAlbumNum += change_entry;
-							}
-							// Enter the album at the start or end depending which direction we're going.
-							if(change_entry < 0) randTrackFromAlbum = albums[randAlbumNum]->num_entries-1;
-							else randTrackFromAlbum = 0;
-						}
-						else {
-							randTrackFromAlbum += change_entry;
-						}
+						stepEntry(change_entry, &randAlbumNum, &randTrackFromAlbum);
 					}
 				}				
 				
 				// Only fetch the cover if the album changed
-				if(prevRandAlbumNum != randAlbumNum) {
-					if(cover) {
-						GRRLIB_FreeTexture(cover);
-					}
-					cover = getCoverFromIdx(randAlbumNum, &coverScaledW, &coverScaledH, &coverStartX, &coverStartY);
+				if(prevRandAlbumNum != randAlbumNum || coverAlbumNum != randAlbumNum) {
+					coverAlbumNum = randAlbumNum;
+					coverShow(coverAlbumNum);
 				}
 				
-				MP3Player_Stop();
-				if(mp3File) {
-					fclose(mp3File);
-				}
+				playerStop();
 				memset(entryName, 0, 1024);
-				mp3File = getEntryFromIndex(randAlbumNum, randTrackFromAlbum, entryNamePtr);
-				print_gecko("mp3File ptr %08X\r\n", mp3File);
+				FILE *mp3File = getEntryFromIndex(randAlbumNum, randTrackFromAlbum, entryNamePtr);
+				debug_gecko("mp3File ptr %p\r\n", mp3File);
 				if(mp3File != NULL) {
-					MP3Player_PlayFile(mp3File, &mp3Reader, NULL);
+					playerPlayFrom(mp3File, resumed ? resumeOffset : 0);
+					historyPlayed(randAlbumNum, randTrackFromAlbum);
+					queue_next = 1;
 				}
+				redraw |= REDRAW_TRACK;
 				change_entry = 0;
 				change_entry_rand = 0;
 				change_album = 0;
+				pick_for_alarm = 0;
+			}
+		}
+		
+		// Playback ran on into the queued track by itself, catch up with it.
+		if(playerTrackChanged()) {
+			int prevRandAlbumNum = randAlbumNum;
+			randAlbumNum = queuedAlbumNum;
+			randTrackFromAlbum = queuedTrackFromAlbum;
+			strcpy(entryName, queuedEntryName);
+			if(queuedFromShuffle) {
+				// It was only peeked at when it got queued
+				int album, track;
+				shuffleNext(&album, &track);
+			}
+			historyPlayed(randAlbumNum, randTrackFromAlbum);
+			if(prevRandAlbumNum != randAlbumNum) {
+				coverAlbumNum = randAlbumNum;
+				coverShow(coverAlbumNum);
+			}
+			redraw |= REDRAW_TRACK;
+			queue_next = 1;
+		}
+		
+		// Open what continuous play will move on to while the current track is still playing.
+		if(queue_next && continuousPlayOn && num_albums && randAlbumNum >= 0) {
+			queuedAlbumNum = randAlbumNum;
+			queuedTrackFromAlbum = randTrackFromAlbum;
+			queuedFromShuffle = continuousPlayType == CONT_PLAY_TYPE_SHUFFLE;
+			if(queuedFromShuffle) {
+				shufflePeek(&queuedAlbumNum, &queuedTrackFromAlbum);
+			}
+			else {
+				stepEntry(1, &queuedAlbumNum, &queuedTrackFromAlbum);
 			}
+			memset(queuedEntryName, 0, 1024);
+			FILE *nextFile = getEntryFromIndex(queuedAlbumNum, queuedTrackFromAlbum, queuedEntryName);
+			if(nextFile != NULL) {
+				playerQueueNext(nextFile);
+				coverPrefetch(queuedAlbumNum);
+				tagsPrefetch(queuedAlbumNum, queuedTrackFromAlbum);
+			}
+			queue_next = 0;
 		}
 		
 		// Scan for input
@@ -727,135 +503,326 @@ int main() {
         WPAD_ScanPads();
         const u32 paddown = WPAD_ButtonsDown(0);
         const u32 padheld = WPAD_ButtonsHeld(0);
+        const u32 padup = WPAD_ButtonsUp(0);
 #else
 		PAD_ScanPads();
 		const u32 paddown = PAD_ButtonsDown(0);
         const u32 padheld = PAD_ButtonsHeld(0);
+        const u32 padup = PAD_ButtonsUp(0);
 #endif
 
-        GRRLIB_FillScreen(GRRLIB_BLACK);    // Clear the screen
-		if(mp3File && MP3Player_IsPlaying()) {
-			if(cover != NULL) {
-				// Draw the cover
-				GRRLIB_DrawImg(coverStartX, coverStartY, cover, 0, MIN(coverScaledW, coverScaledH), MIN(coverScaledW, coverScaledH), GRRLIB_WHITE);  
+		// The console clock is local time, no time zone to apply
+		time(&curtime);
+		struct tm nowTm;
+		gmtime_r(&curtime, &nowTm);
+		
+		int alarmEvents = alarmTakeEvents();
+		if(alarmEvents & ALARM_ARMED) {
+			armedValid = num_albums && (historyPickAlarm(&armedAlbumNum, &armedTrackFromAlbum)
+				|| shuffleNext(&armedAlbumNum, &armedTrackFromAlbum));
+			if(armedValid) {
+				coverPrefetch(armedAlbumNum);
 			}
-			if(!hourlyGoingOff) {
-				GRRLIB_Printf(100, scrHeight-(60+palHeightBias), tex_BMfont5, GRRLIB_WHITE, 1, "Album: %s", albums[randAlbumNum]->name);
+		}
+		if(armedValid && alarmArmed && !playerIsPrimed() && !playerIsPlaying()) {
+			// Read it in while the player's free, a chime in the meantime means doing it again after
+			memset(armedEntryName, 0, 1024);
+			FILE *mp3File = getEntryFromIndex(armedAlbumNum, armedTrackFromAlbum, armedEntryName);
+			if(mp3File != NULL) {
+				playerPrime(mp3File);
+			}
+			else {
+				armedValid = 0;
 			}
-			char *trackNameWithLabel = calloc(1, 1024);
-			sprintf(trackNameWithLabel, "Track: %.*s", strlen(entryName)-4, entryName);
-			GRRLIB_Printf(100, scrHeight-(40+palHeightBias), tex_BMfont5, GRRLIB_WHITE, 1, trackNameWithLabel);
-			free(trackNameWithLabel);
 		}
-		
-		// Print general stuff
-		time(&curtime);
-		struct tm *tmpTime = gmtime(&curtime);
-		GRRLIB_Printf(50, 25, tex_BMfont3, GRRLIB_WHITE, 1, "WAKEMII");
-		GRRLIB_Printf(280, 44, tex_BMfont5, GRRLIB_WHITE, 1, "v1.1");
-        GRRLIB_Printf(350, 27, tex_BMfont5, GRRLIB_WHITE, 1, "Current FPS: %d | Mem Free %.2fMB", FPS, (SYS_GetArena1Hi()-SYS_GetArena1Lo())/(1048576.0f));
-		if(!continuousPlayOn) {
-			if(tmpTime->tm_sec % 2) {
-				strftime(timeLine, sizeof(timeLine), "%H:%M", localtime(&curtime));
+		if(alarmEvents & ALARM_DISARMED) {
+			if(playerIsPrimed()) {
+				playerStop();
+			}
+			armedValid = 0;
+		}
+		if(alarmEvents & ALARM_STARTED) {
+			playerMeasureLatency(gettime());
+			if(armedValid && playerIsPrimed() && !playerStartPrimed()) {
+				// Started here and now rather than next time round the loop
+				if(coverAlbumNum != armedAlbumNum) {
+					coverAlbumNum = armedAlbumNum;
+					coverShow(coverAlbumNum);
+				}
+				randAlbumNum = armedAlbumNum;
+				randTrackFromAlbum = armedTrackFromAlbum;
+				strcpy(entryName, armedEntryName);
+				historyPlayed(randAlbumNum, randTrackFromAlbum);
+				redraw |= REDRAW_TRACK;
 			}
 			else {
-				strftime(timeLine, sizeof(timeLine), "%H %M", localtime(&curtime));
+				change_entry_rand = 1;
+				pick_for_alarm = 1;
 			}
-			GRRLIB_Printf(90, 150, tex_BMfont3, GRRLIB_WHITE, 3, "%s", timeLine);
+			armedValid = 0;
 		}
-		else {
-			strftime(timeLine, sizeof(timeLine), "%Y-%m-%d %H:%M:%S", localtime(&curtime));
-			GRRLIB_Printf(350, 47, tex_BMfont5, GRRLIB_WHITE, 1, "Date Time: %s", timeLine);
+		if(alarmEvents & HOURLY_STARTED) {
+			change_entry_rand_hourly = 1;
 		}
-
-		// If volume was updated, set the volume
-		if(vol_updated) {
-			GRRLIB_Printf(500, scrHeight-(40+palHeightBias), tex_BMfont5, GRRLIB_WHITE, 1, "Volume (%i%%)", (int)(((float)vol/(float)256)*100));
-			vol_updated--;
+		if((alarmEvents & ALARM_ENDED) && shutdownAfterAlarm) {
+			shutdown = 1;
 		}
 		
-		// Trigger the hourly alarm
-		if((num_hourly && hourlyAlarmOn && !continuousPlayOn && !(alarmOn && !alarmMins)) && tmpTime->tm_min == 0 && !hourlyGoingOff) {
-			print_gecko("Hourly alarm triggered!\r\n");
-			hourlyGoingOff = 1;
+		// Nod off when it's just being a clock, anything happening wakes it straight back up
+		int playing = playerIsPlaying();
+		if(!hourlyGoingOff) {
+			resumeUpdate(randAlbumNum, randTrackFromAlbum, playing ? playerPosition() : 0, vol, playing);
+			if(playing) {
+				// Has its seek index ready by the time the D-pad's been held long enough
+				seekPrepare(randAlbumNum, randTrackFromAlbum);
+			}
 		}
-		
-		// End the hourly alarm
-		if((num_hourly && hourlyAlarmOn && hourlyGoingOff) && tmpTime->tm_min != 0) {
-			hourlyGoingOff = 0;
-			hourlyChimeHandled = 0;
+		int wokeUp = standbyActive();
+		int standbyAllowed = !continuousPlayOn && !playing && menu_state == NOT_IN_MENU && !alarmGoingOff && !hourlyGoingOff && !profileShown();
+		if(standbyCheck(standbyAllowed, paddown || padheld || alarmEvents)) {
+			redraw |= REDRAW_INPUT;
 		}
-			
+		// The button that wakes it up doesn't do anything else
+		wokeUp = wokeUp && !standbyActive() && (paddown || padheld);
 		
-		// Trigger the alarm
-		if(alarmOn && (alarmHrs == tmpTime->tm_hour && alarmMins == tmpTime->tm_min) && !alarmGoingOff) {
-			print_gecko("Alarm triggered!\r\n");
-			alarmGoingOff = 1;
+		// Work out if anything on screen has changed since it was last drawn
+		GRRLIB_texImg* cover = playing ? coverGet(coverAlbumNum) : NULL;
+		if(curtime != drawnTime) {
+			redraw |= REDRAW_CLOCK;
 		}
-		
-		// End the alarm
-		if(alarmOn && alarmGoingOff && (alarmHrs != tmpTime->tm_hour || alarmMins != tmpTime->tm_min)) {
-			alarmGoingOff = 0;
-			alarmSongHandled = 0;
-			if(shutdownAfterAlarm) shutdown = 1;
+		if(playing != drawnPlaying || cover != drawnCover) {
+			redraw |= REDRAW_TRACK;
+		}
+		if(num_albums != drawnAlbums || num_tracks != drawnTracks || num_hourly != drawnHourly || libraryScanState != drawnScanState) {
+			redraw |= REDRAW_LIBRARY;
+		}
+		if(profileShown()) {
+			redraw |= REDRAW_PROFILER;
 		}
 		
-		if(menu_state == MENU_SETTINGS) {
-			GRRLIB_Rectangle (80, 80, 540, 330, 0x808080A0, true);
-			if(settings_pos < SETTINGS_CANCEL) {
-				GRRLIB_Rectangle (80, 140 + (settings_pos * 30), 12, 12, 0x8A8A8AFF, true);
-			}
-			GRRLIB_Printf(90, 90, tex_BMfont3, GRRLIB_WHITE, 1, "SETTINGS");
-			GRRLIB_Printf(90, 140, tex_BMfont4, GRRLIB_WHITE, 1, "CONTINUOUS PLAY");
-			GRRLIB_Printf(420, 140, tex_BMfont4, GRRLIB_WHITE, 1, "[%s]", continuousPlayOn ? "ON" : "OFF");
-			GRRLIB_Printf(90, 170, tex_BMfont4, GRRLIB_WHITE, 1, "CONTINUOUS PLAY TYPE");
-			GRRLIB_Printf(420, 170, tex_BMfont4, GRRLIB_WHITE, 1, "[%s]", continuousPlayType == CONT_PLAY_TYPE_SHUFFLE ? "SHUFFLE" : "SEQUENTIAL");
-			GRRLIB_Printf(90, 200, tex_BMfont4, GRRLIB_WHITE, 1, "ALARM");
-			GRRLIB_Printf(420, 200, tex_BMfont4, GRRLIB_WHITE, 1, "[%s]", alarmOn ? "ON" : "OFF");
-			GRRLIB_Printf(90, 230, tex_BMfont4, GRRLIB_WHITE, 1, "ALARM HOUR");
-			GRRLIB_Printf(420, 230, tex_BMfont4, GRRLIB_WHITE, 1, "%02d", alarmHrs);
-			GRRLIB_Printf(90, 260, tex_BMfont4, GRRLIB_WHITE, 1, "ALARM MINUTE");
-			GRRLIB_Printf(420, 260, tex_BMfont4, GRRLIB_WHITE, 1, "%02d", alarmMins);
-			GRRLIB_Printf(90, 290, tex_BMfont4, GRRLIB_WHITE, 1, "HOURLY ALARM");
-			GRRLIB_Printf(420, 290, tex_BMfont4, GRRLIB_WHITE, 1, "[%s]", num_hourly ? (hourlyAlarmOn ? "ON" : "OFF") : "NOT AVAIL");
-			GRRLIB_Printf(90, 320, tex_BMfont4, GRRLIB_WHITE, 1, "SHUTDOWN AFTER ALARM");
-			GRRLIB_Printf(420, 320, tex_BMfont4, GRRLIB_WHITE, 1, "[%s]", shutdownAfterAlarm ? "YES" : "NO");
-			GRRLIB_Printf(420, 345, tex_BMfont4, GRRLIB_WHITE, 1, settings_pos == SETTINGS_CANCEL ? "(CANCEL)" : "CANCEL");
-			GRRLIB_Printf(420, 370, tex_BMfont4, GRRLIB_WHITE, 1, settings_pos == SETTINGS_SAVE ? "(SAVE)" : "SAVE");
+		if(standbyBlank()) {
+			redraw = 0;
+		}
 		
+		if(redraw) {
+			u64 drawStart = profileBegin();
+			GRRLIB_FillScreen(GRRLIB_BLACK);    // Clear the screen
+			if(playing) {
+				// Draw the cover, if it's been decoded yet
+				if(cover != NULL) {
+					float coverScaledW = 500.0f/(float)cover->w;
+					float coverScaledH = 360.0f/(float)cover->h;
+					int coverStartX = (scrWidth / 2) - (int)((coverScaledW*(float)cover->w)/2);
+					int coverStartY = (scrHeight / 2) - (int)((coverScaledH*(float)cover->h)/2);
+					GRRLIB_DrawImg(coverStartX, coverStartY, cover, 0, MIN(coverScaledW, coverScaledH), MIN(coverScaledW, coverScaledH), GRRLIB_WHITE);  
+				}
+				// The file and dir names until the tags have been read, or if there aren't any
+				const struct track_tags *tags = !hourlyGoingOff ? tagsGet(randAlbumNum, randTrackFromAlbum) : NULL;
+				if(!hourlyGoingOff && randAlbumNum >= 0) {
+					textPrintf(100, scrHeight-(60+palHeightBias), tex_BMfont5, GRRLIB_WHITE, 1, "Album: %s",
+						tags && tags->album[0] ? tags->album : albumName(randAlbumNum));
+				}
+				const char *fav = !hourlyGoingOff && randAlbumNum >= 0 && historyIsFavourite(randAlbumNum, randTrackFromAlbum) ? " (FAV)" : "";
+				if(tags && tags->title[0]) {
+					char length[16] = "";
+					if(tags->duration_ms) {
+						sprintf(length, " (%u:%02u)", tags->duration_ms / 60000, (tags->duration_ms / 1000) % 60);
+					}
+					textPrintf(100, scrHeight-(40+palHeightBias), tex_BMfont5, GRRLIB_WHITE, 1, "Track: %s%s%s%s%s", tags->artist,
+						tags->artist[0] ? " - " : "", tags->title, length, fav);
+				}
+				else {
+					textPrintf(100, scrHeight-(40+palHeightBias), tex_BMfont5, GRRLIB_WHITE, 1, "Track: %.*s%s", (int)strlen(entryName)-4, entryName, fav);
+				}
+			}
+			
+			// Print general stuff, just the clock in standby
+			if(!standbyActive()) {
+				textPrintf(50, 25, tex_BMfont3, GRRLIB_WHITE, 1, "WAKEMII");
+				textPrintf(280, 44, tex_BMfont5, GRRLIB_WHITE, 1, "v1.1");
+				if(libraryScanState == LIBRARY_SCANNING) {
+					textPrintf(350, 27, tex_BMfont5, GRRLIB_WHITE, 1, "FPS: %d Drawn: %d | Scan %iA %iT", FPS, drawnFPS, num_albums, num_tracks);
+				}
+				else {
+					textPrintf(350, 27, tex_BMfont5, GRRLIB_WHITE, 1, "FPS: %d Drawn: %d | Mem Free %.2fMB", FPS, drawnFPS, (SYS_GetArena1Hi()-SYS_GetArena1Lo())/(1048576.0f));
+				}
+			}
+			if(!continuousPlayOn) {
+				if(nowTm.tm_sec % 2) {
+					strftime(timeLine, sizeof(timeLine), "%H:%M", &nowTm);
+				}
+				else {
+					strftime(timeLine, sizeof(timeLine), "%H %M", &nowTm);
+				}
+				textPrintf(90, 150, tex_BMfont3, standbyActive() ? STANDBY_DIM_COLOUR : GRRLIB_WHITE, 3, "%s", timeLine);
+			}
+			else {
+				strftime(timeLine, sizeof(timeLine), "%Y-%m-%d %H:%M:%S", &nowTm);
+				textPrintf(350, 47, tex_BMfont5, GRRLIB_WHITE, 1, "Date Time: %s", timeLine);
+			}
+
+			// If volume was updated, show it for a bit
+			if(vol_updated) {
+				textPrintf(500, scrHeight-(40+palHeightBias), tex_BMfont5, GRRLIB_WHITE, 1, "Volume (%i%%)", (int)(((float)vol/(float)256)*100));
+			}
+			// Same for where a seek landed
+			if(seek_updated) {
+				textPrintf(500, scrHeight-(60+palHeightBias), tex_BMfont5, GRRLIB_WHITE, 1, "%u:%02u / %u:%02u",
+					seekShownMs / 60000, (seekShownMs / 1000) % 60, seekLengthMs / 60000, (seekLengthMs / 1000) % 60);
+			}
+			
+			// Menus go over the top of everything queued so far
+			textFlush();
+			
+			if(menu_state == MENU_SETTINGS) {
+				GRRLIB_Rectangle (80, 80, 540, 330, 0x808080A0, true);
+				if(settings_pos < SETTINGS_CANCEL) {
+					GRRLIB_Rectangle (80, 140 + (settings_pos * 30), 12, 12, 0x8A8A8AFF, true);
+				}
+				textPrintf(90, 90, tex_BMfont3, GRRLIB_WHITE, 1, "SETTINGS");
+				textPrintf(90, 140, tex_BMfont4, GRRLIB_WHITE, 1, "CONTINUOUS PLAY");
+				textPrintf(420, 140, tex_BMfont4, GRRLIB_WHITE, 1, "[%s]", continuousPlayOn ? "ON" : "OFF");
+				textPrintf(90, 170, tex_BMfont4, GRRLIB_WHITE, 1, "CONTINUOUS PLAY TYPE");
+				textPrintf(420, 170, tex_BMfont4, GRRLIB_WHITE, 1, "[%s]", continuousPlayType == CONT_PLAY_TYPE_SHUFFLE ? "SHUFFLE" : "SEQUENTIAL");
+				textPrintf(90, 200, tex_BMfont4, GRRLIB_WHITE, 1, "ALARM");
+				textPrintf(420, 200, tex_BMfont4, GRRLIB_WHITE, 1, "[%s]", alarms[0].on ? "ON" : "OFF");
+				textPrintf(90, 230, tex_BMfont4, GRRLIB_WHITE, 1, "ALARM HOUR");
+				textPrintf(420, 230, tex_BMfont4, GRRLIB_WHITE, 1, "%02d", alarms[0].hrs);
+				textPrintf(90, 260, tex_BMfont4, GRRLIB_WHITE, 1, "ALARM MINUTE");
+				textPrintf(420, 260, tex_BMfont4, GRRLIB_WHITE, 1, "%02d", alarms[0].mins);
+				textPrintf(90, 290, tex_BMfont4, GRRLIB_WHITE, 1, "HOURLY ALARM");
+				textPrintf(420, 290, tex_BMfont4, GRRLIB_WHITE, 1, "[%s]", num_hourly ? (hourlyAlarmOn ? "ON" : "OFF") : "NOT AVAIL");
+				textPrintf(90, 320, tex_BMfont4, GRRLIB_WHITE, 1, "SHUTDOWN AFTER ALARM");
+				textPrintf(420, 320, tex_BMfont4, GRRLIB_WHITE, 1, "[%s]", shutdownAfterAlarm ? "YES" : "NO");
+				textPrintf(420, 345, tex_BMfont4, GRRLIB_WHITE, 1, settings_pos == SETTINGS_CANCEL ? "(CANCEL)" : "CANCEL");
+				textPrintf(420, 370, tex_BMfont4, GRRLIB_WHITE, 1, settings_pos == SETTINGS_SAVE ? "(SAVE)" : "SAVE");
+			
+			}
+			
+			// Draw a message box
+			if(menu_state == MENU_MSGBOX) {
+				GRRLIB_Rectangle (80, 160, 500, 200, 0x808080A0, true);
+				if(msgBoxTitle != NULL)
+					textPrintf(90, 170, tex_BMfont5, GRRLIB_WHITE, 2, "%s", msgBoxTitle);
+				if(msgBoxMsg != NULL)
+					textPrintf(90, 240, tex_BMfont5, GRRLIB_WHITE, 1, "%s", msgBoxMsg);
+			}
+			
+			textFlush();
+			profileDrawOverlay(scrWidth - PROFILE_HISTORY - 40, 80, tex_BMfont5);
+			textFlush();
+			profileEnd(PROF_DRAW, drawStart);
+			u64 renderStart = profileBegin();
+			standbyRender();
+			profileEnd(PROF_RENDER, renderStart);
+			drawnTime = curtime;
+			drawnCover = cover;
+			drawnPlaying = playing;
+			drawnAlbums = num_albums;
+			drawnTracks = num_tracks;
+			drawnHourly = num_hourly;
+			drawnScanState = libraryScanState;
 		}
+		else {
+			// Nothing changed, the last frame stays up and we just keep time with the display (or doze)
+			standbyWait();
+		}
+		standbyFrameDone(redraw != 0);
+		profileFrameEnd();
+		CalculateFrameRate(redraw != 0, &FPS, &drawnFPS);
+		redraw = 0;
+		coverCacheUpdate();
+		if(tagsUpdate()) {
+			redraw |= REDRAW_TRACK;
+		}
+		historyFlush(0);
+		shuffleFlush(0);
 		
-		// Handle a message box
+		// Timed overlays, these tick once a frame whether it was drawn or not
+		if(vol_updated) {
+			vol_updated--;
+			if(!vol_updated) {
+				redraw |= REDRAW_VOLUME;
+			}
+		}
+		if(seek_updated) {
+			seek_updated--;
+			if(!seek_updated) {
+				redraw |= REDRAW_VOLUME;
+			}
+		}
 		if(menu_state == MENU_MSGBOX) {
-			GRRLIB_Rectangle (80, 160, 500, 200, 0x808080A0, true);
-			if(msgBoxTitle != NULL)
-				GRRLIB_Printf(90, 170, tex_BMfont5, GRRLIB_WHITE, 2, "%s", msgBoxTitle);
-			if(msgBoxMsg != NULL)
-				GRRLIB_Printf(90, 240, tex_BMfont5, GRRLIB_WHITE, 1, "%s", msgBoxMsg);
 			msgBoxTimer--;
 			if(!msgBoxTimer) {
 				menu_state = NOT_IN_MENU;
+				redraw |= REDRAW_MENU;
 			}
 		}
+		
+		// Anything pressed can change what's on screen
+		if(paddown || (padheld & (BTN_UP|BTN_DOWN))) {
+			redraw |= REDRAW_INPUT;
+		}
 
 		// Handle input
-		if(menu_state == NOT_IN_MENU) {
+		if(wokeUp) {
+			// Already dealt with
+		}
+		else if(menu_state == NOT_IN_MENU) {
 			// main screen input
 			if(paddown & BTN_EXIT) {
+				resumeFlush();
+				historyFlush(1);
+				shuffleFlush(1);
 				break;
 			}
-			if(paddown & BTN_LEFT) {
-				change_entry = -1;
-			}
-			else if(paddown & BTN_RIGHT) {
-				change_entry = 1;
+			if(padheld & (BTN_LEFT|BTN_RIGHT)) {
+				// A tap changes track when it's let go, holding it steps through the track instead
+				if(paddown & (BTN_LEFT|BTN_RIGHT)) {
+					seekHeldSince = gettime();
+					seekSteps = 0;
+				}
+				else if(seekHeldSince && playing && !hourlyGoingOff && seekReady(randAlbumNum, randTrackFromAlbum)
+					&& diff_msec(seekHeldSince, gettime()) >= SEEK_HOLD_MS + seekSteps * SEEK_REPEAT_MS) {
+					if(!seekSteps) {
+						seekAlbum = randAlbumNum;
+						seekTrack = randTrackFromAlbum;
+						seekLengthMs = seekDuration();
+						seekTargetMs = seekTimeAt(playerPosition());
+					}
+					seekSteps++;
+					seekTargetMs += ((padheld & BTN_RIGHT) ? 1 : -1) * SEEK_STEP_SECS * 1000;
+					seekTargetMs = MAX(0, MIN(seekTargetMs, (s32)seekLengthMs - 1000));
+					seekShownMs = seekTargetMs;
+					seek_updated = 120;	// ~2 sec position display
+					redraw |= REDRAW_INPUT;
+				}
+			}
+			else if(padup & (BTN_LEFT|BTN_RIGHT)) {
+				if(seekHeldSince && !seekSteps) {
+					change_entry = (padup & BTN_RIGHT) ? 1 : -1;
+				}
+				else if(seekSteps && seekAlbum == randAlbumNum && seekTrack == randTrackFromAlbum
+					&& seekReady(randAlbumNum, randTrackFromAlbum)) {
+					// Only the one open and restart for the whole hold, wherever it got to
+					u32 offset = seekOffsetAt(seekTargetMs, &seekShownMs);
+					FILE *mp3File = getEntryFromIndex(randAlbumNum, randTrackFromAlbum, entryNamePtr);
+					if(mp3File) {
+						playerPlayFrom(mp3File, offset);
+						queue_next = 1;
+						seek_updated = 120;
+						redraw |= REDRAW_INPUT;
+					}
+				}
+				seekHeldSince = 0;
+				seekSteps = 0;
 			}
 			else if(padheld & BTN_UP) {
-				if(vol<256) {vol++; MP3Player_Volume(vol);}
+				if(vol<256) {vol++; playerVolume(vol);}
 				vol_updated = 300;	// ~5 sec volume display
 			}
 			else if(padheld & BTN_DOWN) {
-				if(vol>0) {vol--; MP3Player_Volume(vol);}
+				if(vol>0) {vol--; playerVolume(vol);}
 				vol_updated = 300;	// ~5 sec volume display
 			}
 			else if(paddown & BTN_PREV_ALBUM) {
@@ -871,13 +838,29 @@ int main() {
 				menu_state = MENU_SETTINGS;
 				settings_pos = 0;
 			}
+			else if((paddown & BTN_CANCEL) && alarmGoingOff) {
+				playerStop();
+				if(alarmSnooze()) {
+					msgBoxTitle = "Snooze";
+					msgBoxMsg = "See you in a few minutes";
+					msgBoxTimer = 150;
+					menu_state = MENU_MSGBOX;
+				}
+			}
+			else if(paddown & BTN_CANCEL) {
+				profileToggle();
+			}
+			else if((paddown & BTN_ACK) && playing && !hourlyGoingOff && randAlbumNum >= 0) {
+				historyToggleFavourite(randAlbumNum, randTrackFromAlbum);
+			}
 		}
 		else if(menu_state == MENU_SETTINGS) {
-			if(!num_hourly) {
+			if(!num_hourly && libraryScanState != LIBRARY_SCANNING) {
 				hourlyAlarmOn = 0;
 			}
 			// settings menu
 			int oldContinuousPlayOn = continuousPlayOn;
+			int oldContinuousPlayType = continuousPlayType;
 			if(paddown & BTN_CANCEL) {
 				menu_state = NOT_IN_MENU;
 			}
@@ -890,13 +873,13 @@ int main() {
 			else if(paddown & BTN_RIGHT) {
 				if(settings_pos == SETTING_CONTINUOUS_PLAY_ON_OFF) {
 					continuousPlayOn^=1;
-					if(alarmOn && continuousPlayOn) {
-						alarmOn = 0;
+					if(alarms[0].on && continuousPlayOn) {
+						alarms[0].on = 0;
 					}
 				}
 				if(settings_pos == SETTING_ALARM_ON_OFF) {
-					alarmOn^=1;
-					if(alarmOn && continuousPlayOn) {
+					alarms[0].on^=1;
+					if(alarms[0].on && continuousPlayOn) {
 						continuousPlayOn = 0;
 					}
 				}
@@ -904,10 +887,10 @@ int main() {
 					hourlyAlarmOn^=1;
 				}
 				if(settings_pos == SETTING_ALARM_TIME_HRS) {
-					alarmHrs = alarmHrs == 23 ? 0 : alarmHrs+1;
+					alarms[0].hrs = alarms[0].hrs == 23 ? 0 : alarms[0].hrs+1;
 				}
 				if(settings_pos == SETTING_ALARM_TIME_MINS) {
-					alarmMins = alarmMins == 59 ? 0 : alarmMins+1;
+					alarms[0].mins = alarms[0].mins == 59 ? 0 : alarms[0].mins+1;
 				}
 				if(settings_pos == SETTING_SHUTDOWN_AFTER_ALARM) {
 					shutdownAfterAlarm ^= 1;
@@ -919,13 +902,13 @@ int main() {
 			else if(paddown & BTN_LEFT) {
 				if(settings_pos == SETTING_CONTINUOUS_PLAY_ON_OFF) {
 					continuousPlayOn^=1;
-					if(alarmOn && continuousPlayOn) {
-						alarmOn = 0;
+					if(alarms[0].on && continuousPlayOn) {
+						alarms[0].on = 0;
 					}
 				}
 				if(settings_pos == SETTING_ALARM_ON_OFF) {
-					alarmOn^=1;
-					if(alarmOn && continuousPlayOn) {
+					alarms[0].on^=1;
+					if(alarms[0].on && continuousPlayOn) {
 						continuousPlayOn = 0;
 					}
 				}
@@ -933,10 +916,10 @@ int main() {
 					hourlyAlarmOn^=1;
 				}
 				if(settings_pos == SETTING_ALARM_TIME_HRS) {
-					alarmHrs = alarmHrs == 0 ? 23 : alarmHrs-1;
+					alarms[0].hrs = alarms[0].hrs == 0 ? 23 : alarms[0].hrs-1;
 				}
 				if(settings_pos == SETTING_ALARM_TIME_MINS) {
-					alarmMins = alarmMins == 0 ? 59 : alarmMins-1;
+					alarms[0].mins = alarms[0].mins == 0 ? 59 : alarms[0].mins-1;
 				}
 				if(settings_pos == SETTING_SHUTDOWN_AFTER_ALARM) {
 					shutdownAfterAlarm ^= 1;
@@ -964,22 +947,25 @@ int main() {
 			// If we were just playing and now we're not, handle that etc.
 			if(continuousPlayOn != oldContinuousPlayOn) {
 				if(oldContinuousPlayOn) {
-					MP3Player_Stop();
-					if(mp3File) {
-						fclose(mp3File);
-					}
+					playerStop();
 				}
 				else {
 					change_entry_rand = 1;
 				}
 			}
+			// What's queued up next depends on the play type
+			if(continuousPlayType != oldContinuousPlayType) {
+				queue_next = 1;
+			}
+			// Alarm times may have moved
+			if(paddown) {
+				alarmScheduleChanged();
+			}
 			
 			
 		}
 
-        GRRLIB_Render();
-        FPS = CalculateFrameRate();
-		if(continuousPlayOn && !MP3Player_IsPlaying()) {
+		if(continuousPlayOn && !playerIsPlaying()) {
 			if(continuousPlayType == CONT_PLAY_TYPE_SEQUENTIAL) {
 				change_entry = 1;
 			}
@@ -997,24 +983,30 @@ int main() {
     GRRLIB_FreeBMF(bmf_Font1);
     GRRLIB_FreeBMF(bmf_Font2);
     GRRLIB_Exit(); // Be a good boy, clear the memory allocated by GRRLIB
+	logShutdown();
     return 0;
 }
 
 /**
- * This function calculates the number of frames we render each second.
- * @return The number of frames per second.
+ * This function calculates the number of frames we go round the main loop each second
+ * and how many of those actually had to be drawn.
+ * @param rendered Whether this frame was drawn.
+ * @param fps Gets the number of frames per second.
+ * @param drawnFps Gets the number of drawn frames per second.
  */
-static u8 CalculateFrameRate(void) {
+static void CalculateFrameRate(int rendered, u8 *fps, u8 *drawnFps) {
     static u8 frameCount = 0;
+    static u8 drawnCount = 0;
     static u32 lastTime;
-    static u8 FPS = 0;
     const u32 currentTime = ticks_to_millisecs(gettime());
 
     frameCount++;
+    drawnCount += rendered ? 1 : 0;
     if(currentTime - lastTime > 1000) {
         lastTime = currentTime;
-        FPS = frameCount;
+        *fps = frameCount;
+        *drawnFps = drawnCount;
         frameCount = 0;
+        drawnCount = 0;
     }
-    return FPS;
 }
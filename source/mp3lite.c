@@ -0,0 +1,1515 @@
+/*===========================================
+        WakeMii - Lightweight MP3 decoder
+
+        The Decoder=lite backend, a small MPEG-1, 2 and 2.5 layer III
+        decoder along the lines of minimp3. It works in floats rather
+        than libmad's fixed point, the Wii and GameCube both have a
+        proper FPU, and does less work where it can: Huffman codes are
+        looked up several bits at a time, nothing past the last
+        non-zero line of a granule is antialiased or transformed, the
+        IMDCT only works out the half of its output that isn't a mirror
+        of the other half and the synthesis filter's matrixing is a
+        fast 32 point DCT.
+
+        It's fed through the same reader callback as libmad's backend
+        and skips the same frames: the Xing/Info or VBRI frame and any
+        frame whose main data starts in frames it never saw (after
+        starting part way in). Layer I and II frames and free format
+        streams aren't decoded at all.
+
+        The Huffman tables, scalefactor bands and synthesis window are
+        exported for the encoder the host tests build their MP3s with.
+============================================*/
+#include <gccore.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mp3lite.h"
+#include "gecko.h"
+
+#define LITE_INPUT_SIZE (8*1024)		// comfortably more than the biggest frame
+#define LITE_MAX_FRAME 1441				// 320kbps at 32kHz, padded
+#define LITE_RESERVOIR 511				// main_data_begin can reach back this far
+#define LITE_MAIN_PAD 32				// zeros after the main data, a bad granule can't read past them
+#define LITE_HUFF_POOL 4608				// lookup entries for all the Huffman tables, 4412 are used
+#define LITE_HUFF_FIRST_BITS 8			// looked up at once for a code's first bits
+#define LITE_HUFF_NEXT_BITS 4			// and then this many at a time
+#define LITE_MAX_VALUE (15 + 8191)		// biggest value with 13 linbits
+
+static const u16 codes1[4] = {
+	1, 1, 1, 0
+};
+static const u8 lengths1[4] = {
+	1, 3, 2, 3
+};
+static const u16 codes2[9] = {
+	1, 2, 1, 3, 1, 1, 3, 2, 0
+};
+static const u8 lengths2[9] = {
+	1, 3, 6, 3, 3, 5, 5, 5, 6
+};
+static const u16 codes3[9] = {
+	3, 2, 1, 1, 1, 1, 3, 2, 0
+};
+static const u8 lengths3[9] = {
+	2, 2, 6, 3, 2, 5, 5, 5, 6
+};
+static const u16 codes5[16] = {
+	1, 2, 6, 5, 3, 1, 4, 4, 7, 5, 7, 1, 6, 1, 1, 0
+};
+static const u8 lengths5[16] = {
+	1, 3, 6, 7, 3, 3, 6, 7, 6, 6, 7, 8, 7, 6, 7, 8
+};
+static const u16 codes6[16] = {
+	7, 3, 5, 1, 6, 2, 3, 2, 5, 4, 4, 1, 3, 3, 2, 0
+};
+static const u8 lengths6[16] = {
+	3, 3, 5, 7, 3, 2, 4, 5, 4, 4, 5, 6, 6, 5, 6, 7
+};
+static const u16 codes7[36] = {
+	1, 2, 10, 19, 16, 10,
+	3, 3, 7, 10, 5, 3,
+	11, 4, 13, 17, 8, 4,
+	12, 11, 18, 15, 11, 2,
+	7, 6, 9, 14, 3, 1,
+	6, 4, 5, 3, 2, 0
+};
+static const u8 lengths7[36] = {
+	1, 3, 6, 8, 8, 9,
+	3, 4, 6, 7, 7, 8,
+	6, 5, 7, 8, 8, 9,
+	7, 7, 8, 9, 9, 9,
+	7, 7, 8, 9, 9, 10,
+	8, 8, 9, 10, 10, 10
+};
+static const u16 codes8[36] = {
+	3, 4, 6, 18, 12, 5,
+	5, 1, 2, 16, 9, 3,
+	7, 3, 5, 14, 7, 3,
+	19, 17, 15, 13, 10, 4,
+	13, 5, 8, 11, 5, 1,
+	12, 4, 4, 1, 1, 0
+};
+static const u8 lengths8[36] = {
+	2, 3, 6, 8, 8, 9,
+	3, 2, 4, 8, 8, 8,
+	6, 4, 6, 8, 8, 9,
+	8, 8, 8, 9, 9, 10,
+	8, 7, 8, 9, 10, 10,
+	9, 8, 9, 9, 11, 11
+};
+static const u16 codes9[36] = {
+	7, 5, 9, 14, 15, 7,
+	6, 4, 5, 5, 6, 7,
+	7, 6, 8, 8, 8, 5,
+	15, 6, 9, 10, 5, 1,
+	11, 7, 9, 6, 4, 1,
+	14, 4, 6, 2, 6, 0
+};
+static const u8 lengths9[36] = {
+	3, 3, 5, 6, 8, 9,
+	3, 3, 4, 5, 6, 8,
+	4, 4, 5, 6, 7, 8,
+	6, 5, 6, 7, 7, 8,
+	7, 6, 7, 7, 8, 9,
+	8, 7, 8, 8, 9, 9
+};
+static const u16 codes10[64] = {
+	1, 2, 10, 23, 35, 30, 12, 17,
+	3, 3, 8, 12, 18, 21, 12, 7,
+	11, 9, 15, 21, 32, 40, 19, 6,
+	14, 13, 22, 34, 46, 23, 18, 7,
+	20, 19, 33, 47, 27, 22, 9, 3,
+	31, 22, 41, 26, 21, 20, 5, 3,
+	14, 13, 10, 11, 16, 6, 5, 1,
+	9, 8, 7, 8, 4, 4, 2, 0
+};
+static const u8 lengths10[64] = {
+	1, 3, 6, 8, 9, 9, 9, 10,
+	3, 4, 6, 7, 8, 9, 8, 8,
+	6, 6, 7, 8, 9, 10, 9, 9,
+	7, 7, 8, 9, 10, 10, 9, 10,
+	8, 8, 9, 10, 10, 10, 10, 10,
+	9, 9, 10, 10, 11, 11, 10, 11,
+	8, 8, 9, 10, 10, 10, 11, 11,
+	9, 8, 9, 10, 10, 11, 11, 11
+};
+static const u16 codes11[64] = {
+	3, 4, 10, 24, 34, 33, 21, 15,
+	5, 3, 4, 10, 32, 17, 11, 10,
+	11, 7, 13, 18, 30, 31, 20, 5,
+	25, 11, 19, 59, 27, 18, 12, 5,
+	35, 33, 31, 58, 30, 16, 7, 5,
+	28, 26, 32, 19, 17, 15, 8, 14,
+	14, 12, 9, 13, 14, 9, 4, 1,
+	11, 4, 6, 6, 6, 3, 2, 0
+};
+static const u8 lengths11[64] = {
+	2, 3, 5, 7, 8, 9, 8, 9,
+	3, 3, 4, 6, 8, 8, 7, 8,
+	5, 5, 6, 7, 8, 9, 8, 8,
+	7, 6, 7, 9, 8, 10, 8, 9,
+	8, 8, 8, 9, 9, 10, 9, 10,
+	8, 8, 9, 10, 10, 11, 10, 11,
+	8, 7, 7, 8, 9, 10, 10, 10,
+	8, 7, 8, 9, 10, 10, 10, 10
+};
+static const u16 codes12[64] = {
+	9, 6, 16, 33, 41, 39, 38, 26,
+	7, 5, 6, 9, 23, 16, 26, 11,
+	17, 7, 11, 14, 21, 30, 10, 7,
+	17, 10, 15, 12, 18, 28, 14, 5,
+	32, 13, 22, 19, 18, 16, 9, 5,
+	40, 17, 31, 29, 17, 13, 4, 2,
+	27, 12, 11, 15, 10, 7, 4, 1,
+	27, 12, 8, 12, 6, 3, 1, 0
+};
+static const u8 lengths12[64] = {
+	4, 3, 5, 7, 8, 9, 9, 9,
+	3, 3, 4, 5, 7, 7, 8, 8,
+	5, 4, 5, 6, 7, 8, 7, 8,
+	6, 5, 6, 6, 7, 8, 8, 8,
+	7, 6, 7, 7, 8, 8, 8, 9,
+	8, 7, 8, 8, 8, 9, 8, 9,
+	8, 7, 7, 8, 8, 9, 9, 10,
+	9, 8, 8, 9, 9, 9, 9, 10
+};
+static const u16 codes13[256] = {
+	1, 5, 14, 21, 34, 51, 46, 71, 42, 52, 68, 52, 67, 44, 43, 19,
+	3, 4, 12, 19, 31, 26, 44, 33, 31, 24, 32, 24, 31, 35, 22, 14,
+	15, 13, 23, 36, 59, 49, 77, 65, 29, 40, 30, 40, 27, 33, 42, 16,
+	22, 20, 37, 61, 56, 79, 73, 64, 43, 76, 56, 37, 26, 31, 25, 14,
+	35, 16, 60, 57, 97, 75, 114, 91, 54, 73, 55, 41, 48, 53, 23, 24,
+	58, 27, 50, 96, 76, 70, 93, 84, 77, 58, 79, 29, 74, 49, 41, 17,
+	47, 45, 78, 74, 115, 94, 90, 79, 69, 83, 71, 50, 59, 38, 36, 15,
+	72, 34, 56, 95, 92, 85, 91, 90, 86, 73, 77, 65, 51, 44, 43, 42,
+	43, 20, 30, 44, 55, 78, 72, 87, 78, 61, 46, 54, 37, 30, 20, 16,
+	53, 25, 41, 37, 44, 59, 54, 81, 66, 76, 57, 54, 37, 18, 39, 11,
+	35, 33, 31, 57, 42, 82, 72, 80, 47, 58, 55, 21, 22, 26, 38, 22,
+	53, 25, 23, 38, 70, 60, 51, 36, 55, 26, 34, 23, 27, 14, 9, 7,
+	34, 32, 28, 39, 49, 75, 30, 52, 48, 40, 52, 28, 18, 17, 9, 5,
+	45, 21, 34, 64, 56, 50, 49, 45, 31, 19, 12, 15, 10, 7, 6, 3,
+	48, 23, 20, 39, 36, 35, 53, 21, 16, 23, 13, 10, 6, 1, 4, 2,
+	16, 15, 17, 27, 25, 20, 29, 11, 17, 12, 16, 8, 1, 1, 0, 1
+};
+static const u8 lengths13[256] = {
+	1, 4, 6, 7, 8, 9, 9, 10, 9, 10, 11, 11, 12, 12, 13, 13,
+	3, 4, 6, 7, 8, 8, 9, 9, 9, 9, 10, 10, 11, 12, 12, 12,
+	6, 6, 7, 8, 9, 9, 10, 10, 9, 10, 10, 11, 11, 12, 13, 13,
+	7, 7, 8, 9, 9, 10, 10, 10, 10, 11, 11, 11, 11, 12, 13, 13,
+	8, 7, 9, 9, 10, 10, 11, 11, 10, 11, 11, 12, 12, 13, 13, 14,
+	9, 8, 9, 10, 10, 10, 11, 11, 11, 11, 12, 11, 13, 13, 14, 14,
+	9, 9, 10, 10, 11, 11, 11, 11, 11, 12, 12, 12, 13, 13, 14, 14,
+	10, 9, 10, 11, 11, 11, 12, 12, 12, 12, 13, 13, 13, 14, 16, 16,
+	9, 8, 9, 10, 10, 11, 11, 12, 12, 12, 12, 13, 13, 14, 15, 15,
+	10, 9, 10, 10, 11, 11, 11, 13, 12, 13, 13, 14, 14, 14, 16, 15,
+	10, 10, 10, 11, 11, 12, 12, 13, 12, 13, 14, 13, 14, 15, 16, 17,
+	11, 10, 10, 11, 12, 12, 12, 12, 13, 13, 13, 14, 15, 15, 15, 16,
+	11, 11, 11, 12, 12, 13, 12, 13, 14, 14, 15, 15, 15, 16, 16, 16,
+	12, 11, 12, 13, 13, 13, 14, 14, 14, 14, 14, 15, 16, 15, 16, 16,
+	13, 12, 12, 13, 13, 13, 15, 14, 14, 17, 15, 15, 15, 17, 16, 16,
+	12, 12, 13, 14, 14, 14, 15, 14, 15, 15, 16, 16, 19, 18, 19, 16
+};
+static const u16 codes15[256] = {
+	7, 12, 18, 53, 47, 76, 124, 108, 89, 123, 108, 119, 107, 81, 122, 63,
+	13, 5, 16, 27, 46, 36, 61, 51, 42, 70, 52, 83, 65, 41, 59, 36,
+	19, 17, 15, 24, 41, 34, 59, 48, 40, 64, 50, 78, 62, 80, 56, 33,
+	29, 28, 25, 43, 39, 63, 55, 93, 76, 59, 93, 72, 54, 75, 50, 29,
+	52, 22, 42, 40, 67, 57, 95, 79, 72, 57, 89, 69, 49, 66, 46, 27,
+	77, 37, 35, 66, 58, 52, 91, 74, 62, 48, 79, 63, 90, 62, 40, 38,
+	125, 32, 60, 56, 50, 92, 78, 65, 55, 87, 71, 51, 73, 51, 70, 30,
+	109, 53, 49, 94, 88, 75, 66, 122, 91, 73, 56, 42, 64, 44, 21, 25,
+	90, 43, 41, 77, 73, 63, 56, 92, 77, 66, 47, 67, 48, 53, 36, 20,
+	71, 34, 67, 60, 58, 49, 88, 76, 67, 106, 71, 54, 38, 39, 23, 15,
+	109, 53, 51, 47, 90, 82, 58, 57, 48, 72, 57, 41, 23, 27, 62, 9,
+	86, 42, 40, 37, 70, 64, 52, 43, 70, 55, 42, 25, 29, 18, 11, 11,
+	118, 68, 30, 55, 50, 46, 74, 65, 49, 39, 24, 16, 22, 13, 14, 7,
+	91, 44, 39, 38, 34, 63, 52, 45, 31, 52, 28, 19, 14, 8, 9, 3,
+	123, 60, 58, 53, 47, 43, 32, 22, 37, 24, 17, 12, 15, 10, 2, 1,
+	71, 37, 34, 30, 28, 20, 17, 26, 21, 16, 10, 6, 8, 6, 2, 0
+};
+static const u8 lengths15[256] = {
+	3, 4, 5, 7, 7, 8, 9, 9, 9, 10, 10, 11, 11, 11, 12, 13,
+	4, 3, 5, 6, 7, 7, 8, 8, 8, 9, 9, 10, 10, 10, 11, 11,
+	5, 5, 5, 6, 7, 7, 8, 8, 8, 9, 9, 10, 10, 11, 11, 11,
+	6, 6, 6, 7, 7, 8, 8, 9, 9, 9, 10, 10, 10, 11, 11, 11,
+	7, 6, 7, 7, 8, 8, 9, 9, 9, 9, 10, 10, 10, 11, 11, 11,
+	8, 7, 7, 8, 8, 8, 9, 9, 9, 9, 10, 10, 11, 11, 11, 12,
+	9, 7, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 11, 11, 12, 12,
+	9, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 10, 11, 11, 11, 12,
+	9, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 11, 11, 12, 12, 12,
+	9, 8, 9, 9, 9, 9, 10, 10, 10, 11, 11, 11, 11, 12, 12, 12,
+	10, 9, 9, 9, 10, 10, 10, 10, 10, 11, 11, 11, 11, 12, 13, 12,
+	10, 9, 9, 9, 10, 10, 10, 10, 11, 11, 11, 11, 12, 12, 12, 13,
+	11, 10, 9, 10, 10, 10, 11, 11, 11, 11, 11, 11, 12, 12, 13, 13,
+	11, 10, 10, 10, 10, 11, 11, 11, 11, 12, 12, 12, 12, 12, 13, 13,
+	12, 11, 11, 11, 11, 11, 11, 11, 12, 12, 12, 12, 13, 13, 12, 13,
+	12, 11, 11, 11, 11, 11, 11, 12, 12, 12, 12, 12, 13, 13, 13, 13
+};
+static const u16 codes16[256] = {
+	1, 5, 14, 44, 74, 63, 110, 93, 172, 149, 138, 242, 225, 195, 376, 17,
+	3, 4, 12, 20, 35, 62, 53, 47, 83, 75, 68, 119, 201, 107, 207, 9,
+	15, 13, 23, 38, 67, 58, 103, 90, 161, 72, 127, 117, 110, 209, 206, 16,
+	45, 21, 39, 69, 64, 114, 99, 87, 158, 140, 252, 212, 199, 387, 365, 26,
+	75, 36, 68, 65, 115, 101, 179, 164, 155, 264, 246, 226, 395, 382, 362, 9,
+	66, 30, 59, 56, 102, 185, 173, 265, 142, 253, 232, 400, 388, 378, 445, 16,
+	111, 54, 52, 100, 184, 178, 160, 133, 257, 244, 228, 217, 385, 366, 715, 10,
+	98, 48, 91, 88, 165, 157, 148, 261, 248, 407, 397, 372, 380, 889, 884, 8,
+	85, 84, 81, 159, 156, 143, 260, 249, 427, 401, 392, 383, 727, 713, 708, 7,
+	154, 76, 73, 141, 131, 256, 245, 426, 406, 394, 384, 735, 359, 710, 352, 11,
+	139, 129, 67, 125, 247, 233, 229, 219, 393, 743, 737, 720, 885, 882, 439, 4,
+	243, 120, 118, 115, 227, 223, 396, 746, 742, 736, 721, 712, 706, 223, 436, 6,
+	202, 224, 222, 218, 216, 389, 386, 381, 364, 888, 443, 707, 440, 437, 1728, 4,
+	747, 211, 210, 208, 370, 379, 734, 723, 714, 1735, 883, 877, 876, 3459, 865, 2,
+	377, 369, 102, 187, 726, 722, 358, 711, 709, 866, 1734, 871, 3458, 870, 434, 0,
+	12, 10, 7, 11, 10, 17, 11, 9, 13, 12, 10, 7, 5, 3, 1, 3
+};
+static const u8 lengths16[256] = {
+	1, 4, 6, 8, 9, 9, 10, 10, 11, 11, 11, 12, 12, 12, 13, 9,
+	3, 4, 6, 7, 8, 9, 9, 9, 10, 10, 10, 11, 12, 11, 12, 8,
+	6, 6, 7, 8, 9, 9, 10, 10, 11, 10, 11, 11, 11, 12, 12, 9,
+	8, 7, 8, 9, 9, 10, 10, 10, 11, 11, 12, 12, 12, 13, 13, 10,
+	9, 8, 9, 9, 10, 10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 9,
+	9, 8, 9, 9, 10, 11, 11, 12, 11, 12, 12, 13, 13, 13, 14, 10,
+	10, 9, 9, 10, 11, 11, 11, 11, 12, 12, 12, 12, 13, 13, 14, 10,
+	10, 9, 10, 10, 11, 11, 11, 12, 12, 13, 13, 13, 13, 15, 15, 10,
+	10, 10, 10, 11, 11, 11, 12, 12, 13, 13, 13, 13, 14, 14, 14, 10,
+	11, 10, 10, 11, 11, 12, 12, 13, 13, 13, 13, 14, 13, 14, 13, 11,
+	11, 11, 10, 11, 12, 12, 12, 12, 13, 14, 14, 14, 15, 15, 14, 10,
+	12, 11, 11, 11, 12, 12, 13, 14, 14, 14, 14, 14, 14, 13, 14, 11,
+	12, 12, 12, 12, 12, 13, 13, 13, 13, 15, 14, 14, 14, 14, 16, 11,
+	14, 12, 12, 12, 13, 13, 14, 14, 14, 16, 15, 15, 15, 17, 15, 11,
+	13, 13, 11, 12, 14, 14, 13, 14, 14, 15, 16, 15, 17, 15, 14, 11,
+	9, 8, 8, 9, 9, 10, 10, 10, 11, 11, 11, 11, 11, 11, 11, 8
+};
+static const u16 codes24[256] = {
+	15, 13, 46, 80, 146, 262, 248, 434, 426, 669, 653, 649, 621, 517, 1032, 88,
+	14, 12, 21, 38, 71, 130, 122, 216, 209, 198, 327, 345, 319, 297, 279, 42,
+	47, 22, 41, 74, 68, 128, 120, 221, 207, 194, 182, 340, 315, 295, 541, 18,
+	81, 39, 75, 70, 134, 125, 116, 220, 204, 190, 178, 325, 311, 293, 271, 16,
+	147, 72, 69, 135, 127, 118, 112, 210, 200, 188, 352, 323, 306, 285, 540, 14,
+	263, 66, 129, 126, 119, 114, 214, 202, 192, 180, 341, 317, 301, 281, 262, 12,
+	249, 123, 121, 117, 113, 215, 206, 195, 185, 347, 330, 308, 291, 272, 520, 10,
+	435, 115, 111, 109, 211, 203, 196, 187, 353, 332, 313, 298, 283, 531, 381, 17,
+	427, 212, 208, 205, 201, 193, 186, 177, 169, 320, 303, 286, 268, 514, 377, 16,
+	335, 199, 197, 191, 189, 181, 174, 333, 321, 305, 289, 275, 521, 379, 371, 11,
+	668, 184, 183, 179, 175, 344, 331, 314, 304, 290, 277, 530, 383, 373, 366, 10,
+	652, 346, 171, 168, 164, 318, 309, 299, 287, 276, 263, 513, 375, 368, 362, 6,
+	648, 322, 316, 312, 307, 302, 292, 284, 269, 261, 512, 376, 370, 364, 359, 4,
+	620, 300, 296, 294, 288, 282, 273, 266, 515, 380, 374, 369, 365, 361, 357, 2,
+	1033, 280, 278, 274, 267, 264, 259, 382, 378, 372, 367, 363, 360, 358, 356, 0,
+	43, 20, 19, 17, 15, 13, 11, 9, 7, 6, 4, 7, 5, 3, 1, 3
+};
+static const u8 lengths24[256] = {
+	4, 4, 6, 7, 8, 9, 9, 10, 10, 11, 11, 11, 11, 11, 12, 9,
+	4, 4, 5, 6, 7, 8, 8, 9, 9, 9, 10, 10, 10, 10, 10, 8,
+	6, 5, 6, 7, 7, 8, 8, 9, 9, 9, 9, 10, 10, 10, 11, 7,
+	7, 6, 7, 7, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 7,
+	8, 7, 7, 8, 8, 8, 8, 9, 9, 9, 10, 10, 10, 10, 11, 7,
+	9, 7, 8, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 10, 7,
+	9, 8, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 10, 11, 7,
+	10, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 10, 11, 11, 8,
+	10, 9, 9, 9, 9, 9, 9, 9, 9, 10, 10, 10, 10, 11, 11, 8,
+	10, 9, 9, 9, 9, 9, 9, 10, 10, 10, 10, 10, 11, 11, 11, 8,
+	11, 9, 9, 9, 9, 10, 10, 10, 10, 10, 10, 11, 11, 11, 11, 8,
+	11, 10, 9, 9, 9, 10, 10, 10, 10, 10, 10, 11, 11, 11, 11, 8,
+	11, 10, 10, 10, 10, 10, 10, 10, 10, 10, 11, 11, 11, 11, 11, 8,
+	11, 10, 10, 10, 10, 10, 10, 10, 11, 11, 11, 11, 11, 11, 11, 8,
+	12, 10, 10, 10, 10, 10, 10, 11, 11, 11, 11, 11, 11, 11, 11, 8,
+	8, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 8, 8, 8, 8, 4
+};
+static const u16 codesA[16] = {
+	1, 5, 4, 5, 6, 5, 4, 4, 7, 3, 6, 0, 7, 2, 3, 1
+};
+static const u8 lengthsA[16] = {
+	1, 4, 4, 5, 4, 6, 5, 6, 4, 5, 5, 6, 5, 6, 6, 6
+};
+
+const s32 liteWindow[257] = {
+	0, -1, -1, -1, -1, -1, -1, -2, -2, -2, -2, -3, -3, -4, -4, -5,
+	-5, -6, -7, -7, -8, -9, -10, -11, -13, -14, -16, -17, -19, -21, -24, -26,
+	-29, -31, -35, -38, -41, -45, -49, -53, -58, -63, -68, -73, -79, -85, -91, -97,
+	-104, -111, -117, -125, -132, -139, -147, -154, -161, -169, -176, -183, -190, -196, -202, -208,
+	-213, -218, -222, -225, -227, -228, -228, -227, -224, -221, -215, -208, -200, -189, -177, -163,
+	-146, -127, -106, -83, -57, -29, 2, 36, 72, 111, 153, 197, 244, 294, 347, 401,
+	459, 519, 581, 645, 711, 779, 848, 919, 991, 1064, 1137, 1210, 1283, 1356, 1428, 1498,
+	1567, 1634, 1698, 1759, 1817, 1870, 1919, 1962, 2001, 2032, 2057, 2075, 2085, 2087, 2080, 2063,
+	2037, 2000, 1952, 1893, 1822, 1739, 1644, 1535, 1414, 1280, 1131, 970, 794, 605, 402, 185,
+	-45, -288, -545, -814, -1095, -1388, -1692, -2006, -2330, -2663, -3004, -3351, -3705, -4063, -4425, -4788,
+	-5153, -5517, -5879, -6237, -6589, -6935, -7271, -7597, -7910, -8209, -8491, -8755, -8998, -9219, -9416, -9585,
+	-9727, -9838, -9916, -9959, -9966, -9935, -9863, -9750, -9592, -9389, -9139, -8840, -8492, -8092, -7640, -7134,
+	-6574, -5959, -5288, -4561, -3776, -2935, -2037, -1082, -70, 998, 2122, 3300, 4533, 5818, 7154, 8540,
+	9975, 11455, 12980, 14548, 16155, 17799, 19478, 21189, 22929, 24694, 26482, 28289, 30112, 31947, 33791, 35640,
+	37489, 39336, 41176, 43006, 44821, 46617, 48390, 50137, 51853, 53534, 55178, 56778, 58333, 59838, 61289, 62684,
+	64019, 65290, 66494, 67629, 68692, 69679, 70590, 71420, 72169, 72835, 73415, 73908, 74313, 74630, 74856, 74992,
+	75038
+};
+
+const struct lite_huff_table liteHuffTables[32] = {
+	{NULL, NULL, 0, 0},
+	{codes1, lengths1, 2, 0},
+	{codes2, lengths2, 3, 0},
+	{codes3, lengths3, 3, 0},
+	{NULL, NULL, 0, 0},
+	{codes5, lengths5, 4, 0},
+	{codes6, lengths6, 4, 0},
+	{codes7, lengths7, 6, 0},
+	{codes8, lengths8, 6, 0},
+	{codes9, lengths9, 6, 0},
+	{codes10, lengths10, 8, 0},
+	{codes11, lengths11, 8, 0},
+	{codes12, lengths12, 8, 0},
+	{codes13, lengths13, 16, 0},
+	{NULL, NULL, 0, 0},
+	{codes15, lengths15, 16, 0},
+	{codes16, lengths16, 16, 1},
+	{codes16, lengths16, 16, 2},
+	{codes16, lengths16, 16, 3},
+	{codes16, lengths16, 16, 4},
+	{codes16, lengths16, 16, 6},
+	{codes16, lengths16, 16, 8},
+	{codes16, lengths16, 16, 10},
+	{codes16, lengths16, 16, 13},
+	{codes24, lengths24, 16, 4},
+	{codes24, lengths24, 16, 5},
+	{codes24, lengths24, 16, 6},
+	{codes24, lengths24, 16, 7},
+	{codes24, lengths24, 16, 8},
+	{codes24, lengths24, 16, 9},
+	{codes24, lengths24, 16, 11},
+	{codes24, lengths24, 16, 13}
+};
+
+const struct lite_huff_table liteCount1Table = {codesA, lengthsA, 4, 0};
+
+const u8 liteSfbLong[9][22] = {
+	{4, 4, 4, 4, 4, 4, 6, 6, 8, 8, 10, 12, 16, 20, 24, 28, 34, 42, 50, 54, 76, 158},
+	{4, 4, 4, 4, 4, 4, 6, 6, 6, 8, 10, 12, 16, 18, 22, 28, 34, 40, 46, 54, 54, 192},
+	{4, 4, 4, 4, 4, 4, 6, 6, 8, 10, 12, 16, 20, 24, 30, 38, 46, 56, 68, 84, 102, 26},
+	{6, 6, 6, 6, 6, 6, 8, 10, 12, 14, 16, 20, 24, 28, 32, 38, 46, 52, 60, 68, 58, 54},
+	{6, 6, 6, 6, 6, 6, 8, 10, 12, 14, 16, 18, 22, 26, 32, 38, 46, 54, 62, 70, 76, 36},
+	{6, 6, 6, 6, 6, 6, 8, 10, 12, 14, 16, 20, 24, 28, 32, 38, 46, 52, 60, 68, 58, 54},
+	{6, 6, 6, 6, 6, 6, 8, 10, 12, 14, 16, 20, 24, 28, 32, 38, 46, 52, 60, 68, 58, 54},
+	{6, 6, 6, 6, 6, 6, 8, 10, 12, 14, 16, 20, 24, 28, 32, 38, 46, 52, 60, 68, 58, 54},
+	{12, 12, 12, 12, 12, 12, 16, 20, 24, 28, 32, 40, 48, 56, 64, 76, 90, 2, 2, 2, 2, 2}
+};
+
+const u8 liteSfbShort[9][13] = {
+	{4, 4, 4, 4, 6, 8, 10, 12, 14, 18, 22, 30, 56},
+	{4, 4, 4, 4, 6, 6, 10, 12, 14, 16, 20, 26, 66},
+	{4, 4, 4, 4, 6, 8, 12, 16, 20, 26, 34, 42, 12},
+	{4, 4, 4, 6, 6, 8, 10, 14, 18, 26, 32, 42, 18},
+	{4, 4, 4, 6, 8, 10, 12, 14, 18, 24, 32, 44, 12},
+	{4, 4, 4, 6, 8, 10, 12, 14, 18, 24, 30, 40, 18},
+	{4, 4, 4, 6, 8, 10, 12, 14, 18, 24, 30, 40, 18},
+	{4, 4, 4, 6, 8, 10, 12, 14, 18, 24, 30, 40, 18},
+	{8, 8, 8, 12, 16, 20, 24, 28, 36, 2, 2, 2, 26}
+};
+
+static const u16 bitratesMpeg1[16] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0};
+static const u16 bitratesMpeg2[16] = {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0};
+static const u16 sampleRates[3] = {44100, 48000, 32000};
+static const u8 slenMpeg1[16][2] = {
+	{0, 0}, {0, 1}, {0, 2}, {0, 3}, {3, 0}, {1, 1}, {1, 2}, {1, 3},
+	{2, 1}, {2, 2}, {2, 3}, {3, 1}, {3, 2}, {3, 3}, {4, 2}, {4, 3}
+};
+// Scalefactors in each of the four parts of an LSF granule: by slen choice, then long, short or mixed blocks
+static const u8 lsfPartSizes[6][3][4] = {
+	{{6, 5, 5, 5}, {9, 9, 9, 9}, {6, 9, 9, 9}},
+	{{6, 5, 7, 3}, {9, 9, 12, 6}, {6, 9, 12, 6}},
+	{{11, 10, 0, 0}, {18, 18, 0, 0}, {15, 18, 0, 0}},
+	{{7, 7, 7, 0}, {12, 12, 12, 0}, {6, 15, 12, 0}},
+	{{6, 6, 6, 3}, {12, 9, 9, 6}, {6, 12, 9, 6}},
+	{{8, 8, 5, 0}, {15, 12, 9, 0}, {6, 18, 9, 0}}
+};
+static const u8 pretab[22] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 3, 3, 3, 2, 0};
+static const float aliasCoefs[8] = {-0.6f, -0.535f, -0.33f, -0.185f, -0.095f, -0.041f, -0.0142f, -0.0037f};
+
+#define BLOCKS_LONG 0
+#define BLOCKS_SHORT 1
+#define BLOCKS_MIXED 2
+
+#define MODE_EXT_INTENSITY 1
+#define MODE_EXT_MS 2
+
+// Where a table's lookup starts, see huffBuild()
+struct huff_lookup {
+	u16 first;
+	u8 bits;
+};
+
+struct lite_header {
+	u32 length;							// of the whole frame
+	u32 sampleRate;
+	int rate;							// which scalefactor bands, as in liteSfbLong
+	int lsf;							// MPEG-2 or 2.5: one granule and the LSF scalefactors
+	int channels;
+	int modeExt;						// joint stereo only, 0 otherwise
+	int crc;
+};
+
+struct lite_channel {
+	u32 part23Length;
+	u32 bigValues;
+	int globalGain;
+	u32 scalefacCompress;
+	u8 blockType;						// 0 normal, 1 start, 2 short, 3 stop
+	u8 mixed;
+	u8 tableSelect[3];
+	u8 subblockGain[3];
+	u8 region0Count;
+	u8 region1Count;
+	u8 preflag;
+	u8 scalefacScale;
+	u8 count1Table;
+};
+
+struct lite_bits {
+	const u8 *buf;
+	u32 pos;
+};
+
+struct lite_state {
+	decoder_reader_t reader;
+	void *cbdata;
+	u32 inputPos;						// stream position of input[0]
+	u32 inputLen;
+	u32 inputOff;						// where the next frame's looked for
+	int eof;
+	int locked;							// the last frame was found straight after the one before
+	u8 lockHeader[4];					// its header, for the version, layer and sample rate
+	u32 reservoirLen;
+	u8 scalefac[2][40];					// granule 0's are still there for scfsi in granule 1
+	u8 illegal[40];						// LSF intensity positions that mean it isn't intensity stereo
+	u8 active[2];						// subbands with anything in from the last granule
+	u32 synthOff[2];
+	float xr[2][576];
+	float overlap[2][32][18];
+	float hybrid[18][32];				// one channel's subband samples for a granule, by time slot
+	float synth[2][2048];				// the V vectors, each written twice so it never wraps
+	u8 input[LITE_INPUT_SIZE];
+	u8 mainData[LITE_RESERVOIR + LITE_MAX_FRAME + LITE_MAIN_PAD];	// the reservoir, then this frame's
+};
+
+static int tablesReady;
+static u32 huffPool[LITE_HUFF_POOL];
+static u32 huffUsed;
+static struct huff_lookup huffLookups[32];
+static struct huff_lookup count1Lookup;
+static u8 sfbWidths[9][3][40];			// long, short (one per window) and mixed bands
+static float pow43[LITE_MAX_VALUE + 1];
+static float quarterPows[4];
+static float aliasCs[8];
+static float aliasCa[8];
+static float isRatios[7];
+static float lsfRatios[2][16];
+static float imdctLong[18][18];
+static float imdctShort[6][6];
+static float windowLong[36];
+static float windowShort[12];
+static float dctCoefs[31];
+static float synthWindow[512];
+
+// One node of a table's lookup: an entry for every value of its next bits, either a leaf
+// (bits used << 8 | x << 4 | y) or 0x80000000 | next node's bits << 24 | next node.
+// Returns the node's offset in huffPool, -1 if the pool's too small.
+static int huffBuild(const struct lite_huff_table *t, int count, u32 prefix, int prefixLen, int bits) {
+	int node = huffUsed;
+	if(huffUsed + (1 << bits) > LITE_HUFF_POOL) {
+		return -1;
+	}
+	huffUsed += 1 << bits;
+	for(u32 i = 0; i < (1u << bits); i++) {
+		u32 path = (prefix << bits) | i;
+		int pathLen = prefixLen + bits;
+		u32 entry = 0;
+		int longest = 0;
+		for(int c = 0; c < count; c++) {
+			int len = t->lengths[c];
+			if(len <= pathLen) {
+				if(len > prefixLen && (path >> (pathLen - len)) == t->codes[c]) {
+					u32 value = t == &liteCount1Table ? c : ((c / t->dim) << 4) | (c % t->dim);
+					entry = ((len - prefixLen) << 8) | value;
+				}
+			}
+			else if((t->codes[c] >> (len - pathLen)) == path) {
+				longest = MAX(longest, len - pathLen);
+			}
+		}
+		if(longest) {
+			int nextBits = MIN(longest, LITE_HUFF_NEXT_BITS);
+			int next = huffBuild(t, count, path, pathLen, nextBits);
+			if(next < 0) {
+				return -1;
+			}
+			entry = 0x80000000 | (nextBits << 24) | next;
+		}
+		huffPool[node + i] = entry;
+	}
+	return node;
+}
+
+static int huffLookup(const struct lite_huff_table *t, struct huff_lookup *lookup) {
+	int count = t->dim * t->dim;
+	int longest = 0;
+	for(int c = 0; c < count; c++) {
+		longest = MAX(longest, t->lengths[c]);
+	}
+	lookup->bits = MIN(longest, LITE_HUFF_FIRST_BITS);
+	int first = huffBuild(t, count, 0, 0, lookup->bits);
+	lookup->first = first;
+	return first >= 0;
+}
+
+static void initTables() {
+	if(tablesReady) {
+		return;
+	}
+	for(int t = 0; t < 32; t++) {
+		// Tables sharing codes (16 and 24 with their linbits) share a lookup too
+		if(liteHuffTables[t].dim && (t <= 16 || t == 24)) {
+			if(!huffLookup(&liteHuffTables[t], &huffLookups[t])) {
+				error_gecko("Huffman lookup pool too small\r\n");
+			}
+		}
+		else if(t > 16) {
+			huffLookups[t] = huffLookups[t < 24 ? 16 : 24];
+		}
+	}
+	huffLookup(&liteCount1Table, &count1Lookup);
+	debug_gecko("Huffman lookups: %u entries\r\n", huffUsed);
+
+	for(int rate = 0; rate < 9; rate++) {
+		u8 *widths = sfbWidths[rate][BLOCKS_LONG];
+		memcpy(widths, liteSfbLong[rate], 22);
+		widths = sfbWidths[rate][BLOCKS_SHORT];
+		for(int sfb = 0; sfb < 13; sfb++) {
+			widths[sfb*3] = widths[sfb*3 + 1] = widths[sfb*3 + 2] = liteSfbShort[rate][sfb];
+		}
+		// Mixed blocks are long bands up to line 36 then short ones from the third on,
+		// 8kHz's is libmad's table (its long bands don't end at 36 on a short band's edge)
+		widths = sfbWidths[rate][BLOCKS_MIXED];
+		int n = 0;
+		if(rate == 8) {
+			static const u8 shortAt8k[12] = {4, 8, 12, 16, 20, 24, 28, 36, 2, 2, 2, 26};
+			widths[n++] = 12;
+			widths[n++] = 12;
+			widths[n++] = 12;
+			for(int sfb = 0; sfb < 12; sfb++, n += 3) {
+				widths[n] = widths[n + 1] = widths[n + 2] = shortAt8k[sfb];
+			}
+		}
+		else {
+			for(int sfb = 0; sfb < (rate < 3 ? 8 : 6); sfb++) {
+				widths[n++] = liteSfbLong[rate][sfb];
+			}
+			for(int sfb = 3; sfb < 13; sfb++, n += 3) {
+				widths[n] = widths[n + 1] = widths[n + 2] = liteSfbShort[rate][sfb];
+			}
+		}
+	}
+
+	for(int i = 0; i <= LITE_MAX_VALUE; i++) {
+		pow43[i] = powf(i, 4.0f / 3.0f);
+	}
+	for(int i = 0; i < 4; i++) {
+		quarterPows[i] = powf(2.0f, i / 4.0f);
+	}
+	for(int i = 0; i < 8; i++) {
+		float sq = sqrtf(1.0f + aliasCoefs[i] * aliasCoefs[i]);
+		aliasCs[i] = 1.0f / sq;
+		aliasCa[i] = aliasCoefs[i] / sq;
+	}
+	for(int i = 0; i < 7; i++) {
+		float s = sin(i * M_PI / 12), c = cos(i * M_PI / 12);
+		isRatios[i] = s / (s + c);
+	}
+	for(int i = 0; i < 16; i++) {
+		lsfRatios[0][i] = powf(2.0f, -(i + 1) / 4.0f);
+		lsfRatios[1][i] = powf(2.0f, -(i + 1) / 2.0f);
+	}
+	// Only half of each IMDCT's output is worked out, the rest mirrors it
+	for(int r = 0; r < 18; r++) {
+		int i = r < 9 ? r : r + 9;
+		for(int k = 0; k < 18; k++) {
+			imdctLong[r][k] = cos(M_PI / 72 * (2*i + 1 + 18) * (2*k + 1));
+		}
+	}
+	for(int r = 0; r < 6; r++) {
+		int i = r < 3 ? r : r + 3;
+		for(int k = 0; k < 6; k++) {
+			imdctShort[r][k] = cos(M_PI / 24 * (2*i + 1 + 6) * (2*k + 1));
+		}
+	}
+	for(int i = 0; i < 36; i++) {
+		windowLong[i] = sin(M_PI / 36 * (i + 0.5));
+	}
+	for(int i = 0; i < 12; i++) {
+		windowShort[i] = sin(M_PI / 12 * (i + 0.5));
+	}
+	for(int n = 2; n <= 32; n *= 2) {
+		for(int k = 0; k < n / 2; k++) {
+			dctCoefs[n/2 - 1 + k] = 0.5 / cos(M_PI * (2*k + 1) / (2*n));
+		}
+	}
+	for(int i = 0; i < 512; i++) {
+		float d = liteWindow[i <= 256 ? i : 512 - i] / 65536.0f;
+		synthWindow[i] = ((i >> 6) & 1) ? -d : d;
+	}
+	tablesReady = 1;
+}
+
+// Up to 24 bits, the buffer has to have 3 bytes to spare past them
+static inline u32 peekBits(const struct lite_bits *b, int n) {
+	const u8 *p = b->buf + (b->pos >> 3);
+	u32 v = ((u32)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+	return (v << (b->pos & 7)) >> (32 - n);
+}
+
+static inline u32 getBits(struct lite_bits *b, int n) {
+	if(!n) {
+		return 0;
+	}
+	u32 v = peekBits(b, n);
+	b->pos += n;
+	return v;
+}
+
+static inline u32 huffDecode(struct lite_bits *b, const struct huff_lookup *lookup) {
+	int bits = lookup->bits;
+	u32 entry = huffPool[lookup->first + peekBits(b, bits)];
+	while(entry & 0x80000000) {
+		b->pos += bits;
+		bits = (entry >> 24) & 0x7F;
+		entry = huffPool[(entry & 0xFFFFFF) + peekBits(b, bits)];
+	}
+	b->pos += entry >> 8;
+	return entry & 0xFF;
+}
+
+// The length of the layer III frame whose header's at p, 0 if it isn't one.
+static u32 parseHeader(const u8 *p, struct lite_header *h) {
+	if(p[0] != 0xFF || (p[1] & 0xE0) != 0xE0) {
+		return 0;
+	}
+	int version = (p[1] >> 3) & 3;		// 0 MPEG-2.5, 1 reserved, 2 MPEG-2, 3 MPEG-1
+	int layer = (p[1] >> 1) & 3;		// 1 for layer III
+	int bitrateIndex = p[2] >> 4;
+	int rateIndex = (p[2] >> 2) & 3;
+	if(version == 1 || layer != 1 || bitrateIndex == 0 || bitrateIndex == 15 || rateIndex == 3) {
+		return 0;
+	}
+	int shift = version == 3 ? 0 : version == 2 ? 1 : 2;
+	h->lsf = version != 3;
+	h->rate = rateIndex + shift * 3;
+	h->sampleRate = sampleRates[rateIndex] >> shift;
+	u32 bitrate = (h->lsf ? bitratesMpeg2 : bitratesMpeg1)[bitrateIndex] * 1000;
+	h->length = (h->lsf ? 72 : 144) * bitrate / h->sampleRate + ((p[2] >> 1) & 1);
+	h->crc = !(p[1] & 1);
+	int mode = p[3] >> 6;
+	h->modeExt = mode == 1 ? (p[3] >> 4) & 3 : 0;
+	h->channels = mode == 3 ? 1 : 2;
+	return h->length;
+}
+
+static void* liteOpen(decoder_reader_t reader, void *cbdata) {
+	initTables();
+	struct lite_state *dec = malloc(sizeof(struct lite_state));
+	if(!dec) {
+		return NULL;
+	}
+	memset(dec, 0, sizeof(struct lite_state));
+	dec->reader = reader;
+	dec->cbdata = cbdata;
+	return dec;
+}
+
+static void liteSeek(void *state, u32 streamPos) {
+	struct lite_state *dec = state;
+	decoder_reader_t reader = dec->reader;
+	void *cbdata = dec->cbdata;
+	memset(dec, 0, offsetof(struct lite_state, input));
+	dec->reader = reader;
+	dec->cbdata = cbdata;
+	dec->inputPos = streamPos;
+}
+
+static void liteClose(void *dec) {
+	free(dec);
+}
+
+// Keeps whatever hasn't been looked at yet and tops the rest of the input up from the reader.
+static int liteFill(struct lite_state *dec) {
+	if(dec->eof) {
+		return 0;
+	}
+	u32 keep = dec->inputLen - dec->inputOff;
+	memmove(dec->input, dec->input + dec->inputOff, keep);
+	dec->inputPos += dec->inputOff;
+	dec->inputOff = 0;
+	dec->inputLen = keep;
+	s32 got = dec->reader(dec->cbdata, dec->input + keep, LITE_INPUT_SIZE - keep);
+	if(got <= 0) {
+		dec->eof = 1;
+		return 0;
+	}
+	dec->inputLen += got;
+	return 1;
+}
+
+static int sameStream(const u8 *a, const u8 *b) {
+	return (a[1] & 0xFE) == (b[1] & 0xFE) && (a[2] & 0x0C) == (b[2] & 0x0C);
+}
+
+// Finds the next frame, whole in the input at inputOff. After anything that wasn't a frame
+// the one found has to be followed by another like it, unless it's the last.
+static int findFrame(struct lite_state *dec, struct lite_header *h) {
+	while(1) {
+		u32 avail = dec->inputLen - dec->inputOff;
+		const u8 *p = dec->input + dec->inputOff;
+		if(avail < 4) {
+			if(!liteFill(dec)) {
+				return 0;
+			}
+			continue;
+		}
+		u32 len = parseHeader(p, h);
+		if(len && dec->locked && !sameStream(p, dec->lockHeader)) {
+			dec->locked = 0;
+		}
+		if(len && avail < len + 4 && !dec->eof) {
+			liteFill(dec);
+			continue;
+		}
+		if(len && avail < len) {
+			// Cut short at the end
+			return 0;
+		}
+		if(len && !dec->locked && avail >= len + 4) {
+			struct lite_header next;
+			if(!parseHeader(p + len, &next) || !sameStream(p, p + len)) {
+				len = 0;
+			}
+		}
+		if(!len) {
+			dec->inputOff++;
+			dec->locked = 0;
+			continue;
+		}
+		dec->locked = 1;
+		memcpy(dec->lockHeader, p, 4);
+		return 1;
+	}
+}
+
+// The Xing/Info or VBRI frame at the top of a track carries no sound, only the tag.
+static int isTagFrame(const u8 *f, const struct lite_header *h, u32 sideSize) {
+	const u8 *xing = f + 4 + (h->crc ? 2 : 0) + sideSize;
+	if(xing + 4 <= f + h->length && (!memcmp(xing, "Xing", 4) || !memcmp(xing, "Info", 4))) {
+		return 1;
+	}
+	return h->length >= 40 && !memcmp(f + 36, "VBRI", 4);
+}
+
+static int readSideInfo(struct lite_bits *b, const struct lite_header *h, u32 *mainDataBegin, u8 scfsi[2], struct lite_channel gr[2][2]) {
+	int nch = h->channels;
+	if(h->lsf) {
+		*mainDataBegin = getBits(b, 8);
+		getBits(b, nch == 1 ? 1 : 2);
+	}
+	else {
+		*mainDataBegin = getBits(b, 9);
+		getBits(b, nch == 1 ? 5 : 3);
+		for(int ch = 0; ch < nch; ch++) {
+			scfsi[ch] = getBits(b, 4);
+		}
+	}
+	for(int g = 0; g < (h->lsf ? 1 : 2); g++) {
+		for(int ch = 0; ch < nch; ch++) {
+			struct lite_channel *c = &gr[g][ch];
+			c->part23Length = getBits(b, 12);
+			c->bigValues = getBits(b, 9);
+			c->globalGain = getBits(b, 8);
+			c->scalefacCompress = getBits(b, h->lsf ? 9 : 4);
+			if(c->bigValues > 288) {
+				return 0;
+			}
+			if(getBits(b, 1)) {
+				c->blockType = getBits(b, 2);
+				c->mixed = getBits(b, 1);
+				if(!c->blockType) {
+					return 0;
+				}
+				c->tableSelect[0] = getBits(b, 5);
+				c->tableSelect[1] = getBits(b, 5);
+				c->tableSelect[2] = 0;
+				for(int w = 0; w < 3; w++) {
+					c->subblockGain[w] = getBits(b, 3);
+				}
+				c->region0Count = c->blockType == 2 && !c->mixed ? 8 : 7;
+				c->region1Count = 36;
+			}
+			else {
+				c->blockType = 0;
+				c->mixed = 0;
+				for(int r = 0; r < 3; r++) {
+					c->tableSelect[r] = getBits(b, 5);
+				}
+				memset(c->subblockGain, 0, 3);
+				c->region0Count = getBits(b, 4);
+				c->region1Count = getBits(b, 3);
+			}
+			c->preflag = h->lsf ? 0 : getBits(b, 1);
+			c->scalefacScale = getBits(b, 1);
+			c->count1Table = getBits(b, 1);
+		}
+	}
+	return 1;
+}
+
+static int blocksOf(const struct lite_channel *c) {
+	return c->blockType != 2 ? BLOCKS_LONG : c->mixed ? BLOCKS_MIXED : BLOCKS_SHORT;
+}
+
+static void readScalefacs(struct lite_bits *b, const struct lite_channel *c, int g, u8 scfsi, u8 *scalefac) {
+	int slen1 = slenMpeg1[c->scalefacCompress][0];
+	int slen2 = slenMpeg1[c->scalefacCompress][1];
+	int n = 0;
+	if(c->blockType == 2) {
+		int first = c->mixed ? 8 + 3*3 : 6*3;
+		for(; n < first; n++) {
+			scalefac[n] = getBits(b, slen1);
+		}
+		for(int i = 0; i < 6*3; i++, n++) {
+			scalefac[n] = getBits(b, slen2);
+		}
+		memset(scalefac + n, 0, 40 - n);
+		return;
+	}
+	// Bands 0-5, 6-10, 11-15 and 16-20, each can be granule 0's again in granule 1
+	static const u8 groupEnds[4] = {6, 11, 16, 21};
+	for(int group = 0; group < 4; group++) {
+		int slen = group < 2 ? slen1 : slen2;
+		if(g && (scfsi & (8 >> group))) {
+			n = groupEnds[group];
+			continue;
+		}
+		for(; n < groupEnds[group]; n++) {
+			scalefac[n] = getBits(b, slen);
+		}
+	}
+	scalefac[21] = 0;
+}
+
+static void readScalefacsLsf(struct lite_bits *b, struct lite_channel *c, int intensityRight, u8 *scalefac, u8 *illegal) {
+	u32 sc = c->scalefacCompress;
+	int slen[4];
+	int choice;
+	if(!intensityRight) {
+		if(sc < 400) {
+			slen[0] = (sc >> 4) / 5;
+			slen[1] = (sc >> 4) % 5;
+			slen[2] = (sc & 15) >> 2;
+			slen[3] = sc & 3;
+			choice = 0;
+		}
+		else if(sc < 500) {
+			sc -= 400;
+			slen[0] = (sc >> 2) / 5;
+			slen[1] = (sc >> 2) % 5;
+			slen[2] = sc & 3;
+			slen[3] = 0;
+			choice = 1;
+		}
+		else {
+			sc -= 500;
+			slen[0] = sc / 3;
+			slen[1] = sc % 3;
+			slen[2] = slen[3] = 0;
+			c->preflag = 1;
+			choice = 2;
+		}
+	}
+	else {
+		sc >>= 1;
+		if(sc < 180) {
+			slen[0] = sc / 36;
+			slen[1] = (sc % 36) / 6;
+			slen[2] = (sc % 36) % 6;
+			slen[3] = 0;
+			choice = 3;
+		}
+		else if(sc < 244) {
+			sc -= 180;
+			slen[0] = (sc & 63) >> 4;
+			slen[1] = (sc & 15) >> 2;
+			slen[2] = sc & 3;
+			slen[3] = 0;
+			choice = 4;
+		}
+		else {
+			sc -= 244;
+			slen[0] = sc / 3;
+			slen[1] = sc % 3;
+			slen[2] = slen[3] = 0;
+			choice = 5;
+		}
+	}
+	const u8 *sizes = lsfPartSizes[choice][blocksOf(c)];
+	int n = 0;
+	for(int part = 0; part < 4; part++) {
+		u32 max = (1 << slen[part]) - 1;
+		for(int i = 0; i < sizes[part]; i++, n++) {
+			scalefac[n] = getBits(b, slen[part]);
+			if(intensityRight) {
+				illegal[n] = scalefac[n] == max;
+			}
+		}
+	}
+	memset(scalefac + n, 0, 40 - n);
+	if(intensityRight) {
+		memset(illegal + n, 0, 40 - n);
+	}
+}
+
+static inline float quarterPow(int e) {
+	return ldexpf(quarterPows[e & 3], e >> 2);
+}
+
+// What each band's values get multiplied by, 2^(exponent/4)
+static void bandGains(const struct lite_channel *c, const u8 *scalefac, const u8 *widths, float *gains) {
+	int gain = c->globalGain - 210;
+	int shift = c->scalefacScale ? 2 : 1;
+	int sfbi = 0;
+	int l = 0;
+	if(c->blockType == 2) {
+		if(c->mixed) {
+			for(; l < 36; l += widths[sfbi++]) {
+				gains[sfbi] = quarterPow(gain - ((scalefac[sfbi] + (c->preflag ? pretab[sfbi] : 0)) << shift));
+			}
+		}
+		for(; l < 576; l += 3 * widths[sfbi], sfbi += 3) {
+			for(int w = 0; w < 3; w++) {
+				gains[sfbi + w] = quarterPow(gain - 8 * c->subblockGain[w] - (scalefac[sfbi + w] << shift));
+			}
+		}
+	}
+	else {
+		for(; sfbi < 22; sfbi++) {
+			gains[sfbi] = quarterPow(gain - ((scalefac[sfbi] + (c->preflag ? pretab[sfbi] : 0)) << shift));
+		}
+	}
+}
+
+// Decodes and requantises a granule's lines, returns how many there were (the rest are
+// zeroed) or -1 for a bad table. The count1 quadruple that ran past the end is dropped.
+static int readLines(struct lite_bits *b, const struct lite_channel *c, const u8 *widths, const float *gains, u32 end, float *xr) {
+	u32 regionEnds[2];
+	u32 l = 0;
+	int sfbi = 0;
+	for(int r = 0; r < 2; r++) {
+		int bands = r ? c->region1Count + 1 : c->region0Count + 1;
+		for(; bands && l < 576; bands--) {
+			l += widths[sfbi++];
+		}
+		regionEnds[r] = l;
+	}
+	u32 bigEnd = c->bigValues * 2;
+	sfbi = 0;
+	u32 bound = widths[0];
+	float gain = gains[0];
+	l = 0;
+	for(int r = 0; r < 3 && l < bigEnd; r++) {
+		u32 stop = MIN(bigEnd, r < 2 ? regionEnds[r] : 576);
+		int t = c->tableSelect[r];
+		const struct lite_huff_table *table = &liteHuffTables[t];
+		const struct huff_lookup *lookup = &huffLookups[t];
+		int linbits = table->linbits;
+		if(t && !table->dim) {
+			return -1;
+		}
+		for(; l < stop; l += 2) {
+			while(l >= bound) {
+				gain = gains[++sfbi];
+				bound += widths[sfbi];
+			}
+			if(!t) {
+				xr[l] = xr[l + 1] = 0;
+				continue;
+			}
+			u32 v = huffDecode(b, lookup);
+			u32 x = v >> 4;
+			u32 y = v & 15;
+			if(x == 15 && linbits) {
+				x += getBits(b, linbits);
+			}
+			xr[l] = x ? (getBits(b, 1) ? -pow43[x] : pow43[x]) * gain : 0;
+			if(y == 15 && linbits) {
+				y += getBits(b, linbits);
+			}
+			xr[l + 1] = y ? (getBits(b, 1) ? -pow43[y] : pow43[y]) * gain : 0;
+			if(b->pos > end) {
+				return -1;
+			}
+		}
+	}
+	while(l + 4 <= 576 && b->pos < end) {
+		u32 quad = c->count1Table ? 15 - getBits(b, 4) : huffDecode(b, &count1Lookup);
+		for(int i = 0; i < 4; i++, l++) {
+			while(l >= bound) {
+				gain = gains[++sfbi];
+				bound += widths[sfbi];
+			}
+			xr[l] = (quad & (8 >> i)) ? (getBits(b, 1) ? -gain : gain) : 0;
+		}
+	}
+	if(b->pos > end) {
+		l -= 4;
+	}
+	memset(xr + l, 0, (576 - l) * sizeof(float));
+	return l;
+}
+
+// libmad's III_stereo(), in floats
+static int stereo(struct lite_state *dec, const struct lite_header *h, const struct lite_channel *gr, const u8 *widths) {
+	if(gr[0].blockType != gr[1].blockType || gr[0].mixed != gr[1].mixed) {
+		return 0;
+	}
+	u8 modes[40];
+	memset(modes, h->modeExt, sizeof(modes));
+	const struct lite_channel *right = &gr[1];
+	const u8 *rightScalefac = dec->scalefac[1];
+	if(h->modeExt & MODE_EXT_INTENSITY) {
+		// Intensity stereo only starts above the right channel's last non-zero band
+		const float *rightXr = dec->xr[1];
+		int sfbi = 0;
+		u32 l = 0;
+		if(right->blockType == 2) {
+			u32 lower = 0, start = 0, max = 0, bound[3] = {0, 0, 0};
+			if(right->mixed) {
+				while(l < 36) {
+					int n = widths[sfbi++];
+					for(int i = 0; i < n; i++) {
+						if(rightXr[l + i]) {
+							lower = sfbi;
+							break;
+						}
+					}
+					l += n;
+				}
+				start = sfbi;
+			}
+			for(int w = 0; l < 576; w = (w + 1) % 3) {
+				int n = widths[sfbi++];
+				for(int i = 0; i < n; i++) {
+					if(rightXr[l + i]) {
+						max = bound[w] = sfbi;
+						break;
+					}
+				}
+				l += n;
+			}
+			if(max) {
+				lower = start;
+			}
+			for(u32 i = 0; i < lower; i++) {
+				modes[i] &= ~MODE_EXT_INTENSITY;
+			}
+			for(u32 i = start, w = 0; i < max; i++, w = (w + 1) % 3) {
+				if(i < bound[w]) {
+					modes[i] &= ~MODE_EXT_INTENSITY;
+				}
+			}
+		}
+		else {
+			u32 bound = 0;
+			for(; l < 576; l += widths[sfbi++]) {
+				for(int i = 0; i < widths[sfbi]; i++) {
+					if(rightXr[l + i]) {
+						bound = sfbi + 1;
+						break;
+					}
+				}
+			}
+			for(u32 i = 0; i < bound; i++) {
+				modes[i] &= ~MODE_EXT_INTENSITY;
+			}
+		}
+
+		float *left = dec->xr[0];
+		float *rightOut = dec->xr[1];
+		l = 0;
+		for(sfbi = 0; l < 576; l += widths[sfbi++]) {
+			int n = widths[sfbi];
+			if(!(modes[sfbi] & MODE_EXT_INTENSITY)) {
+				continue;
+			}
+			u32 pos = rightScalefac[sfbi];
+			if(h->lsf) {
+				if(dec->illegal[sfbi]) {
+					modes[sfbi] &= ~MODE_EXT_INTENSITY;
+					continue;
+				}
+				const float *ratios = lsfRatios[right->scalefacCompress & 1];
+				for(int i = 0; i < n; i++) {
+					float v = left[l + i];
+					if(!pos) {
+						rightOut[l + i] = v;
+					}
+					else if(pos & 1) {
+						left[l + i] = v * ratios[(pos - 1) / 2];
+						rightOut[l + i] = v;
+					}
+					else {
+						rightOut[l + i] = v * ratios[(pos - 1) / 2];
+					}
+				}
+			}
+			else {
+				if(pos >= 7) {
+					modes[sfbi] &= ~MODE_EXT_INTENSITY;
+					continue;
+				}
+				for(int i = 0; i < n; i++) {
+					float v = left[l + i];
+					left[l + i] = v * isRatios[pos];
+					rightOut[l + i] = v * isRatios[6 - pos];
+				}
+			}
+		}
+	}
+	if(h->modeExt & MODE_EXT_MS) {
+		float *left = dec->xr[0];
+		float *rightOut = dec->xr[1];
+		u32 l = 0;
+		for(int sfbi = 0; l < 576; l += widths[sfbi++]) {
+			if(modes[sfbi] != MODE_EXT_MS) {
+				continue;
+			}
+			for(int i = 0; i < widths[sfbi]; i++) {
+				float m = left[l + i], s = rightOut[l + i];
+				left[l + i] = (m + s) * (float)M_SQRT1_2;
+				rightOut[l + i] = (m - s) * (float)M_SQRT1_2;
+			}
+		}
+	}
+	return 1;
+}
+
+// Short blocks come in band by band, each band window by window. The IMDCT wants each
+// subband's 18 lines as the three windows' 6 one after the other.
+static void reorder(float *xr, int mixed, const u8 *widths) {
+	float tmp[576];
+	int sb = 0;
+	int sfbi = 0;
+	if(mixed) {
+		sb = 2;
+		for(int l = 0; l < 36; l += widths[sfbi++]);
+	}
+	int sbw[3] = {sb, sb, sb};
+	int sw[3] = {0, 0, 0};
+	int f = widths[sfbi++];
+	int w = 0;
+	for(int l = 18 * sb; l < 576; l++) {
+		if(f-- == 0) {
+			f = widths[sfbi++] - 1;
+			w = (w + 1) % 3;
+		}
+		tmp[sbw[w] * 18 + w * 6 + sw[w]++] = xr[l];
+		if(sw[w] == 6) {
+			sw[w] = 0;
+			sbw[w]++;
+		}
+	}
+	memcpy(xr + 18 * sb, tmp + 18 * sb, (576 - 18 * sb) * sizeof(float));
+}
+
+static void aliasReduce(float *xr, int subbands) {
+	for(int sb = 1; sb < subbands; sb++) {
+		float *edge = xr + 18 * sb;
+		for(int i = 0; i < 8; i++) {
+			float a = edge[-1 - i], b = edge[i];
+			edge[-1 - i] = a * aliasCs[i] - b * aliasCa[i];
+			edge[i] = b * aliasCs[i] + a * aliasCa[i];
+		}
+	}
+}
+
+static void imdctLongBlock(const float *x, float *z, int blockType) {
+	for(int r = 0; r < 18; r++) {
+		const float *row = imdctLong[r];
+		float s = 0;
+		for(int k = 0; k < 18; k++) {
+			s += x[k] * row[k];
+		}
+		z[r < 9 ? r : r + 9] = s;
+	}
+	for(int i = 0; i < 9; i++) {
+		z[17 - i] = -z[i];
+		z[35 - i] = z[18 + i];
+	}
+	switch(blockType) {
+		case 1:
+			for(int i = 0; i < 18; i++) {
+				z[i] *= windowLong[i];
+			}
+			for(int i = 24; i < 30; i++) {
+				z[i] *= windowShort[i - 18];
+			}
+			memset(z + 30, 0, 6 * sizeof(float));
+			break;
+		case 3:
+			memset(z, 0, 6 * sizeof(float));
+			for(int i = 6; i < 12; i++) {
+				z[i] *= windowShort[i - 6];
+			}
+			for(int i = 18; i < 36; i++) {
+				z[i] *= windowLong[i];
+			}
+			break;
+		default:
+			for(int i = 0; i < 36; i++) {
+				z[i] *= windowLong[i];
+			}
+			break;
+	}
+}
+
+static void imdctShortBlock(const float *x, float *z) {
+	float y[3][12];
+	for(int w = 0; w < 3; w++) {
+		float *yw = y[w];
+		for(int r = 0; r < 6; r++) {
+			float s = 0;
+			for(int k = 0; k < 6; k++) {
+				s += x[w*6 + k] * imdctShort[r][k];
+			}
+			yw[r < 3 ? r : r + 3] = s;
+		}
+		for(int i = 0; i < 3; i++) {
+			yw[5 - i] = -yw[i];
+			yw[11 - i] = yw[6 + i];
+		}
+		for(int i = 0; i < 12; i++) {
+			yw[i] *= windowShort[i];
+		}
+	}
+	for(int i = 0; i < 6; i++) {
+		z[i] = 0;
+		z[6 + i] = y[0][i];
+		z[12 + i] = y[0][6 + i] + y[1][i];
+		z[18 + i] = y[1][6 + i] + y[2][i];
+		z[24 + i] = y[2][6 + i];
+		z[30 + i] = 0;
+	}
+}
+
+// One channel's granule from frequency lines to 18 time slots of 32 subband samples.
+static void hybrid(struct lite_state *dec, int ch, const struct lite_channel *c, const u8 *widths) {
+	float *xr = dec->xr[ch];
+	if(c->blockType == 2) {
+		reorder(xr, c->mixed, widths);
+	}
+	int lines = 576;
+	while(lines > 0 && xr[lines - 1] == 0) {
+		lines--;
+	}
+	int used = (lines + 17) / 18;
+	int aliased = c->blockType != 2 ? MIN(used + 1, 32) : c->mixed ? MIN(used + 1, 2) : 0;
+	aliasReduce(xr, aliased);
+	used = MAX(used, aliased);
+	int live = MAX(used, dec->active[ch]);
+	dec->active[ch] = used;
+
+	float z[36];
+	for(int sb = 0; sb < 32; sb++) {
+		float *overlap = dec->overlap[ch][sb];
+		if(sb >= live) {
+			for(int t = 0; t < 18; t++) {
+				dec->hybrid[t][sb] = 0;
+			}
+			continue;
+		}
+		if(sb >= used) {
+			memset(z, 0, sizeof(z));
+		}
+		else if(c->blockType == 2 && (sb >= 2 || !c->mixed)) {
+			imdctShortBlock(xr + sb * 18, z);
+		}
+		else {
+			imdctLongBlock(xr + sb * 18, z, c->mixed ? 0 : c->blockType);
+		}
+		for(int t = 0; t < 18; t++) {
+			float v = z[t] + overlap[t];
+			// Odd subbands' odd samples are the other way up
+			dec->hybrid[t][sb] = (sb & t & 1) ? -v : v;
+			overlap[t] = z[t + 18];
+		}
+	}
+}
+
+// Fast DCT-II, x in place, tmp has to hold n floats
+static void dct(float *x, float *tmp, int n) {
+	if(n == 1) {
+		return;
+	}
+	int half = n >> 1;
+	const float *coefs = dctCoefs + half - 1;
+	for(int k = 0; k < half; k++) {
+		float a = x[k], b = x[n - 1 - k];
+		tmp[k] = a + b;
+		tmp[half + k] = (a - b) * coefs[k];
+	}
+	dct(tmp, x, half);
+	dct(tmp + half, x + half, half);
+	for(int m = 0; m < half - 1; m++) {
+		x[2*m] = tmp[m];
+		x[2*m + 1] = tmp[half + m] + tmp[half + m + 1];
+	}
+	x[n - 2] = tmp[half - 1];
+	x[n - 1] = tmp[n - 1];
+}
+
+static inline s16 toSample(float v) {
+	v *= 32768.0f;
+	if(v >= 32767.0f) {
+		return 32767;
+	}
+	if(v <= -32768.0f) {
+		return -32768;
+	}
+	return (s16)(v + (v >= 0 ? 0.5f : -0.5f));
+}
+
+// The polyphase synthesis filter, each time slot's 32 subband samples to 32 PCM samples.
+static void synthesise(struct lite_state *dec, int ch, s16 *out) {
+	float x[32], tmp[32];
+	float *buf = dec->synth[ch];
+	for(int t = 0; t < 18; t++) {
+		memcpy(x, dec->hybrid[t], sizeof(x));
+		dct(x, tmp, 32);
+		u32 off = dec->synthOff[ch] = (dec->synthOff[ch] - 64) & 1023;
+		float *v = buf + off;
+		for(int i = 0; i < 16; i++) {
+			v[i] = x[16 + i];
+		}
+		v[16] = 0;
+		for(int i = 17; i < 48; i++) {
+			v[i] = -x[48 - i];
+		}
+		v[48] = -x[0];
+		for(int i = 49; i < 64; i++) {
+			v[i] = -x[i - 48];
+		}
+		memcpy(buf + ((off + 1024) & 2047), v, 64 * sizeof(float));
+		for(int j = 0; j < 32; j++) {
+			const float *d = synthWindow + j;
+			const float *vj = v + j;
+			float sum = 0;
+			for(int k = 0; k < 8; k++) {
+				sum += vj[128*k] * d[64*k] + vj[128*k + 96] * d[64*k + 32];
+			}
+			out[(t*32 + j) * 2] = toSample(sum);
+		}
+	}
+}
+
+// Decodes the frame at inputOff, 0 if it couldn't be (its main data isn't all there or it's bad).
+static int decodeFrame(struct lite_state *dec, const struct lite_header *h, struct decoder_pcm *pcm) {
+	const u8 *frame = dec->input + dec->inputOff;
+	int nch = h->channels;
+	u32 sideSize = h->lsf ? (nch == 1 ? 9 : 17) : (nch == 1 ? 17 : 32);
+	u32 headerSize = 4 + (h->crc ? 2 : 0) + sideSize;
+	if(h->length <= headerSize) {
+		return 0;
+	}
+	struct lite_bits b = {frame + 4 + (h->crc ? 2 : 0), 0};
+	u32 mainDataBegin;
+	u8 scfsi[2] = {0, 0};
+	struct lite_channel gr[2][2];
+	int sideOk = readSideInfo(&b, h, &mainDataBegin, scfsi, gr);
+
+	// This frame's main data goes on the end of the reservoir, what it's after starts mainDataBegin back
+	u32 frameMainLen = h->length - headerSize;
+	u8 *reservoirEnd = dec->mainData + dec->reservoirLen;
+	memcpy(reservoirEnd, frame + headerSize, frameMainLen);
+	memset(reservoirEnd + frameMainLen, 0, LITE_MAIN_PAD);
+	int ok = sideOk && mainDataBegin <= dec->reservoirLen;
+	const u8 *main = reservoirEnd - mainDataBegin;
+	u32 mainBits = (mainDataBegin + frameMainLen) * 8;
+
+	b.buf = main;
+	b.pos = 0;
+	int ngr = h->lsf ? 1 : 2;
+	for(int g = 0; ok && g < ngr; g++) {
+		for(int ch = 0; ok && ch < nch; ch++) {
+			struct lite_channel *c = &gr[g][ch];
+			u32 end = b.pos + c->part23Length;
+			const u8 *widths = sfbWidths[h->rate][blocksOf(c)];
+			float gains[40];
+			if(end > mainBits) {
+				ok = 0;
+				break;
+			}
+			if(h->lsf) {
+				readScalefacsLsf(&b, c, ch == 1 && (h->modeExt & MODE_EXT_INTENSITY), dec->scalefac[ch], dec->illegal);
+			}
+			else {
+				readScalefacs(&b, c, g, scfsi[ch], dec->scalefac[ch]);
+			}
+			bandGains(c, dec->scalefac[ch], widths, gains);
+			ok = b.pos <= end && readLines(&b, c, widths, gains, end, dec->xr[ch]) >= 0;
+			b.pos = end;
+		}
+		if(ok && nch == 2 && h->modeExt) {
+			ok = stereo(dec, h, gr[g], sfbWidths[h->rate][blocksOf(&gr[g][1])]);
+		}
+		for(int ch = 0; ok && ch < nch; ch++) {
+			hybrid(dec, ch, &gr[g][ch], sfbWidths[h->rate][blocksOf(&gr[g][ch])]);
+			synthesise(dec, ch, pcm->samples + g * 576 * 2 + ch);
+		}
+	}
+
+	// Only the last LITE_RESERVOIR bytes can be reached back to
+	u32 total = dec->reservoirLen + frameMainLen;
+	u32 keep = MIN(total, LITE_RESERVOIR);
+	memmove(dec->mainData, dec->mainData + total - keep, keep);
+	dec->reservoirLen = keep;
+	if(!ok) {
+		return 0;
+	}
+	u32 count = ngr * 576;
+	if(nch == 1) {
+		for(u32 i = 0; i < count; i++) {
+			pcm->samples[i*2 + 1] = pcm->samples[i*2];
+		}
+	}
+	pcm->count = count;
+	pcm->sampleRate = h->sampleRate;
+	pcm->streamPos = dec->inputPos + dec->inputOff;
+	return 1;
+}
+
+static int liteDecode(void *state, struct decoder_pcm *pcm) {
+	struct lite_state *dec = state;
+	struct lite_header h;
+	while(findFrame(dec, &h)) {
+		u32 sideSize = h.lsf ? (h.channels == 1 ? 9 : 17) : (h.channels == 1 ? 17 : 32);
+		int decoded = !isTagFrame(dec->input + dec->inputOff, &h, sideSize) && decodeFrame(dec, &h, pcm);
+		dec->inputOff += h.length;
+		if(decoded) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+const struct decoder_backend liteBackend = {
+	"lite",
+	LITE_DELAY,
+	liteOpen,
+	liteDecode,
+	liteSeek,
+	liteClose
+};
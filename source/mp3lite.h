@@ -0,0 +1,26 @@
+#ifndef __MP3LITE_H__
+#define __MP3LITE_H__
+
+#include <gccore.h>
+#include "decoder.h"
+
+#define LITE_DELAY 529					// same synthesis filter delay as any other layer III decoder
+
+// A layer III Huffman table: the code for (x, y) is codes[x * dim + y], lengths[x * dim + y] bits long
+struct lite_huff_table {
+	const u16 *codes;
+	const u8 *lengths;
+	u8 dim;								// 0 for tables 0, 4 and 14, which carry nothing
+	u8 linbits;
+};
+
+// The tables below are the decoder's, the host tests' encoder writes its MP3s with them too
+extern const struct lite_huff_table liteHuffTables[32];	// by table_select
+extern const struct lite_huff_table liteCount1Table;	// table A, index v w x y as 4 bits
+extern const u8 liteSfbLong[9][22];		// scalefactor band widths, by sample rate
+extern const u8 liteSfbShort[9][13];	// 44.1, 48, 32, 22.05, 24, 16, 11.025, 12 and 8kHz
+extern const s32 liteWindow[257];		// synthesis window D[0..256] * 65536, sign of every other 64 flipped
+
+extern const struct decoder_backend liteBackend;
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef __PATHS_H__
+#define __PATHS_H__
+
+// Everything WakeMii keeps on the SD card / USB drive lives under here,
+// the host build (Makefile.host) points it somewhere of its own
+#ifndef WAKEMII_DIR
+#define WAKEMII_DIR "/wakemii"
+#endif
+
+#endif
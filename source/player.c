@@ -0,0 +1,381 @@
+/*===========================================
+        WakeMii - Gapless playback on top of a decoder backend
+
+        The player's thread pulls PCM a frame at a time out of the
+        decoder backend and writes it to the audio output (audio.c). The
+        decoder reads through the read-ahead stream, which carries on
+        straight into the next track (queued ahead of time) when the
+        current one runs dry, so the decoder just sees one long stream.
+
+        The stream says which track each frame came from, so the encoder
+        delay and padding from a track's LAME tag can be cut off either
+        end of it, and the gap between two tracks is measured where it's
+        heard: whatever the output played between the last sample of
+        one and the first of the next.
+
+        Priming for an alarm reads the track into the stream and has the
+        thread decode its first PLAYER_PRIME_FRAMES frames, then hold
+        them until playerStartPrimed(), so the first sound waits on
+        neither the card nor the decoder.
+
+        The decoder's opened once, the first time anything plays, and
+        seeked back to the start of the stream each time it starts again
+        (a new track, a D-pad seek), so that never allocates.
+============================================*/
+#include <gccore.h>
+#include <string.h>
+#include <ogc/lwp_watchdog.h>
+#include "player.h"
+#include "decoder.h"
+#include "audio.h"
+#include "stream.h"
+#include "settings.h"
+#include "profile.h"
+#include "gecko.h"
+
+#define PLAYER_PRIORITY 80
+#define PLAYER_STACK_SIZE (16*1024)
+
+static const struct decoder_backend *decoder;
+static void *dec;						// the open decoder, only ever touched by the player's thread
+static struct decoder_pcm pcm;			// only ever touched by the player's thread
+static struct decoder_pcm primeFrames[PLAYER_PRIME_FRAMES];	// and these
+static int numPrimeFrames;
+static int outputStarted;
+
+static mutex_t playerMutex;
+static cond_t playerCond;
+static lwp_t playerThread = LWP_THREAD_NULL;
+static int wanted;						// a start is waiting for the thread to pick it up
+static int wantedPrime;					// and it's to be held once it's decoded a little
+static int released;					// playerStartPrimed() let it go
+static volatile int running;			// from the start being asked for until the output's played out
+static volatile int stopping;
+
+static volatile u32 sampleRate = 44100;
+static volatile u32 lastGapSamples;
+static volatile u32 position;			// file offset of the last frame sent to the output
+static int trackChanges;
+static int wasPlaying;
+static u64 endedTime;
+static volatile u64 restartFrom;		// when the output ran out ahead of this start, 0 if it didn't
+static int primed;
+static u64 latencyFrom;					// when the sound was wanted, 0 if nobody's asking
+static volatile u64 firstFrameTime;
+
+// Where the player's thread is up to in the stream
+static int trackNum;
+static struct stream_track track;
+static u32 trackDecoded;				// samples decoded from the track so far
+static u32 trimStart;					// which of those get played, trimEnd 0 for all of them
+static u32 trimEnd;
+static int trackStarted;
+static int anyStarted;
+static int gapPending;
+static u32 gapFrom;						// output buffers holding the last sample of one track
+static u32 gapTo;						// and the first of the next
+
+static u32 ticksToSamples(u64 ticks) {
+	return (u32)((ticks_to_microsecs(ticks) * sampleRate) / 1000000);
+}
+
+static s32 playerReader(void *cbdata, void *dst, s32 size) {
+	if(!streamReady() && outputStarted) {
+		// The card's behind, get what's been decoded out before the voice runs dry
+		audioFlush();
+	}
+	return streamRead(dst, size);
+}
+
+// The silence between two tracks is only known once the second has reached the voice.
+static void resolveGap() {
+	u32 silent;
+	if(!gapPending) {
+		return;
+	}
+	int ret = audioSilenceBetween(gapFrom, gapTo, &silent);
+	if(ret) {
+		gapPending = 0;
+	}
+	if(ret > 0) {
+		lastGapSamples = silent;
+		print_gecko("Gapless track change, gap: %u samples, %u stream underruns so far\r\n", silent, streamUnderruns());
+	}
+}
+
+static void startTrack(int num, const struct stream_track *t) {
+	trackNum = num;
+	track = *t;
+	trackDecoded = 0;
+	trackStarted = 0;
+	trimStart = trimEnd = 0;
+	if(track.samples) {
+		trimStart = track.delay + decoder->delay;
+		// The decoder's delay pushes the last samples that much later, into the padding
+		trimEnd = MIN(track.samples - track.padding + decoder->delay, track.samples);
+	}
+}
+
+// Sends the track's own samples from a decoded frame to the output, 0 once stopped.
+static int playFrame(const struct decoder_pcm *pcm) {
+	struct stream_track t;
+	int num = streamTrackAt(pcm->streamPos, &t);
+	if(num >= 0 && num != trackNum) {
+		startTrack(num, &t);
+	}
+	u32 from = trackDecoded;
+	trackDecoded += pcm->count;
+	u32 first = MAX(from, trimStart);
+	u32 last = trimEnd ? MIN(trackDecoded, trimEnd) : trackDecoded;
+	if(first >= last) {
+		return 1;
+	}
+	sampleRate = pcm->sampleRate;
+	position = track.filePos + (pcm->streamPos - track.start);
+	if(!trackStarted) {
+		trackStarted = 1;
+		if(anyStarted) {
+			gapFrom = audioLastBuffer();
+			gapTo = audioNextBuffer();
+			gapPending = 1;
+			LWP_MutexLock(playerMutex);
+			trackChanges++;
+			LWP_MutexUnlock(playerMutex);
+		}
+		else {
+			anyStarted = 1;
+			if(latencyFrom && !firstFrameTime) {
+				firstFrameTime = gettime();
+			}
+			if(restartFrom) {
+				// The last track ran out with nothing queued, so this is how long we were silent for
+				lastGapSamples = ticksToSamples(diff_ticks(restartFrom, gettime()));
+				print_gecko("Track change gap: %u samples\r\n", lastGapSamples);
+			}
+		}
+	}
+	int ret = audioWrite(pcm->samples + (first - from) * 2, last - first, pcm->sampleRate);
+	resolveGap();
+	return ret;
+}
+
+// Decodes the first few frames and waits to be released, 0 if it was stopped instead.
+static int primeStream() {
+	numPrimeFrames = 0;
+	while(!stopping && numPrimeFrames < PLAYER_PRIME_FRAMES && decoder->decode(dec, &primeFrames[numPrimeFrames])) {
+		numPrimeFrames++;
+	}
+	LWP_MutexLock(playerMutex);
+	while(!released && !stopping) {
+		LWP_CondWait(playerCond, playerMutex);
+	}
+	LWP_MutexUnlock(playerMutex);
+	return !stopping;
+}
+
+static void playStream(int prime) {
+	trackNum = -1;
+	memset(&track, 0, sizeof(struct stream_track));
+	trimStart = trimEnd = 0;
+	anyStarted = 0;
+	gapPending = 0;
+	numPrimeFrames = 0;
+	outputStarted = 0;
+	if(dec) {
+		decoder->seek(dec, 0);
+	}
+	else if(!(dec = decoder->open(&playerReader, NULL))) {
+		error_gecko("Couldn't open the decoder\r\n");
+		return;
+	}
+	if(!prime || primeStream()) {
+		audioStart();
+		outputStarted = 1;
+		int ok = 1;
+		for(int i = 0; ok && !stopping && i < numPrimeFrames; i++) {
+			ok = playFrame(&primeFrames[i]);
+		}
+		while(ok && !stopping && decoder->decode(dec, &pcm)) {
+			ok = playFrame(&pcm);
+		}
+	}
+	if(stopping) {
+		// playerStop() may have got in before audioStart()
+		audioStop();
+	}
+	else {
+		audioDrain();
+		resolveGap();
+	}
+}
+
+static void* playerThreadMain(void *arg) {
+	LWP_MutexLock(playerMutex);
+	while(1) {
+		if(!wanted) {
+			LWP_CondWait(playerCond, playerMutex);
+			continue;
+		}
+		wanted = 0;
+		int prime = wantedPrime;
+		LWP_MutexUnlock(playerMutex);
+		playStream(prime);
+		LWP_MutexLock(playerMutex);
+		running = 0;
+		LWP_CondBroadcast(playerCond);
+	}
+	LWP_MutexUnlock(playerMutex);
+	return NULL;
+}
+
+static void startThread(int prime) {
+	LWP_MutexLock(playerMutex);
+	wanted = 1;
+	wantedPrime = prime;
+	released = 0;
+	running = 1;
+	LWP_CondBroadcast(playerCond);
+	LWP_MutexUnlock(playerMutex);
+}
+
+void playerInit() {
+	streamInit();
+	audioInit();
+	decoder = decoderGet(decoderBackend);
+	print_gecko("Decoder: %s\r\n", decoder->name);
+	LWP_MutexInit(&playerMutex, false);
+	LWP_CondInit(&playerCond);
+	LWP_CreateThread(&playerThread, playerThreadMain, NULL, NULL, PLAYER_STACK_SIZE, PLAYER_PRIORITY);
+}
+
+// Stops whatever is playing and starts on file straight away, takes ownership of file.
+int playerPlay(FILE *file) {
+	return playerPlayFrom(file, 0);
+}
+
+// Same again but from offset bytes into file.
+int playerPlayFrom(FILE *file, u32 offset) {
+	u64 profileStart = profileBegin();
+	u64 ended = endedTime;
+	playerStop();
+	streamStart(file, offset);
+	restartFrom = ended;
+	position = offset;
+	wasPlaying = 1;
+	startThread(0);
+	profileEnd(PROF_PLAYER_START, profileStart);
+	return 0;
+}
+
+// Gets file read into memory and its first frames decoded without any sound, so
+// playerStartPrimed() can have sound out straight away. Stops anything playing, takes
+// ownership of file.
+void playerPrime(FILE *file) {
+	playerStop();
+	streamStart(file, 0);
+	primed = 1;
+	startThread(1);
+}
+
+// Whether a primed file is still waiting, anything else played or stopped in the meantime drops it.
+int playerIsPrimed() {
+	return primed;
+}
+
+int playerStartPrimed() {
+	if(!primed) {
+		return -1;
+	}
+	u64 profileStart = profileBegin();
+	primed = 0;
+	restartFrom = 0;
+	position = 0;
+	wasPlaying = 1;
+	LWP_MutexLock(playerMutex);
+	released = 1;
+	LWP_CondBroadcast(playerCond);
+	LWP_MutexUnlock(playerMutex);
+	profileEnd(PROF_PLAYER_START, profileStart);
+	return 0;
+}
+
+// Logs how long after from the next track started decoding.
+void playerMeasureLatency(u64 from) {
+	firstFrameTime = 0;
+	latencyFrom = from;
+}
+
+// Opens file ahead of time so playback can run straight into it, takes ownership of file.
+void playerQueueNext(FILE *file) {
+	streamQueue(file);
+}
+
+int playerHasQueued() {
+	return streamHasQueued();
+}
+
+// True once for every time playback moved on into the queued track.
+int playerTrackChanged() {
+	int changed = 0;
+	LWP_MutexLock(playerMutex);
+	if(trackChanges) {
+		trackChanges--;
+		changed = 1;
+	}
+	LWP_MutexUnlock(playerMutex);
+	return changed;
+}
+
+void playerStop() {
+	LWP_MutexLock(playerMutex);
+	stopping = 1;
+	// Lets go of a primed start
+	LWP_CondBroadcast(playerCond);
+	LWP_MutexUnlock(playerMutex);
+	// Unblocks the player's thread if it's waiting on the stream or the output
+	streamStop();
+	audioStop();
+	LWP_MutexLock(playerMutex);
+	if(wanted) {
+		// Never got going
+		wanted = 0;
+		running = 0;
+	}
+	while(running) {
+		LWP_CondWait(playerCond, playerMutex);
+	}
+	stopping = 0;
+	trackChanges = 0;
+	LWP_MutexUnlock(playerMutex);
+	wasPlaying = 0;
+	endedTime = 0;
+	primed = 0;
+}
+
+int playerIsPlaying() {
+	// A primed track's only holding its first frames
+	int playing = running && !primed;
+	if(latencyFrom && firstFrameTime) {
+		print_gecko("First audio %u us after it was wanted\r\n", (u32)ticks_to_microsecs(diff_ticks(latencyFrom, firstFrameTime)));
+		latencyFrom = 0;
+	}
+	if(wasPlaying && !playing) {
+		endedTime = gettime();
+		wasPlaying = 0;
+	}
+	return playing;
+}
+
+// Byte offset into the track that's playing, near enough to start it again from.
+u32 playerPosition() {
+	return position;
+}
+
+void playerVolume(u32 volume) {
+	audioVolume(volume);
+}
+
+// Silence between the last two tracks, in output samples.
+u32 playerLastGapSamples() {
+	return lastGapSamples;
+}
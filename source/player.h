@@ -0,0 +1,25 @@
+#ifndef __PLAYER_H__
+#define __PLAYER_H__
+
+#include <gccore.h>
+#include <stdio.h>
+
+#define PLAYER_PRIME_FRAMES 8			// decoded ahead by playerPrime(), about 200ms at 44.1kHz
+
+void playerInit();
+int playerPlay(FILE *file);
+int playerPlayFrom(FILE *file, u32 offset);
+void playerPrime(FILE *file);
+int playerIsPrimed();
+int playerStartPrimed();
+void playerMeasureLatency(u64 from);
+void playerQueueNext(FILE *file);
+int playerHasQueued();
+int playerTrackChanged();
+void playerStop();
+int playerIsPlaying();
+u32 playerPosition();
+void playerVolume(u32 volume);
+u32 playerLastGapSamples();
+
+#endif
@@ -0,0 +1,99 @@
+/*===========================================
+        WakeMii - Playlist navigation
+
+        Moving between tracks and albums of the library, wrapping around
+        at either end, and numbering every track in the library back to
+        back for the things that pick from all of it.
+============================================*/
+#include <stdlib.h>
+#include "playlist.h"
+#include "library.h"
+
+// Sequential movement amongst entries, potentially moving into other albums
+void stepEntry(int change_entry, int *albumNum, int *trackNum) {
+	if(*trackNum + change_entry < 0 || *trackNum + change_entry > albumNumEntries(*albumNum)-1) {
+		// Go to the next/prev album cause we've reached the end of this one
+		if(*albumNum + change_entry < 0) {
+			*albumNum = num_albums-1;
+		}
+		else if (*albumNum + change_entry > num_albums-1) {
+			*albumNum = 0;
+		}
+		else {
+			*albumNum += change_entry;
+		}
+		// Enter the album at the start or end depending which direction we're going.
+		if(change_entry < 0) *trackNum = albumNumEntries(*albumNum)-1;
+		else *trackNum = 0;
+	}
+	else {
+		*trackNum += change_entry;
+	}
+}
+
+// Sequential movement amongst albums, always going to the first entry in the destination album
+void stepAlbum(int change_album, int *albumNum, int *trackNum) {
+	if(*albumNum + change_album < 0) {
+		*albumNum = num_albums-1;
+	}
+	else if (*albumNum + change_album > num_albums-1) {
+		*albumNum = 0;
+	}
+	else {
+		*albumNum += change_album;
+	}
+	// Enter the album at the start
+	*trackNum = 0;
+}
+
+static u32 *albumStart;			// global number of each album's first track, num_albums+1 entries
+static int num_mappedAlbums;
+static int mappedTracks;		// num_tracks when albumStart was built
+static u32 mapGeneration;
+
+// (Re)numbers the tracks if the library has changed, returns how many there are. If
+// generation is given it gets bumped whenever the numbering changes.
+u32 playlistMapTracks(int *numAlbums, u32 *generation) {
+	int albumCount = num_albums;
+	if(albumCount != num_mappedAlbums || num_tracks != mappedTracks || !albumStart) {
+		u32 *starts = realloc(albumStart, (albumCount + 1) * sizeof(u32));
+		if(!starts) {
+			return 0;
+		}
+		albumStart = starts;
+		albumStart[0] = 0;
+		for(int i = 0; i < albumCount; i++) {
+			albumStart[i+1] = albumStart[i] + albumNumEntries(i);
+		}
+		num_mappedAlbums = albumCount;
+		mappedTracks = num_tracks;
+		mapGeneration++;
+	}
+	if(numAlbums) {
+		*numAlbums = num_mappedAlbums;
+	}
+	if(generation) {
+		*generation = mapGeneration;
+	}
+	return albumStart[num_mappedAlbums];
+}
+
+void playlistGlobalToEntry(u32 global, int *albumNum, int *trackNum) {
+	// Last album starting at or before global
+	int lo = 0, hi = num_mappedAlbums - 1;
+	while(lo < hi) {
+		int mid = (lo + hi + 1) / 2;
+		if(albumStart[mid] <= global) {
+			lo = mid;
+		}
+		else {
+			hi = mid - 1;
+		}
+	}
+	*albumNum = lo;
+	*trackNum = global - albumStart[lo];
+}
+
+u32 playlistEntryToGlobal(int albumNum, int trackNum) {
+	return albumStart[albumNum] + trackNum;
+}
@@ -0,0 +1,12 @@
+#ifndef __PLAYLIST_H__
+#define __PLAYLIST_H__
+
+#include <gccore.h>
+
+void stepEntry(int change_entry, int *albumNum, int *trackNum);
+void stepAlbum(int change_album, int *albumNum, int *trackNum);
+u32 playlistMapTracks(int *numAlbums, u32 *generation);
+void playlistGlobalToEntry(u32 global, int *albumNum, int *trackNum);
+u32 playlistEntryToGlobal(int albumNum, int trackNum);
+
+#endif
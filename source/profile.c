@@ -0,0 +1,173 @@
+/*===========================================
+        WakeMii - Profiler
+
+        Scoped timers around the slow paths. Each section keeps its total
+        for every one of the last PROFILE_HISTORY frames (for the graph)
+        and its last PROFILE_HISTORY timings (for p50/p99/max). Toggled
+        with the cancel button, the overlay shows both and while it's up
+        every frame's totals also go out over USB Gecko as binary records:
+
+          u8 0xFF, u8 'P', u8 version, u8 sections,
+          u32 frame, u32 microseconds[sections]   (big endian)
+
+        0xFF never turns up in the text print_gecko sends, so the records
+        can be picked out of the log. They're queued with the log lines and
+        sent in its batches.
+============================================*/
+#include <gccore.h>
+#include <grrlib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ogc/lwp_watchdog.h>
+#include "profile.h"
+#include "text.h"
+#include "gecko.h"
+
+#define PROFILE_RECORD_VERSION 1
+#define PROFILE_GRAPH_H 120
+#define PROFILE_US_PER_PIXEL 250		// 60fps is the line at 67 pixels
+
+#define PROFILE_RECORD_SIZE (8 + 4 * PROF_NUM_SECTIONS)
+
+static const char *sectionNames[PROF_NUM_SECTIONS] = {"Frame", "Draw", "Render", "Open", "Play", "Cover"};
+static const u32 sectionColours[PROF_NUM_SECTIONS] = {0x808080FF, 0x00C000FF, 0x4060FFFF, 0xFF4040FF, 0xFFFF00FF, 0xFF00FFFF};
+// Stacked up the graph bottom to top, whatever's left of the frame goes on top in the frame colour
+static const enum profile_section stacked[] = {PROF_DRAW, PROF_RENDER, PROF_ENTRY_OPEN, PROF_PLAYER_START};
+#define NUM_STACKED (sizeof(stacked) / sizeof(stacked[0]))
+
+static mutex_t profileMutex;
+static u32 frameTotals[PROF_NUM_SECTIONS];					// this frame so far
+static u32 frameHistory[PROF_NUM_SECTIONS][PROFILE_HISTORY];
+static u32 samples[PROF_NUM_SECTIONS][PROFILE_HISTORY];
+static u32 numSamples[PROF_NUM_SECTIONS];
+static u32 frameCount;
+static u64 lastFrameEnd;
+static int shown;
+
+static void putBE32(u8 *p, u32 v) {
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+void profileInit() {
+	LWP_MutexInit(&profileMutex, false);
+	lastFrameEnd = gettime();
+}
+
+u64 profileBegin() {
+	return gettime();
+}
+
+// Adds the time since start to section, from any thread.
+void profileEnd(enum profile_section section, u64 start) {
+	u32 us = ticks_to_microsecs(diff_ticks(start, gettime()));
+	LWP_MutexLock(profileMutex);
+	frameTotals[section] += us;
+	samples[section][numSamples[section]++ & (PROFILE_HISTORY-1)] = us;
+	LWP_MutexUnlock(profileMutex);
+}
+
+// Call once a loop, the frame time is the time since the last call.
+void profileFrameEnd() {
+	u64 now = gettime();
+	profileEnd(PROF_FRAME, lastFrameEnd);
+	lastFrameEnd = now;
+
+	LWP_MutexLock(profileMutex);
+	u32 slot = frameCount & (PROFILE_HISTORY-1);
+	for(int i = 0; i < PROF_NUM_SECTIONS; i++) {
+		frameHistory[i][slot] = frameTotals[i];
+	}
+	u8 rec[PROFILE_RECORD_SIZE];
+	if(shown) {
+		rec[0] = 0xFF;
+		rec[1] = 'P';
+		rec[2] = PROFILE_RECORD_VERSION;
+		rec[3] = PROF_NUM_SECTIONS;
+		putBE32(rec + 4, frameCount);
+		for(int i = 0; i < PROF_NUM_SECTIONS; i++) {
+			putBE32(rec + 8 + i * 4, frameTotals[i]);
+		}
+	}
+	memset(frameTotals, 0, sizeof(frameTotals));
+	frameCount++;
+	LWP_MutexUnlock(profileMutex);
+
+	if(shown) {
+		send_gecko(rec, sizeof(rec));
+	}
+}
+
+void profileToggle() {
+	shown ^= 1;
+}
+
+int profileShown() {
+	return shown;
+}
+
+static int compareU32(const void *a, const void *b) {
+	u32 x = *(const u32*)a;
+	u32 y = *(const u32*)b;
+	return x < y ? -1 : x > y;
+}
+
+static void percentiles(enum profile_section section, u32 *p50, u32 *p99, u32 *max) {
+	u32 sorted[PROFILE_HISTORY];
+	LWP_MutexLock(profileMutex);
+	u32 n = MIN(numSamples[section], PROFILE_HISTORY);
+	memcpy(sorted, samples[section], n * sizeof(u32));
+	LWP_MutexUnlock(profileMutex);
+	if(!n) {
+		*p50 = *p99 = *max = 0;
+		return;
+	}
+	qsort(sorted, n, sizeof(u32), compareU32);
+	*p50 = sorted[(n - 1) / 2];
+	*p99 = sorted[((n - 1) * 99) / 100];
+	*max = sorted[n - 1];
+}
+
+// Frame time graph with the sections stacked up in it and the percentiles beside it.
+// Call with nothing left queued for textFlush(), it queues its own text.
+void profileDrawOverlay(f32 x, f32 y, GRRLIB_texImg *font) {
+	if(!shown) {
+		return;
+	}
+	GRRLIB_Rectangle(x - 8, y - 8, PROFILE_HISTORY + 16, PROFILE_GRAPH_H + 16 + 18 * (PROF_NUM_SECTIONS + 1), 0x000000C0, true);
+	u32 n = MIN(frameCount, PROFILE_HISTORY);
+	if(n) {
+		GX_Begin(GX_LINES, GX_VTXFMT0, n * (NUM_STACKED + 1) * 2);
+		for(u32 i = 0; i < n; i++) {
+			u32 slot = (frameCount - n + i) & (PROFILE_HISTORY-1);
+			f32 px = x + (PROFILE_HISTORY - n) + i + 0.5f;
+			f32 base = y + PROFILE_GRAPH_H;
+			u32 rest = frameHistory[PROF_FRAME][slot];
+			for(int s = 0; s <= NUM_STACKED; s++) {
+				enum profile_section section = s < NUM_STACKED ? stacked[s] : PROF_FRAME;
+				u32 us = s < NUM_STACKED ? MIN(frameHistory[section][slot], rest) : rest;
+				rest -= us;
+				f32 top = MAX(base - (f32)us / PROFILE_US_PER_PIXEL, y);
+				GX_Position3f32(px, base, 0);
+				GX_Color1u32(sectionColours[section]);
+				GX_Position3f32(px, top, 0);
+				GX_Color1u32(sectionColours[section]);
+				base = top;
+			}
+		}
+		GX_End();
+	}
+	f32 frameLine = y + PROFILE_GRAPH_H - 16667.0f / PROFILE_US_PER_PIXEL;
+	GRRLIB_Line(x, frameLine, x + PROFILE_HISTORY, frameLine, 0xFFFFFF80);
+
+	f32 textY = y + PROFILE_GRAPH_H + 8;
+	textPrintf(x, textY, font, 0xFFFFFFFF, 1, "ms      p50    p99    max");
+	for(int i = 0; i < PROF_NUM_SECTIONS; i++) {
+		u32 p50, p99, max;
+		percentiles(i, &p50, &p99, &max);
+		textY += 18;
+		textPrintf(x, textY, font, sectionColours[i], 1, "%-6s %6.2f %6.2f %6.2f", sectionNames[i], p50 / 1000.0f, p99 / 1000.0f, max / 1000.0f);
+	}
+}
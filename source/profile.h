@@ -0,0 +1,27 @@
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include <gccore.h>
+#include <grrlib.h>
+
+enum profile_section {
+	PROF_FRAME,			// once round the main loop
+	PROF_DRAW,			// building a frame that needed drawing
+	PROF_RENDER,		// GRRLIB_Render
+	PROF_ENTRY_OPEN,	// getEntryFromIndex
+	PROF_PLAYER_START,	// starting the decoder on a track
+	PROF_COVER_LOAD,	// decoding a cover, on the cover thread
+	PROF_NUM_SECTIONS
+};
+
+#define PROFILE_HISTORY 256		// frames / samples kept per section, must be a power of two
+
+void profileInit();
+u64 profileBegin();
+void profileEnd(enum profile_section section, u64 start);
+void profileFrameEnd();
+void profileToggle();
+int profileShown();
+void profileDrawOverlay(f32 x, f32 y, GRRLIB_texImg *font);
+
+#endif
@@ -0,0 +1,311 @@
+/*===========================================
+        WakeMii - Resume
+
+        Remembers what was playing and how far into it, so booting again
+        (after a shutdown after alarm or the power going) carries on from
+        there rather than with a random pick. resume.dat is a journal of
+        RESUME_SLOTS sector sized slots written round in turn, so the same
+        sector isn't rewritten every save and a save cut short only loses
+        itself: loading takes the newest slot whose checksum is good.
+
+        Saves are written by a worker thread, the main thread only hands
+        it the record. The file's made full size up front and kept open,
+        so a write never changes its size, but libfat rewrites the
+        directory entry (the mtime) on every sync whatever was written,
+        so syncs are kept down to one per RESUME_SYNC_SECS. A burst of
+        track changes only writes the newest, a stop or start is synced
+        straight away.
+
+        Albums and tracks are kept by name hash, their numbers are only a
+        hint in case the library changed in between.
+============================================*/
+#include <gccore.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <ogc/lwp_watchdog.h>
+#include "resume.h"
+#include "library.h"
+#include "gecko.h"
+
+#define RESUME_MAGIC 0x574D5253	// "WMRS"
+#define RESUME_VERSION 1
+#define RESUME_WORKER_PRIORITY 25
+#define RESUME_WORKER_STACK_SIZE (16*1024)
+
+struct resume_record {
+	u32 magic;
+	u16 version;
+	u16 volume;
+	u32 seq;				// newest wins, wraps
+	u32 album_key;
+	u32 track_key;
+	s32 album_num;
+	s32 track_num;
+	u32 offset;				// byte offset into the track
+	u32 playing;
+	u32 checksum;			// of everything before it
+};
+
+static struct resume_record saved;		// newest at boot
+static int savedValid;
+static int toResume;					// saved hasn't been found or given up on yet
+
+// Only the main thread touches these
+static struct resume_record current;	// as last saved
+static int changed;
+static u64 lastSave;
+
+// Only the worker touches these, once it's started
+static int nextSlot;
+static FILE *resumeFile;				// open from the first save on
+
+// Shared with the worker
+static mutex_t resumeMutex;
+static cond_t resumeCond;
+static lwp_t resumeThread = LWP_THREAD_NULL;
+static struct resume_record pending;	// the newest record not written yet
+static int pendingValid;
+static int syncWanted;					// sync as soon as it's written
+static u32 doneSeq;						// the newest record that's been written and synced
+
+static u32 hashName(u32 hash, const char *name) {
+	while(name && *name) {
+		hash ^= (u8)*name++;	// FNV-1a
+		hash *= 0x01000193;
+	}
+	return hash;
+}
+
+static u32 recordChecksum(struct resume_record *rec) {
+	u32 hash = 0x811C9DC5;
+	u8 *bytes = (u8*)rec;
+	for(int i = 0; i < offsetof(struct resume_record, checksum); i++) {
+		hash ^= bytes[i];
+		hash *= 0x01000193;
+	}
+	return hash;
+}
+
+// Writes rec to the next slot, leaving it in libfat's cache until the file's synced.
+static int writeSlot(struct resume_record *rec) {
+	u8 slot[RESUME_SLOT_SIZE];
+	memset(slot, 0, RESUME_SLOT_SIZE);
+	if(!resumeFile) {
+		resumeFile = fopen(RESUME_FILE, "r+b");
+	}
+	if(!resumeFile) {
+		// Made full size up front, every slot is then written in place
+		resumeFile = fopen(RESUME_FILE, "w+b");
+		for(int i = 0; resumeFile && i < RESUME_SLOTS; i++) {
+			fwrite(slot, 1, RESUME_SLOT_SIZE, resumeFile);
+		}
+		nextSlot = 0;
+	}
+	if(!resumeFile) {
+		error_gecko("resume.dat failed to create\r\n");
+		return 0;
+	}
+	memcpy(slot, rec, sizeof(struct resume_record));
+	if(fseek(resumeFile, nextSlot * RESUME_SLOT_SIZE, SEEK_SET) || fwrite(slot, 1, RESUME_SLOT_SIZE, resumeFile) != RESUME_SLOT_SIZE
+		|| fflush(resumeFile)) {
+		error_gecko("resume.dat failed to write\r\n");
+		fclose(resumeFile);
+		resumeFile = NULL;
+		return 0;
+	}
+	nextSlot = (nextSlot + 1) % RESUME_SLOTS;
+	return 1;
+}
+
+static void syncFile() {
+	if(resumeFile && fsync(fileno(resumeFile))) {
+		error_gecko("resume.dat failed to sync\r\n");
+		fclose(resumeFile);
+		resumeFile = NULL;
+	}
+}
+
+// Writes whatever's newest when it's woken, and syncs once RESUME_SYNC_SECS have
+// gone since the last sync, or straight away if it's asked to.
+static void* resumeWorker(void *arg) {
+	struct resume_record rec;
+	u32 writtenSeq = 0;
+	int unsynced = 0;
+	u64 lastSync = gettime();
+	LWP_MutexLock(resumeMutex);
+	while(1) {
+		if(!pendingValid) {
+			if(!unsynced) {
+				LWP_CondWait(resumeCond, resumeMutex);
+				continue;
+			}
+			u32 waited = diff_msec(lastSync, gettime());
+			if(waited < RESUME_SYNC_SECS * 1000 && !syncWanted) {
+				u32 left = RESUME_SYNC_SECS * 1000 - waited;
+				struct timespec timeout;
+				timeout.tv_sec = left / 1000;
+				timeout.tv_nsec = (left % 1000) * 1000000;
+				LWP_CondTimedWait(resumeCond, resumeMutex, &timeout);
+				continue;
+			}
+		}
+		int have = pendingValid;
+		int urgent = syncWanted;
+		rec = pending;
+		pendingValid = 0;
+		syncWanted = 0;
+		LWP_MutexUnlock(resumeMutex);
+
+		if(have) {
+			writtenSeq = rec.seq;
+			unsynced |= writeSlot(&rec);
+		}
+		if(unsynced && (urgent || diff_sec(lastSync, gettime()) >= RESUME_SYNC_SECS)) {
+			syncFile();
+			unsynced = 0;
+			lastSync = gettime();
+		}
+
+		LWP_MutexLock(resumeMutex);
+		if(!unsynced) {
+			doneSeq = writtenSeq;
+		}
+		LWP_CondBroadcast(resumeCond);
+	}
+	return NULL;
+}
+
+void resumeInit() {
+	lastSave = gettime();
+	current.album_num = -1;
+	if(resumeThread == LWP_THREAD_NULL) {
+		LWP_MutexInit(&resumeMutex, false);
+		LWP_CondInit(&resumeCond);
+		LWP_CreateThread(&resumeThread, resumeWorker, NULL, NULL, RESUME_WORKER_STACK_SIZE, RESUME_WORKER_PRIORITY);
+	}
+	FILE *fp = fopen(RESUME_FILE, "rb");
+	if(!fp) {
+		return;
+	}
+	struct resume_record rec;
+	for(int i = 0; i < RESUME_SLOTS; i++) {
+		if(fseek(fp, i * RESUME_SLOT_SIZE, SEEK_SET) || fread(&rec, 1, sizeof(rec), fp) != sizeof(rec)) {
+			break;
+		}
+		if(rec.magic != RESUME_MAGIC || rec.version != RESUME_VERSION || rec.checksum != recordChecksum(&rec)) {
+			continue;
+		}
+		if(!savedValid || (s32)(rec.seq - saved.seq) > 0) {
+			saved = rec;
+			savedValid = 1;
+			nextSlot = (i + 1) % RESUME_SLOTS;
+		}
+	}
+	fclose(fp);
+	if(savedValid) {
+		current.seq = saved.seq;
+		doneSeq = saved.seq;
+		toResume = saved.playing;
+		print_gecko("Resume state %u: album %i track %i at %u\r\n", saved.seq, saved.album_num, saved.track_num, saved.offset);
+	}
+}
+
+// The volume as it was last saved, 0 if there isn't one.
+int resumeVolume(int *volume) {
+	if(savedValid) {
+		*volume = saved.volume;
+	}
+	return savedValid;
+}
+
+// Where to carry on from, if it was playing when last saved. RESUME_WAIT until the
+// scanner's got as far as the album, RESUME_NONE once it's been found or it's gone.
+int resumeFind(int *albumNum, int *trackNum, u32 *offset) {
+	if(!toResume) {
+		return RESUME_NONE;
+	}
+	int album = saved.album_num;
+	if(album < 0 || album >= num_albums || hashName(0x811C9DC5, albumName(album)) != saved.album_key) {
+		if(libraryScanState == LIBRARY_SCANNING) {
+			return RESUME_WAIT;
+		}
+		// The library changed since, look for it by name
+		for(album = 0; album < num_albums && hashName(0x811C9DC5, albumName(album)) != saved.album_key; album++);
+	}
+	toResume = 0;
+	if(album == num_albums) {
+		print_gecko("The album to resume has gone\r\n");
+		return RESUME_NONE;
+	}
+	int track = saved.track_num;
+	int numTracks = albumNumEntries(album);
+	if(track < 0 || track >= numTracks || hashName(0x811C9DC5, albumTrackName(album, track)) != saved.track_key) {
+		for(track = 0; track < numTracks && hashName(0x811C9DC5, albumTrackName(album, track)) != saved.track_key; track++);
+		if(track == numTracks) {
+			print_gecko("The track to resume has gone\r\n");
+			return RESUME_NONE;
+		}
+	}
+	*albumNum = album;
+	*trackNum = track;
+	*offset = saved.offset;
+	return RESUME_FOUND;
+}
+
+// Hands current to the worker to be saved, replacing anything it hasn't got to yet.
+static void saveRecord(int urgent) {
+	current.magic = RESUME_MAGIC;
+	current.version = RESUME_VERSION;
+	current.seq++;
+	current.album_key = hashName(0x811C9DC5, albumName(current.album_num));
+	current.track_key = hashName(0x811C9DC5, albumTrackName(current.album_num, current.track_num));
+	current.checksum = recordChecksum(&current);
+	changed = 0;
+	lastSave = gettime();
+
+	LWP_MutexLock(resumeMutex);
+	pending = current;
+	pendingValid = 1;
+	syncWanted |= urgent;
+	LWP_CondBroadcast(resumeCond);
+	LWP_MutexUnlock(resumeMutex);
+}
+
+// Call every frame with what's playing, it's only written when it's worth it.
+void resumeUpdate(int albumNum, int trackNum, u32 offset, int volume, int playing) {
+	if(albumNum < 0 || albumNum >= num_albums) {
+		return;
+	}
+	int moved = albumNum != current.album_num || trackNum != current.track_num;
+	int stopped = playing != current.playing;	// or started
+	if(moved || stopped || offset != current.offset || volume != current.volume) {
+		current.album_num = albumNum;
+		current.track_num = trackNum;
+		current.offset = offset;
+		current.volume = volume;
+		current.playing = playing;
+		changed = 1;
+	}
+	if(changed && (moved || stopped || diff_sec(lastSave, gettime()) >= RESUME_SAVE_SECS)) {
+		saveRecord(stopped);
+	}
+}
+
+// Saves and syncs anything not on the card yet and waits for it, for before powering
+// off or exiting.
+void resumeFlush() {
+	if(changed) {
+		saveRecord(1);
+	}
+	LWP_MutexLock(resumeMutex);
+	if(doneSeq != current.seq) {
+		syncWanted = 1;
+		LWP_CondBroadcast(resumeCond);
+		while(doneSeq != current.seq) {
+			LWP_CondWait(resumeCond, resumeMutex);
+		}
+	}
+	LWP_MutexUnlock(resumeMutex);
+}
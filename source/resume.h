@@ -0,0 +1,27 @@
+#ifndef __RESUME_H__
+#define __RESUME_H__
+
+#include <gccore.h>
+#include "paths.h"
+
+#define RESUME_FILE WAKEMII_DIR "/resume.dat"
+
+// The file is RESUME_SLOTS sector sized slots, each save goes in the next one round
+#define RESUME_SLOTS 16
+#define RESUME_SLOT_SIZE 512
+// While playing the position is saved this often, a track change, stop or start is saved straight away
+#define RESUME_SAVE_SECS 30
+// Saves are synced to the card at most this often, except a stop or start
+#define RESUME_SYNC_SECS 5
+
+#define RESUME_NONE 0
+#define RESUME_FOUND 1
+#define RESUME_WAIT 2
+
+void resumeInit();
+int resumeVolume(int *volume);
+int resumeFind(int *albumNum, int *trackNum, u32 *offset);
+void resumeUpdate(int albumNum, int trackNum, u32 offset, int volume, int playing);
+void resumeFlush();
+
+#endif
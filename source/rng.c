@@ -0,0 +1,49 @@
+/*===========================================
+        WakeMii - Random numbers
+
+        A small seedable generator so shuffles can be replayed from their
+        seed, rand() gives no such guarantee.
+============================================*/
+#include <gccore.h>
+#include "rng.h"
+
+static u32 rotl(u32 x, int k) {
+	return (x << k) | (x >> (32 - k));
+}
+
+// The state is filled from the seed with splitmix32 so any seed, even 0, is fine
+void rngSeed(struct rng_state *rng, u32 seed) {
+	for(int i = 0; i < 4; i++) {
+		u32 z = (seed += 0x9E3779B9);
+		z = (z ^ (z >> 16)) * 0x85EBCA6B;
+		z = (z ^ (z >> 13)) * 0xC2B2AE35;
+		rng->s[i] = z ^ (z >> 16);
+	}
+}
+
+u32 rngNext(struct rng_state *rng) {
+	u32 *s = rng->s;
+	u32 result = rotl(s[1] * 5, 7) * 9;
+	u32 t = s[1] << 9;
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl(s[3], 11);
+	return result;
+}
+
+// Uniform in [0, range) without the bias of a plain modulo (Lemire's method)
+u32 rngBounded(struct rng_state *rng, u32 range) {
+	u64 m = (u64)rngNext(rng) * range;
+	u32 low = (u32)m;
+	if(low < range) {
+		u32 threshold = -range % range;
+		while(low < threshold) {
+			m = (u64)rngNext(rng) * range;
+			low = (u32)m;
+		}
+	}
+	return m >> 32;
+}
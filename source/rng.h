@@ -0,0 +1,15 @@
+#ifndef __RNG_H__
+#define __RNG_H__
+
+#include <gccore.h>
+
+// xoshiro128**, 32-bit all the way through which suits the Broadway/Gekko
+struct rng_state {
+	u32 s[4];
+};
+
+void rngSeed(struct rng_state *rng, u32 seed);
+u32 rngNext(struct rng_state *rng);
+u32 rngBounded(struct rng_state *rng, u32 range);
+
+#endif
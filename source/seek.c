@@ -0,0 +1,533 @@
+/*===========================================
+        WakeMii - Seeking
+
+        Turns a time in a track into the byte offset of the frame that
+        plays then, and back again. A Xing/Info or VBRI header in the first
+        frame gives a table of contents straight away. Without one, the
+        track gets a sparse index instead, the offset of every
+        SEEK_INDEX_FRAMES-th frame, built by hopping from frame header to
+        frame header without decoding anything. It's kept in the cache dir
+        next to the covers, so each track is only ever indexed once.
+
+        Seeking is a lookup plus one read to land on the exact frame, going
+        from an offset back to a time is a binary search. Only the track
+        being played is held in memory.
+
+        The index is loaded or built on a worker thread as soon as a track
+        starts, so the first seek doesn't hold up a frame. The worker keeps
+        its own handle on the track open for the reads seeking needs, the
+        main thread only looks at any of it once seekReady() says so.
+============================================*/
+#include <gccore.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <ogc/lwp_watchdog.h>
+#include "seek.h"
+#include "library.h"
+#include "coverload.h"
+#include "gecko.h"
+
+#define SEEK_CACHE_MAGIC 0x574D534B	// "WMSK"
+#define SEEK_CACHE_VERSION 1
+#define SEEK_MAX_FRAME 1441				// MPEG1 layer III, 320kbps at 32kHz with padding
+#define NO_TRACK -2
+#define SEEK_WORKER_PRIORITY 25
+#define SEEK_WORKER_STACK_SIZE (16*1024)
+
+enum seek_mode {
+	SEEK_NONE,
+	SEEK_INDEX,		// offsets[] every frames_per_entry frames, built or from VBRI
+	SEEK_TOC		// Xing's 100 entry table
+};
+
+struct frame_header {
+	u32 length;
+	u32 sample_rate;
+	u32 samples;
+	u32 side_info;	// bytes between the header and a Xing tag
+	u32 match;		// version, layer and sample rate, the same for every frame in a track
+};
+
+// Also the header of the cached index, the offsets follow it
+struct seek_info {
+	u32 magic;
+	u32 version;
+	u32 src_size;
+	u32 src_mtime;
+	u32 first_frame;
+	u32 end;
+	u32 num_frames;
+	u32 sample_rate;
+	u32 match;
+	u16 samples_per_frame;
+	u16 frames_per_entry;
+	u32 num_entries;
+};
+
+// Shared with the worker, only the main thread changes what's wanted
+static mutex_t seekMutex;
+static cond_t seekCond;
+static lwp_t seekThread = LWP_THREAD_NULL;
+static int wantedAlbum = NO_TRACK;
+static int wantedTrack;
+static int prepared;				// the worker's done with the wanted track
+
+// The worker's until prepared, then the main thread's until it wants another track
+static FILE *seekFile;
+static enum seek_mode mode;
+static struct seek_info info;
+static u32 *offsets;
+static u32 offsetsSize;
+static u8 toc[100];
+static u32 tocBase;
+static u32 tocBytes;
+
+static u8 readBuf[SEEK_READ_SIZE];
+static u32 readPos;
+static u32 readLen;
+
+static const u16 bitratesMpeg1[16] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0};
+static const u16 bitratesMpeg2[16] = {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0};
+static const u16 sampleRates[4] = {44100, 48000, 32000, 0};
+
+static u32 be32(const u8 *p) {
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static u32 be16(const u8 *p) {
+	return (p[0] << 8) | p[1];
+}
+
+// Layer III only, returns 0 if h isn't a frame header.
+static int parseHeader(const u8 *h, struct frame_header *fh) {
+	if(h[0] != 0xFF || (h[1] & 0xE0) != 0xE0) {
+		return 0;
+	}
+	int version = (h[1] >> 3) & 3;		// 0 MPEG2.5, 2 MPEG2, 3 MPEG1
+	int layer = (h[1] >> 1) & 3;		// 1 is layer III
+	int bitrate = h[2] >> 4;
+	int rate = (h[2] >> 2) & 3;
+	if(version == 1 || layer != 1 || bitrate == 0 || bitrate == 15 || rate == 3) {
+		return 0;
+	}
+	int mpeg1 = version == 3;
+	int mono = (h[3] >> 6) == 3;
+	u32 kbps = mpeg1 ? bitratesMpeg1[bitrate] : bitratesMpeg2[bitrate];
+	fh->sample_rate = sampleRates[rate] >> (mpeg1 ? 0 : version == 2 ? 1 : 2);
+	fh->samples = mpeg1 ? 1152 : 576;
+	fh->length = (mpeg1 ? 144000 : 72000) * kbps / fh->sample_rate + ((h[2] >> 1) & 1);
+	fh->side_info = mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+	fh->match = ((h[1] & 0x1E) << 8) | (h[2] & 0x0C);
+	return 1;
+}
+
+// Bytes pos..pos+len of file, reading SEEK_READ_SIZE from pos if they aren't in already.
+static const u8* peek(FILE *file, u32 pos, u32 len) {
+	if(pos < readPos || pos + len > readPos + readLen) {
+		readPos = pos;
+		readLen = 0;
+		if(fseek(file, pos, SEEK_SET) == 0) {
+			readLen = fread(readBuf, 1, SEEK_READ_SIZE, file);
+		}
+		if(len > readLen) {
+			return NULL;
+		}
+	}
+	return readBuf + (pos - readPos);
+}
+
+// First frame at or after pos that's followed by another like it (or the end), end if there isn't one.
+static u32 findFrame(FILE *file, u32 pos, u32 end, u32 match, struct frame_header *fh) {
+	for(; pos + 4 <= end; pos++) {
+		u32 avail = MIN(end - pos, SEEK_MAX_FRAME + 4);
+		const u8 *h = peek(file, pos, avail);
+		if(!h) {
+			break;
+		}
+		if(!parseHeader(h, fh) || (match && fh->match != match)) {
+			continue;
+		}
+		struct frame_header next;
+		if(fh->length + 4 > avail || (parseHeader(h + fh->length, &next) && next.match == fh->match)) {
+			return pos;
+		}
+	}
+	return end;
+}
+
+static u32 framesToMs(u32 frames) {
+	return (u64)frames * info.samples_per_frame * 1000 / info.sample_rate;
+}
+
+static int growOffsets(u32 size) {
+	if(size <= offsetsSize) {
+		return 1;
+	}
+	u32 newSize = MAX(size, offsetsSize ? offsetsSize * 2 : 1024);
+	u32 *newOffsets = realloc(offsets, newSize * sizeof(u32));
+	if(!newOffsets) {
+		error_gecko("Not enough memory for the seek index\r\n");
+		return 0;
+	}
+	offsets = newOffsets;
+	offsetsSize = newSize;
+	return 1;
+}
+
+static void getCachePath(char *cachePath, int albumNum, int trackNum) {
+	u32 hash = 0x811C9DC5;	// FNV-1a
+	const char *name = albumName(albumNum);
+	while(*name) {
+		hash ^= (u8)*name++;
+		hash *= 0x01000193;
+	}
+	hash ^= '/';
+	hash *= 0x01000193;
+	name = albumTrackName(albumNum, trackNum);
+	while(name && *name) {
+		hash ^= (u8)*name++;
+		hash *= 0x01000193;
+	}
+	sprintf(cachePath, "%s/%08X.sek", COVER_CACHE_DIR, hash);
+}
+
+static int readIndexCache(const char *cachePath) {
+	FILE *fp = fopen(cachePath, "rb");
+	if(!fp) {
+		return 0;
+	}
+	struct seek_info hdr;
+	int ok = fread(&hdr, 1, sizeof(struct seek_info), fp) == sizeof(struct seek_info)
+		&& hdr.magic == SEEK_CACHE_MAGIC && hdr.version == SEEK_CACHE_VERSION
+		&& hdr.src_size == info.src_size && hdr.src_mtime == info.src_mtime
+		&& hdr.num_entries && hdr.frames_per_entry && hdr.sample_rate && hdr.samples_per_frame
+		&& growOffsets(hdr.num_entries)
+		&& fread(offsets, sizeof(u32), hdr.num_entries, fp) == hdr.num_entries;
+	fclose(fp);
+	if(ok) {
+		info = hdr;
+	}
+	return ok;
+}
+
+static void writeIndexCache(const char *cachePath) {
+	info.magic = SEEK_CACHE_MAGIC;
+	info.version = SEEK_CACHE_VERSION;
+	FILE *fp = fopen(cachePath, "wb");
+	if(!fp) {
+		error_gecko("%s failed to create\r\n", cachePath);
+		return;
+	}
+	if(fwrite(&info, 1, sizeof(struct seek_info), fp) != sizeof(struct seek_info)
+		|| fwrite(offsets, sizeof(u32), info.num_entries, fp) != info.num_entries) {
+		error_gecko("%s failed to write\r\n", cachePath);
+		fclose(fp);
+		remove(cachePath);
+		return;
+	}
+	fclose(fp);
+}
+
+// Looks for a Xing/Info or VBRI header in the first frame. Either way audio gets where the
+// audio frames start, which is after the tag's frame if there is one.
+static int readToc(FILE *file, u32 first, struct frame_header *fh, u32 *audio) {
+	const u8 *f = peek(file, first, fh->length);
+	*audio = first;
+	if(!f) {
+		return 0;
+	}
+	const u8 *x = f + 4 + fh->side_info;
+	if(!memcmp(x, "Xing", 4) || !memcmp(x, "Info", 4)) {
+		*audio = first + fh->length;
+		u32 flags = be32(x + 4);
+		u32 frames = 0;
+		u32 bytes = 0;
+		x += 8;
+		if(flags & 1) {
+			frames = be32(x);
+			x += 4;
+		}
+		if(flags & 2) {
+			bytes = be32(x);
+			x += 4;
+		}
+		if(!(flags & 4) || !frames) {
+			return 0;
+		}
+		memcpy(toc, x, 100);
+		info.first_frame = *audio;
+		info.num_frames = frames;
+		// The table is in 256ths of the bytes from the tag's frame on
+		tocBase = first;
+		tocBytes = bytes > fh->length && first + bytes <= info.end ? bytes : info.end - first;
+		mode = SEEK_TOC;
+		return 1;
+	}
+	x = f + 4 + 32;
+	if(fh->length >= 4 + 32 + 26 && !memcmp(x, "VBRI", 4)) {
+		*audio = first + fh->length;
+		u32 frames = be32(x + 14);
+		u32 entries = be16(x + 18);
+		u32 scale = be16(x + 20);
+		u32 entrySize = be16(x + 22);
+		u32 framesPerEntry = be16(x + 24);
+		if(!frames || !entries || !framesPerEntry || entrySize < 1 || entrySize > 4
+			|| entries * entrySize > SEEK_READ_SIZE || !growOffsets(entries)) {
+			return 0;
+		}
+		const u8 *table = peek(file, first + 4 + 32 + 26, entries * entrySize);
+		if(!table) {
+			return 0;
+		}
+		// Each entry is the size of its stretch of frames_per_entry frames
+		u32 pos = *audio;
+		for(u32 i = 0; i < entries; i++) {
+			offsets[i] = pos;
+			u32 size = 0;
+			for(u32 b = 0; b < entrySize; b++) {
+				size = (size << 8) | *table++;
+			}
+			pos += size * scale;
+		}
+		info.first_frame = *audio;
+		info.num_frames = frames;
+		info.frames_per_entry = framesPerEntry;
+		info.num_entries = entries;
+		mode = SEEK_INDEX;
+		return 1;
+	}
+	return 0;
+}
+
+// The header-only pass, every frame from pos to end.
+static int buildIndex(FILE *file, u32 pos, u32 end) {
+	u64 start = gettime();
+	struct frame_header fh;
+	info.first_frame = pos;
+	info.frames_per_entry = SEEK_INDEX_FRAMES;
+	info.num_frames = 0;
+	info.num_entries = 0;
+	while(pos + 4 <= end) {
+		const u8 *h = peek(file, pos, 4);
+		if(!h) {
+			break;
+		}
+		if(!parseHeader(h, &fh) || fh.match != info.match) {
+			// Lost sync, carry on from the next good frame
+			pos = findFrame(file, pos + 1, end, info.match, &fh);
+			continue;
+		}
+		if(info.num_frames % SEEK_INDEX_FRAMES == 0) {
+			if(!growOffsets(info.num_entries + 1)) {
+				return 0;
+			}
+			offsets[info.num_entries++] = pos;
+		}
+		info.num_frames++;
+		pos += fh.length;
+	}
+	print_gecko("Seek index of %u frames built in %u ms\r\n", info.num_frames, diff_msec(start, gettime()));
+	mode = info.num_frames ? SEEK_INDEX : SEEK_NONE;
+	return mode != SEEK_NONE;
+}
+
+// On the worker, opens the track and gets its index one way or another. Returns 0 if it can't.
+static int loadTrack(int albumNum, int trackNum) {
+	if(seekFile) {
+		fclose(seekFile);
+		seekFile = NULL;
+	}
+	mode = SEEK_NONE;
+	readLen = 0;
+	const char *name = albumNum >= 0 ? albumTrackName(albumNum, trackNum) : NULL;
+	if(!name) {
+		return 0;
+	}
+	char path[1024];
+	sprintf(path, "%s/%s/%s", ALBUMS_DIR, albumName(albumNum), name);
+	seekFile = fopen(path, "rb");
+	FILE *file = seekFile;
+	struct stat st;
+	if(!file || fstat(fileno(file), &st)) {
+		return 0;
+	}
+	memset(&info, 0, sizeof(struct seek_info));
+	info.src_size = st.st_size;
+	info.src_mtime = st.st_mtime;
+	char cachePath[256];
+	getCachePath(cachePath, albumNum, trackNum);
+	if(readIndexCache(cachePath)) {
+		mode = SEEK_INDEX;
+		return 1;
+	}
+
+	// Where the frames are, between any ID3v2 tag at the start and ID3v1 tag at the end
+	u32 start = 0;
+	info.end = st.st_size;
+	const u8 *tag = peek(file, 0, 10);
+	if(tag && !memcmp(tag, "ID3", 3)) {
+		start = 10 + (((tag[6] & 0x7F) << 21) | ((tag[7] & 0x7F) << 14) | ((tag[8] & 0x7F) << 7) | (tag[9] & 0x7F));
+		if(tag[5] & 0x10) {
+			start += 10;
+		}
+	}
+	if(info.end >= 128 && (tag = peek(file, info.end - 128, 3)) && !memcmp(tag, "TAG", 3)) {
+		info.end -= 128;
+	}
+	struct frame_header fh;
+	u32 first = findFrame(file, start, info.end, 0, &fh);
+	if(first >= info.end) {
+		print_gecko("No MP3 frames to seek in\r\n");
+		return 0;
+	}
+	info.sample_rate = fh.sample_rate;
+	info.samples_per_frame = fh.samples;
+	info.match = fh.match;
+	u32 audio;
+	if(readToc(file, first, &fh, &audio)) {
+		return 1;
+	}
+	if(buildIndex(file, audio, info.end)) {
+		writeIndexCache(cachePath);
+		return 1;
+	}
+	return 0;
+}
+
+static void* seekWorker(void *arg) {
+	LWP_MutexLock(seekMutex);
+	while(1) {
+		if(wantedAlbum == NO_TRACK || prepared) {
+			LWP_CondWait(seekCond, seekMutex);
+			continue;
+		}
+		int albumNum = wantedAlbum;
+		int trackNum = wantedTrack;
+		LWP_MutexUnlock(seekMutex);
+		loadTrack(albumNum, trackNum);
+		LWP_MutexLock(seekMutex);
+		// Another track may have started in the meantime, then it's round again for that
+		prepared = albumNum == wantedAlbum && trackNum == wantedTrack;
+	}
+	LWP_MutexUnlock(seekMutex);
+	return NULL;
+}
+
+void seekInit() {
+	LWP_MutexInit(&seekMutex, false);
+	LWP_CondInit(&seekCond);
+	LWP_CreateThread(&seekThread, seekWorker, NULL, NULL, SEEK_WORKER_STACK_SIZE, SEEK_WORKER_PRIORITY);
+}
+
+// Has the worker get the track ready to seek in, call whenever a track starts. Never blocks,
+// asking again for the same track does nothing.
+void seekPrepare(int albumNum, int trackNum) {
+	if(albumNum == wantedAlbum && trackNum == wantedTrack) {
+		return;
+	}
+	LWP_MutexLock(seekMutex);
+	wantedAlbum = albumNum;
+	wantedTrack = trackNum;
+	prepared = 0;
+	LWP_CondSignal(seekCond);
+	LWP_MutexUnlock(seekMutex);
+}
+
+// Whether the track can be seeked in yet, the rest only work once it can. Never blocks.
+int seekReady(int albumNum, int trackNum) {
+	if(albumNum != wantedAlbum || trackNum != wantedTrack) {
+		return 0;
+	}
+	LWP_MutexLock(seekMutex);
+	int ready = prepared;
+	LWP_MutexUnlock(seekMutex);
+	return ready && mode != SEEK_NONE;
+}
+
+// Length of the track that's ready, in ms.
+u32 seekDuration() {
+	return mode == SEEK_NONE ? 0 : framesToMs(info.num_frames);
+}
+
+// Time at a byte offset into the track, the offset needn't be at a frame.
+u32 seekTimeAt(u32 offset) {
+	if(mode == SEEK_INDEX) {
+		if(!info.num_entries || offset <= offsets[0]) {
+			return 0;
+		}
+		// Last entry at or before offset, then part way to the next
+		u32 lo = 0;
+		u32 hi = info.num_entries - 1;
+		while(lo < hi) {
+			u32 mid = (lo + hi + 1) / 2;
+			if(offsets[mid] <= offset) {
+				lo = mid;
+			}
+			else {
+				hi = mid - 1;
+			}
+		}
+		u32 firstFrame = lo * info.frames_per_entry;
+		u32 next = lo + 1 < info.num_entries ? offsets[lo + 1] : info.end;
+		u32 frames = lo + 1 < info.num_entries ? info.frames_per_entry : info.num_frames - firstFrame;
+		u32 span = MAX(next - offsets[lo], 1);
+		u32 into = MIN(offset, next) - offsets[lo];
+		return framesToMs(firstFrame + (u64)into * frames / span);
+	}
+	if(mode == SEEK_TOC) {
+		f32 x = offset <= tocBase ? 0 : (offset - tocBase) * 256.0f / tocBytes;
+		int lo = 0;
+		int hi = 99;
+		while(lo < hi) {
+			int mid = (lo + hi + 1) / 2;
+			if(toc[mid] <= x) {
+				lo = mid;
+			}
+			else {
+				hi = mid - 1;
+			}
+		}
+		f32 from = toc[lo];
+		f32 to = lo < 99 ? toc[lo + 1] : 256;
+		f32 percent = lo + (to > from ? MIN((x - from) / (to - from), 1.0f) : 0);
+		return percent * seekDuration() / 100;
+	}
+	return 0;
+}
+
+// Offset of the frame playing at ms, frameMs gets when that frame starts. One read of the track.
+u32 seekOffsetAt(u32 ms, u32 *frameMs) {
+	FILE *file = seekFile;
+	struct frame_header fh;
+	readLen = 0;
+	*frameMs = 0;
+	if(mode == SEEK_INDEX) {
+		u32 frame = MIN((u64)ms * info.sample_rate / (info.samples_per_frame * 1000), info.num_frames - 1);
+		u32 entry = MIN(frame / info.frames_per_entry, info.num_entries - 1);
+		u32 got = entry * info.frames_per_entry;
+		// Walk the last few frames from the entry before it
+		u32 pos = findFrame(file, offsets[entry], info.end, info.match, &fh);
+		while(got < frame && pos + 4 <= info.end) {
+			const u8 *h = peek(file, pos, 4);
+			if(!h || !parseHeader(h, &fh) || fh.match != info.match) {
+				break;
+			}
+			pos += fh.length;
+			got++;
+		}
+		*frameMs = framesToMs(got);
+		return pos;
+	}
+	if(mode == SEEK_TOC) {
+		f32 percent = MIN(ms * 100.0f / MAX(seekDuration(), 1), 99.99f);
+		int i = (int)percent;
+		f32 from = toc[i];
+		f32 to = i < 99 ? toc[i + 1] : 256;
+		u32 pos = tocBase + (u32)((from + (to - from) * (percent - i)) / 256.0f * tocBytes);
+		pos = findFrame(file, MAX(pos, info.first_frame), info.end, info.match, &fh);
+		*frameMs = seekTimeAt(pos);
+		return pos;
+	}
+	return 0;
+}
@@ -0,0 +1,20 @@
+#ifndef __SEEK_H__
+#define __SEEK_H__
+
+#include <gccore.h>
+#include <stdio.h>
+
+#define SEEK_INDEX_FRAMES 8			// frames per entry in a built index, ~0.2s
+#define SEEK_READ_SIZE (64*1024)	// one read, what the header pass reads at a time
+#define SEEK_STEP_SECS 10			// how far the D-pad seeks each step
+#define SEEK_HOLD_MS 500			// held this long before the D-pad seeks instead of changing track
+#define SEEK_REPEAT_MS 250			// and steps on this often while held, playing from there once let go
+
+void seekInit();
+void seekPrepare(int albumNum, int trackNum);
+int seekReady(int albumNum, int trackNum);
+u32 seekDuration();
+u32 seekTimeAt(u32 offset);
+u32 seekOffsetAt(u32 ms, u32 *frameMs);
+
+#endif
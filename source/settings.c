@@ -0,0 +1,292 @@
+/*===========================================
+        WakeMii - Settings
+
+        What's in /wakemii/settings.cfg, loaded at boot and saved from the
+        settings menu. Every key is a row in settingKeys, which says what
+        type it is and where it lives, so adding a setting is adding a row.
+        Loading reads a line at a time into a fixed buffer and looks each
+        key up in a sorted index, nothing is allocated.
+
+        Saves go to settings.tmp first and end with a checksum line, then
+        replace settings.cfg. If the power goes mid-save either the old
+        settings.cfg is still there or settings.tmp is, and the checksum
+        says whether settings.tmp was finished. A settings.cfg edited by
+        hand won't match its checksum any more, that's fine, it's only
+        settings.tmp that has to.
+============================================*/
+#include <gccore.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "settings.h"
+#include "gecko.h"
+
+int continuousPlayOn = 1;
+int continuousPlayType = CONT_PLAY_TYPE_SEQUENTIAL;
+struct alarm_setting alarms[MAX_ALARMS] = {
+	{0, 7, 0, ALARM_EVERY_DAY},
+	{0, 7, 0, ALARM_EVERY_DAY},
+	{0, 7, 0, ALARM_EVERY_DAY},
+	{0, 7, 0, ALARM_EVERY_DAY}
+};
+int snoozeMins = 9;
+int standbyMode = STANDBY_DIM;
+int hourlyAlarmOn = 0;
+int shutdownAfterAlarm = 0;
+int alarmPickMode = ALARM_PICK_LEAST_RECENT;
+int alarmSkipLast = 0;
+int debugLogOn = 0;
+int decoderBackend = DECODER_LIBMAD;
+
+static int fileVersion;
+
+static const char *contPlayTypeNames[] = {"sequential", "shuffle"};
+static const char *alarmPickNames[] = {"random", "least recent", "favourites"};
+static const char *standbyNames[] = {"off", "dim", "blank"};
+static const char *decoderNames[] = {"libmad", "lite"};
+static const char *dayNames[] = {"sun", "mon", "tue", "wed", "thu", "fri", "sat"};
+
+enum setting_type {
+	SETTING_BOOL,		// yes/no
+	SETTING_INT,		// clamped to min..max
+	SETTING_CLOCK,		// an hour or minute, two digits
+	SETTING_CHOICE,		// one of choices, stored as its index
+	SETTING_DAYS,		// sun,mon,... as a bit mask
+	SETTING_VERSION		// the schema the file was written with
+};
+
+struct setting_key {
+	const char *name;
+	enum setting_type type;
+	int *value;
+	int min;
+	int max;
+	const char **choices;
+};
+
+#define CHOICES(names) 0, sizeof(names) / sizeof(names[0]) - 1, names
+
+// "Alarm Hour" is the first alarm's, "Alarm 2 Hour" the second's and so on
+#define ALARM_KEYS(num, prefix) \
+	{prefix "On", SETTING_BOOL, &alarms[num].on}, \
+	{prefix "Hour", SETTING_CLOCK, &alarms[num].hrs, 0, 23}, \
+	{prefix "Minute", SETTING_CLOCK, &alarms[num].mins, 0, 59}, \
+	{prefix "Days", SETTING_DAYS, &alarms[num].days}
+
+// In the order they're saved
+static const struct setting_key settingKeys[] = {
+	{"Version", SETTING_VERSION, &fileVersion},
+	{"Continuous Play", SETTING_BOOL, &continuousPlayOn},
+	{"Continuous Play Type", SETTING_CHOICE, &continuousPlayType, CHOICES(contPlayTypeNames)},
+	ALARM_KEYS(0, "Alarm "),
+	ALARM_KEYS(1, "Alarm 2 "),
+	ALARM_KEYS(2, "Alarm 3 "),
+	ALARM_KEYS(3, "Alarm 4 "),
+	{"Snooze Minutes", SETTING_INT, &snoozeMins, 1, 24*60},
+	{"Hourly Alarm On", SETTING_BOOL, &hourlyAlarmOn},
+	{"Shutdown after alarm", SETTING_BOOL, &shutdownAfterAlarm},
+	{"Alarm Pick", SETTING_CHOICE, &alarmPickMode, CHOICES(alarmPickNames)},
+	{"Alarm Skip Last", SETTING_INT, &alarmSkipLast, 0, INT_MAX},
+	{"Standby Screen", SETTING_CHOICE, &standbyMode, CHOICES(standbyNames)},
+	{"Debug Log", SETTING_BOOL, &debugLogOn},
+	{"Decoder", SETTING_CHOICE, &decoderBackend, CHOICES(decoderNames)},
+};
+
+#define NUM_SETTING_KEYS (sizeof(settingKeys) / sizeof(settingKeys[0]))
+
+static const struct setting_key *sortedKeys[NUM_SETTING_KEYS];
+static int sorted;
+
+static int compareKeys(const void *a, const void *b) {
+	return strcmp((*(const struct setting_key**)a)->name, (*(const struct setting_key**)b)->name);
+}
+
+static int compareName(const void *name, const void *key) {
+	return strcmp((const char*)name, (*(const struct setting_key**)key)->name);
+}
+
+static const struct setting_key* findKey(const char *name) {
+	if(!sorted) {
+		for(int i = 0; i < NUM_SETTING_KEYS; i++) {
+			sortedKeys[i] = &settingKeys[i];
+		}
+		qsort(sortedKeys, NUM_SETTING_KEYS, sizeof(sortedKeys[0]), compareKeys);
+		sorted = 1;
+	}
+	const struct setting_key **found = bsearch(name, sortedKeys, NUM_SETTING_KEYS, sizeof(sortedKeys[0]), compareName);
+	return found ? *found : NULL;
+}
+
+static u32 checksum(u32 hash, const char *str) {
+	while(*str) {
+		hash ^= (u8)*str++;	// FNV-1a
+		hash *= 0x01000193;
+	}
+	return hash;
+}
+
+static void parseValue(const struct setting_key *key, const char *value) {
+	int num;
+	switch(key->type) {
+		case SETTING_BOOL:
+			*key->value = !strcmp("yes", value);
+			break;
+		case SETTING_INT:
+		case SETTING_CLOCK:
+		case SETTING_VERSION:
+			num = atoi(value);
+			if(key->type != SETTING_VERSION) {
+				num = num < key->min ? key->min : num > key->max ? key->max : num;
+			}
+			*key->value = num;
+			break;
+		case SETTING_CHOICE:
+			for(int i = 0; i <= key->max; i++) {
+				if(!strcmp(key->choices[i], value)) {
+					*key->value = i;
+				}
+			}
+			break;
+		case SETTING_DAYS:
+			num = 0;
+			for(int i = 0; i < 7; i++) {
+				if(strstr(value, dayNames[i])) {
+					num |= 1 << i;
+				}
+			}
+			*key->value = num;
+			break;
+	}
+}
+
+// Reads path, just to check it if apply is 0. Returns 1 if it ended with a matching checksum.
+// Anything after the checksum line (added by hand after a save) is still applied.
+static int readSettings(const char *path, int apply) {
+	FILE *fp = fopen(path, "rb");
+	if(!fp) {
+		return -1;
+	}
+	char line[SETTINGS_MAX_LINE];
+	u32 hash = 0x811C9DC5;
+	int checked = 0;
+	while(fgets(line, sizeof(line), fp)) {
+		if(!strncmp("Checksum=", line, 9)) {
+			checked = strtoul(line + 9, NULL, 16) == hash;
+			continue;
+		}
+		checked = 0;
+		hash = checksum(hash, line);
+		if(!apply) {
+			continue;
+		}
+		// Cut the line into name and value where it stands
+		line[strcspn(line, "\r\n")] = 0;
+		char *value = strchr(line, '=');
+		if(line[0] == '#' || !value) {
+			continue;
+		}
+		*value++ = 0;
+		const struct setting_key *key = findKey(line);
+		if(key) {
+			parseValue(key, value);
+		}
+		else {
+			debug_gecko("settings.cfg has an unknown key %s\r\n", line);
+		}
+	}
+	fclose(fp);
+	return checked;
+}
+
+void loadSettings() {
+	// A save that got as far as a finished settings.tmp is newer than settings.cfg
+	if(readSettings(SETTINGS_TMP_FILE, 0) == 1) {
+		print_gecko("Finishing an interrupted settings save\r\n");
+		remove(SETTINGS_FILE);
+		rename(SETTINGS_TMP_FILE, SETTINGS_FILE);
+	}
+	else {
+		remove(SETTINGS_TMP_FILE);
+	}
+
+	fileVersion = 1;	// from before it was written down
+	if(readSettings(SETTINGS_FILE, 1) < 0) {
+		error_gecko("settings.cfg not found\r\n");
+		return;
+	}
+	if(fileVersion > SETTINGS_VERSION) {
+		print_gecko("settings.cfg is from a newer version (%d), keeping what's understood\r\n", fileVersion);
+	}
+}
+
+static int writeLine(FILE *fp, u32 *hash, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+static int writeLine(FILE *fp, u32 *hash, const char *fmt, ...) {
+	char line[SETTINGS_MAX_LINE];
+	va_list arglist;
+	va_start(arglist, fmt);
+	vsnprintf(line, sizeof(line), fmt, arglist);
+	va_end(arglist);
+	*hash = checksum(*hash, line);
+	return fputs(line, fp) >= 0;
+}
+
+static int writeSetting(FILE *fp, u32 *hash, const struct setting_key *key) {
+	int value = *key->value;
+	char days[32];
+	switch(key->type) {
+		case SETTING_BOOL:
+			return writeLine(fp, hash, "%s=%s\r\n", key->name, value ? "yes":"no");
+		case SETTING_INT:
+			return writeLine(fp, hash, "%s=%d\r\n", key->name, value);
+		case SETTING_CLOCK:
+			return writeLine(fp, hash, "%s=%02d\r\n", key->name, value);
+		case SETTING_CHOICE:
+			return writeLine(fp, hash, "%s=%s\r\n", key->name, key->choices[value]);
+		case SETTING_DAYS:
+			days[0] = 0;
+			for(int day = 0; day < 7; day++) {
+				if(value & (1 << day)) {
+					if(days[0]) {
+						strcat(days, ",");
+					}
+					strcat(days, dayNames[day]);
+				}
+			}
+			return writeLine(fp, hash, "%s=%s\r\n", key->name, days);
+		case SETTING_VERSION:
+			return writeLine(fp, hash, "%s=%d\r\n", key->name, SETTINGS_VERSION);
+	}
+	return 0;
+}
+
+bool saveSettings() {
+	FILE *fp = fopen(SETTINGS_TMP_FILE, "wb");
+	if(!fp) {
+		error_gecko("settings.tmp failed to create\r\n");
+		return false;
+	}
+
+	// Write in a format we can parse later
+	u32 hash = 0x811C9DC5;
+	int ok = writeLine(fp, &hash, "# WakeMii configuration file, do not edit anything unless you know what you're doing!\r\n");
+	for(int i = 0; i < NUM_SETTING_KEYS && ok; i++) {
+		ok = writeSetting(fp, &hash, &settingKeys[i]);
+	}
+	ok = ok && fprintf(fp, "Checksum=%08X\r\n", hash) > 0;
+	ok = ok && !fflush(fp);
+	if(fclose(fp) || !ok) {
+		error_gecko("settings.tmp failed to write\r\n");
+		remove(SETTINGS_TMP_FILE);
+		return false;
+	}
+
+	// The FAT rename won't replace a file, so there's a moment with only settings.tmp
+	remove(SETTINGS_FILE);
+	if(rename(SETTINGS_TMP_FILE, SETTINGS_FILE)) {
+		error_gecko("settings.tmp failed to rename\r\n");
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,52 @@
+#ifndef __SETTINGS_H__
+#define __SETTINGS_H__
+
+#include <stdbool.h>
+#include "paths.h"
+
+#define SETTINGS_FILE WAKEMII_DIR "/settings.cfg"
+#define SETTINGS_TMP_FILE WAKEMII_DIR "/settings.tmp"
+#define SETTINGS_VERSION 2
+#define SETTINGS_MAX_LINE 256		// longer lines are read as more than one
+
+#define CONT_PLAY_TYPE_SEQUENTIAL 0
+#define CONT_PLAY_TYPE_SHUFFLE 1
+
+#define ALARM_PICK_RANDOM 0
+#define ALARM_PICK_LEAST_RECENT 1
+#define ALARM_PICK_FAVOURITES 2
+
+#define STANDBY_OFF 0
+#define STANDBY_DIM 1
+#define STANDBY_BLANK 2
+
+#define DECODER_LIBMAD 0
+#define DECODER_LITE 1
+
+extern int continuousPlayOn;
+extern int continuousPlayType;
+// The first alarm is the one in the settings menu, the rest are settings.cfg only
+#define MAX_ALARMS 4
+#define ALARM_EVERY_DAY 0x7F
+
+struct alarm_setting {
+	int on;
+	int hrs;
+	int mins;
+	int days;		// bit 0 for Sunday through bit 6 for Saturday
+};
+
+extern struct alarm_setting alarms[MAX_ALARMS];
+extern int snoozeMins;
+extern int standbyMode;
+extern int hourlyAlarmOn;
+extern int shutdownAfterAlarm;
+extern int alarmPickMode;
+extern int alarmSkipLast;
+extern int debugLogOn;
+extern int decoderBackend;
+
+void loadSettings();
+bool saveSettings();
+
+#endif
@@ -0,0 +1,228 @@
+/*===========================================
+        WakeMii - Shuffle
+
+        Shuffles every track in the library rather than picking an album
+        then a track in it, so tracks in small albums don't come up more
+        often. The order is a Fisher-Yates permutation of the global track
+        numbers that's only drawn as far as it's been played, going back
+        and forth through it is just moving the position. The round's seed
+        and position are kept in /wakemii/shuffle.dat so a reboot carries
+        on with the same order as long as the library is the same. The
+        file stays open and its one record is rewritten in place, it's
+        never truncated or reallocated. Next/prev only mark it dirty, it's
+        written by shuffleFlush() SHUFFLE_SAVE_SECS after the first of
+        them, so skipping through tracks costs one write and sync (which
+        also rewrites the file's directory entry) rather than one each.
+============================================*/
+#include <gccore.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <ogc/lwp_watchdog.h>
+#include "shuffle.h"
+#include "library.h"
+#include "rng.h"
+#include "playlist.h"
+#include "gecko.h"
+
+#define SHUFFLE_STATE_MAGIC 0x574D5348	// "WMSH"
+#define SHUFFLE_STATE_VERSION 1
+
+struct shuffle_state_file {
+	u32 magic;
+	u32 version;
+	u32 seed;
+	u32 num_tracks;
+	u32 num_albums;
+	u32 pos;
+};
+
+static struct rng_state rng;
+static u32 numMapped;			// tracks in the library as last numbered
+static int num_mappedAlbums;
+
+static u32 *order;				// order[0..drawn) is the shuffled order so far, the rest is yet to be drawn
+static u32 orderSize;
+static u32 drawn;
+static u32 pos;					// order[pos-1] is the current track
+static u32 roundSeed;
+static int ready;				// a proper round has started, before that picks are just random
+
+static int provisionalValid;	// what shufflePeek() promised while the library was still scanning
+static u32 provisionalPick;
+
+static struct shuffle_state_file saved;
+static int savedValid;
+static FILE *stateFile;			// open from the first save on
+static int stateDirty;
+static u64 firstDirtyTime;
+
+static void saveShuffleState() {
+	struct shuffle_state_file state;
+	memset(&state, 0, sizeof(struct shuffle_state_file));
+	state.magic = SHUFFLE_STATE_MAGIC;
+	state.version = SHUFFLE_STATE_VERSION;
+	state.seed = roundSeed;
+	state.num_tracks = orderSize;
+	state.num_albums = num_mappedAlbums;
+	state.pos = pos;
+	if(!stateFile) {
+		stateFile = fopen(SHUFFLE_STATE_FILE, "r+b");
+		if(!stateFile) {
+			stateFile = fopen(SHUFFLE_STATE_FILE, "w+b");
+		}
+		if(!stateFile) {
+			error_gecko("shuffle.dat failed to create\r\n");
+			return;
+		}
+	}
+	// Same size every time, so this only ever rewrites the file's first sector. libfat keeps
+	// written sectors in its cache until the file's synced.
+	if(fseek(stateFile, 0, SEEK_SET) || fwrite(&state, 1, sizeof(struct shuffle_state_file), stateFile) != sizeof(struct shuffle_state_file)
+		|| fflush(stateFile) || fsync(fileno(stateFile))) {
+		error_gecko("shuffle.dat failed to write\r\n");
+		fclose(stateFile);
+		stateFile = NULL;
+	}
+	stateDirty = 0;
+}
+
+static void markDirty() {
+	if(!stateDirty) {
+		firstDirtyTime = gettime();
+		stateDirty = 1;
+	}
+}
+
+// Writes the position out once it's been waiting SHUFFLE_SAVE_SECS, or now if force.
+void shuffleFlush(int force) {
+	if(stateDirty && (force || diff_sec(firstDirtyTime, gettime()) >= SHUFFLE_SAVE_SECS)) {
+		saveShuffleState();
+	}
+}
+
+// One Fisher-Yates step, fixes order[drawn]
+static void drawNext() {
+	u32 j = drawn + rngBounded(&rng, orderSize - drawn);
+	u32 tmp = order[drawn];
+	order[drawn] = order[j];
+	order[j] = tmp;
+	drawn++;
+}
+
+static int startRound(u32 seed, u32 replayTo) {
+	u32 size = numMapped;
+	if(!size) {
+		return 0;
+	}
+	if(size != orderSize) {
+		u32 *newOrder = realloc(order, size * sizeof(u32));
+		if(!newOrder) {
+			return 0;
+		}
+		order = newOrder;
+		orderSize = size;
+	}
+	for(u32 i = 0; i < orderSize; i++) {
+		order[i] = i;
+	}
+	roundSeed = seed;
+	rngSeed(&rng, seed);
+	drawn = 0;
+	while(drawn < replayTo) {
+		drawNext();
+	}
+	pos = replayTo;
+	ready = 1;
+	print_gecko("Shuffle round of %u tracks, seed %08X, at %u\r\n", orderSize, roundSeed, pos);
+	return 1;
+}
+
+// Starts or resumes a proper round once the library is complete, or a new
+// one if the library changed under the current one.
+static int syncShuffle() {
+	if(!num_albums) {
+		return 0;
+	}
+	numMapped = playlistMapTracks(&num_mappedAlbums, NULL);
+	if(!numMapped) {
+		return 0;
+	}
+	if(libraryScanState != LIBRARY_SCAN_DONE) {
+		return 1;
+	}
+	if(ready && orderSize == numMapped) {
+		return 1;
+	}
+	if(savedValid) {
+		savedValid = 0;
+		if(saved.num_tracks == numMapped && saved.num_albums == num_mappedAlbums && saved.pos <= saved.num_tracks) {
+			return startRound(saved.seed, saved.pos);
+		}
+		print_gecko("Library changed, not resuming the saved shuffle\r\n");
+	}
+	return startRound(gettick() ^ rngNext(&rng), 0);
+}
+
+void shuffleInit() {
+	rngSeed(&rng, gettick());
+	FILE *fp = fopen(SHUFFLE_STATE_FILE, "rb");
+	if(!fp) {
+		return;
+	}
+	if(fread(&saved, 1, sizeof(struct shuffle_state_file), fp) == sizeof(struct shuffle_state_file)
+		&& saved.magic == SHUFFLE_STATE_MAGIC && saved.version == SHUFFLE_STATE_VERSION) {
+		savedValid = 1;
+	}
+	fclose(fp);
+}
+
+// The track shuffleNext() will give, without moving on to it.
+int shufflePeek(int *albumNum, int *trackNum) {
+	if(!syncShuffle()) {
+		return 0;
+	}
+	if(!ready) {
+		// Still scanning, just pick uniformly from what's been found so far
+		if(!provisionalValid) {
+			provisionalPick = rngBounded(&rng, numMapped);
+			provisionalValid = 1;
+		}
+		playlistGlobalToEntry(provisionalPick, albumNum, trackNum);
+		return 1;
+	}
+	if(pos == orderSize) {
+		// Round's over, go again in a new order
+		startRound(gettick() ^ rngNext(&rng), 0);
+	}
+	if(drawn == pos) {
+		drawNext();
+	}
+	playlistGlobalToEntry(order[pos], albumNum, trackNum);
+	return 1;
+}
+
+int shuffleNext(int *albumNum, int *trackNum) {
+	if(!shufflePeek(albumNum, trackNum)) {
+		return 0;
+	}
+	if(!ready) {
+		provisionalValid = 0;
+		return 1;
+	}
+	pos++;
+	markDirty();
+	return 1;
+}
+
+// Back to the track before the current one, 0 if there's no going back.
+int shufflePrev(int *albumNum, int *trackNum) {
+	if(!syncShuffle() || !ready || pos < 2) {
+		return 0;
+	}
+	pos--;
+	playlistGlobalToEntry(order[pos-1], albumNum, trackNum);
+	markDirty();
+	return 1;
+}
@@ -0,0 +1,16 @@
+#ifndef __SHUFFLE_H__
+#define __SHUFFLE_H__
+
+#include "paths.h"
+
+#define SHUFFLE_STATE_FILE WAKEMII_DIR "/shuffle.dat"
+// The position's saved at most this long after it moves
+#define SHUFFLE_SAVE_SECS 10
+
+void shuffleInit();
+int shufflePeek(int *albumNum, int *trackNum);
+int shuffleNext(int *albumNum, int *trackNum);
+int shufflePrev(int *albumNum, int *trackNum);
+void shuffleFlush(int force);
+
+#endif
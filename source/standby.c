@@ -0,0 +1,135 @@
+/*===========================================
+        WakeMii - Standby
+
+        Once it's been left alone as a clock for a while the main loop
+        stops waking for every frame. It sleeps until an alarm event turns
+        up or STANDBY_POLL_MS has gone by (which is when buttons get looked
+        at) and the screen goes dim or black as set by "Standby Screen".
+        Anything happening brings it straight back.
+
+        Also keeps count of loops, drawn frames and how long the CPU spent
+        on them rather than waiting, for normal running and standby, which
+        get logged over USB Gecko to show what standby saves.
+============================================*/
+#include <gccore.h>
+#include <grrlib.h>
+#include <ogc/lwp_watchdog.h>
+#include "standby.h"
+#include "settings.h"
+#include "alarm.h"
+#include "gecko.h"
+
+struct load_stats {
+	u32 loops;
+	u32 drawn;
+	u64 busyTicks;
+	u64 since;
+};
+
+static int active;
+static u64 lastActivity;
+static u64 busySince;
+static u64 lastReport;
+static struct load_stats stats[2];		// [0] normal, [1] standby
+
+static void resetStats(struct load_stats *load) {
+	load->loops = 0;
+	load->drawn = 0;
+	load->busyTicks = 0;
+	load->since = gettime();
+}
+
+static void reportStats(struct load_stats *load, const char *what) {
+	u64 now = gettime();
+	u32 secs = diff_sec(load->since, now);
+	u32 busyMs = ticks_to_millisecs(load->busyTicks);
+	if(!secs) {
+		return;
+	}
+	print_gecko("%s for %u s: %u loops (%u/s), %u drawn, CPU busy %u ms (%u.%02u%%)\r\n", what, secs, load->loops, load->loops / secs,
+		load->drawn, busyMs, busyMs / (secs * 10), (busyMs * 10 / secs) % 100);
+}
+
+void standbyInit() {
+	lastActivity = busySince = lastReport = gettime();
+	resetStats(&stats[0]);
+	resetStats(&stats[1]);
+}
+
+static void setActive(int standby) {
+	reportStats(&stats[active], active ? "Standby" : "Awake");
+	resetStats(&stats[standby]);
+	active = standby;
+	lastReport = gettime();
+	if(standbyMode == STANDBY_BLANK) {
+		VIDEO_SetBlack(standby ? true : false);
+		VIDEO_Flush();
+	}
+}
+
+// Call once a loop, allowed is whether it's only being a clock right now and activity whether
+// anything happened (input, alarms). Returns 1 if it went into or came out of standby.
+int standbyCheck(int allowed, int activity) {
+	u64 now = gettime();
+	if(activity || !allowed) {
+		lastActivity = now;
+		if(active) {
+			setActive(0);
+			return 1;
+		}
+		return 0;
+	}
+	if(!active && standbyMode != STANDBY_OFF && diff_sec(lastActivity, now) >= STANDBY_AFTER_SECS) {
+		setActive(1);
+		return 1;
+	}
+	if(active && diff_sec(lastReport, now) >= STANDBY_REPORT_SECS) {
+		reportStats(&stats[1], "Standby");
+		resetStats(&stats[1]);
+		lastReport = now;
+	}
+	return 0;
+}
+
+int standbyActive() {
+	return active;
+}
+
+// Nothing needs drawing when the screen's off
+int standbyBlank() {
+	return active && standbyMode == STANDBY_BLANK;
+}
+
+static void idleBegin() {
+	stats[active].busyTicks += diff_ticks(busySince, gettime());
+}
+
+static void idleEnd() {
+	busySince = gettime();
+}
+
+// GRRLIB_Render, with the wait for the GPU and vsync not counted as busy
+void standbyRender() {
+	idleBegin();
+	GRRLIB_Render();
+	idleEnd();
+}
+
+// Waits out a loop with nothing to draw, one vsync normally and longer in standby.
+void standbyWait() {
+	idleBegin();
+	if(active) {
+		alarmWaitEvents(STANDBY_POLL_MS);
+	}
+	else {
+		VIDEO_WaitVSync();
+	}
+	idleEnd();
+}
+
+void standbyFrameDone(int drawn) {
+	stats[active].loops++;
+	if(drawn) {
+		stats[active].drawn++;
+	}
+}
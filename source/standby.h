@@ -0,0 +1,22 @@
+#ifndef __STANDBY_H__
+#define __STANDBY_H__
+
+#include <gccore.h>
+
+// Nothing pressed for this long while just being a clock and it goes into standby
+#define STANDBY_AFTER_SECS 30
+// How often buttons are looked at in standby, an alarm wakes it straight away regardless
+#define STANDBY_POLL_MS 100
+// How often the work saved gets logged while in standby
+#define STANDBY_REPORT_SECS (60*60)
+#define STANDBY_DIM_COLOUR 0x505050FF
+
+void standbyInit();
+int standbyCheck(int allowed, int activity);
+int standbyActive();
+int standbyBlank();
+void standbyRender();
+void standbyWait();
+void standbyFrameDone(int drawn);
+
+#endif
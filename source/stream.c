@@ -0,0 +1,350 @@
+/*===========================================
+        WakeMii - Read-ahead MP3 stream
+
+        An I/O thread keeps a large ring buffer topped up with big reads
+        aligned to the typical SD cluster size, so the decoder never waits
+        on the card for each small chunk it wants. Once the current file
+        has been read in full it carries on into the queued one, and the
+        last few tracks' start positions in the stream are kept so the
+        player can tell which track each decoded frame belongs to. The
+        encoder delay and padding from a track's LAME tag are read when
+        it's opened, so the player can trim them off.
+============================================*/
+#include <gccore.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include "stream.h"
+#include "gecko.h"
+
+#define STREAM_RING_SIZE (512*1024)		// must be a power of two
+#define STREAM_CHUNK_SIZE (32*1024)		// reads are aligned to this within the file
+#define STREAM_IO_PRIORITY 70
+#define STREAM_IO_STACK_SIZE (8*1024)
+#define STREAM_TRACKS 4					// tracks the start of is remembered, the decoder is never more than one behind
+#define STREAM_TAG_READ 192				// enough of the first frame to get past the Xing fields to the LAME tag
+
+struct stream_file {
+	FILE* file;
+	u32 pos;
+	u32 end;			// where the MPEG data stops, before any ID3v1 tag
+	u32 delay;			// from the LAME tag, see struct stream_track
+	u32 padding;
+	u32 samples;
+};
+
+static u8* ring;
+static volatile u32 ringHead;			// bytes ever written, by the I/O thread
+static volatile u32 ringTail;			// bytes ever consumed, by the decoder
+static struct stream_file reading;		// file the I/O thread is working through
+static struct stream_file queued;
+static u32 nextTrackStart;				// ring position the queued track's data starts at
+static int nextTrackPending;
+static struct stream_track tracks[STREAM_TRACKS];	// track n is at n % STREAM_TRACKS
+static u32 numTracks;					// since the last start
+static int ioEof;						// nothing left to read until something is queued
+static int aborted;						// decoder reads return nothing until the next start
+static u32 generation;					// bumped on every start/stop
+static int ioBusy;
+static u32 underruns;
+
+static mutex_t streamMutex;
+static cond_t dataCond;
+static cond_t spaceCond;
+static cond_t idleCond;
+static lwp_t ioThread = LWP_THREAD_NULL;
+
+static u32 readBE32(const u8 *p) {
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+// Reads the encoder delay and padding from the LAME tag in the first frame, if there is one.
+static void readGapless(struct stream_file *sf) {
+	u8 f[STREAM_TAG_READ];
+	if(fread(f, 1, sizeof(f), sf->file) != sizeof(f)) {
+		return;
+	}
+	// Layer III only
+	if(f[0] != 0xFF || (f[1] & 0xE6) != 0xE2) {
+		return;
+	}
+	int mpeg1 = f[1] & 0x08;
+	int mono = (f[3] >> 6) == 3;
+	u32 side = mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+	const u8 *x = f + 4 + ((f[1] & 0x01) ? 0 : 2) + side;
+	if(memcmp(x, "Xing", 4) && memcmp(x, "Info", 4)) {
+		return;
+	}
+	u32 flags = readBE32(x + 4);
+	u32 frames = 0;
+	x += 8;
+	if(flags & 0x1) {
+		frames = readBE32(x);
+		x += 4;
+	}
+	if(flags & 0x2) {
+		x += 4;
+	}
+	if(flags & 0x4) {
+		x += 100;
+	}
+	if(flags & 0x8) {
+		x += 4;
+	}
+	// 9 bytes of encoder version, then 12 bits each of delay and padding 21 bytes in
+	if(!frames || (memcmp(x, "LAME", 4) && memcmp(x, "Lavc", 4) && memcmp(x, "Lavf", 4))) {
+		return;
+	}
+	u32 delay = (x[21] << 4) | (x[22] >> 4);
+	u32 padding = ((x[22] & 0x0F) << 8) | x[23];
+	u32 total = frames * (mpeg1 ? 1152 : 576);
+	if(delay + padding >= total) {
+		return;
+	}
+	sf->delay = delay;
+	sf->padding = padding;
+	sf->samples = total;
+}
+
+// Skips any ID3v2 tag at the start and ID3v1 tag at the end, only MPEG frames should reach the decoder.
+static void openStreamFile(struct stream_file *sf, FILE *file) {
+	u8 tag[10];
+	memset(sf, 0, sizeof(struct stream_file));
+	sf->file = file;
+	// We do our own big reads, stdio buffering would only add a copy
+	setvbuf(file, NULL, _IONBF, 0);
+	fseek(file, 0L, SEEK_END);
+	sf->end = ftell(file);
+	if(sf->end >= 128) {
+		fseek(file, sf->end - 128, SEEK_SET);
+		if(fread(tag, 1, 3, file) == 3 && !memcmp(tag, "TAG", 3)) {
+			sf->end -= 128;
+		}
+	}
+	fseek(file, 0L, SEEK_SET);
+	if(fread(tag, 1, 10, file) == 10 && !memcmp(tag, "ID3", 3)) {
+		// Syncsafe size, plus the footer if there is one
+		sf->pos = 10 + (((tag[6] & 0x7F) << 21) | ((tag[7] & 0x7F) << 14) | ((tag[8] & 0x7F) << 7) | (tag[9] & 0x7F));
+		if(tag[5] & 0x10) {
+			sf->pos += 10;
+		}
+	}
+	if(sf->pos > sf->end) {
+		sf->pos = sf->end;
+	}
+	fseek(file, sf->pos, SEEK_SET);
+	readGapless(sf);
+	fseek(file, sf->pos, SEEK_SET);
+}
+
+static void addTrack(u32 start, const struct stream_file *sf) {
+	struct stream_track *track = &tracks[numTracks % STREAM_TRACKS];
+	track->start = start;
+	track->filePos = sf->pos;
+	track->delay = sf->delay;
+	track->padding = sf->padding;
+	track->samples = sf->samples;
+	numTracks++;
+}
+
+static void closeStreamFile(struct stream_file *sf) {
+	if(sf->file) {
+		fclose(sf->file);
+	}
+	memset(sf, 0, sizeof(struct stream_file));
+}
+
+static void* streamIoThread(void *arg) {
+	LWP_MutexLock(streamMutex);
+	while(1) {
+		if(reading.file && reading.pos >= reading.end) {
+			closeStreamFile(&reading);
+		}
+		if(!reading.file && queued.file) {
+			// Carry straight on into the next track
+			reading = queued;
+			memset(&queued, 0, sizeof(struct stream_file));
+			nextTrackStart = ringHead;
+			nextTrackPending = 1;
+			addTrack(ringHead, &reading);
+			ioEof = 0;
+		}
+		u32 space = STREAM_RING_SIZE - (ringHead - ringTail);
+		if(!reading.file || space < STREAM_CHUNK_SIZE) {
+			if(!reading.file && !ioEof) {
+				ioEof = 1;
+				LWP_CondBroadcast(dataCond);
+			}
+			LWP_CondWait(spaceCond, streamMutex);
+			continue;
+		}
+		// Read up to the next chunk boundary in the file, without running past the end of the ring
+		u32 headPos = ringHead & (STREAM_RING_SIZE - 1);
+		u32 want = STREAM_CHUNK_SIZE - (reading.pos % STREAM_CHUNK_SIZE);
+		want = MIN(want, reading.end - reading.pos);
+		want = MIN(want, STREAM_RING_SIZE - headPos);
+		FILE *file = reading.file;
+		u32 gen = generation;
+		ioBusy = 1;
+		LWP_MutexUnlock(streamMutex);
+		s32 got = fread(ring + headPos, 1, want, file);
+		LWP_MutexLock(streamMutex);
+		ioBusy = 0;
+		LWP_CondBroadcast(idleCond);
+		if(gen != generation) {
+			continue;
+		}
+		if(got <= 0) {
+			error_gecko("Stream read failed at %u\r\n", reading.pos);
+			reading.pos = reading.end;
+			continue;
+		}
+		reading.pos += got;
+		ringHead += got;
+		LWP_CondBroadcast(dataCond);
+	}
+	LWP_MutexUnlock(streamMutex);
+	return NULL;
+}
+
+void streamInit() {
+	ring = memalign(32, STREAM_RING_SIZE);
+	LWP_MutexInit(&streamMutex, false);
+	LWP_CondInit(&dataCond);
+	LWP_CondInit(&spaceCond);
+	LWP_CondInit(&idleCond);
+	ioEof = 1;
+	LWP_CreateThread(&ioThread, streamIoThread, NULL, NULL, STREAM_IO_STACK_SIZE, STREAM_IO_PRIORITY);
+}
+
+// Drops everything, pending decoder reads return nothing until the next streamStart.
+void streamStop() {
+	LWP_MutexLock(streamMutex);
+	generation++;
+	aborted = 1;
+	LWP_CondBroadcast(dataCond);
+	while(ioBusy) {
+		LWP_CondWait(idleCond, streamMutex);
+	}
+	closeStreamFile(&reading);
+	closeStreamFile(&queued);
+	ringHead = ringTail = 0;
+	nextTrackPending = 0;
+	numTracks = 0;
+	ioEof = 1;
+	LWP_MutexUnlock(streamMutex);
+}
+
+// Starts reading file from offset bytes in (0 for the top), takes ownership of file. The
+// decoder must not be running. libmad finds the next frame by itself from any offset.
+void streamStart(FILE *file, u32 offset) {
+	struct stream_file sf;
+	streamStop();
+	openStreamFile(&sf, file);
+	if(offset > sf.pos && offset < sf.end) {
+		// Part way in there's no telling which decoded sample is which, so no trimming
+		sf.pos = offset;
+		sf.delay = sf.padding = sf.samples = 0;
+		fseek(file, sf.pos, SEEK_SET);
+	}
+	LWP_MutexLock(streamMutex);
+	reading = sf;
+	addTrack(0, &sf);
+	aborted = 0;
+	ioEof = 0;
+	LWP_CondBroadcast(spaceCond);
+	LWP_MutexUnlock(streamMutex);
+}
+
+// File to carry on into once the current one has been read, takes ownership of file.
+void streamQueue(FILE *file) {
+	struct stream_file sf;
+	openStreamFile(&sf, file);
+	LWP_MutexLock(streamMutex);
+	closeStreamFile(&queued);
+	queued = sf;
+	LWP_CondBroadcast(spaceCond);
+	LWP_MutexUnlock(streamMutex);
+}
+
+int streamHasQueued() {
+	return queued.file != NULL;
+}
+
+// Whether streamRead() would return straight away.
+int streamReady() {
+	return ringHead != ringTail || ioEof || aborted;
+}
+
+// Runs on the decoder thread. Copies straight out of the ring into the decoder's buffer.
+s32 streamRead(void *dst, s32 size) {
+	int waited = 0;
+	LWP_MutexLock(streamMutex);
+	while(ringHead == ringTail && !ioEof && !aborted) {
+		// Running dry mid track is an underrun, the initial fill isn't
+		if(!waited && ringTail) {
+			underruns++;
+			print_gecko("Stream underrun (%u so far)\r\n", underruns);
+		}
+		waited = 1;
+		LWP_CondWait(dataCond, streamMutex);
+	}
+	if(aborted) {
+		LWP_MutexUnlock(streamMutex);
+		return 0;
+	}
+	u32 avail = ringHead - ringTail;
+	u32 gen = generation;
+	if(nextTrackPending) {
+		u32 toNext = nextTrackStart - ringTail;
+		if(toNext == 0) {
+			// This read is the first from the next track
+			nextTrackPending = 0;
+		}
+		else if(toNext < avail) {
+			// Don't mix two tracks in one read, keeps the change point exact
+			avail = toNext;
+		}
+	}
+	u32 tailPos = ringTail & (STREAM_RING_SIZE - 1);
+	u32 len = MIN((u32)size, avail);
+	LWP_MutexUnlock(streamMutex);
+
+	u32 first = MIN(len, STREAM_RING_SIZE - tailPos);
+	memcpy(dst, ring + tailPos, first);
+	if(len > first) {
+		memcpy((u8*)dst + first, ring, len - first);
+	}
+
+	LWP_MutexLock(streamMutex);
+	if(gen != generation) {
+		len = 0;
+	}
+	else {
+		ringTail += len;
+		LWP_CondBroadcast(spaceCond);
+	}
+	LWP_MutexUnlock(streamMutex);
+	return len;
+}
+
+// Which track the data at stream position pos came from, counting from 0 at the last
+// streamStart(), -1 if it's too far back to say.
+int streamTrackAt(u32 pos, struct stream_track *track) {
+	int found = -1;
+	LWP_MutexLock(streamMutex);
+	u32 oldest = numTracks > STREAM_TRACKS ? numTracks - STREAM_TRACKS : 0;
+	for(u32 n = numTracks; n > oldest; n--) {
+		if(tracks[(n - 1) % STREAM_TRACKS].start <= pos) {
+			*track = tracks[(n - 1) % STREAM_TRACKS];
+			found = n - 1;
+			break;
+		}
+	}
+	LWP_MutexUnlock(streamMutex);
+	return found;
+}
+
+u32 streamUnderruns() {
+	return underruns;
+}
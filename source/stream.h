@@ -0,0 +1,25 @@
+#ifndef __STREAM_H__
+#define __STREAM_H__
+
+#include <gccore.h>
+#include <stdio.h>
+
+struct stream_track {
+	u32 start;			// stream position the track's data starts at
+	u32 filePos;		// and the file offset that is
+	u32 delay;			// encoder delay and padding from the LAME tag, in samples
+	u32 padding;
+	u32 samples;		// decoded samples in the track, 0 if there was no LAME tag
+};
+
+void streamInit();
+void streamStart(FILE *file, u32 offset);
+void streamQueue(FILE *file);
+int streamHasQueued();
+void streamStop();
+int streamReady();
+s32 streamRead(void *dst, s32 size);
+int streamTrackAt(u32 pos, struct stream_track *track);
+u32 streamUnderruns();
+
+#endif
@@ -0,0 +1,676 @@
+/*===========================================
+        WakeMii - Track tags
+
+        Title, artist, album, track number and length from a track's ID3v2
+        tag, or its ID3v1 tag for whatever that didn't have. Only the tag
+        header and the frame headers are read, plus the start of the few
+        frames that get shown, everything else is skipped over.
+        tagsFindPicture() walks the frames the same way to find embedded
+        cover art for the cover worker.
+
+        Reading is done on a worker thread and what it finds goes in a
+        store (/wakemii/cache/tags.dat) of fixed size records checked
+        against the file's size and mtime, so a file is only ever parsed
+        once. The worker keeps an index of the store in memory, the main
+        thread only sees the last few tracks' tags, handed back the same
+        way covers are.
+============================================*/
+#include <gccore.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "tags.h"
+#include "library.h"
+#include "gecko.h"
+
+#define TAGS_STORE_MAGIC 0x574D5447	// "WMTG"
+#define TAGS_STORE_VERSION 1
+#define TAGS_INDEX_MIN 1024
+#define TAGS_WORKER_PRIORITY 25
+#define TAGS_WORKER_STACK_SIZE (16*1024)
+
+#define TAG_TITLE	(1<<0)
+#define TAG_ARTIST	(1<<1)
+#define TAG_ALBUM	(1<<2)
+#define TAG_TRACK	(1<<3)
+#define TAG_LENGTH	(1<<4)
+#define TAG_ALL		0x1F
+
+struct tags_store_header {
+	u32 magic;
+	u32 version;
+};
+
+struct tags_record {
+	u32 key;			// hash of the album and track name
+	u32 src_size;
+	u32 src_mtime;
+	struct track_tags tags;
+	u32 checksum;		// of everything before it
+};
+
+struct tags_index_slot {
+	u32 key;
+	u32 record;			// record number + 1, 0 when the slot is free
+};
+
+struct tags_entry {
+	int albumNum;		// -1 when the slot is free
+	int trackNum;
+	struct track_tags tags;
+	u32 lastUse;
+};
+
+// Only the worker touches the store
+static struct tags_index_slot *storeIndex;
+static u32 storeIndexSize;
+static u32 storeRecords;
+
+// Only the main thread touches the cache
+static struct tags_entry cache[TAGS_CACHE_ENTRIES];
+static u32 useCounter;
+
+// Shared with the worker
+static mutex_t tagsMutex;
+static cond_t tagsCond;
+static struct {
+	int albumNum;		// -1 for none
+	int trackNum;
+} wanted[TAGS_WANTED], reading;
+static struct tags_entry ready[TAGS_WANTED];
+static int num_ready;
+static lwp_t tagsThread = LWP_THREAD_NULL;
+
+static u32 hashBytes(u32 hash, const void *data, u32 len) {
+	const u8 *bytes = data;
+	for(u32 i = 0; i < len; i++) {
+		hash ^= bytes[i];	// FNV-1a
+		hash *= 0x01000193;
+	}
+	return hash;
+}
+
+static u32 trackKey(int albumNum, int trackNum) {
+	const char *album = albumName(albumNum);
+	const char *track = albumTrackName(albumNum, trackNum);
+	u32 hash = hashBytes(0x811C9DC5, album, strlen(album));
+	hash = hashBytes(hash, "/", 1);
+	return hashBytes(hash, track, strlen(track));
+}
+
+static u32 be32(const u8 *b) {
+	return (b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
+}
+
+static u32 syncsafe(const u8 *b) {
+	return ((b[0] & 0x7F) << 21) | ((b[1] & 0x7F) << 14) | ((b[2] & 0x7F) << 7) | (b[3] & 0x7F);
+}
+
+// Latin-1 out, anything past that becomes a '?'
+static void putChar(char *out, u32 *len, u32 c) {
+	if(*len < TAGS_FIELD_SIZE - 1) {
+		out[(*len)++] = c < 0x100 ? c : '?';
+	}
+}
+
+static void trimField(char *out, u32 len) {
+	while(len > 0 && (out[len-1] == ' ' || out[len-1] == 0)) {
+		len--;
+	}
+	out[len] = 0;
+}
+
+// A text frame's value, the encoding byte first. Stops at the first NUL, only the
+// first of several values is wanted.
+static void decodeText(char *out, const u8 *data, u32 size) {
+	u32 len = 0;
+	if(size < 1) {
+		out[0] = 0;
+		return;
+	}
+	u8 encoding = data[0];
+	const u8 *p = data + 1;
+	const u8 *end = data + size;
+	if(encoding == 1 || encoding == 2) {
+		// UTF-16, with a BOM saying which way round (1) or big endian (2)
+		int little = 0;
+		if(encoding == 1 && end - p >= 2 && ((p[0] == 0xFF && p[1] == 0xFE) || (p[0] == 0xFE && p[1] == 0xFF))) {
+			little = p[0] == 0xFF;
+			p += 2;
+		}
+		for(; end - p >= 2; p += 2) {
+			u32 c = little ? p[0] | (p[1] << 8) : (p[0] << 8) | p[1];
+			if(!c) {
+				break;
+			}
+			if(c >= 0xDC00 && c < 0xE000) {
+				continue;	// the high surrogate already put a '?'
+			}
+			putChar(out, &len, c);
+		}
+	}
+	else if(encoding == 3) {
+		// UTF-8, only how many bytes a character takes matters
+		while(p < end && *p) {
+			u32 c = *p++;
+			if(c >= 0xC0) {
+				int more = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : 1;
+				c &= 0x3F >> more;
+				for(; more && p < end && (*p & 0xC0) == 0x80; more--) {
+					c = (c << 6) | (*p++ & 0x3F);
+				}
+			}
+			putChar(out, &len, c);
+		}
+	}
+	else {
+		while(p < end && *p) {
+			putChar(out, &len, *p++);
+		}
+	}
+	trimField(out, len);
+}
+
+// Undoes ID3v2 unsynchronisation (a 0x00 stuffed after every 0xFF) in place.
+static u32 resync(u8 *data, u32 size) {
+	u32 out = 0;
+	for(u32 i = 0; i < size; i++) {
+		data[out++] = data[i];
+		if(data[i] == 0xFF && i + 1 < size && data[i+1] == 0x00) {
+			i++;
+		}
+	}
+	return out;
+}
+
+static int frameField(const u8 *id, int version) {
+	static const struct {
+		char v2[4];
+		char v3[5];
+		int field;
+	} frames[] = {
+		{"TT2", "TIT2", TAG_TITLE},
+		{"TP1", "TPE1", TAG_ARTIST},
+		{"TAL", "TALB", TAG_ALBUM},
+		{"TRK", "TRCK", TAG_TRACK},
+		{"TLE", "TLEN", TAG_LENGTH}
+	};
+	for(int i = 0; i < sizeof(frames) / sizeof(frames[0]); i++) {
+		if(version == 2 ? !memcmp(id, frames[i].v2, 3) : !memcmp(id, frames[i].v3, 4)) {
+			return frames[i].field;
+		}
+	}
+	return 0;
+}
+
+static void setField(struct track_tags *tags, int field, const char *value) {
+	switch(field) {
+		case TAG_TITLE:
+			strcpy(tags->title, value);
+			break;
+		case TAG_ARTIST:
+			strcpy(tags->artist, value);
+			break;
+		case TAG_ALBUM:
+			strcpy(tags->album, value);
+			break;
+		case TAG_TRACK:
+			tags->track = atoi(value);	// "3/12" is track 3
+			break;
+		case TAG_LENGTH:
+			tags->duration_ms = strtoul(value, NULL, 10);
+			break;
+	}
+}
+
+// Walks an ID3v2 tag a frame header at a time
+struct id3_walk {
+	int version;
+	int unsync;		// the whole tag, v2.4 says so per frame instead
+	u32 pos;		// of the next frame header
+	u32 end;
+	u8 id[4];		// the frame it's on
+	u32 size;
+	int flags;
+};
+
+static int id3Start(FILE *fp, struct id3_walk *walk) {
+	u8 hdr[10];
+	if(fseek(fp, 0, SEEK_SET) || fread(hdr, 1, 10, fp) != 10 || memcmp(hdr, "ID3", 3)) {
+		return 0;
+	}
+	walk->version = hdr[3];
+	walk->unsync = hdr[5] & 0x80;
+	walk->pos = 10;
+	walk->end = 10 + syncsafe(hdr + 6);
+	if(walk->version < 2 || walk->version > 4 || (walk->version == 2 && (hdr[5] & 0x40))) {
+		// v2.2 used that bit for a compression scheme that was never defined
+		return 0;
+	}
+	if(walk->version > 2 && (hdr[5] & 0x40)) {
+		u8 ext[4];
+		if(fread(ext, 1, 4, fp) != 4) {
+			return 0;
+		}
+		walk->pos += walk->version == 4 ? syncsafe(ext) : be32(ext) + 4;
+	}
+	return 1;
+}
+
+// Leaves fp at the start of the next frame's data, 0 once there aren't any more.
+static int id3Next(FILE *fp, struct id3_walk *walk) {
+	u8 hdr[10];
+	u32 headerSize = walk->version == 2 ? 6 : 10;
+	if(walk->pos + headerSize > walk->end || fseek(fp, walk->pos, SEEK_SET)
+		|| fread(hdr, 1, headerSize, fp) != headerSize || !hdr[0]) {
+		return 0;	// ran into the padding
+	}
+	memcpy(walk->id, hdr, 4);
+	if(walk->version == 2) {
+		walk->size = (hdr[3] << 16) | (hdr[4] << 8) | hdr[5];
+		walk->flags = 0;
+	}
+	else {
+		walk->size = walk->version == 4 ? syncsafe(hdr + 4) : be32(hdr + 4);
+		walk->flags = hdr[9];
+	}
+	walk->pos += headerSize;
+	if(!walk->size || walk->pos + walk->size > walk->end) {
+		return 0;
+	}
+	walk->pos += walk->size;
+	return 1;
+}
+
+// Compressed or encrypted frames are skipped, they're never text or pictures in practice
+static int id3Unreadable(struct id3_walk *walk) {
+	return walk->version == 3 ? walk->flags & 0xC0 : walk->version == 4 ? walk->flags & 0x0C : 0;
+}
+
+// Any v2.4 data length indicator in front of the frame data, which is skipped.
+static u32 id3DataOffset(struct id3_walk *walk) {
+	return walk->version == 4 && (walk->flags & 0x01) ? 4 : 0;
+}
+
+static int id3Unsynced(struct id3_walk *walk) {
+	return walk->unsync || (walk->version == 4 && (walk->flags & 0x02));
+}
+
+// Returns the TAG_ bits it found.
+static int readId3v2(FILE *fp, struct track_tags *tags) {
+	struct id3_walk walk;
+	if(!id3Start(fp, &walk)) {
+		return 0;
+	}
+	int found = 0;
+	u8 frame[TAGS_FRAME_READ];
+	char value[TAGS_FIELD_SIZE];
+	while(found != TAG_ALL && id3Next(fp, &walk)) {
+		int field = frameField(walk.id, walk.version);
+		if(!field || (found & field) || id3Unreadable(&walk)) {
+			continue;
+		}
+		u32 len = MIN(walk.size, TAGS_FRAME_READ);
+		if(fread(frame, 1, len, fp) != len) {
+			break;
+		}
+		u32 skip = MIN(len, id3DataOffset(&walk));
+		u8 *data = frame + skip;
+		len -= skip;
+		if(id3Unsynced(&walk)) {
+			len = resync(data, len);
+		}
+		decodeText(value, data, len);
+		if(value[0]) {
+			setField(tags, field, value);
+			found |= field;
+		}
+	}
+	return found;
+}
+
+// Where the image in an APIC (or v2.2 PIC) frame starts, the front cover if
+// there's more than one. Pictures are read straight out of the file, so
+// unsynchronised ones are passed over. Returns 0 if there isn't one.
+u32 tagsFindPicture(FILE *fp, u32 *size) {
+	struct id3_walk walk;
+	if(!id3Start(fp, &walk)) {
+		return 0;
+	}
+	u8 frame[TAGS_FRAME_READ];
+	u32 found = 0;
+	while(id3Next(fp, &walk)) {
+		if(memcmp(walk.id, walk.version == 2 ? "PIC" : "APIC", walk.version == 2 ? 3 : 4)
+			|| id3Unreadable(&walk) || id3Unsynced(&walk)) {
+			continue;
+		}
+		u32 len = MIN(walk.size, TAGS_FRAME_READ);
+		if(fread(frame, 1, len, fp) != len) {
+			break;
+		}
+		// Text encoding, MIME type (v2.2 has a three letter format instead), picture type, description
+		u32 i = id3DataOffset(&walk);
+		int wide = i < len && (frame[i] == 1 || frame[i] == 2);
+		i++;
+		if(walk.version == 2) {
+			i += 3;
+		}
+		else {
+			for(; i < len && frame[i]; i++);
+			i++;
+		}
+		int front = i < len && frame[i] == 3;
+		i++;
+		if(wide) {
+			for(; i + 1 < len && (frame[i] || frame[i+1]); i += 2);
+			i += 2;
+		}
+		else {
+			for(; i < len && frame[i]; i++);
+			i++;
+		}
+		if(i >= len) {
+			continue;	// a description that long isn't worth the trouble
+		}
+		if(!found || front) {
+			found = walk.pos - walk.size + i;
+			*size = walk.size - i;
+		}
+		if(front) {
+			break;
+		}
+	}
+	return found;
+}
+
+// ID3v1 fields are space or NUL padded Latin-1, only used for what ID3v2 didn't have.
+static void readId3v1(FILE *fp, struct track_tags *tags, int found) {
+	u8 tag[128];
+	if(fseek(fp, -128, SEEK_END) || fread(tag, 1, 128, fp) != 128 || memcmp(tag, "TAG", 3)) {
+		return;
+	}
+	static const struct {
+		int field;
+		int offset;
+	} fields[] = {
+		{TAG_TITLE, 3},
+		{TAG_ARTIST, 33},
+		{TAG_ALBUM, 63}
+	};
+	char value[31];
+	for(int i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+		if(!(found & fields[i].field)) {
+			memcpy(value, tag + fields[i].offset, 30);
+			value[30] = 0;
+			trimField(value, strlen(value));
+			setField(tags, fields[i].field, value);
+		}
+	}
+	// ID3v1.1 keeps the track number at the end of the comment
+	if(!(found & TAG_TRACK) && !tag[125] && tag[126]) {
+		tags->track = tag[126];
+	}
+}
+
+static u32 recordChecksum(struct tags_record *rec) {
+	return hashBytes(0x811C9DC5, rec, offsetof(struct tags_record, checksum));
+}
+
+static struct tags_index_slot* indexSlot(u32 key) {
+	u32 mask = storeIndexSize - 1;
+	u32 i = key & mask;
+	while(storeIndex[i].record && storeIndex[i].key != key) {
+		i = (i + 1) & mask;
+	}
+	return &storeIndex[i];
+}
+
+static void indexPut(u32 key, u32 record) {
+	// Doubles at half full, a track that changed just points at its newer record
+	if((storeRecords + 1) * 2 > storeIndexSize) {
+		struct tags_index_slot *old = storeIndex;
+		u32 oldSize = storeIndexSize;
+		u32 newSize = MAX(TAGS_INDEX_MIN, oldSize * 2);
+		struct tags_index_slot *grown = calloc(newSize, sizeof(struct tags_index_slot));
+		if(!grown) {
+			return;		// it's only not found again next boot
+		}
+		storeIndex = grown;
+		storeIndexSize = newSize;
+		for(u32 i = 0; i < oldSize; i++) {
+			if(old[i].record) {
+				*indexSlot(old[i].key) = old[i];
+			}
+		}
+		free(old);
+	}
+	struct tags_index_slot *slot = indexSlot(key);
+	slot->key = key;
+	slot->record = record + 1;
+}
+
+// Reads the keys of every record in the store, up to the first bad one. Appending
+// starts there, which takes care of a record cut short by the power going.
+static void loadStore() {
+	FILE *fp = fopen(TAGS_STORE_FILE, "rb");
+	if(!fp) {
+		return;
+	}
+	struct tags_store_header hdr;
+	struct tags_record rec;
+	if(fread(&hdr, 1, sizeof(hdr), fp) == sizeof(hdr) && hdr.magic == TAGS_STORE_MAGIC && hdr.version == TAGS_STORE_VERSION) {
+		while(fread(&rec, 1, sizeof(rec), fp) == sizeof(rec) && rec.checksum == recordChecksum(&rec)) {
+			indexPut(rec.key, storeRecords);
+			storeRecords++;
+		}
+	}
+	fclose(fp);
+	print_gecko("tags.dat has %u tracks\r\n", storeRecords);
+}
+
+static int storeFind(u32 key, struct stat *src, struct track_tags *tags) {
+	struct tags_index_slot *slot = storeIndexSize ? indexSlot(key) : NULL;
+	if(!slot || !slot->record) {
+		return 0;
+	}
+	FILE *fp = fopen(TAGS_STORE_FILE, "rb");
+	if(!fp) {
+		return 0;
+	}
+	struct tags_record rec;
+	int found = !fseek(fp, sizeof(struct tags_store_header) + (slot->record - 1) * sizeof(rec), SEEK_SET)
+		&& fread(&rec, 1, sizeof(rec), fp) == sizeof(rec) && rec.checksum == recordChecksum(&rec)
+		&& rec.key == key && rec.src_size == (u32)src->st_size && rec.src_mtime == (u32)src->st_mtime;
+	fclose(fp);
+	if(found) {
+		*tags = rec.tags;
+	}
+	return found;
+}
+
+static void storeAdd(u32 key, struct stat *src, struct track_tags *tags) {
+	struct tags_record rec;
+	memset(&rec, 0, sizeof(rec));
+	rec.key = key;
+	rec.src_size = src->st_size;
+	rec.src_mtime = src->st_mtime;
+	rec.tags = *tags;
+	rec.checksum = recordChecksum(&rec);
+
+	FILE *fp = storeRecords ? fopen(TAGS_STORE_FILE, "r+b") : NULL;
+	if(!fp) {
+		struct tags_store_header hdr = {TAGS_STORE_MAGIC, TAGS_STORE_VERSION};
+		storeRecords = 0;
+		fp = fopen(TAGS_STORE_FILE, "wb");
+		if(!fp || fwrite(&hdr, 1, sizeof(hdr), fp) != sizeof(hdr)) {
+			error_gecko("tags.dat failed to create\r\n");
+			if(fp) {
+				fclose(fp);
+			}
+			return;
+		}
+	}
+	if(fseek(fp, sizeof(struct tags_store_header) + storeRecords * sizeof(rec), SEEK_SET)
+		|| fwrite(&rec, 1, sizeof(rec), fp) != sizeof(rec)) {
+		error_gecko("tags.dat failed to write\r\n");
+		fclose(fp);
+		return;
+	}
+	fclose(fp);
+	indexPut(key, storeRecords);
+	storeRecords++;
+}
+
+static void readTrackTags(int albumNum, int trackNum, struct track_tags *tags) {
+	memset(tags, 0, sizeof(struct track_tags));
+	const char *name = albumTrackName(albumNum, trackNum);
+	if(!name) {
+		return;
+	}
+	char path[1024];
+	sprintf(path, "%s/%s/%s", ALBUMS_DIR, albumName(albumNum), name);
+	FILE *fp = fopen(path, "rb");
+	struct stat src;
+	if(!fp || fstat(fileno(fp), &src)) {
+		if(fp) {
+			fclose(fp);
+		}
+		return;
+	}
+	u32 key = trackKey(albumNum, trackNum);
+	if(!storeFind(key, &src, tags)) {
+		readId3v1(fp, tags, readId3v2(fp, tags));
+		debug_gecko("Tags for %s: %s / %s / %s\r\n", name, tags->artist, tags->album, tags->title);
+		storeAdd(key, &src, tags);
+	}
+	fclose(fp);
+}
+
+static void* tagsWorker(void *arg) {
+	loadStore();
+	LWP_MutexLock(tagsMutex);
+	while(1) {
+		int i;
+		for(i = 0; i < TAGS_WANTED && wanted[i].albumNum == -1; i++);
+		if(i == TAGS_WANTED || num_ready == TAGS_WANTED) {
+			LWP_CondWait(tagsCond, tagsMutex);
+			continue;
+		}
+		reading.albumNum = wanted[i].albumNum;
+		reading.trackNum = wanted[i].trackNum;
+		wanted[i].albumNum = -1;
+		LWP_MutexUnlock(tagsMutex);
+		struct track_tags tags;
+		readTrackTags(reading.albumNum, reading.trackNum, &tags);
+		LWP_MutexLock(tagsMutex);
+		ready[num_ready].albumNum = reading.albumNum;
+		ready[num_ready].trackNum = reading.trackNum;
+		ready[num_ready].tags = tags;
+		num_ready++;
+		reading.albumNum = -1;
+	}
+	LWP_MutexUnlock(tagsMutex);
+	return NULL;
+}
+
+static struct tags_entry* findCached(int albumNum, int trackNum) {
+	for(int i = 0; i < TAGS_CACHE_ENTRIES; i++) {
+		if(cache[i].albumNum == albumNum && cache[i].trackNum == trackNum) {
+			return &cache[i];
+		}
+	}
+	return NULL;
+}
+
+// Must be called with tagsMutex held
+static void addWanted(int albumNum, int trackNum, int first) {
+	if(albumNum < 0 || albumNum >= num_albums || findCached(albumNum, trackNum)
+		|| (reading.albumNum == albumNum && reading.trackNum == trackNum)) {
+		return;
+	}
+	for(int i = 0; i < num_ready; i++) {
+		if(ready[i].albumNum == albumNum && ready[i].trackNum == trackNum) {
+			return;
+		}
+	}
+	int slot = -1;
+	for(int i = 0; i < TAGS_WANTED; i++) {
+		if(wanted[i].albumNum == albumNum && wanted[i].trackNum == trackNum) {
+			return;
+		}
+		if(wanted[i].albumNum == -1 && slot == -1) {
+			slot = i;
+		}
+	}
+	if(first) {
+		// Pushes the rest down, the last one falls off if it's full
+		memmove(&wanted[1], &wanted[0], sizeof(wanted[0]) * (TAGS_WANTED - 1));
+		slot = 0;
+	}
+	if(slot != -1) {
+		wanted[slot].albumNum = albumNum;
+		wanted[slot].trackNum = trackNum;
+	}
+}
+
+void tagsInit() {
+	for(int i = 0; i < TAGS_CACHE_ENTRIES; i++) {
+		cache[i].albumNum = -1;
+	}
+	for(int i = 0; i < TAGS_WANTED; i++) {
+		wanted[i].albumNum = -1;
+	}
+	reading.albumNum = -1;
+	LWP_MutexInit(&tagsMutex, false);
+	LWP_CondInit(&tagsCond);
+	LWP_CreateThread(&tagsThread, tagsWorker, NULL, NULL, TAGS_WORKER_STACK_SIZE, TAGS_WORKER_PRIORITY);
+}
+
+// Never blocks, NULL until the worker has read them. Asking is what gets them read.
+const struct track_tags* tagsGet(int albumNum, int trackNum) {
+	if(albumNum < 0) {
+		return NULL;
+	}
+	struct tags_entry *entry = findCached(albumNum, trackNum);
+	if(entry) {
+		entry->lastUse = ++useCounter;
+		return &entry->tags;
+	}
+	LWP_MutexLock(tagsMutex);
+	addWanted(albumNum, trackNum, 1);
+	LWP_CondSignal(tagsCond);
+	LWP_MutexUnlock(tagsMutex);
+	return NULL;
+}
+
+// Read a track's tags ahead of time, e.g. the next queued track.
+void tagsPrefetch(int albumNum, int trackNum) {
+	LWP_MutexLock(tagsMutex);
+	addWanted(albumNum, trackNum, 0);
+	LWP_CondSignal(tagsCond);
+	LWP_MutexUnlock(tagsMutex);
+}
+
+// Picks up what the worker has read, once a frame. Returns 1 if anything new came in.
+int tagsUpdate() {
+	if(!num_ready) {
+		return 0;
+	}
+	LWP_MutexLock(tagsMutex);
+	for(int i = 0; i < num_ready; i++) {
+		struct tags_entry *slot = &cache[0];
+		for(int j = 1; j < TAGS_CACHE_ENTRIES && slot->albumNum != -1; j++) {
+			if(cache[j].albumNum == -1 || cache[j].lastUse < slot->lastUse) {
+				slot = &cache[j];
+			}
+		}
+		*slot = ready[i];
+		slot->lastUse = ++useCounter;
+	}
+	num_ready = 0;
+	LWP_CondSignal(tagsCond);
+	LWP_MutexUnlock(tagsMutex);
+	return 1;
+}
@@ -0,0 +1,29 @@
+#ifndef __TAGS_H__
+#define __TAGS_H__
+
+#include <gccore.h>
+#include <stdio.h>
+#include "paths.h"
+
+#define TAGS_STORE_FILE WAKEMII_DIR "/cache/tags.dat"
+
+#define TAGS_FIELD_SIZE 64			// longer titles and names are cut short
+#define TAGS_FRAME_READ 256			// at most this much of a frame is read, the rest is skipped over
+#define TAGS_CACHE_ENTRIES 16		// read tags kept in memory
+#define TAGS_WANTED 4
+
+struct track_tags {
+	char title[TAGS_FIELD_SIZE];	// Latin-1, empty if the file didn't say
+	char artist[TAGS_FIELD_SIZE];
+	char album[TAGS_FIELD_SIZE];
+	u32 duration_ms;				// TLEN, 0 if there wasn't one
+	u16 track;						// 0 if there wasn't one
+};
+
+void tagsInit();
+const struct track_tags* tagsGet(int albumNum, int trackNum);
+void tagsPrefetch(int albumNum, int trackNum);
+int tagsUpdate();
+u32 tagsFindPicture(FILE *fp, u32 *size);
+
+#endif
@@ -0,0 +1,213 @@
+/*===========================================
+        WakeMii - Batched tile-set text
+
+        A drop in for GRRLIB_Printf with tile-set fonts. Each string is laid
+        out once into a list of glyph quads and kept until a different
+        string turns up in its place, the lines queued up for a frame are
+        then drawn with one texture setup and one GX_Begin per font rather
+        than one of each for every character. Quads land exactly where
+        GRRLIB_DrawTile would have put them.
+============================================*/
+#include <grrlib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "text.h"
+
+#define TEXT_CACHE_LINES 64
+#define TEXT_MAX_LEN 1024		// same as GRRLIB_Printf
+
+struct glyph_quad {
+	f32 x0, y0, x1, y1;
+	f32 s0, t0, s1, t1;
+};
+
+struct text_line {
+	GRRLIB_texImg *font;	// NULL when the slot is free
+	u32 hash;
+	f32 xpos;
+	f32 ypos;
+	f32 zoom;
+	u32 color;
+	char *text;
+	int len;
+	struct glyph_quad *glyphs;
+	u32 lastUse;
+};
+
+static struct text_line lines[TEXT_CACHE_LINES];
+static struct text_line *queued[TEXT_CACHE_LINES];
+static int num_queued;
+static u32 useCounter;
+static u32 drawnUpTo;		// lines used after this haven't been drawn yet and can't be evicted
+
+static u32 hashText(const char *text, int len) {
+	u32 hash = 0x811C9DC5;	// FNV-1a
+	for(int i = 0; i < len; i++) {
+		hash ^= (u8)text[i];
+		hash *= 0x01000193;
+	}
+	return hash;
+}
+
+// Same placement and texture coordinates as GRRLIB_Printf -> GRRLIB_DrawTile with no rotation.
+static void layoutLine(struct text_line *line) {
+	GRRLIB_texImg *font = line->font;
+	f32 halfW = font->tilew * 0.5f;
+	f32 halfH = font->tileh * 0.5f;
+	f32 advance = font->tilew * line->zoom;
+	f32 centreY = line->ypos + halfH + font->handley - font->offsety - line->zoom * font->handley;
+	for(int i = 0; i < line->len; i++) {
+		struct glyph_quad *g = &line->glyphs[i];
+		int frame = (u8)line->text[i] - font->tilestart;
+		f32 centreX = line->xpos + i * advance + halfW + font->handlex - font->offsetx - line->zoom * font->handlex;
+		g->x0 = centreX - halfW * line->zoom;
+		g->x1 = centreX + halfW * line->zoom;
+		g->y0 = centreY - halfH * line->zoom;
+		g->y1 = centreY + halfH * line->zoom;
+		g->s0 = (((frame % font->nbtilew)) * font->tilew) / (f32)font->w + 0.001f / font->w;
+		g->s1 = (((frame % font->nbtilew) + 1) * font->tilew) / (f32)font->w - 0.001f / font->w;
+		g->t0 = (((int)(frame / font->nbtilew)) * font->tileh) / (f32)font->h + 0.001f / font->h;
+		g->t1 = (((int)(frame / font->nbtilew) + 1) * font->tileh) / (f32)font->h - 0.001f / font->h;
+	}
+}
+
+static void freeLine(struct text_line *line) {
+	free(line->text);
+	free(line->glyphs);
+	memset(line, 0, sizeof(struct text_line));
+}
+
+static struct text_line* findLine(GRRLIB_texImg *font, f32 xpos, f32 ypos, f32 zoom, u32 color, const char *text, int len) {
+	u32 hash = hashText(text, len);
+	struct text_line *victim = NULL;
+	for(int i = 0; i < TEXT_CACHE_LINES; i++) {
+		struct text_line *line = &lines[i];
+		if(line->font == font && line->hash == hash && line->len == len && line->xpos == xpos && line->ypos == ypos
+			&& line->zoom == zoom && line->color == color && !memcmp(line->text, text, len)) {
+			return line;
+		}
+		if(!line->font) {
+			victim = line;
+		}
+		else if(line->lastUse <= drawnUpTo && (!victim || (victim->font && line->lastUse < victim->lastUse))) {
+			victim = line;
+		}
+	}
+	if(!victim) {
+		// Every line is waiting to be drawn, get them out of the way
+		textFlush();
+		return findLine(font, xpos, ypos, zoom, color, text, len);
+	}
+	freeLine(victim);
+	victim->text = malloc(len);
+	victim->glyphs = malloc(len * sizeof(struct glyph_quad));
+	if(!victim->text || !victim->glyphs) {
+		freeLine(victim);
+		return NULL;
+	}
+	memcpy(victim->text, text, len);
+	victim->font = font;
+	victim->hash = hash;
+	victim->len = len;
+	victim->xpos = xpos;
+	victim->ypos = ypos;
+	victim->zoom = zoom;
+	victim->color = color;
+	layoutLine(victim);
+	return victim;
+}
+
+// Queues a line of text to be drawn by the next textFlush(), takes the same arguments as GRRLIB_Printf.
+void textPrintf(f32 xpos, f32 ypos, GRRLIB_texImg *font, u32 color, f32 zoom, const char *fmt, ...) {
+	char text[TEXT_MAX_LEN];
+	if(font == NULL || font->data == NULL) {
+		return;
+	}
+	va_list arglist;
+	va_start(arglist, fmt);
+	int len = vsnprintf(text, sizeof(text), fmt, arglist);
+	va_end(arglist);
+	if(len <= 0) {
+		return;
+	}
+	len = MIN(len, TEXT_MAX_LEN - 1);
+	struct text_line *line = findLine(font, xpos, ypos, zoom, color, text, len);
+	if(!line) {
+		return;
+	}
+	if(num_queued == TEXT_CACHE_LINES) {
+		textFlush();
+	}
+	line->lastUse = ++useCounter;
+	queued[num_queued++] = line;
+}
+
+// Draws everything queued so far, call before drawing anything that should go on top of the text.
+void textFlush() {
+	int done = 0;
+	while(done < num_queued) {
+		// Everything left in the same font goes in one batch
+		GRRLIB_texImg *font = queued[done]->font;
+		GXTexObj texObj;
+		GX_InitTexObj(&texObj, font->data, font->w, font->h, GX_TF_RGBA8, GX_CLAMP, GX_CLAMP, GX_FALSE);
+		if(!GRRLIB_Settings.antialias) {
+			GX_InitTexObjLOD(&texObj, GX_NEAR, GX_NEAR, 0.0f, 0.0f, 0.0f, 0, 0, GX_ANISO_1);
+		}
+		GX_LoadTexObj(&texObj, GX_TEXMAP0);
+		GX_SetTevOp(GX_TEVSTAGE0, GX_MODULATE);
+		GX_SetVtxDesc(GX_VA_TEX0, GX_DIRECT);
+		GX_LoadPosMtxImm(GXmodelView2D, GX_PNMTX0);
+		while(1) {
+			// GX_Begin takes a u16 vertex count, a batch is as many whole lines as fit
+			u32 numGlyphs = 0;
+			int last = done;
+			for(int i = done; i < num_queued; i++) {
+				if(queued[i] == NULL || queued[i]->font != font) {
+					continue;
+				}
+				if(numGlyphs + queued[i]->len > 0xFFFF / 4) {
+					break;
+				}
+				numGlyphs += queued[i]->len;
+				last = i + 1;
+			}
+			if(!numGlyphs) {
+				break;
+			}
+			GX_Begin(GX_QUADS, GX_VTXFMT0, numGlyphs * 4);
+			for(int i = done; i < last; i++) {
+				struct text_line *line = queued[i];
+				if(line == NULL || line->font != font) {
+					continue;
+				}
+				for(int j = 0; j < line->len; j++) {
+					struct glyph_quad *g = &line->glyphs[j];
+					GX_Position3f32(g->x0, g->y0, 0);
+					GX_Color1u32(line->color);
+					GX_TexCoord2f32(g->s0, g->t0);
+					GX_Position3f32(g->x1, g->y0, 0);
+					GX_Color1u32(line->color);
+					GX_TexCoord2f32(g->s1, g->t0);
+					GX_Position3f32(g->x1, g->y1, 0);
+					GX_Color1u32(line->color);
+					GX_TexCoord2f32(g->s1, g->t1);
+					GX_Position3f32(g->x0, g->y1, 0);
+					GX_Color1u32(line->color);
+					GX_TexCoord2f32(g->s0, g->t1);
+				}
+				queued[i] = NULL;
+			}
+			GX_End();
+		}
+		GX_SetTevOp(GX_TEVSTAGE0, GX_PASSCLR);
+		GX_SetVtxDesc(GX_VA_TEX0, GX_NONE);
+		// Move past everything that's been drawn
+		while(done < num_queued && queued[done] == NULL) {
+			done++;
+		}
+	}
+	num_queued = 0;
+	drawnUpTo = useCounter;
+}
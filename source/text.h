@@ -0,0 +1,9 @@
+#ifndef __TEXT_H__
+#define __TEXT_H__
+
+#include <grrlib.h>
+
+void textPrintf(f32 xpos, f32 ypos, GRRLIB_texImg *font, u32 color, f32 zoom, const char *fmt, ...);
+void textFlush();
+
+#endif
@@ -0,0 +1,211 @@
+// The chunked album/track tables against the album pointer array they replaced
+// (one malloc'd struct, name and track blob per album, track offsets built on
+// first use), on libraries of 20k and 50k albums built straight in memory.
+#include "library.c"
+#include <malloc.h>
+#include "harness.h"
+
+#define TRACKS_PER_ALBUM 10
+#define LOOKUPS 2000000
+#define PASSES 20
+
+// As library.h had it before the tables
+struct old_album {
+	char* name;
+	int num_entries;
+	enum cover_type_t cover_type;
+	time_t mtime;
+	char* tracks;
+	u32 tracks_size;
+	u32* track_offsets;
+};
+
+static struct old_album **oldAlbums;
+static int num_oldAlbums;
+static int sizes[] = {20000, 50000};
+static u32 lookupAlbum[LOOKUPS];
+static u8 lookupTrack[LOOKUPS];
+static char label[128];
+static volatile u32 sink;
+
+static void albumText(int albumNum, char *name, char *tracks, u32 *tracksSize) {
+	sprintf(name, "Artist %d - Album Title %d", albumNum % 3000, albumNum);
+	u32 size = 0;
+	for(int i = 0; i < TRACKS_PER_ALBUM; i++) {
+		size += sprintf(tracks + size, "%02d Some Track Name %d.mp3", i + 1, albumNum * 7 + i) + 1;
+	}
+	*tracksSize = size;
+}
+
+static size_t heapUsed() {
+	return mallinfo2().uordblks;
+}
+
+static void buildOld(int numAlbums) {
+	char name[128], tracks[1024];
+	u32 tracksSize;
+	oldAlbums = malloc(numAlbums * sizeof(struct old_album*));
+	for(int i = 0; i < numAlbums; i++) {
+		albumText(i, name, tracks, &tracksSize);
+		struct old_album *album = calloc(1, sizeof(struct old_album));
+		album->name = strdup(name);
+		album->num_entries = TRACKS_PER_ALBUM;
+		album->tracks = malloc(tracksSize);
+		memcpy(album->tracks, tracks, tracksSize);
+		album->tracks_size = tracksSize;
+		oldAlbums[i] = album;
+	}
+	num_oldAlbums = numAlbums;
+}
+
+static const char* oldTrackName(int albumNum, int entryNum) {
+	struct old_album *album = oldAlbums[albumNum];
+	if(album->track_offsets == NULL) {
+		u32 *offsets = malloc(album->num_entries * sizeof(u32));
+		u32 pos = 0;
+		for(int i = 0; i < album->num_entries; i++) {
+			offsets[i] = pos;
+			pos += strlen(album->tracks + pos) + 1;
+		}
+		album->track_offsets = offsets;
+	}
+	return album->tracks + album->track_offsets[entryNum];
+}
+
+static void freeOld() {
+	for(int i = 0; i < num_oldAlbums; i++) {
+		free(oldAlbums[i]->name);
+		free(oldAlbums[i]->tracks);
+		free(oldAlbums[i]->track_offsets);
+		free(oldAlbums[i]);
+	}
+	free(oldAlbums);
+}
+
+static void buildTables(int numAlbums) {
+	char name[128], tracks[1024];
+	u32 tracksSize;
+	int stored = 1;
+	LWP_MutexInit(&poolMutex, false);
+	for(int i = 0; i < numAlbums; i++) {
+		albumText(i, name, tracks, &tracksSize);
+		struct album album = {0};
+		album.num_entries = TRACKS_PER_ALBUM;
+		stored &= storeAlbum(&album, name, tracks);
+		publishAlbum(&album);
+	}
+	CHECK(stored);
+	CHECK_EQ(num_albums, numAlbums);
+}
+
+static void report(const char *what, int numAlbums, double value, const char *unit) {
+	snprintf(label, sizeof(label), "%s, %dk albums", what, numAlbums / 1000);
+	benchReport(label, value, unit);
+}
+
+static void benchLayouts() {
+	int numAlbums = num_oldAlbums;
+	u32 seed = 12345;
+	for(int i = 0; i < LOOKUPS; i++) {
+		seed = seed * 1664525 + 1013904223;
+		lookupAlbum[i] = (seed >> 8) % numAlbums;
+		lookupTrack[i] = (seed >> 4) % TRACKS_PER_ALBUM;
+	}
+	// Same names both ways
+	int same = 1;
+	for(int i = 0; i < numAlbums; i += 97) {
+		same &= !strcmp(albumName(i), oldAlbums[i]->name);
+		same &= !strcmp(albumTrackName(i, i % TRACKS_PER_ALBUM), oldTrackName(i, i % TRACKS_PER_ALBUM));
+	}
+	CHECK(same);
+
+	// Random track lookups, as shuffle and the album browser do. The old layout's
+	// offsets are all built by now, so this is just the pointer chasing.
+	for(int i = 0; i < numAlbums; i++) {
+		oldTrackName(i, 0);
+	}
+	u32 sum = 0;
+	u64 start = gettime();
+	for(int i = 0; i < LOOKUPS; i++) {
+		sum += oldTrackName(lookupAlbum[i], lookupTrack[i])[3];
+	}
+	report("track lookup, pointer array", numAlbums, elapsedMs(start) * 1000000 / LOOKUPS, "ns");
+	start = gettime();
+	for(int i = 0; i < LOOKUPS; i++) {
+		sum += albumTrackName(lookupAlbum[i], lookupTrack[i])[3];
+	}
+	report("track lookup, tables", numAlbums, elapsedMs(start) * 1000000 / LOOKUPS, "ns");
+
+	// Walking every album's track count, as picking a random track across the library does
+	start = gettime();
+	for(int p = 0; p < PASSES; p++) {
+		for(int i = 0; i < numAlbums; i++) {
+			sum += oldAlbums[i]->num_entries;
+		}
+	}
+	report("track count walk, pointer array", numAlbums, elapsedMs(start) * 1000 / PASSES, "us");
+	start = gettime();
+	for(int p = 0; p < PASSES; p++) {
+		for(int i = 0; i < numAlbums; i++) {
+			sum += albumNumEntries(i);
+		}
+	}
+	report("track count walk, tables", numAlbums, elapsedMs(start) * 1000 / PASSES, "us");
+
+	// Every track name in order, as writing library.idx does
+	start = gettime();
+	for(int p = 0; p < PASSES; p++) {
+		for(int i = 0; i < numAlbums; i++) {
+			struct old_album *album = oldAlbums[i];
+			for(int j = 0; j < album->num_entries; j++) {
+				sum += album->tracks[album->track_offsets[j]];
+			}
+		}
+	}
+	report("track name walk, pointer array", numAlbums, elapsedMs(start) * 1000 / PASSES, "us");
+	start = gettime();
+	for(int p = 0; p < PASSES; p++) {
+		for(int i = 0; i < numAlbums; i++) {
+			u32 first = albumChunks[i / ALBUM_CHUNK_SIZE]->first_track[i % ALBUM_CHUNK_SIZE];
+			u32 count = albumChunks[i / ALBUM_CHUNK_SIZE]->num_entries[i % ALBUM_CHUNK_SIZE];
+			for(u32 j = 0; j < count; j++) {
+				sum += trackName(first + j)[0];
+			}
+		}
+	}
+	report("track name walk, tables", numAlbums, elapsedMs(start) * 1000 / PASSES, "us");
+	sink = sum;
+}
+
+static void benchSize(int numAlbums) {
+	size_t before = heapUsed();
+	buildOld(numAlbums);
+	// With the offsets every album gets once it's been played from
+	for(int i = 0; i < numAlbums; i++) {
+		oldTrackName(i, 0);
+	}
+	size_t oldBytes = heapUsed() - before;
+	before = heapUsed();
+	buildTables(numAlbums);
+	size_t tableBytes = heapUsed() - before;
+	report("memory, pointer array", numAlbums, oldBytes / 1024.0, "KB");
+	report("memory, tables", numAlbums, tableBytes / 1024.0, "KB");
+	CHECK(tableBytes < oldBytes);
+	benchLayouts();
+	freeOld();
+}
+
+static void bench20k() {
+	benchSize(sizes[0]);
+}
+
+static void bench50k() {
+	benchSize(sizes[1]);
+}
+
+int main() {
+	// Each in a process of its own so the tables start out empty
+	runIsolated(bench20k);
+	runIsolated(bench50k);
+	return testsFinish("bench_albums");
+}
@@ -0,0 +1,153 @@
+// Every decoder backend built in, on ten seconds of notes and hi-hats encoded at a range of
+// bitrates: how many times faster than realtime it decodes, and its PSNR against the
+// signal that was encoded and, for lite when libmad's built in, against libmad's output
+#include <gccore.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ogc/lwp_watchdog.h>
+#include "decoder.h"
+#include "settings.h"
+#include "harness.h"
+#include "mp3enc.h"
+
+#define SECONDS 10
+#define MAX_SAMPLES (44100 * SECONDS)
+#define RUNS 3
+
+struct source {
+	const u8 *data;
+	u32 len;
+	u32 pos;
+};
+
+struct corpus_entry {
+	u32 sampleRate;
+	int channels;
+	u32 bitrate;
+	int ms;
+	const char *name;
+};
+
+static const struct corpus_entry corpus[] = {
+	{44100, 2, 64, 1, "64kbps joint"},
+	{44100, 2, 128, 1, "128kbps joint"},
+	{44100, 2, 192, 0, "192kbps stereo"},
+	{44100, 2, 320, 0, "320kbps stereo"},
+	{44100, 1, 96, 0, "96kbps mono"},
+	{22050, 2, 64, 1, "22kHz 64kbps joint"}
+};
+
+static s16 pcm[MAX_SAMPLES * 2];
+static s16 decoded[(MAX_SAMPLES + 8192) * 2];
+static s16 reference[(MAX_SAMPLES + 8192) * 2];
+static char label[128];
+
+static s32 sourceRead(void *cbdata, void *dst, s32 size) {
+	struct source *src = cbdata;
+	s32 n = MIN((u32)size, src->len - src->pos);
+	memcpy(dst, src->data + src->pos, n);
+	src->pos += n;
+	return n;
+}
+
+static u32 decodeAll(const struct decoder_backend *backend, const u8 *mp3, u32 len, s16 *out) {
+	static struct decoder_pcm frame;
+	struct source src = {mp3, len, 0};
+	void *dec = backend->open(sourceRead, &src);
+	u32 samples = 0;
+	while(backend->decode(dec, &frame)) {
+		u32 n = MIN(frame.count, MAX_SAMPLES + 8192 - samples);
+		memcpy(out + samples * 2, frame.samples, n * 4);
+		samples += n;
+	}
+	backend->close(dec);
+	return samples;
+}
+
+// A chord a quarter second, each note decaying, and a burst of noise on every other
+static void makeMusic(u32 samples, u32 sampleRate, int channels) {
+	static const float notes[8] = {220.0f, 261.6f, 329.6f, 392.0f, 440.0f, 523.3f, 659.3f, 784.0f};
+	srand(1);
+	for(u32 i = 0; i < samples; i++) {
+		u32 beat = i / (sampleRate / 4);
+		float t = (float)(i % (sampleRate / 4)) / sampleRate;
+		float decay = expf(-6 * t);
+		for(int ch = 0; ch < channels; ch++) {
+			float v = 0;
+			for(int n = 0; n < 3; n++) {
+				float f = notes[(beat + n * 2 + ch) % 8];
+				for(int h = 1; h <= 4; h++) {
+					v += 0.12f / h * decay * sinf(2 * M_PI * f * h * i / sampleRate);
+				}
+			}
+			if(beat % 2 && t < 0.03f) {
+				v += (rand() % 2001 - 1000) / 4000.0f * (1 - t / 0.03f);
+			}
+			pcm[i * channels + ch] = v * 32767;
+		}
+	}
+}
+
+// Of what was decoded against what it should have been, the first delay samples skipped
+static double psnr(const s16 *got, const s16 *want, int wantChannels, u32 samples, u32 delay, int channels) {
+	double noise = 0;
+	for(u32 i = 0; i < samples; i++) {
+		for(int ch = 0; ch < channels; ch++) {
+			double diff = got[(i + delay) * 2 + ch] - want[i * wantChannels + ch];
+			noise += diff * diff;
+		}
+	}
+	return 10 * log10(32767.0 * 32767.0 * samples * channels / MAX(noise, 1));
+}
+
+static void benchEntry(const struct corpus_entry *c) {
+	struct mp3enc_options opts = {c->sampleRate, c->channels, c->bitrate, c->ms, 1};
+	u32 samples = c->sampleRate * SECONDS;
+	makeMusic(samples, c->sampleRate, c->channels);
+	u32 size;
+	u8 *mp3 = mp3Encode(pcm, samples, &opts, &size);
+	const struct decoder_backend *libmad = NULL;
+	u32 referenceSamples = 0;
+	for(int which = DECODER_LIBMAD; which <= DECODER_LITE; which++) {
+		const struct decoder_backend *backend = decoderGet(which);
+		if(which != DECODER_LIBMAD && backend == decoderGet(DECODER_LIBMAD)) {
+			// Not built in, so that's the one it fell back on again
+			continue;
+		}
+		double best = 0;
+		u32 got = 0;
+		for(int run = 0; run < RUNS; run++) {
+			u64 start = gettime();
+			got = decodeAll(backend, mp3, size, decoded);
+			double ms = elapsedMs(start);
+			best = run ? MIN(best, ms) : ms;
+		}
+		CHECK(got >= samples);
+		snprintf(label, sizeof(label), "%s %s", backend->name, c->name);
+		benchReport(label, SECONDS * 1000.0 / MAX(best, 0.001), "x realtime");
+		snprintf(label, sizeof(label), "%s %s PSNR/source", backend->name, c->name);
+		benchReport(label, psnr(decoded, pcm, c->channels, samples, MP3ENC_DELAY + backend->delay, c->channels), "dB");
+		if(!strcmp(backend->name, "libmad")) {
+			libmad = backend;
+			referenceSamples = got;
+			memcpy(reference, decoded, got * 4);
+		}
+		else if(libmad) {
+			CHECK_EQ(got, referenceSamples);
+			snprintf(label, sizeof(label), "%s %s PSNR/libmad", backend->name, c->name);
+			benchReport(label, psnr(decoded, reference, 2, MIN(got, referenceSamples), 0, 2), "dB");
+		}
+	}
+	free(mp3);
+}
+
+int main() {
+#ifdef NO_LIBMAD
+	printf("Built without libmad, so there's nothing to compare lite with but the source\n");
+#endif
+	for(int i = 0; i < sizeof(corpus) / sizeof(corpus[0]); i++) {
+		benchEntry(&corpus[i]);
+	}
+	return testsFinish("bench_decoder");
+}
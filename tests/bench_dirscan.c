@@ -0,0 +1,75 @@
+// A 5,000 file tree walked with dirScan against readdir() plus a stat() per entry
+#include <gccore.h>
+#include <ogc/lwp_watchdog.h>
+#include "harness.h"
+#include "dirscan.h"
+#include "library.h"
+
+#define NUM_DIRS 250
+#define FILES_PER_DIR 20
+#define PASSES 20
+
+static int walkStat() {
+	int files = 0;
+	DIR *top = opendir(ALBUMS_DIR);
+	struct dirent *entry;
+	while((entry = readdir(top)) != NULL) {
+		char path[512];
+		struct stat st;
+		snprintf(path, sizeof(path), "%s/%s", ALBUMS_DIR, entry->d_name);
+		if(entry->d_name[0] == '.' || stat(path, &st) || !(st.st_mode & _IFDIR)) {
+			continue;
+		}
+		DIR *dp = opendir(path);
+		struct dirent *file;
+		while((file = readdir(dp)) != NULL) {
+			char filePath[1024];
+			snprintf(filePath, sizeof(filePath), "%s/%s", path, file->d_name);
+			if(file->d_name[0] != '.' && !stat(filePath, &st) && !(st.st_mode & _IFDIR)) {
+				files++;
+			}
+		}
+		closedir(dp);
+	}
+	closedir(top);
+	return files;
+}
+
+static int walkDirScan() {
+	int files = 0;
+	dir_scan top, album;
+	struct dirent *entry;
+	dirScanOpen(&top, ALBUMS_DIR, DIRSCAN_DIRS);
+	while((entry = dirScanNext(&top, NULL)) != NULL) {
+		char path[512];
+		snprintf(path, sizeof(path), "%s/%s", ALBUMS_DIR, entry->d_name);
+		dirScanOpen(&album, path, DIRSCAN_FILES);
+		while(dirScanNext(&album, NULL)) {
+			files++;
+		}
+		dirScanClose(&album);
+	}
+	dirScanClose(&top);
+	return files;
+}
+
+int main() {
+	testDirEnter("bench");
+	makeAlbums(NUM_DIRS, FILES_PER_DIR, 0);
+	// Warm the caches first, the card doesn't have any but it evens things out
+	CHECK_EQ(walkStat(), NUM_DIRS * FILES_PER_DIR);
+	CHECK_EQ(walkDirScan(), NUM_DIRS * FILES_PER_DIR);
+
+	u64 start = gettime();
+	for(int i = 0; i < PASSES; i++) {
+		walkStat();
+	}
+	benchReport("readdir + stat, 5000 files", elapsedMs(start) / PASSES, "ms");
+	start = gettime();
+	for(int i = 0; i < PASSES; i++) {
+		walkDirScan();
+	}
+	benchReport("dirScan, 5000 files", elapsedMs(start) / PASSES, "ms");
+	testDirLeave();
+	return testsFinish("bench_dirscan");
+}
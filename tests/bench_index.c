@@ -0,0 +1,34 @@
+// How much of a boot's scan library.idx saves, on synthetic libraries of 10k to 100k tracks
+#include <gccore.h>
+#include <ogc/lwp_watchdog.h>
+#include <unistd.h>
+#include "harness.h"
+#include "library.h"
+
+#define TRACKS_PER_ALBUM 10
+
+static int sizes[] = {10000, 50000, 100000};
+
+static void timedScan() {
+	char label[64];
+	int indexed = access(LIBRARY_INDEX_FILE, F_OK) == 0;
+	u64 start = gettime();
+	startLibraryScan();
+	waitForScan();
+	double ms = elapsedMs(start);
+	snprintf(label, sizeof(label), "%s, %d tracks", indexed ? "with library.idx" : "full scan", num_tracks);
+	benchReport(label, ms, "ms");
+}
+
+int main() {
+	for(int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		testDirEnter("bench");
+		makeAlbums(sizes[i] / TRACKS_PER_ALBUM, TRACKS_PER_ALBUM, 24);
+		runIsolated(timedScan);			// writes the index
+		remove(LIBRARY_INDEX_FILE);
+		runIsolated(timedScan);			// writes it again, the first one had cold caches
+		runIsolated(timedScan);
+		testDirLeave();
+	}
+	return testsFinish("bench_index");
+}
@@ -0,0 +1,72 @@
+// Scanning, opening and stepping through synthetic libraries of 10k to 100k tracks
+#include <gccore.h>
+#include <ogc/lwp_watchdog.h>
+#include "harness.h"
+#include "library.h"
+#include "playlist.h"
+#include "settings.h"
+
+#define TRACKS_PER_ALBUM 10
+
+static int sizes[] = {10000, 50000, 100000};
+static char label[128];
+
+static void benchScan() {
+	u64 start = gettime();
+	startLibraryScan();
+	waitForScan();
+	double ms = elapsedMs(start);
+	snprintf(label, sizeof(label), "scan %d tracks", num_tracks);
+	benchReport(label, ms, "ms");
+
+	// Opening tracks all over the library
+	char name[256];
+	int opens = 2000;
+	start = gettime();
+	for(int i = 0; i < opens; i++) {
+		FILE *fp = getEntryFromIndex((i * 7919) % num_albums, i % TRACKS_PER_ALBUM, name);
+		if(fp) {
+			fclose(fp);
+		}
+	}
+	snprintf(label, sizeof(label), "getEntryFromIndex, %d tracks", num_tracks);
+	benchReport(label, elapsedMs(start) * 1000 / opens, "us/open");
+
+	// What the main loop does holding the D-pad
+	int steps = 10000000;
+	int album = 0, track = 0;
+	start = gettime();
+	for(int i = 0; i < steps; i++) {
+		stepEntry(i & 64 ? -1 : 1, &album, &track);
+	}
+	snprintf(label, sizeof(label), "stepEntry, %d tracks", num_tracks);
+	benchReport(label, elapsedMs(start) * 1000000 / steps, "ns/step");
+}
+
+static void benchSettings() {
+	CHECK(saveSettings());
+	int loads = 2000;
+	u64 start = gettime();
+	for(int i = 0; i < loads; i++) {
+		loadSettings();
+	}
+	benchReport("loadSettings", elapsedMs(start) * 1000 / loads, "us/load");
+	start = gettime();
+	for(int i = 0; i < loads; i++) {
+		saveSettings();
+	}
+	benchReport("saveSettings", elapsedMs(start) * 1000 / loads, "us/save");
+}
+
+int main() {
+	for(int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		testDirEnter("bench");
+		makeAlbums(sizes[i] / TRACKS_PER_ALBUM, TRACKS_PER_ALBUM, 24);
+		runIsolated(benchScan);
+		testDirLeave();
+	}
+	testDirEnter("bench");
+	benchSettings();
+	testDirLeave();
+	return testsFinish("bench_library");
+}
@@ -0,0 +1,83 @@
+// Shuffle steps and saves, and replaying a saved round on boot, over 50k tracks
+#include "shuffle.c"
+#include "harness.h"
+
+#define NUM_ALBUMS 5000
+#define TRACKS_PER_ALBUM 10
+#define STEPS 20000
+
+static char label[128];
+static volatile u32 sink;
+
+// What saving did before, truncating and rewriting the file every time
+static void saveByRecreating() {
+	struct shuffle_state_file state;
+	memset(&state, 0, sizeof(struct shuffle_state_file));
+	state.pos = pos;
+	FILE *fp = fopen(SHUFFLE_STATE_FILE ".old", "wb");
+	fwrite(&state, 1, sizeof(struct shuffle_state_file), fp);
+	fclose(fp);
+}
+
+static void benchShuffle() {
+	startLibraryScan();
+	waitForScan();
+	shuffleInit();
+	int album, track;
+	shufflePeek(&album, &track);
+
+	u64 start = gettime();
+	for(int i = 0; i < STEPS; i++) {
+		shuffleNext(&album, &track);
+	}
+	snprintf(label, sizeof(label), "shuffleNext, %d tracks", num_tracks);
+	benchReport(label, elapsedMs(start) * 1000 / STEPS, "us/step");
+	start = gettime();
+	for(int i = 0; i < STEPS; i++) {
+		shufflePrev(&album, &track);
+	}
+	benchReport("shufflePrev", elapsedMs(start) * 1000 / STEPS, "us/step");
+
+	// The saving on its own, in place against recreating the file
+	start = gettime();
+	for(int i = 0; i < STEPS; i++) {
+		saveShuffleState();
+	}
+	benchReport("save in place", elapsedMs(start) * 1000 / STEPS, "us/save");
+	start = gettime();
+	for(int i = 0; i < STEPS; i++) {
+		saveByRecreating();
+	}
+	benchReport("save by recreating", elapsedMs(start) * 1000 / STEPS, "us/save");
+
+	// Booting back into a round part way through redraws it that far
+	int rounds = 50;
+	start = gettime();
+	for(int i = 0; i < rounds; i++) {
+		startRound(i, num_tracks / 2);
+	}
+	snprintf(label, sizeof(label), "resume half way through %d tracks", num_tracks);
+	benchReport(label, elapsedMs(start) / rounds, "ms");
+}
+
+static void benchRng() {
+	struct rng_state rng;
+	rngSeed(&rng, 1);
+	int draws = 10000000;
+	u32 sum = 0;
+	u64 start = gettime();
+	for(int i = 0; i < draws; i++) {
+		sum += rngBounded(&rng, 50000);
+	}
+	benchReport("rngBounded", elapsedMs(start) * 1000000 / draws, "ns");
+	sink = sum;
+}
+
+int main() {
+	benchRng();
+	testDirEnter("bench");
+	makeAlbums(NUM_ALBUMS, TRACKS_PER_ALBUM, 0);
+	runIsolated(benchShuffle);
+	testDirLeave();
+	return testsFinish("bench_shuffle");
+}
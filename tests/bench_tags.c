@@ -0,0 +1,140 @@
+// Reading the tags of 10k tracks: parsed the first time and added to tags.dat, out of
+// tags.dat after that, and after a reboot (a fresh process) with the store loaded again
+#include "tags.c"
+#include <ogc/lwp_watchdog.h>
+#include <sys/stat.h>
+#include "harness.h"
+
+#define NUM_ALBUMS 100
+#define TRACKS_PER_ALBUM 100
+#define PICTURE_SIZE 8192
+
+static char label[128];
+
+static void putFrame(u8 *p, u32 *len, const char *id, const void *payload, u32 size) {
+	u8 *f = p + *len;
+	memcpy(f, id, 4);
+	f[4] = size >> 24;
+	f[5] = size >> 16;
+	f[6] = size >> 8;
+	f[7] = size;
+	f[8] = f[9] = 0;
+	memcpy(f + 10, payload, size);
+	*len += 10 + size;
+}
+
+static void putText(u8 *p, u32 *len, const char *id, const char *text) {
+	char payload[128];
+	payload[0] = 0;
+	u32 size = strlen(text);
+	memcpy(payload + 1, text, size);
+	putFrame(p, len, id, payload, size + 1);
+}
+
+// A v2.3 tag with a picture in front of the text frames to be skipped over, padding, a
+// few frames of audio and an ID3v1 tag on the end, like most ripped tracks
+static void makeTaggedTrack(u8 *file, int albumNum, int trackNum) {
+	static u8 picture[PICTURE_SIZE];
+	char text[64], path[256];
+	u32 len = 10;
+	putFrame(file, &len, "APIC", picture, sizeof(picture));
+	snprintf(text, sizeof(text), "Title %d.%d", albumNum, trackNum);
+	putText(file, &len, "TIT2", text);
+	snprintf(text, sizeof(text), "Artist %d", albumNum % 37);
+	putText(file, &len, "TPE1", text);
+	snprintf(text, sizeof(text), "Album %d", albumNum);
+	putText(file, &len, "TALB", text);
+	snprintf(text, sizeof(text), "%d/%d", trackNum + 1, TRACKS_PER_ALBUM);
+	putText(file, &len, "TRCK", text);
+	snprintf(text, sizeof(text), "%d", 180000 + trackNum * 1000);
+	putText(file, &len, "TLEN", text);
+	memset(file + len, 0, 1024);
+	len += 1024;
+	u32 tagSize = len - 10;
+	memcpy(file, "ID3\3\0\0", 6);
+	for(int i = 9; i >= 6; i--, tagSize >>= 7) {
+		file[i] = tagSize & 0x7F;
+	}
+	for(int i = 0; i < 8; i++, len += 417) {
+		memset(file + len, 0x55, 417);
+		memcpy(file + len, "\xFF\xFB\x90\x00", 4);
+	}
+	memset(file + len, 0, 128);
+	memcpy(file + len, "TAG", 3);
+	len += 128;
+	snprintf(path, sizeof(path), "%s/Album %05d/%02d Track.mp3", ALBUMS_DIR, albumNum, trackNum);
+	writeFile(path, file, len);
+}
+
+static void makeLibrary() {
+	u8 *file = malloc(PICTURE_SIZE + 8192);
+	for(int a = 0; a < NUM_ALBUMS; a++) {
+		char path[256];
+		snprintf(path, sizeof(path), "%s/Album %05d", ALBUMS_DIR, a);
+		mkdir(path, 0755);
+		for(int t = 0; t < TRACKS_PER_ALBUM; t++) {
+			makeTaggedTrack(file, a, t);
+		}
+	}
+	free(file);
+	mkdir(WAKEMII_DIR "/cache", 0755);
+}
+
+// Reads every track, checking what came back against the album it's in
+static double readAll() {
+	struct track_tags tags;
+	char title[64];
+	int right = 1;
+	u64 start = gettime();
+	for(int a = 0; a < num_albums; a++) {
+		int albumNum = atoi(albumName(a) + strlen("Album "));
+		for(int t = 0; t < albumNumEntries(a); t++) {
+			readTrackTags(a, t, &tags);
+			snprintf(title, sizeof(title), "Title %d.%d", albumNum, atoi(albumTrackName(a, t)));
+			right &= !strcmp(tags.title, title) && tags.duration_ms >= 180000;
+		}
+	}
+	double ms = elapsedMs(start);
+	CHECK(right);
+	return ms;
+}
+
+static void benchFirstRead() {
+	startLibraryScan();
+	waitForScan();
+	CHECK_EQ(num_albums, NUM_ALBUMS);
+	loadStore();
+	CHECK_EQ(storeRecords, 0);
+
+	int tracks = NUM_ALBUMS * TRACKS_PER_ALBUM;
+	snprintf(label, sizeof(label), "parse and store, %d tracks", tracks);
+	benchReport(label, readAll() * 1000 / tracks, "us/track");
+	CHECK_EQ(storeRecords, tracks);
+	benchReport("out of tags.dat", readAll() * 1000 / tracks, "us/track");
+	CHECK_EQ(storeRecords, tracks);
+}
+
+static void benchReboot() {
+	startLibraryScan();
+	waitForScan();
+	int tracks = NUM_ALBUMS * TRACKS_PER_ALBUM;
+	u64 start = gettime();
+	loadStore();
+	benchReport("load tags.dat after a reboot", elapsedMs(start), "ms");
+	CHECK_EQ(storeRecords, tracks);
+	benchReport("out of tags.dat after a reboot", readAll() * 1000 / tracks, "us/track");
+	CHECK_EQ(storeRecords, tracks);
+
+	struct stat st;
+	CHECK(!stat(TAGS_STORE_FILE, &st));
+	benchReport("tags.dat", st.st_size / 1024.0, "KB");
+}
+
+int main() {
+	testDirEnter("bench");
+	makeLibrary();
+	runIsolated(benchFirstRead);
+	runIsolated(benchReboot);
+	testDirLeave();
+	return testsFinish("bench_tags");
+}
@@ -0,0 +1,164 @@
+/*===========================================
+        WakeMii - Host test harness
+
+        Checks, scratch directories, synthetic album trees and a fork per
+        library scan for the tests and benchmarks in tests/.
+============================================*/
+#define _GNU_SOURCE		// nftw
+#include <gccore.h>
+#include <ogc/lwp_watchdog.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <ftw.h>
+#include <utime.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include "harness.h"
+#include "library.h"
+
+static int checks;
+static int failures;
+static char testDir[256];
+static char startDir[1024];
+
+int checkResult(int ok, const char *what, const char *file, int line) {
+	checks++;
+	if(!ok) {
+		failures++;
+		fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what);
+	}
+	return ok;
+}
+
+int checkEqual(long long a, long long b, const char *aText, const char *bText, const char *file, int line) {
+	checks++;
+	if(a != b) {
+		failures++;
+		fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n", file, line, aText, bText, a, b);
+	}
+	return a == b;
+}
+
+int testsFinish(const char *name) {
+	printf("%s: %d checks, %d failed\n", name, checks, failures);
+	return failures ? 1 : 0;
+}
+
+void testDirEnter(const char *name) {
+	if(!getcwd(startDir, sizeof(startDir))) {
+		startDir[0] = 0;
+	}
+	snprintf(testDir, sizeof(testDir), "/tmp/wakemii-%s-XXXXXX", name);
+	if(!mkdtemp(testDir) || chdir(testDir)) {
+		perror("testDirEnter");
+		exit(2);
+	}
+	mkdir(WAKEMII_DIR, 0755);
+	mkdir(ALBUMS_DIR, 0755);
+}
+
+static int removeEntry(const char *path, const struct stat *sb, int type, struct FTW *ftw) {
+	return remove(path);
+}
+
+void testDirLeave() {
+	if(startDir[0] && chdir(startDir)) {
+		perror("testDirLeave");
+	}
+	nftw(testDir, removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+void writeFile(const char *path, const void *data, size_t len) {
+	FILE *fp = fopen(path, "wb");
+	if(!fp || fwrite(data, 1, len, fp) != len) {
+		perror(path);
+		exit(2);
+	}
+	fclose(fp);
+}
+
+size_t readFile(const char *path, void *data, size_t len) {
+	FILE *fp = fopen(path, "rb");
+	if(!fp) {
+		return 0;
+	}
+	size_t got = fread(data, 1, len, fp);
+	fclose(fp);
+	return got;
+}
+
+void setMtime(const char *path, time_t mtime) {
+	struct utimbuf times = {mtime, mtime};
+	utime(path, &times);
+}
+
+void makeAlbum(int albumNum, int numTracks) {
+	char path[256];
+	snprintf(path, sizeof(path), "%s/Album %05d", ALBUMS_DIR, albumNum);
+	mkdir(path, 0755);
+	for(int i = 0; i < numTracks; i++) {
+		char track[300], contents[64];
+		snprintf(track, sizeof(track), "%s/%02d Track.mp3", path, i);
+		int len = snprintf(contents, sizeof(contents), "album %d track %d", albumNum, i);
+		writeFile(track, contents, len);
+	}
+}
+
+void makeAlbums(int numAlbums, int tracksPerAlbum, int numHourly) {
+	for(int i = 0; i < numAlbums; i++) {
+		makeAlbum(i, tracksPerAlbum);
+	}
+	if(numHourly) {
+		mkdir(HOURLY_DIR, 0755);
+		for(int i = 0; i < numHourly; i++) {
+			char path[64];
+			snprintf(path, sizeof(path), "%s/%02d.mp3", HOURLY_DIR, i);
+			writeFile(path, "chime", 5);
+		}
+	}
+}
+
+int runIsolated(void (*fn)(void)) {
+	// The child's counts come back through a shared page
+	int *counts = mmap(NULL, 2 * sizeof(int), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if(counts == MAP_FAILED) {
+		perror("runIsolated");
+		exit(2);
+	}
+	fflush(stdout);
+	fflush(stderr);
+	pid_t pid = fork();
+	if(pid == 0) {
+		checks = failures = 0;
+		fn();
+		counts[0] = checks;
+		counts[1] = failures;
+		fflush(stdout);
+		_exit(0);
+	}
+	int status;
+	if(pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status)) {
+		fprintf(stderr, "runIsolated: child didn't finish\n");
+		counts[1]++;
+	}
+	int failed = counts[1];
+	checks += counts[0];
+	failures += failed;
+	munmap(counts, 2 * sizeof(int));
+	return failed;
+}
+
+void waitForScan() {
+	while(libraryScanState == LIBRARY_SCANNING) {
+		usleep(1000);
+	}
+}
+
+double elapsedMs(u64 start) {
+	return ticks_to_microsecs(diff_ticks(start, gettime())) / 1000.0;
+}
+
+void benchReport(const char *what, double value, const char *unit) {
+	printf("%-48s %12.3f %s\n", what, value, unit);
+	fflush(stdout);
+}
@@ -0,0 +1,35 @@
+#ifndef __HARNESS_H__
+#define __HARNESS_H__
+
+#include <gccore.h>
+
+// Checks report and carry on, so one run shows everything that's wrong
+#define CHECK(cond) checkResult((cond), #cond, __FILE__, __LINE__)
+#define CHECK_EQ(a, b) checkEqual((long long)(a), (long long)(b), #a, #b, __FILE__, __LINE__)
+
+int checkResult(int ok, const char *what, const char *file, int line);
+int checkEqual(long long a, long long b, const char *aText, const char *bText, const char *file, int line);
+int testsFinish(const char *name);
+
+// Each test works in a fresh directory under /tmp holding a wakemii/ dir
+void testDirEnter(const char *name);
+void testDirLeave();
+
+// Synthetic libraries: wakemii/albums/Album NNNNN/NN Track.mp3 with the
+// track's album and number written in it, and hourly/NN.mp3 chimes
+void makeAlbum(int albumNum, int numTracks);
+void makeAlbums(int numAlbums, int tracksPerAlbum, int numHourly);
+void writeFile(const char *path, const void *data, size_t len);
+size_t readFile(const char *path, void *data, size_t len);
+void setMtime(const char *path, time_t mtime);
+
+// startLibraryScan() runs once per process, so each scan gets a process of its own.
+// Returns how many checks failed in it.
+int runIsolated(void (*fn)(void));
+void waitForScan();
+
+// Benchmarks print one "name: value unit" line per measurement
+double elapsedMs(u64 start);
+void benchReport(const char *what, double value, const char *unit);
+
+#endif
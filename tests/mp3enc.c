@@ -0,0 +1,690 @@
+/*===========================================
+        WakeMii - Test MP3 encoder
+
+        Makes the MP3s test_decoder and bench_decoder decode, there's no
+        encoder on the host to make them with. It's the textbook layer
+        III encoder without the psychoacoustic model: polyphase analysis,
+        MDCT, scalefactors picked from each band's level, a global gain
+        searched for to fit the bits, and the bit reservoir.
+
+        The Huffman tables, scalefactor bands and window come from
+        mp3lite.c, so the two can't disagree. A wrong entry would be
+        written and read back the same wrong way, so test_decoder checks
+        the tables on their own (whole prefix codes, bands that add up
+        to a granule) and bench_decoder compares with libmad.
+============================================*/
+#include <gccore.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mp3enc.h"
+#include "mp3lite.h"
+
+#define ENC_MAX_VALUE (15 + 8191)
+#define ENC_ATTACK_RATIO 10.0f			// a sixth of a granule this much louder than the last granule's average
+
+static const u16 bitratesMpeg1[16] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0};
+static const u16 bitratesMpeg2[16] = {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0};
+static const u32 sampleRates[9] = {44100, 48000, 32000, 22050, 24000, 16000, 11025, 12000, 8000};
+static const u8 scfsiGroupEnds[4] = {6, 11, 16, 21};
+
+struct bit_writer {
+	u8 *buf;							// zeroed beforehand
+	u32 pos;
+};
+
+struct enc_channel {
+	int ix[576];
+	u8 scalefac[40];
+	u32 part2Bits;
+	u32 part23Length;
+	u32 bigValues;
+	int globalGain;
+	u32 scalefacCompress;
+	int blockType;
+	u8 tableSelect[3];
+	u8 region0Count;
+	u8 region1Count;
+	u8 count1Table;
+};
+
+struct encoder {
+	const struct mp3enc_options *opts;
+	int lsf;
+	int rate;							// as in liteSfbLong
+	int nch;
+	u8 widths[2][40];					// long bands, then short bands window by window
+	int numBands[2];
+	float *subbands[2];					// [slot * 32 + sb]
+	u32 slots;
+	u8 *blockTypes;						// by granule
+};
+
+static int tablesReady;
+static float analysisWindow[512];
+static float analysisMatrix[32][64];
+static float mdctLong[18][36];
+static float mdctShort[6][12];
+static float windows[4][36];			// by block type, short's is the 12 point one
+static float aliasCs[8];
+static float aliasCa[8];
+
+static void initTables() {
+	static const float aliasCoefs[8] = {-0.6f, -0.535f, -0.33f, -0.185f, -0.095f, -0.041f, -0.0142f, -0.0037f};
+	if(tablesReady) {
+		return;
+	}
+	// The analysis window is the synthesis one over 32
+	for(int i = 0; i < 512; i++) {
+		float d = liteWindow[i <= 256 ? i : 512 - i] / 65536.0f;
+		analysisWindow[i] = (((i >> 6) & 1) ? -d : d) / 32;
+	}
+	for(int k = 0; k < 32; k++) {
+		for(int i = 0; i < 64; i++) {
+			analysisMatrix[k][i] = cos((2*k + 1) * (i - 16) * M_PI / 64);
+		}
+	}
+	// Scaled so the decoder's unscaled IMDCT and overlap gives back what went in
+	for(int k = 0; k < 18; k++) {
+		for(int n = 0; n < 36; n++) {
+			mdctLong[k][n] = cos(M_PI / 72 * (2*n + 1 + 18) * (2*k + 1)) / 9;
+		}
+	}
+	for(int k = 0; k < 6; k++) {
+		for(int n = 0; n < 12; n++) {
+			mdctShort[k][n] = cos(M_PI / 24 * (2*n + 1 + 6) * (2*k + 1)) / 3;
+		}
+	}
+	for(int i = 0; i < 36; i++) {
+		float l = sin(M_PI / 36 * (i + 0.5));
+		windows[0][i] = l;
+		windows[1][i] = i < 18 ? l : i < 24 ? 1 : i < 30 ? sin(M_PI / 12 * (i - 18 + 0.5)) : 0;
+		windows[3][i] = i < 6 ? 0 : i < 12 ? sin(M_PI / 12 * (i - 6 + 0.5)) : i < 18 ? 1 : l;
+	}
+	for(int i = 0; i < 12; i++) {
+		windows[2][i] = sin(M_PI / 12 * (i + 0.5));
+	}
+	for(int i = 0; i < 8; i++) {
+		float sq = sqrtf(1.0f + aliasCoefs[i] * aliasCoefs[i]);
+		aliasCs[i] = 1.0f / sq;
+		aliasCa[i] = aliasCoefs[i] / sq;
+	}
+	tablesReady = 1;
+}
+
+static void putBits(struct bit_writer *w, u32 value, int n) {
+	for(int i = n - 1; i >= 0; i--, w->pos++) {
+		if((value >> i) & 1) {
+			w->buf[w->pos >> 3] |= 0x80 >> (w->pos & 7);
+		}
+	}
+}
+
+// One channel through the polyphase filterbank, 32 subband samples per slot
+static void analyse(const s16 *pcm, u32 samples, int ch, int nch, float *out, u32 slots) {
+	float x[512];
+	memset(x, 0, sizeof(x));
+	for(u32 slot = 0; slot < slots; slot++) {
+		memmove(x + 32, x, 480 * sizeof(float));
+		for(int i = 31; i >= 0; i--) {
+			u32 n = slot * 32 + 31 - i;
+			x[i] = n < samples ? pcm[n * nch + ch] / 32768.0f : 0;
+		}
+		float y[64];
+		for(int i = 0; i < 64; i++) {
+			float s = 0;
+			for(int j = 0; j < 8; j++) {
+				s += analysisWindow[i + 64*j] * x[i + 64*j];
+			}
+			y[i] = s;
+		}
+		for(int k = 0; k < 32; k++) {
+			float s = 0;
+			for(int i = 0; i < 64; i++) {
+				s += analysisMatrix[k][i] * y[i];
+			}
+			out[slot * 32 + k] = s;
+		}
+	}
+}
+
+static float segmentEnergy(const struct encoder *e, s32 firstSlot, int numSlots) {
+	float sum = 0;
+	for(s32 slot = MAX(firstSlot, 0); slot < firstSlot + numSlots; slot++) {
+		for(int sb = 0; sb < 32; sb++) {
+			float v = e->subbands[0][slot * 32 + sb];
+			if(e->nch == 2) {
+				v += e->subbands[1][slot * 32 + sb];
+			}
+			sum += v * v;
+		}
+	}
+	return sum;
+}
+
+// Short blocks where a granule's got a sudden attack, start and stop windows either side
+static void pickBlockTypes(struct encoder *e, u32 granules) {
+	u8 *attack = calloc(granules + 1, 1);
+	for(u32 g = 0; e->opts->shortBlocks && g < granules; g++) {
+		float before = segmentEnergy(e, (s32)g * 18 - 18, 18) / 3;
+		for(int seg = 0; seg < 3; seg++) {
+			if(segmentEnergy(e, g * 18 + seg * 6, 6) > before * ENC_ATTACK_RATIO + 1e-6f) {
+				attack[g] = 1;
+			}
+		}
+	}
+	for(u32 g = 0; g < granules; g++) {
+		int prev = g > 0 && attack[g - 1];
+		if(attack[g] || (prev && attack[g + 1])) {
+			e->blockTypes[g] = 2;
+		}
+		else {
+			e->blockTypes[g] = attack[g + 1] ? 1 : prev ? 3 : 0;
+		}
+	}
+	free(attack);
+}
+
+// A granule of one channel to frequency lines, in the order they're written
+static void transform(const struct encoder *e, int ch, u32 g, int blockType, float *xr) {
+	float spectrum[32][18];
+	for(int sb = 0; sb < 32; sb++) {
+		float in[36];
+		for(int t = 0; t < 36; t++) {
+			s32 slot = (s32)g * 18 - 18 + t;
+			float v = slot >= 0 ? e->subbands[ch][slot * 32 + sb] : 0;
+			in[t] = (sb & t & 1) ? -v : v;
+		}
+		if(blockType == 2) {
+			for(int w = 0; w < 3; w++) {
+				for(int k = 0; k < 6; k++) {
+					float s = 0;
+					for(int i = 0; i < 12; i++) {
+						s += in[6 + 6*w + i] * windows[2][i] * mdctShort[k][i];
+					}
+					spectrum[sb][w*6 + k] = s;
+				}
+			}
+		}
+		else {
+			for(int k = 0; k < 18; k++) {
+				float s = 0;
+				for(int n = 0; n < 36; n++) {
+					s += in[n] * windows[blockType][n] * mdctLong[k][n];
+				}
+				spectrum[sb][k] = s;
+			}
+		}
+	}
+	if(blockType == 2) {
+		// Band by band, each band window by window
+		int l = 0, start = 0;
+		for(int sfb = 0; sfb < 13; sfb++) {
+			int width = liteSfbShort[e->rate][sfb];
+			for(int w = 0; w < 3; w++) {
+				for(int i = 0; i < width; i++) {
+					int line = start + i;
+					xr[l++] = spectrum[line / 6][w*6 + line % 6];
+				}
+			}
+			start += width;
+		}
+		return;
+	}
+	memcpy(xr, spectrum, 576 * sizeof(float));
+	// Undo the decoder's alias reduction butterflies
+	for(int sb = 1; sb < 32; sb++) {
+		float *edge = xr + 18 * sb;
+		for(int i = 0; i < 8; i++) {
+			float a = edge[-1 - i], b = edge[i];
+			edge[-1 - i] = a * aliasCs[i] + b * aliasCa[i];
+			edge[i] = b * aliasCs[i] - a * aliasCa[i];
+		}
+	}
+}
+
+static int bandsCarryingScalefacs(const struct enc_channel *c) {
+	return c->blockType == 2 ? 36 : 21;
+}
+
+static int scalefacBits(const struct enc_channel *c, int band) {
+	return band < (c->blockType == 2 ? 18 : 11) ? 4 : 3;
+}
+
+// Quiet bands get a finer step, each scalefactor's half a step of 2^(1/2)
+static void pickScalefacs(const struct encoder *e, struct enc_channel *c, const float *xr) {
+	const u8 *widths = e->widths[c->blockType == 2];
+	int bands = bandsCarryingScalefacs(c);
+	float peaks[40];
+	float loudest = 0;
+	int l = 0;
+	for(int b = 0; b < e->numBands[c->blockType == 2]; b++) {
+		peaks[b] = 0;
+		for(int i = 0; i < widths[b]; i++, l++) {
+			peaks[b] = MAX(peaks[b], fabsf(xr[l]));
+		}
+		loudest = MAX(loudest, peaks[b]);
+	}
+	memset(c->scalefac, 0, sizeof(c->scalefac));
+	int any = 0;
+	for(int b = 0; b < bands; b++) {
+		if(peaks[b] > 0 && loudest > 0) {
+			int sf = (int)log2f(loudest / peaks[b]);
+			c->scalefac[b] = MIN(sf, (1 << scalefacBits(c, b)) - 1);
+			any |= c->scalefac[b];
+		}
+	}
+	c->scalefacCompress = !any ? 0 : e->lsf ? 399 : 15;
+	c->part2Bits = 0;
+	for(int b = 0; any && b < bands; b++) {
+		c->part2Bits += scalefacBits(c, b);
+	}
+}
+
+// Returns the biggest value, -1 if one's too big to code
+static int quantise(const struct encoder *e, struct enc_channel *c, const float *xr, int globalGain) {
+	const u8 *widths = e->widths[c->blockType == 2];
+	int biggest = 0;
+	int l = 0;
+	for(int b = 0; l < 576; b++) {
+		float step = powf(2.0f, -(globalGain - 210 - (c->scalefac[b] << 1)) / 4.0f);
+		for(int i = 0; i < widths[b]; i++, l++) {
+			int v = (int)(powf(fabsf(xr[l]) * step, 0.75f) + 0.4054f);
+			if(v > ENC_MAX_VALUE) {
+				return -1;
+			}
+			biggest = MAX(biggest, v);
+			c->ix[l] = xr[l] < 0 ? -v : v;
+		}
+	}
+	return biggest;
+}
+
+static u32 pairBits(const struct lite_huff_table *t, int x, int y) {
+	x = abs(x);
+	y = abs(y);
+	u32 bits = (x != 0) + (y != 0);
+	if(t->linbits) {
+		if(x >= 15) {
+			bits += t->linbits;
+			x = 15;
+		}
+		if(y >= 15) {
+			bits += t->linbits;
+			y = 15;
+		}
+	}
+	return bits + t->lengths[x * t->dim + y];
+}
+
+// The cheapest table for lines start to end, 0 if they're all zero
+static u32 regionBits(const int *ix, u32 start, u32 end, u8 *table) {
+	int biggest = 0;
+	for(u32 l = start; l < end; l++) {
+		biggest = MAX(biggest, abs(ix[l]));
+	}
+	*table = 0;
+	if(!biggest) {
+		return 0;
+	}
+	u32 best = ~0u;
+	for(int t = 1; t < 32; t++) {
+		const struct lite_huff_table *h = &liteHuffTables[t];
+		if(!h->dim || (biggest <= 15 ? h->linbits || biggest >= h->dim : !h->linbits || biggest > 14 + (1 << h->linbits))) {
+			continue;
+		}
+		u32 bits = 0;
+		for(u32 l = start; l < end && bits < best; l += 2) {
+			bits += pairBits(h, ix[l], ix[l + 1]);
+		}
+		if(bits < best) {
+			best = bits;
+			*table = t;
+		}
+	}
+	return best;
+}
+
+static u32 quadIndex(const int *ix) {
+	return (ix[0] != 0) << 3 | (ix[1] != 0) << 2 | (ix[2] != 0) << 1 | (ix[3] != 0);
+}
+
+// Works out big values, the regions and their tables and the count1 table. Returns the bits.
+static u32 huffmanBits(const struct encoder *e, struct enc_channel *c, u32 *regionEnds, u32 *count1End) {
+	u32 end = 576;
+	while(end > 0 && !c->ix[end - 1]) {
+		end--;
+	}
+	end = (end + 1) & ~1;
+	u32 bigEnd = end;
+	while(bigEnd >= 4 && abs(c->ix[bigEnd - 1]) <= 1 && abs(c->ix[bigEnd - 2]) <= 1 && abs(c->ix[bigEnd - 3]) <= 1 && abs(c->ix[bigEnd - 4]) <= 1) {
+		bigEnd -= 4;
+	}
+	*count1End = end;
+	c->bigValues = bigEnd / 2;
+
+	const u8 *widths = e->widths[c->blockType == 2];
+	u32 ends[40];
+	for(int b = 0, l = 0; b < e->numBands[c->blockType == 2]; b++) {
+		l += widths[b];
+		ends[b] = l;
+	}
+	if(c->blockType) {
+		c->region0Count = c->blockType == 2 ? 8 : 7;
+		c->region1Count = 36;
+		regionEnds[0] = ends[c->region0Count];
+		regionEnds[1] = 576;
+	}
+	else {
+		c->region0Count = 0;
+		for(int j = 0; j < 16; j++) {
+			if(ends[j] <= bigEnd / 3) {
+				c->region0Count = j;
+			}
+		}
+		c->region1Count = 0;
+		for(int k = 0; k < 8 && c->region0Count + 1 + k < 22; k++) {
+			if(ends[c->region0Count + 1 + k] <= bigEnd * 2 / 3) {
+				c->region1Count = k;
+			}
+		}
+		regionEnds[0] = ends[c->region0Count];
+		regionEnds[1] = ends[c->region0Count + 1 + c->region1Count];
+	}
+	u32 bits = 0;
+	u32 start = 0;
+	for(int r = 0; r < 3; r++) {
+		u32 stop = MIN(bigEnd, r < 2 ? regionEnds[r] : 576);
+		c->tableSelect[r] = 0;
+		if(stop > start) {
+			bits += regionBits(c->ix, start, stop, &c->tableSelect[r]);
+			start = stop;
+		}
+	}
+	u32 bitsA = 0, bitsB = 0;
+	for(u32 l = bigEnd; l < end; l += 4) {
+		u32 signs = (c->ix[l] != 0) + (c->ix[l + 1] != 0) + (c->ix[l + 2] != 0) + (c->ix[l + 3] != 0);
+		bitsA += liteCount1Table.lengths[quadIndex(c->ix + l)] + signs;
+		bitsB += 4 + signs;
+	}
+	c->count1Table = bitsB < bitsA;
+	return bits + MIN(bitsA, bitsB);
+}
+
+static void putValue(struct bit_writer *w, int v, int linbits) {
+	if(linbits && abs(v) >= 15) {
+		putBits(w, abs(v) - 15, linbits);
+	}
+	if(v) {
+		putBits(w, v < 0, 1);
+	}
+}
+
+static void writeHuffman(struct bit_writer *w, const struct enc_channel *c, const u32 *regionEnds, u32 count1End) {
+	u32 bigEnd = c->bigValues * 2;
+	u32 l = 0;
+	for(int r = 0; r < 3; r++) {
+		u32 stop = MIN(bigEnd, r < 2 ? regionEnds[r] : 576);
+		const struct lite_huff_table *t = &liteHuffTables[c->tableSelect[r]];
+		for(; l < stop; l += 2) {
+			if(!c->tableSelect[r]) {
+				continue;
+			}
+			int x = MIN(abs(c->ix[l]), 15), y = MIN(abs(c->ix[l + 1]), 15);
+			if(!t->linbits) {
+				x = abs(c->ix[l]);
+				y = abs(c->ix[l + 1]);
+			}
+			putBits(w, t->codes[x * t->dim + y], t->lengths[x * t->dim + y]);
+			putValue(w, c->ix[l], t->linbits);
+			putValue(w, c->ix[l + 1], t->linbits);
+		}
+	}
+	for(l = bigEnd; l < count1End; l += 4) {
+		u32 quad = quadIndex(c->ix + l);
+		if(c->count1Table) {
+			putBits(w, 15 - quad, 4);
+		}
+		else {
+			putBits(w, liteCount1Table.codes[quad], liteCount1Table.lengths[quad]);
+		}
+		for(int i = 0; i < 4; i++) {
+			putValue(w, c->ix[l + i], 0);
+		}
+	}
+}
+
+// The smallest global gain whose lines fit in budget bits, then writes the scalefactors and lines
+static void encodeChannel(const struct encoder *e, struct enc_channel *c, const float *xr, u32 budget, const u8 *reused, struct bit_writer *w) {
+	u32 regionEnds[2], count1End;
+	if(c->part2Bits > budget) {
+		// Granule 0's that are used again have to stay as they are
+		for(int b = 0; b < 40; b++) {
+			if(!reused || !reused[b]) {
+				c->scalefac[b] = 0;
+			}
+		}
+		c->scalefacCompress = 0;
+		c->part2Bits = 0;
+	}
+	int lo = 0, hi = 255;
+	while(lo < hi) {
+		int mid = (lo + hi) / 2;
+		if(quantise(e, c, xr, mid) >= 0 && c->part2Bits + huffmanBits(e, c, regionEnds, &count1End) <= budget) {
+			hi = mid;
+		}
+		else {
+			lo = mid + 1;
+		}
+	}
+	c->globalGain = lo;
+	quantise(e, c, xr, lo);
+	huffmanBits(e, c, regionEnds, &count1End);
+
+	u32 start = w->pos;
+	for(int b = 0; c->scalefacCompress && b < bandsCarryingScalefacs(c); b++) {
+		if(!reused || !reused[b]) {
+			putBits(w, c->scalefac[b], scalefacBits(c, b));
+		}
+	}
+	writeHuffman(w, c, regionEnds, count1End);
+	c->part23Length = w->pos - start;
+}
+
+// Which of granule 1's scalefactor groups are granule 0's again, and the bits that saves
+static u32 pickScfsi(const struct enc_channel *gr0, const struct enc_channel *gr1, u8 *reused) {
+	u32 scfsi = 0;
+	memset(reused, 0, 40);
+	if(gr0->blockType == 2 || gr1->blockType == 2) {
+		return 0;
+	}
+	for(int group = 0, b = 0; group < 4; group++) {
+		int first = b;
+		int same = 1;
+		for(; b < scfsiGroupEnds[group]; b++) {
+			same &= gr0->scalefac[b] == gr1->scalefac[b];
+		}
+		if(same) {
+			scfsi |= 8 >> group;
+			memset(reused + first, 1, b - first);
+		}
+	}
+	return scfsi;
+}
+
+static u32 reusedBits(const struct enc_channel *c, const u8 *reused) {
+	u32 bits = 0;
+	for(int b = 0; c->scalefacCompress && b < bandsCarryingScalefacs(c); b++) {
+		bits += reused[b] ? scalefacBits(c, b) : 0;
+	}
+	return bits;
+}
+
+static void writeSideInfo(struct bit_writer *w, const struct encoder *e, u32 mainDataBegin, const u32 *scfsi, struct enc_channel gr[2][2]) {
+	if(e->lsf) {
+		putBits(w, mainDataBegin, 8);
+		putBits(w, 0, e->nch == 1 ? 1 : 2);
+	}
+	else {
+		putBits(w, mainDataBegin, 9);
+		putBits(w, 0, e->nch == 1 ? 5 : 3);
+		for(int ch = 0; ch < e->nch; ch++) {
+			putBits(w, scfsi[ch], 4);
+		}
+	}
+	for(int g = 0; g < (e->lsf ? 1 : 2); g++) {
+		for(int ch = 0; ch < e->nch; ch++) {
+			const struct enc_channel *c = &gr[g][ch];
+			putBits(w, c->part23Length, 12);
+			putBits(w, c->bigValues, 9);
+			putBits(w, c->globalGain, 8);
+			putBits(w, c->scalefacCompress, e->lsf ? 9 : 4);
+			putBits(w, c->blockType != 0, 1);
+			if(c->blockType) {
+				putBits(w, c->blockType, 2);
+				putBits(w, 0, 1);
+				putBits(w, c->tableSelect[0], 5);
+				putBits(w, c->tableSelect[1], 5);
+				putBits(w, 0, 9);
+			}
+			else {
+				for(int r = 0; r < 3; r++) {
+					putBits(w, c->tableSelect[r], 5);
+				}
+				putBits(w, c->region0Count, 4);
+				putBits(w, c->region1Count, 3);
+			}
+			if(!e->lsf) {
+				putBits(w, 0, 1);
+			}
+			putBits(w, 0, 1);
+			putBits(w, c->count1Table, 1);
+		}
+	}
+}
+
+u8* mp3Encode(const s16 *pcm, u32 samples, const struct mp3enc_options *opts, u32 *size) {
+	initTables();
+	struct encoder e;
+	memset(&e, 0, sizeof(e));
+	e.opts = opts;
+	e.nch = opts->channels;
+	e.rate = -1;
+	for(int i = 0; i < 9; i++) {
+		if(sampleRates[i] == opts->sampleRate) {
+			e.rate = i;
+		}
+	}
+	if(e.rate < 0) {
+		return NULL;
+	}
+	e.lsf = e.rate >= 3;
+	int bitrateIndex = 0;
+	for(int i = 1; i < 15; i++) {
+		if((e.lsf ? bitratesMpeg2 : bitratesMpeg1)[i] == opts->bitrate) {
+			bitrateIndex = i;
+		}
+	}
+	if(!bitrateIndex) {
+		return NULL;
+	}
+	memcpy(e.widths[0], liteSfbLong[e.rate], 22);
+	e.numBands[0] = 22;
+	for(int sfb = 0; sfb < 13; sfb++) {
+		memset(e.widths[1] + sfb * 3, liteSfbShort[e.rate][sfb], 3);
+	}
+	e.numBands[1] = 39;
+
+	int ngr = e.lsf ? 1 : 2;
+	u32 granules = (samples + MP3ENC_DELAY + LITE_DELAY + 575) / 576;
+	granules = (granules + ngr - 1) / ngr * ngr;
+	u32 frames = granules / ngr;
+	e.slots = granules * 18;
+	for(int ch = 0; ch < e.nch; ch++) {
+		e.subbands[ch] = malloc(e.slots * 32 * sizeof(float));
+		analyse(pcm, samples, ch, e.nch, e.subbands[ch], e.slots);
+	}
+	e.blockTypes = malloc(granules);
+	pickBlockTypes(&e, granules);
+
+	u32 perFrame = (e.lsf ? 72 : 144) * opts->bitrate * 1000;
+	u32 sideSize = e.lsf ? (e.nch == 1 ? 9 : 17) : (e.nch == 1 ? 17 : 32);
+	u32 total = (u64)perFrame * frames / opts->sampleRate + 1;
+	u8 *out = calloc(total, 1);
+	u8 *mainStream = calloc(total + 4096, 1);
+	u32 maxBegin = e.lsf ? 255 : 511;
+	int mode = e.nch == 1 ? 3 : opts->ms ? 1 : 0;
+	int version = e.rate < 3 ? 3 : e.rate < 6 ? 2 : 0;
+
+	u32 outPos = 0, slotStart = 0, cursor = 0;
+	for(u32 f = 0; f < frames; f++) {
+		u32 length = (u64)perFrame * (f + 1) / opts->sampleRate - (u64)perFrame * f / opts->sampleRate;
+		int padding = length > perFrame / opts->sampleRate;
+		u32 mainLen = length - 4 - sideSize;
+		if(slotStart - cursor > maxBegin) {
+			cursor = slotStart - maxBegin;
+		}
+		u32 mainDataBegin = slotStart - cursor;
+		struct bit_writer w = {mainStream + cursor, 0};
+		u32 avail = (slotStart + mainLen - cursor) * 8;
+
+		struct enc_channel gr[2][2];
+		u32 scfsi[2] = {0, 0};
+		for(int g = 0; g < ngr; g++) {
+			u32 granule = f * ngr + g;
+			float xr[2][576];
+			for(int ch = 0; ch < e.nch; ch++) {
+				transform(&e, ch, granule, e.blockTypes[granule], xr[ch]);
+			}
+			if(mode == 1) {
+				for(int l = 0; l < 576; l++) {
+					float m = (xr[0][l] + xr[1][l]) * (float)M_SQRT1_2;
+					float s = (xr[0][l] - xr[1][l]) * (float)M_SQRT1_2;
+					xr[0][l] = m;
+					xr[1][l] = s;
+				}
+			}
+			for(int ch = 0; ch < e.nch; ch++) {
+				struct enc_channel *c = &gr[g][ch];
+				u8 reused[40];
+				c->blockType = e.blockTypes[granule];
+				pickScalefacs(&e, c, xr[ch]);
+				if(g == 1) {
+					scfsi[ch] = pickScfsi(&gr[0][ch], c, reused);
+					c->part2Bits -= reusedBits(c, reused);
+				}
+				int left = (ngr - g) * e.nch - ch;
+				u32 budget = MIN((avail - w.pos) / left, 4095);
+				encodeChannel(&e, c, xr[ch], budget, g == 1 ? reused : NULL, &w);
+			}
+		}
+		cursor += (w.pos + 7) / 8;
+
+		u8 *frame = out + outPos;
+		frame[0] = 0xFF;
+		frame[1] = 0xE0 | version << 3 | 1 << 1 | 1;
+		frame[2] = bitrateIndex << 4 | (e.rate % 3) << 2 | padding << 1;
+		frame[3] = mode << 6 | (mode == 1 ? 2 : 0) << 4;
+		struct bit_writer side = {frame + 4, 0};
+		writeSideInfo(&side, &e, mainDataBegin, scfsi, gr);
+		outPos += length;
+		slotStart += mainLen;
+	}
+
+	// Now every frame's main data slot has all it's going to get
+	u32 pos = 0;
+	slotStart = 0;
+	for(u32 f = 0; f < frames; f++) {
+		u32 length = (u64)perFrame * (f + 1) / opts->sampleRate - (u64)perFrame * f / opts->sampleRate;
+		memcpy(out + pos + 4 + sideSize, mainStream + slotStart, length - 4 - sideSize);
+		slotStart += length - 4 - sideSize;
+		pos += length;
+	}
+	for(int ch = 0; ch < e.nch; ch++) {
+		free(e.subbands[ch]);
+	}
+	free(e.blockTypes);
+	free(mainStream);
+	*size = outPos;
+	return out;
+}
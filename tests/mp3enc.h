@@ -0,0 +1,24 @@
+#ifndef __MP3ENC_H__
+#define __MP3ENC_H__
+
+#include <gccore.h>
+
+// A plain layer III encoder for making test MP3s out of synthetic PCM: long blocks with
+// start/short/stop around transients, mid/side, scalefactors from each band's level
+// and the bit reservoir. No psychoacoustics, it spreads the noise evenly.
+struct mp3enc_options {
+	u32 sampleRate;						// any layer III rate, 8 to 48kHz
+	int channels;						// 1 or 2
+	u32 bitrate;						// kbps, one the sample rate's MPEG version has
+	int ms;								// joint stereo, mid/side in every frame
+	int shortBlocks;					// switch to short blocks on transients
+};
+
+// Samples the encoder's output lags its input by (its polyphase filter and the MDCT's
+// overlap), on top of the decoder's delay
+#define MP3ENC_DELAY 528
+
+// Encodes samples (per channel, interleaved if stereo) and returns the MP3, malloc'd.
+u8* mp3Encode(const s16 *pcm, u32 samples, const struct mp3enc_options *opts, u32 *size);
+
+#endif
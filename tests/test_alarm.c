@@ -0,0 +1,159 @@
+// Alarm scheduling against a simulated clock
+#include <gccore.h>
+#include <time.h>
+#include "harness.h"
+
+// The scheduler reads time() for the snooze, give it ours
+static time_t fakeNow;
+#define time(t) (fakeNow)
+#include "alarm.c"
+#undef time
+
+#define MONDAY 1704067200		// 2024-01-01 00:00, a Monday
+#define AT(h, m, s) (MONDAY + (h) * 3600 + (m) * 60 + (s))
+
+static void resetScheduler() {
+	lastLook = 0;
+	memset(firedAt, 0, sizeof(firedAt));
+	ringUntil = chimeUntil = snoozeUntil = armedFor = 0;
+	ringing = chiming = 0;
+	pendingEvents = 0;
+	for(int i = 0; i < MAX_ALARMS; i++) {
+		alarms[i].on = 0;
+		alarms[i].days = ALARM_EVERY_DAY;
+	}
+	alarms[0].on = 1;
+	alarms[0].hrs = 7;
+	alarms[0].mins = 0;
+	num_hourly = 0;
+	hourlyAlarmOn = 0;
+	continuousPlayOn = 0;
+	snoozeMins = 9;
+}
+
+// Runs the scheduler at now and returns what it reported, and when it wants to look next
+static int step(time_t now, time_t *wake) {
+	fakeNow = now;
+	time_t next = schedule(now);
+	if(wake) {
+		*wake = next;
+	}
+	return alarmTakeEvents();
+}
+
+static void testOnTime() {
+	resetScheduler();
+	time_t wake;
+	CHECK_EQ(step(AT(6, 59, 0), &wake), 0);
+	CHECK_EQ(wake, AT(7, 0, 0) - ALARM_PREARM_SECS);
+	CHECK_EQ(step(wake, &wake), ALARM_ARMED);
+	CHECK_EQ(alarmArmed, 1);
+	CHECK_EQ(wake, AT(7, 0, 0));
+	CHECK_EQ(step(wake, &wake), ALARM_STARTED);
+	CHECK_EQ(alarmGoingOff, 1);
+	CHECK_EQ(alarmArmed, 0);
+	CHECK_EQ(wake, AT(7, 0, 0) + ALARM_RING_SECS);
+	CHECK_EQ(step(wake, &wake), ALARM_ENDED);
+	CHECK_EQ(alarmGoingOff, 0);
+	// Tomorrow's is next, with the hourly resync in between
+	CHECK(wake <= AT(7, 1, 0) + SCHEDULER_RESYNC_SECS);
+}
+
+static void testBootDuringAlarm() {
+	resetScheduler();
+	CHECK(step(AT(7, 0, 30), NULL) & ALARM_STARTED);
+}
+
+static void testDays() {
+	// Sundays only, Monday morning is quiet and the next wake is no later than the resync
+	resetScheduler();
+	alarms[0].days = 1 << 0;
+	time_t wake;
+	step(AT(6, 59, 0), &wake);
+	CHECK_EQ(step(AT(7, 0, 0), &wake) & ALARM_STARTED, 0);
+	CHECK(wake <= AT(7, 0, 0) + SCHEDULER_RESYNC_SECS);
+	// Six days on it does
+	step(AT(6 * 24 + 6, 59, 59), NULL);
+	CHECK(step(AT(6 * 24 + 7, 0, 0), NULL) & ALARM_STARTED);
+}
+
+static void testSnooze() {
+	resetScheduler();
+	step(AT(6, 59, 59), NULL);
+	CHECK(step(AT(7, 0, 0), NULL) & ALARM_STARTED);
+	fakeNow = AT(7, 0, 20);
+	CHECK(alarmSnooze());
+	CHECK_EQ(alarmGoingOff, 0);
+	time_t wake;
+	step(AT(7, 0, 20), &wake);
+	CHECK(wake <= AT(7, 9, 20));
+	CHECK(step(AT(7, 9, 20), NULL) & ALARM_STARTED);
+	// Nothing to snooze once it's stopped
+	step(AT(7, 10, 20), NULL);
+	CHECK(!alarmSnooze());
+}
+
+static void testHourly() {
+	resetScheduler();
+	alarms[0].on = 0;
+	num_hourly = 3;
+	hourlyAlarmOn = 1;
+	time_t wake;
+	step(AT(7, 59, 0), &wake);
+	CHECK_EQ(wake, AT(8, 0, 0));
+	CHECK_EQ(step(AT(8, 0, 0), &wake), HOURLY_STARTED);
+	CHECK_EQ(hourlyGoingOff, 1);
+	CHECK_EQ(step(AT(8, 1, 0), &wake), HOURLY_ENDED);
+	// Not while continuous play is on
+	continuousPlayOn = 1;
+	step(AT(8, 59, 59), NULL);
+	CHECK_EQ(step(AT(9, 0, 0), NULL), 0);
+	// Nor when it's an hour the clock jumped right over
+	continuousPlayOn = 0;
+	step(AT(9, 30, 0), NULL);
+	CHECK_EQ(step(AT(12, 30, 0), NULL), 0);
+}
+
+static void testStalled() {
+	// The thread didn't get to run for a while but it's not too late
+	resetScheduler();
+	step(AT(6, 59, 50), NULL);
+	CHECK(step(AT(7, 0, 0) + ALARM_LATE_SECS - 10, NULL) & ALARM_STARTED);
+
+	// Too late, let it go
+	resetScheduler();
+	step(AT(6, 59, 50), NULL);
+	CHECK_EQ(step(AT(7, 0, 0) + ALARM_LATE_SECS + 10, NULL) & ALARM_STARTED, 0);
+}
+
+static void testClockJumps() {
+	// Forward over the alarm by a few hours, it doesn't go off late
+	resetScheduler();
+	step(AT(6, 0, 0), NULL);
+	CHECK_EQ(step(AT(9, 30, 0), NULL) & ALARM_STARTED, 0);
+
+	// Back over an alarm that already went off, it doesn't go off again
+	resetScheduler();
+	step(AT(6, 59, 59), NULL);
+	CHECK(step(AT(7, 0, 0), NULL) & ALARM_STARTED);
+	CHECK(step(AT(7, 1, 0), NULL) & ALARM_ENDED);
+	CHECK_EQ(step(AT(6, 59, 30), NULL), 0);
+	CHECK_EQ(step(AT(7, 0, 5), NULL) & ALARM_STARTED, 0);
+	// But the next day's does
+	CHECK(step(AT(24 + 7, 0, 0) - 1, NULL) & ALARM_ARMED);
+	CHECK(step(AT(24 + 7, 0, 0), NULL) & ALARM_STARTED);
+}
+
+int main() {
+	LWP_MutexInit(&schedMutex, false);
+	LWP_CondInit(&schedCond);
+	LWP_CondInit(&eventCond);
+	testOnTime();
+	testBootDuringAlarm();
+	testDays();
+	testSnooze();
+	testHourly();
+	testStalled();
+	testClockJumps();
+	return testsFinish("test_alarm");
+}
@@ -0,0 +1,410 @@
+// Covers scaled down while decoding, and the converted textures cached on the card
+#include <gccore.h>
+#include <unistd.h>
+#include <png.h>
+#include <jpeglib.h>
+#include "harness.h"
+#include "coverload.h"
+
+#define TEX_HEADER_SIZE 24
+
+typedef u32 (*pixel_fn)(u32 x, u32 y, u32 w, u32 h);
+
+// Red across, green down, so a scaled texel says where in the source it came from
+static u32 gradient(u32 x, u32 y, u32 w, u32 h) {
+	return ((x * 255 / (w - 1)) << 24) | ((y * 255 / (h - 1)) << 16) | (0x80 << 8) | 0xFF;
+}
+
+// Red, green, blue and white quarters, easy on JPEG
+static u32 quarters(u32 x, u32 y, u32 w, u32 h) {
+	static const u32 colours[4] = {0xFF0000FF, 0x00FF00FF, 0x0000FFFF, 0xFFFFFFFF};
+	return colours[(y >= h / 2) * 2 + (x >= w / 2)];
+}
+
+static void writePng(const char *path, u32 w, u32 h, int interlaced, pixel_fn fn) {
+	FILE *fp = fopen(path, "wb");
+	png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	png_infop info = png_create_info_struct(png);
+	png_init_io(png, fp);
+	png_set_IHDR(png, info, w, h, 8, PNG_COLOR_TYPE_RGB_ALPHA,
+		interlaced ? PNG_INTERLACE_ADAM7 : PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+	png_set_compression_level(png, 1);
+	png_write_info(png, info);
+	u8 *image = malloc(w * h * 4);
+	png_bytep rows[h];
+	for(u32 y = 0; y < h; y++) {
+		rows[y] = image + y * w * 4;
+		for(u32 x = 0; x < w; x++) {
+			u32 c = fn(x, y, w, h);
+			rows[y][x*4] = c >> 24;
+			rows[y][x*4+1] = c >> 16;
+			rows[y][x*4+2] = c >> 8;
+			rows[y][x*4+3] = c;
+		}
+	}
+	png_write_image(png, rows);
+	png_write_end(png, NULL);
+	png_destroy_write_struct(&png, &info);
+	free(image);
+	fclose(fp);
+}
+
+// 24 bit bottom up, 32 bit top down with bitfield masks (alpha included) or 8 bit paletted
+// with the palette index taken from the red channel
+static void writeBmp(const char *path, u32 w, u32 h, int bpp, pixel_fn fn) {
+	u32 stride = ((w * bpp + 31) / 32) * 4;
+	u32 infoSize = bpp == 32 ? 56 : 40;
+	u32 paletteSize = bpp == 8 ? 256 * 4 : 0;
+	u32 dataOffset = 14 + infoSize + paletteSize;
+	u8 hdr[14 + 56 + 256 * 4];
+	memset(hdr, 0, sizeof(hdr));
+	u32 fields[] = {dataOffset + stride * h, 0, dataOffset, infoSize, w, bpp == 32 ? -h : h};
+	hdr[0] = 'B';
+	hdr[1] = 'M';
+	memcpy(hdr + 2, fields, sizeof(fields));
+	hdr[26] = 1;
+	hdr[28] = bpp;
+	if(bpp == 32) {
+		u32 masks[] = {0xFF000000, 0x00FF0000, 0x0000FF00, 0x000000FF};
+		hdr[30] = 3;
+		memcpy(hdr + 54, masks, sizeof(masks));
+	}
+	for(u32 i = 0; i < paletteSize / 4; i++) {
+		u8 *entry = hdr + 14 + infoSize + i * 4;
+		entry[0] = 255 - i;
+		entry[1] = i / 2;
+		entry[2] = i;
+	}
+	FILE *fp = fopen(path, "wb");
+	fwrite(hdr, 1, dataOffset, fp);
+	u8 *row = calloc(1, stride);
+	for(u32 n = 0; n < h; n++) {
+		u32 y = bpp == 32 ? n : h - 1 - n;
+		for(u32 x = 0; x < w; x++) {
+			u32 c = fn(x, y, w, h);
+			if(bpp == 32) {
+				memcpy(row + x * 4, &c, 4);
+			}
+			else if(bpp == 24) {
+				row[x*3] = c >> 8;
+				row[x*3+1] = c >> 16;
+				row[x*3+2] = c >> 24;
+			}
+			else {
+				row[x] = c >> 24;
+			}
+		}
+		fwrite(row, 1, stride, fp);
+	}
+	free(row);
+	fclose(fp);
+}
+
+static void writeJpeg(FILE *fp, u32 w, u32 h, pixel_fn fn) {
+	struct jpeg_compress_struct cinfo;
+	struct jpeg_error_mgr err;
+	cinfo.err = jpeg_std_error(&err);
+	jpeg_create_compress(&cinfo);
+	jpeg_stdio_dest(&cinfo, fp);
+	cinfo.image_width = w;
+	cinfo.image_height = h;
+	cinfo.input_components = 3;
+	cinfo.in_color_space = JCS_RGB;
+	jpeg_set_defaults(&cinfo);
+	jpeg_set_quality(&cinfo, 95, TRUE);
+	jpeg_start_compress(&cinfo, TRUE);
+	u8 *row = malloc(w * 3);
+	while(cinfo.next_scanline < h) {
+		for(u32 x = 0; x < w; x++) {
+			u32 c = fn(x, cinfo.next_scanline, w, h);
+			row[x*3] = c >> 24;
+			row[x*3+1] = c >> 16;
+			row[x*3+2] = c >> 8;
+		}
+		jpeg_write_scanlines(&cinfo, &row, 1);
+	}
+	jpeg_finish_compress(&cinfo);
+	jpeg_destroy_compress(&cinfo);
+	free(row);
+}
+
+static int near(u32 a, u32 b, u32 tolerance) {
+	for(int shift = 0; shift < 32; shift += 8) {
+		int ca = (a >> shift) & 0xFF;
+		int cb = (b >> shift) & 0xFF;
+		if(abs(ca - cb) > tolerance) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static void cachePath(char *path, const char *key) {
+	u32 hash = 0x811C9DC5;
+	for(const char *c = key; *c; c++) {
+		hash ^= (u8)*c;
+		hash *= 0x01000193;
+	}
+	sprintf(path, "%s/%08X.tex", COVER_CACHE_DIR, hash);
+}
+
+static u32 fileSize(const char *path) {
+	struct stat st;
+	return stat(path, &st) ? 0 : st.st_size;
+}
+
+static int sameTexture(GRRLIB_texImg *a, GRRLIB_texImg *b) {
+	return a && b && a->w == b->w && a->h == b->h && !memcmp(a->data, b->data, a->w * a->h * 4);
+}
+
+static void testPngDownscale() {
+	const char *path = WAKEMII_DIR "/big.png";
+	writePng(path, 1000, 720, 0, gradient);
+	GRRLIB_texImg *tex = loadCoverTexture(path, "big png");
+	CHECK(tex != NULL);
+	if(!tex) {
+		return;
+	}
+	CHECK_EQ(tex->w, 500);
+	CHECK_EQ(tex->h, 360);
+	// Each texel is the average of a 2x2 block
+	int ok = 1;
+	for(u32 y = 0; y < tex->h; y += 7) {
+		for(u32 x = 0; x < tex->w; x += 5) {
+			u32 want = gradient(x * 2, y * 2, 1000, 720);
+			ok &= near(GRRLIB_GetPixelFromtexImg(x, y, tex), want, 1);
+		}
+	}
+	CHECK(ok);
+	GRRLIB_FreeTexture(tex);
+}
+
+static void testJpegDownscale() {
+	const char *path = WAKEMII_DIR "/big.jpg";
+	FILE *fp = fopen(path, "wb");
+	writeJpeg(fp, 2000, 1500, quarters);
+	fclose(fp);
+	GRRLIB_texImg *tex = loadCoverTexture(path, "big jpg");
+	CHECK(tex != NULL);
+	if(!tex) {
+		return;
+	}
+	CHECK_EQ(tex->w, 480);
+	CHECK_EQ(tex->h, 360);
+	CHECK(near(GRRLIB_GetPixelFromtexImg(120, 90, tex), 0xFF0000FF, 8));
+	CHECK(near(GRRLIB_GetPixelFromtexImg(360, 90, tex), 0x00FF00FF, 8));
+	CHECK(near(GRRLIB_GetPixelFromtexImg(120, 270, tex), 0x0000FFFF, 8));
+	CHECK(near(GRRLIB_GetPixelFromtexImg(360, 270, tex), 0xFFFFFFFF, 8));
+	GRRLIB_FreeTexture(tex);
+}
+
+static void testSmallNotScaled() {
+	const char *path = WAKEMII_DIR "/small.png";
+	writePng(path, 100, 60, 0, gradient);
+	GRRLIB_texImg *tex = loadCoverTexture(path, "small");
+	CHECK(tex != NULL);
+	if(!tex) {
+		return;
+	}
+	CHECK_EQ(tex->w, 100);
+	CHECK_EQ(tex->h, 60);
+	CHECK_EQ(GRRLIB_GetPixelFromtexImg(37, 41, tex), gradient(37, 41, 100, 60));
+	GRRLIB_FreeTexture(tex);
+}
+
+static void testInterlaced() {
+	// Too big to have whole, so it's scaled from the last pass with each odd row standing in
+	// for the even one above
+	const char *path = WAKEMII_DIR "/interlaced.png";
+	writePng(path, 800, 800, 1, gradient);
+	GRRLIB_texImg *tex = loadCoverTexture(path, "interlaced");
+	CHECK(tex != NULL);
+	if(!tex) {
+		return;
+	}
+	CHECK_EQ(tex->w, 360);
+	CHECK_EQ(tex->h, 360);
+	CHECK(near(GRRLIB_GetPixelFromtexImg(180, 90, tex), gradient(400, 200, 800, 800), 2));
+	CHECK(near(GRRLIB_GetPixelFromtexImg(359, 359, tex), gradient(799, 799, 800, 800), 2));
+	GRRLIB_FreeTexture(tex);
+
+	// Small enough to decode whole, every pixel comes through
+	path = WAKEMII_DIR "/interlaced-small.png";
+	writePng(path, 300, 200, 1, gradient);
+	tex = loadCoverTexture(path, "interlaced-small");
+	CHECK(tex != NULL);
+	if(!tex) {
+		return;
+	}
+	CHECK_EQ(tex->w, 300);
+	CHECK_EQ(tex->h, 200);
+	int same = 1;
+	for(u32 y = 0; y < 200; y++) {
+		for(u32 x = 0; x < 300; x++) {
+			same &= GRRLIB_GetPixelFromtexImg(x, y, tex) == gradient(x, y, 300, 200);
+		}
+	}
+	CHECK(same);
+	GRRLIB_FreeTexture(tex);
+}
+
+static void testBmp() {
+	const char *path = WAKEMII_DIR "/cover.bmp";
+	writeBmp(path, 1000, 720, 24, gradient);
+	GRRLIB_texImg *tex = loadCoverTexture(path, "bmp24");
+	CHECK(tex != NULL);
+	if(!tex) {
+		return;
+	}
+	CHECK_EQ(tex->w, 500);
+	CHECK_EQ(tex->h, 360);
+	CHECK(near(GRRLIB_GetPixelFromtexImg(0, 0, tex), gradient(0, 0, 1000, 720), 2));
+	CHECK(near(GRRLIB_GetPixelFromtexImg(250, 90, tex), gradient(500, 180, 1000, 720), 2));
+	CHECK(near(GRRLIB_GetPixelFromtexImg(499, 359, tex), gradient(999, 719, 1000, 720), 2));
+	GRRLIB_FreeTexture(tex);
+
+	writeBmp(path, 104, 76, 32, gradient);
+	tex = loadCoverTexture(path, "bmp32");
+	CHECK(tex != NULL);
+	if(!tex) {
+		return;
+	}
+	CHECK_EQ(tex->w, 104);
+	CHECK_EQ(tex->h, 76);
+	int same = 1;
+	for(u32 y = 0; y < 76; y++) {
+		for(u32 x = 0; x < 104; x++) {
+			same &= GRRLIB_GetPixelFromtexImg(x, y, tex) == gradient(x, y, 104, 76);
+		}
+	}
+	CHECK(same);
+	GRRLIB_FreeTexture(tex);
+
+	// Index i is (i, i/2, 255-i)
+	writeBmp(path, 256, 12, 8, gradient);
+	tex = loadCoverTexture(path, "bmp8");
+	CHECK(tex != NULL);
+	if(!tex) {
+		return;
+	}
+	CHECK_EQ(GRRLIB_GetPixelFromtexImg(0, 5, tex), 0x0000FFFF);
+	CHECK_EQ(GRRLIB_GetPixelFromtexImg(200, 5, tex), 0xC86437FF);
+	GRRLIB_FreeTexture(tex);
+
+	// Cut short
+	FILE *fp = fopen(path, "r+b");
+	CHECK(!ftruncate(fileno(fp), 2000));
+	fclose(fp);
+	CHECK(loadCoverTexture(path, "bmp8-short") == NULL);
+}
+
+static void testCacheRoundTrip() {
+	const char *path = WAKEMII_DIR "/cached.png";
+	char cache[256];
+	cachePath(cache, "cached");
+	writePng(path, 1200, 900, 0, gradient);
+	setMtime(path, 1000000);
+	GRRLIB_texImg *first = loadCoverTexture(path, "cached");
+	CHECK(first != NULL);
+	if(!first) {
+		return;
+	}
+	CHECK_EQ(fileSize(cache), TEX_HEADER_SIZE + first->w * first->h * 4);
+
+	// Same size and time, so it comes from the cache without the cover being decoded at all
+	u32 size = fileSize(path);
+	u8 *garbage = calloc(1, size);
+	writeFile(path, garbage, size);
+	free(garbage);
+	setMtime(path, 1000000);
+	GRRLIB_texImg *again = loadCoverTexture(path, "cached");
+	CHECK(sameTexture(first, again));
+	GRRLIB_FreeTexture(again);
+
+	// A changed cover is decoded again, this one doesn't
+	setMtime(path, 2000000);
+	CHECK(loadCoverTexture(path, "cached") == NULL);
+
+	// A cut short cache file is decoded around
+	writePng(path, 1200, 900, 0, gradient);
+	setMtime(path, 1000000);
+	truncate(cache, TEX_HEADER_SIZE + 1000);
+	again = loadCoverTexture(path, "cached");
+	CHECK(sameTexture(first, again));
+	CHECK_EQ(fileSize(cache), TEX_HEADER_SIZE + first->w * first->h * 4);
+	GRRLIB_FreeTexture(again);
+	GRRLIB_FreeTexture(first);
+}
+
+static void putBE32(u8 *p, u32 v) {
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static void testEmbedded() {
+	// ID3v2.3 with a text frame, then an APIC holding the JPEG, then a little padding
+	const char *path = WAKEMII_DIR "/embedded.mp3";
+	char *jpeg;
+	size_t jpegSize;
+	FILE *mem = open_memstream(&jpeg, &jpegSize);
+	writeJpeg(mem, 1000, 1000, quarters);
+	fclose(mem);
+	static const u8 title[] = "TIT2\0\0\0\6\0\0\0Title";
+	static const u8 apicHead[] = "\0image/jpeg\0\3cover\0";
+	u32 apicSize = sizeof(apicHead) - 1 + jpegSize;
+	u32 tagSize = sizeof(title) - 1 + 10 + apicSize + 64;
+	u8 *file = calloc(1, 10 + tagSize + 1000);
+	u8 *p = file;
+	memcpy(p, "ID3\3\0\0", 6);
+	p[6] = (tagSize >> 21) & 0x7F;
+	p[7] = (tagSize >> 14) & 0x7F;
+	p[8] = (tagSize >> 7) & 0x7F;
+	p[9] = tagSize & 0x7F;
+	p += 10;
+	memcpy(p, title, sizeof(title) - 1);
+	p += sizeof(title) - 1;
+	memcpy(p, "APIC", 4);
+	putBE32(p + 4, apicSize);
+	p += 10;
+	memcpy(p, apicHead, sizeof(apicHead) - 1);
+	memcpy(p + sizeof(apicHead) - 1, jpeg, jpegSize);
+	writeFile(path, file, 10 + tagSize + 1000);
+	free(file);
+	free(jpeg);
+
+	GRRLIB_texImg *tex = loadEmbeddedCover(path, path);
+	CHECK(tex != NULL);
+	if(!tex) {
+		return;
+	}
+	CHECK_EQ(tex->w, 360);
+	CHECK_EQ(tex->h, 360);
+	CHECK(near(GRRLIB_GetPixelFromtexImg(270, 270, tex), 0xFFFFFFFF, 8));
+	char cache[256];
+	cachePath(cache, path);
+	CHECK(fileSize(cache) > 0);
+	GRRLIB_texImg *again = loadEmbeddedCover(path, path);
+	CHECK(sameTexture(tex, again));
+	GRRLIB_FreeTexture(again);
+	GRRLIB_FreeTexture(tex);
+
+	// No picture, no cover
+	writeFile(path, "ID3\3\0\0\0\0\0\x20", 10);
+	CHECK(loadEmbeddedCover(path, "no picture") == NULL);
+}
+
+int main() {
+	testDirEnter("coverload");
+	coverLoadInit();
+	testPngDownscale();
+	testJpegDownscale();
+	testSmallNotScaled();
+	testInterlaced();
+	testBmp();
+	testCacheRoundTrip();
+	testEmbedded();
+	testDirLeave();
+	return testsFinish("test_coverload");
+}
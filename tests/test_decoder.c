@@ -0,0 +1,465 @@
+// The lite decoder: its tables and transforms against the textbook versions, MP3s from
+// tests/mp3enc.c decoded back to what went in at every sample rate, seeking, and streams
+// with junk in. Checked against libmad too when it's built with it.
+#include "mp3lite.c"
+#include "harness.h"
+#include "mp3enc.h"
+#include "settings.h"
+
+#define MAX_SAMPLES (48000 * 4)
+
+struct source {
+	const u8 *data;
+	u32 len;
+	u32 pos;
+};
+
+static s16 pcm[MAX_SAMPLES * 2];
+static s16 decoded[(MAX_SAMPLES + 8192) * 2];
+static s16 reference[(MAX_SAMPLES + 8192) * 2];
+static u32 streamPositions[MAX_SAMPLES / 576 + 16];
+
+static s32 sourceRead(void *cbdata, void *dst, s32 size) {
+	struct source *src = cbdata;
+	s32 n = MIN((u32)size, src->len - src->pos);
+	memcpy(dst, src->data + src->pos, n);
+	src->pos += n;
+	return n;
+}
+
+// Decodes what's left of an open decoder's stream into out, returns the samples
+static u32 decodeRest(const struct decoder_backend *backend, void *dec, s16 *out, u32 *sampleRate, u32 *positions) {
+	static struct decoder_pcm frame;
+	u32 samples = 0;
+	u32 frames = 0;
+	while(backend->decode(dec, &frame)) {
+		u32 n = MIN(frame.count, MAX_SAMPLES + 8192 - samples);
+		memcpy(out + samples * 2, frame.samples, n * 4);
+		samples += n;
+		if(sampleRate) {
+			*sampleRate = frame.sampleRate;
+		}
+		if(positions && frames < MAX_SAMPLES / 576 + 16) {
+			positions[frames] = frame.streamPos;
+		}
+		frames++;
+	}
+	return samples;
+}
+
+static u32 decodeAll(const struct decoder_backend *backend, const u8 *mp3, u32 len, s16 *out, u32 *sampleRate) {
+	struct source src = {mp3, len, 0};
+	void *dec = backend->open(sourceRead, &src);
+	u32 samples = decodeRest(backend, dec, out, sampleRate, NULL);
+	backend->close(dec);
+	return samples;
+}
+
+// Tones spread over the band, or quieter ones and a click every half second
+static void makeSignal(u32 samples, u32 sampleRate, int channels, int clicks) {
+	static const float freqs[3] = {0.01f, 0.027f, 0.061f};
+	srand(sampleRate + channels);
+	for(u32 i = 0; i < samples; i++) {
+		for(int ch = 0; ch < channels; ch++) {
+			float v = 0;
+			for(int k = 0; k < 3; k++) {
+				v += (0.3f / (k + 1)) * sinf(2 * M_PI * freqs[k] * (ch ? 1.5f : 1) * i);
+			}
+			if(clicks) {
+				v = v / 8 + (i % (sampleRate / 2) < sampleRate / 200 ? (rand() % 2001 - 1000) / 1500.0f : 0);
+			}
+			pcm[i * channels + ch] = v * 30000;
+		}
+	}
+}
+
+// Signal to noise of what was decoded against the signal it was made from, in dB
+static double decodedSnr(u32 samples, int channels, int ch, u32 lag) {
+	double signal = 0, noise = 0;
+	for(u32 i = 0; i < samples; i++) {
+		double want = pcm[i * channels + ch];
+		double diff = decoded[(i + lag) * 2 + ch] - want;
+		signal += want * want;
+		noise += diff * diff;
+	}
+	return 10 * log10(signal / MAX(noise, 1));
+}
+
+static void testTables() {
+	initTables();
+	CHECK(huffUsed <= LITE_HUFF_POOL);
+	// Every code's a whole prefix code and looks up as itself
+	for(int t = 1; t < 32; t++) {
+		const struct lite_huff_table *h = &liteHuffTables[t];
+		if(!h->dim || (t > 16 && t != 24)) {
+			continue;
+		}
+		double kraft = 0;
+		int wrong = 0;
+		for(int c = 0; c < h->dim * h->dim; c++) {
+			u8 buf[8] = {0};
+			u32 code = (u32)h->codes[c] << (32 - h->lengths[c]);
+			buf[0] = code >> 24;
+			buf[1] = code >> 16;
+			buf[2] = code >> 8;
+			buf[3] = code;
+			struct lite_bits b = {buf, 0};
+			u32 v = huffDecode(&b, &huffLookups[t]);
+			wrong += v != (((c / h->dim) << 4) | (c % h->dim)) || b.pos != h->lengths[c];
+			kraft += ldexp(1, -h->lengths[c]);
+		}
+		CHECK_EQ(wrong, 0);
+		CHECK(fabs(kraft - 1) < 1e-9);
+	}
+	for(int c = 0; c < 16; c++) {
+		u8 buf[8] = {liteCount1Table.codes[c] << (8 - liteCount1Table.lengths[c])};
+		struct lite_bits b = {buf, 0};
+		CHECK_EQ(huffDecode(&b, &count1Lookup), c);
+		CHECK_EQ(b.pos, liteCount1Table.lengths[c]);
+	}
+	// Bands make up a granule, a short block's window and a mixed block
+	for(int rate = 0; rate < 9; rate++) {
+		int sums[3] = {0, 0, 0};
+		for(int sfb = 0; sfb < 22; sfb++) {
+			sums[0] += liteSfbLong[rate][sfb];
+		}
+		for(int sfb = 0; sfb < 13; sfb++) {
+			sums[1] += liteSfbShort[rate][sfb];
+		}
+		for(int i = 0; sfbWidths[rate][BLOCKS_MIXED][i]; i++) {
+			sums[2] += sfbWidths[rate][BLOCKS_MIXED][i];
+		}
+		CHECK_EQ(sums[0], 576);
+		CHECK_EQ(sums[1], 192);
+		CHECK_EQ(sums[2], 576);
+	}
+	// A few of the standard's synthesis window values
+	CHECK(fabsf(synthWindow[1] + 0.000015259f) < 1e-8f);
+	CHECK(fabsf(synthWindow[511] - 0.000015259f) < 1e-8f);
+	CHECK(fabsf(synthWindow[256] - 1.144989014f) < 1e-6f);
+	CHECK(fabsf(synthWindow[64] - synthWindow[448]) < 1e-8f || fabsf(synthWindow[64] + synthWindow[448]) < 1e-8f);
+}
+
+static void testTransforms() {
+	initTables();
+	srand(1);
+	// The fast DCT
+	float x[32], tmp[32], want[32];
+	for(int k = 0; k < 32; k++) {
+		x[k] = (rand() % 2001 - 1000) / 1000.0f;
+	}
+	for(int m = 0; m < 32; m++) {
+		double s = 0;
+		for(int k = 0; k < 32; k++) {
+			s += x[k] * cos(M_PI * m * (2*k + 1) / 64);
+		}
+		want[m] = s;
+	}
+	dct(x, tmp, 32);
+	float worst = 0;
+	for(int m = 0; m < 32; m++) {
+		worst = MAX(worst, fabsf(x[m] - want[m]));
+	}
+	CHECK(worst < 1e-4f);
+
+	// The half worked out IMDCTs, every block type's window
+	float in[18], z[36];
+	for(int k = 0; k < 18; k++) {
+		in[k] = (rand() % 2001 - 1000) / 1000.0f;
+	}
+	for(int type = 0; type < 4; type++) {
+		if(type == 2) {
+			continue;
+		}
+		imdctLongBlock(in, z, type);
+		worst = 0;
+		for(int i = 0; i < 36; i++) {
+			double s = 0;
+			for(int k = 0; k < 18; k++) {
+				s += in[k] * cos(M_PI / 72 * (2*i + 1 + 18) * (2*k + 1));
+			}
+			double w = sin(M_PI / 36 * (i + 0.5));
+			if(type == 1) {
+				w = i < 18 ? w : i < 24 ? 1 : i < 30 ? sin(M_PI / 12 * (i - 18 + 0.5)) : 0;
+			}
+			else if(type == 3) {
+				w = i < 6 ? 0 : i < 12 ? sin(M_PI / 12 * (i - 6 + 0.5)) : i < 18 ? 1 : w;
+			}
+			worst = MAX(worst, fabsf(z[i] - s * w));
+		}
+		CHECK(worst < 1e-4f);
+	}
+	imdctShortBlock(in, z);
+	float shortWant[36] = {0};
+	for(int w = 0; w < 3; w++) {
+		for(int i = 0; i < 12; i++) {
+			double s = 0;
+			for(int k = 0; k < 6; k++) {
+				s += in[w*6 + k] * cos(M_PI / 24 * (2*i + 1 + 6) * (2*k + 1));
+			}
+			shortWant[6 + 6*w + i] += s * sin(M_PI / 12 * (i + 0.5));
+		}
+	}
+	worst = 0;
+	for(int i = 0; i < 36; i++) {
+		worst = MAX(worst, fabsf(z[i] - shortWant[i]));
+	}
+	CHECK(worst < 1e-4f);
+
+	// The synthesis filter against the standard's matrixing, a granule at a time
+	static struct lite_state dec;
+	static double v[1024];
+	memset(&dec, 0, sizeof(dec));
+	memset(v, 0, sizeof(v));
+	s16 out[576 * 2];
+	int wrong = 0;
+	for(int g = 0; g < 3; g++) {
+		for(int t = 0; t < 18; t++) {
+			for(int sb = 0; sb < 32; sb++) {
+				dec.hybrid[t][sb] = (rand() % 2001 - 1000) / 8000.0f;
+			}
+		}
+		synthesise(&dec, 0, out);
+		for(int t = 0; t < 18; t++) {
+			memmove(v + 64, v, 960 * sizeof(double));
+			for(int i = 0; i < 64; i++) {
+				double s = 0;
+				for(int k = 0; k < 32; k++) {
+					s += cos((16 + i) * (2*k + 1) * M_PI / 64) * dec.hybrid[t][k];
+				}
+				v[i] = s;
+			}
+			for(int j = 0; j < 32; j++) {
+				double s = 0;
+				for(int i = 0; i < 8; i++) {
+					s += v[128*i + j] * synthWindow[64*i + j] + v[128*i + 96 + j] * synthWindow[64*i + 32 + j];
+				}
+				s = round(s * 32768);
+				wrong += fabs(MAX(MIN(s, 32767), -32768) - out[(t*32 + j) * 2]) > 1;
+			}
+		}
+	}
+	CHECK_EQ(wrong, 0);
+}
+
+struct round_trip {
+	u32 sampleRate;
+	int channels;
+	u32 bitrate;
+	int ms;
+	double minSnr;
+};
+
+static void testRoundTrips() {
+	static const struct round_trip trips[] = {
+		{44100, 2, 128, 0, 38},
+		{44100, 2, 128, 1, 35},
+		{44100, 1, 64, 0, 38},
+		{48000, 2, 320, 0, 52},
+		{32000, 1, 32, 0, 35},
+		{22050, 2, 64, 1, 35},
+		{24000, 2, 160, 0, 48},
+		{16000, 1, 32, 0, 42},
+		{11025, 1, 16, 0, 34},
+		{12000, 2, 64, 1, 42},
+		{8000, 1, 8, 0, 28}
+	};
+	for(int i = 0; i < sizeof(trips) / sizeof(trips[0]); i++) {
+		const struct round_trip *r = &trips[i];
+		struct mp3enc_options opts = {r->sampleRate, r->channels, r->bitrate, r->ms, 0};
+		u32 samples = r->sampleRate * 2;
+		makeSignal(samples, r->sampleRate, r->channels, 0);
+		u32 size;
+		u8 *mp3 = mp3Encode(pcm, samples, &opts, &size);
+		u32 sampleRate = 0;
+		u32 got = decodeAll(&liteBackend, mp3, size, decoded, &sampleRate);
+		CHECK_EQ(sampleRate, r->sampleRate);
+		CHECK(got >= samples + MP3ENC_DELAY + LITE_DELAY);
+		for(int ch = 0; ch < r->channels; ch++) {
+			double snr = decodedSnr(samples, r->channels, ch, MP3ENC_DELAY + LITE_DELAY);
+			if(!CHECK(snr >= r->minSnr)) {
+				fprintf(stderr, "%uHz %ukbps channel %d: %.1fdB\n", r->sampleRate, r->bitrate, ch, snr);
+			}
+			// A sample either side is a lot worse, the delay's right
+			CHECK(decodedSnr(samples, r->channels, ch, MP3ENC_DELAY + LITE_DELAY + 1) < snr - 3);
+		}
+		if(r->channels == 1) {
+			int doubled = 1;
+			for(u32 j = 0; j < got; j++) {
+				doubled &= decoded[j*2] == decoded[j*2 + 1];
+			}
+			CHECK(doubled);
+		}
+#ifndef NO_LIBMAD
+		const struct decoder_backend *mad = decoderGet(DECODER_LIBMAD);
+		CHECK_EQ(decodeAll(mad, mp3, size, reference, NULL), got);
+		double signal = 0, noise = 0;
+		for(u32 j = 0; j < got * 2; j++) {
+			double diff = decoded[j] - reference[j];
+			signal += (double)reference[j] * reference[j];
+			noise += diff * diff;
+		}
+		CHECK(10 * log10(signal / MAX(noise, 1)) > 60);
+#endif
+		free(mp3);
+	}
+}
+
+// Side info of every granule, by frame, from the encoder's output
+static u32 blockTypes(const u8 *mp3, u32 size, u8 *types) {
+	u32 n = 0;
+	struct lite_header h;
+	for(u32 pos = 0; pos + 4 <= size && parseHeader(mp3 + pos, &h); pos += h.length) {
+		struct lite_bits b = {mp3 + pos + 4, 0};
+		struct lite_channel gr[2][2];
+		u32 mainDataBegin;
+		u8 scfsi[2];
+		CHECK(readSideInfo(&b, &h, &mainDataBegin, scfsi, gr));
+		for(int g = 0; g < (h.lsf ? 1 : 2); g++) {
+			types[n++] = gr[g][0].blockType;
+		}
+	}
+	return n;
+}
+
+static void testShortBlocks() {
+	static const u32 rates[3] = {44100, 22050, 8000};
+	static u8 types[MAX_SAMPLES / 576 + 16];
+	for(int i = 0; i < 3; i++) {
+		u32 samples = rates[i] * 2;
+		double snr[2];
+		makeSignal(samples, rates[i], 2, 1);
+		for(int shortBlocks = 0; shortBlocks < 2; shortBlocks++) {
+			struct mp3enc_options opts = {rates[i], 2, rates[i] < 32000 ? 96 : 192, 1, shortBlocks};
+			u32 size;
+			u8 *mp3 = mp3Encode(pcm, samples, &opts, &size);
+			decodeAll(&liteBackend, mp3, size, decoded, NULL);
+			snr[shortBlocks] = decodedSnr(samples, 2, 0, MP3ENC_DELAY + LITE_DELAY);
+			if(shortBlocks) {
+				// Start, short and stop, in that order
+				u32 n = blockTypes(mp3, size, types);
+				int shorts = 0, inOrder = 1;
+				for(u32 g = 0; g < n; g++) {
+					shorts += types[g] == 2;
+					if(types[g] == 1) {
+						inOrder &= g + 1 < n && types[g + 1] == 2;
+					}
+					if(types[g] == 3) {
+						inOrder &= g > 0 && types[g - 1] == 2;
+					}
+				}
+				CHECK(shorts >= 4);
+				CHECK(inOrder);
+			}
+			free(mp3);
+		}
+		// Short blocks have to come back as well as long ones, near enough
+		if(!CHECK(snr[1] > snr[0] - 3)) {
+			fprintf(stderr, "%uHz: %.1fdB long, %.1fdB short\n", rates[i], snr[0], snr[1]);
+		}
+	}
+}
+
+static void testSeek() {
+	struct mp3enc_options opts = {44100, 2, 128, 1, 1};
+	u32 samples = 44100 * 3;
+	makeSignal(samples, 44100, 2, 1);
+	u32 size;
+	u8 *mp3 = mp3Encode(pcm, samples, &opts, &size);
+	static u32 refPositions[MAX_SAMPLES / 576 + 16];
+
+	// Back to the start part way through, as when a track's started again
+	struct source src = {mp3, size, 0};
+	void *dec = liteOpen(sourceRead, &src);
+	u32 refSamples = decodeRest(&liteBackend, dec, reference, NULL, refPositions);
+	liteSeek(dec, 0);
+	src.pos = 0;
+	static struct decoder_pcm frame;
+	for(int i = 0; i < 10; i++) {
+		CHECK(liteDecode(dec, &frame));
+	}
+	liteSeek(dec, 0);
+	src.pos = 0;
+	CHECK_EQ(decodeRest(&liteBackend, dec, decoded, NULL, streamPositions), refSamples);
+	CHECK(!memcmp(decoded, reference, refSamples * 4));
+	CHECK(!memcmp(streamPositions, refPositions, refSamples / 1152 * 4));
+
+	// Into the middle of the stream, the same as a decoder opened there
+	u32 offset = refPositions[40];
+	struct source fresh = {mp3 + offset, size - offset, 0};
+	void *other = liteOpen(sourceRead, &fresh);
+	u32 freshSamples = decodeRest(&liteBackend, other, reference, NULL, refPositions);
+	liteClose(other);
+	liteSeek(dec, offset);
+	src.pos = offset;
+	CHECK_EQ(decodeRest(&liteBackend, dec, decoded, NULL, streamPositions), freshSamples);
+	CHECK(!memcmp(decoded, reference, freshSamples * 4));
+	CHECK_EQ(streamPositions[0], refPositions[0] + offset);
+	// Frames whose main data starts before the seek can't be decoded, the rest all are
+	CHECK(freshSamples >= refSamples - 40 * 1152 - 2 * 1152);
+	liteClose(dec);
+	free(mp3);
+}
+
+static void testJunk() {
+	struct mp3enc_options opts = {44100, 2, 128, 0, 0};
+	u32 samples = 44100 * 2;
+	makeSignal(samples, 44100, 2, 0);
+	u32 size;
+	u8 *mp3 = mp3Encode(pcm, samples, &opts, &size);
+	u8 *buf = malloc(size + 8192);
+	u32 clean = decodeAll(&liteBackend, mp3, size, reference, NULL);
+
+	// Junk in front with false syncs in it, and an Info frame
+	srand(7);
+	for(u32 i = 0; i < 3000; i++) {
+		buf[i] = i % 50 == 0 ? 0xFF : rand();
+	}
+	memcpy(buf + 3000, mp3, 4);
+	memset(buf + 3004, 0, 413);
+	memcpy(buf + 3004 + 32, "Info", 4);
+	memcpy(buf + 3417, mp3, size);
+	CHECK_EQ(decodeAll(&liteBackend, buf, size + 3417, decoded, NULL), clean);
+	CHECK(!memcmp(decoded, reference, clean * 4));
+
+	// Junk over the middle loses a few frames at most, cut short loses the rest
+	memcpy(buf, mp3, size);
+	for(u32 i = 0; i < 1000; i++) {
+		buf[size / 2 + i] = rand();
+	}
+	u32 got = decodeAll(&liteBackend, buf, size, decoded, NULL);
+	CHECK(got < clean && got >= clean - 6 * 1152);
+	got = decodeAll(&liteBackend, mp3, size / 2 + 200, decoded, NULL);
+	CHECK(got < clean / 2 + 1152 && got >= clean / 2 - 2 * 1152);
+
+	// Nothing but junk
+	for(u32 i = 0; i < size; i++) {
+		buf[i] = rand();
+	}
+	CHECK(decodeAll(&liteBackend, buf, size, decoded, NULL) <= 2 * 1152);
+	CHECK_EQ(decodeAll(&liteBackend, buf, 0, decoded, NULL), 0);
+	free(buf);
+	free(mp3);
+}
+
+static void testBackends() {
+	CHECK(decoderGet(DECODER_LITE) == &liteBackend);
+	CHECK(decoderGet(-1) != NULL);
+	CHECK(decoderGet(99) == decoderGet(-1));
+#ifdef NO_LIBMAD
+	CHECK(decoderGet(DECODER_LIBMAD) == &liteBackend);
+#else
+	CHECK(!strcmp(decoderGet(DECODER_LIBMAD)->name, "libmad"));
+#endif
+}
+
+int main() {
+	testTables();
+	testTransforms();
+	testRoundTrips();
+	testShortBlocks();
+	testSeek();
+	testJunk();
+	testBackends();
+	return testsFinish("test_decoder");
+}
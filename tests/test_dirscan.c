@@ -0,0 +1,60 @@
+// Directory iteration sorting files from dirs without a stat() each
+#include <gccore.h>
+#include "harness.h"
+#include "dirscan.h"
+
+#define DIR_PATH WAKEMII_DIR "/scan"
+
+static void listing(int flags, int *files, int *dirs) {
+	dir_scan scan;
+	struct dirent *entry;
+	int isDir;
+	*files = *dirs = 0;
+	CHECK(dirScanOpen(&scan, DIR_PATH, flags));
+	while((entry = dirScanNext(&scan, &isDir)) != NULL) {
+		CHECK(strcmp(entry->d_name, ".") && strcmp(entry->d_name, ".."));
+		// The names say what they are
+		CHECK_EQ(isDir, !strncmp(entry->d_name, "dir", 3));
+		*(isDir ? dirs : files) += 1;
+	}
+	dirScanClose(&scan);
+}
+
+int main() {
+	testDirEnter("dirscan");
+	mkdir(DIR_PATH, 0755);
+	char path[256];
+	for(int i = 0; i < 37; i++) {
+		snprintf(path, sizeof(path), DIR_PATH "/file%02d.mp3", i);
+		writeFile(path, "x", 1);
+	}
+	for(int i = 0; i < 5; i++) {
+		snprintf(path, sizeof(path), DIR_PATH "/dir%d.mp3", i);
+		mkdir(path, 0755);
+	}
+
+	int files, dirs;
+	listing(DIRSCAN_FILES, &files, &dirs);
+	CHECK_EQ(files, 37);
+	CHECK_EQ(dirs, 0);
+	listing(DIRSCAN_DIRS, &files, &dirs);
+	CHECK_EQ(files, 0);
+	CHECK_EQ(dirs, 5);
+	listing(DIRSCAN_FILES | DIRSCAN_DIRS, &files, &dirs);
+	CHECK_EQ(files, 37);
+	CHECK_EQ(dirs, 5);
+
+	// isDir is optional, and a missing dir just doesn't open
+	dir_scan scan;
+	int count = 0;
+	CHECK(dirScanOpen(&scan, DIR_PATH, DIRSCAN_DIRS));
+	while(dirScanNext(&scan, NULL)) {
+		count++;
+	}
+	dirScanClose(&scan);
+	dirScanClose(&scan);
+	CHECK_EQ(count, 5);
+	CHECK(!dirScanOpen(&scan, DIR_PATH "/nothing", DIRSCAN_FILES));
+	testDirLeave();
+	return testsFinish("test_dirscan");
+}
@@ -0,0 +1,219 @@
+// Weighted picks out of the Fenwick trees against the weights worked out by
+// hand, skipping the last played, and the history loading off the main thread
+#include "history.c"
+#include <math.h>
+#include <unistd.h>
+#include "harness.h"
+
+#define NUM_ALBUMS 6
+#define TRACKS_PER_ALBUM 7
+#define NUM_HOURLY 5
+#define PICKS 400000
+#define FAV_ALBUM_FILE WAKEMII_DIR "/fav.txt"
+
+// Wilson-Hilferty at p = 0.001
+static double chiCritical(int dof) {
+	double z = 3.09;
+	double a = 2.0 / (9 * dof);
+	double c = 1 - a + z * sqrt(a);
+	return dof * c * c * c;
+}
+
+static int waitLoaded() {
+	for(int i = 0; i < 5000; i++) {
+		if(syncHistory()) {
+			return 1;
+		}
+		usleep(1000);
+	}
+	return 0;
+}
+
+// What a track's weight should be, straight from the definition
+static double expectedWeight(struct pick_pool *pool, u32 item, u32 now) {
+	int skip = poolSkip(pool);
+	for(int i = 0; i < skip && i < pool->numRecent; i++) {
+		if(pool->recent[i] == item) {
+			return 0;
+		}
+	}
+	double mult = 1;
+	if(alarmPickMode == ALARM_PICK_FAVOURITES && (pool->recs[item].flags & HISTORY_FAVOURITE)) {
+		mult = HISTORY_FAV_WEIGHT;
+	}
+	if(alarmPickMode == ALARM_PICK_LEAST_RECENT) {
+		mult *= now - pool->recs[item].last_played + 1;
+	}
+	return mult;
+}
+
+// Picks a lot and checks they follow the weights, returns how many never-to-be-picked tracks came up
+static u32 checkDistribution(const char *what) {
+	struct pick_pool *pool = &pools[POOL_ALBUMS];
+	u32 *counts = calloc(pool->size, sizeof(u32));
+	double *weights = malloc(pool->size * sizeof(double));
+	u32 now = nowMinutes();
+	double total = 0;
+	for(u32 i = 0; i < pool->size; i++) {
+		weights[i] = expectedWeight(pool, i, now);
+		total += weights[i];
+	}
+	for(int i = 0; i < PICKS; i++) {
+		int album, track;
+		if(!historyPickAlarm(&album, &track)) {
+			break;
+		}
+		counts[playlistEntryToGlobal(album, track)]++;
+	}
+	double chi2 = 0;
+	int dof = -1;
+	u32 forbidden = 0;
+	for(u32 i = 0; i < pool->size; i++) {
+		if(weights[i] == 0) {
+			forbidden += counts[i];
+			continue;
+		}
+		double expected = PICKS * weights[i] / total;
+		chi2 += (counts[i] - expected) * (counts[i] - expected) / expected;
+		dof++;
+	}
+	printf("%s: chi2 %.2f, critical %.2f\n", what, chi2, chiCritical(dof));
+	CHECK(chi2 < chiCritical(dof));
+	free(counts);
+	free(weights);
+	return forbidden;
+}
+
+static void testPicks() {
+	startLibraryScan();
+	waitForScan();
+	historyInit();
+	alarmPickMode = ALARM_PICK_RANDOM;
+	alarmSkipLast = 0;
+	CHECK(waitLoaded());
+	CHECK_EQ(pools[POOL_ALBUMS].size, NUM_ALBUMS * TRACKS_PER_ALBUM);
+	CHECK_EQ(pools[POOL_HOURLY].size, NUM_HOURLY);
+	CHECK_EQ(checkDistribution("random"), 0);
+
+	// Least recent: spread the tracks' last plays out over the last few days
+	u32 now = nowMinutes();
+	for(u32 i = 0; i < pools[POOL_ALBUMS].size; i++) {
+		pools[POOL_ALBUMS].recs[i].last_played = i % 3 ? now - (i * 97) % 5000 : 0;
+	}
+	alarmPickMode = ALARM_PICK_LEAST_RECENT;
+	CHECK(syncHistory());
+	CHECK_EQ(checkDistribution("least recent"), 0);
+
+	// Favourites, some of which are also in the last few played
+	for(int i = 0; i < 5; i++) {
+		CHECK_EQ(historyToggleFavourite(i, i), 1);
+	}
+	CHECK_EQ(historyToggleFavourite(4, 4), 0);
+	writeFile(FAV_ALBUM_FILE, albumName(3), strlen(albumName(3)));
+	CHECK(historyIsFavourite(0, 0));
+	CHECK(!historyIsFavourite(4, 4));
+	alarmPickMode = ALARM_PICK_FAVOURITES;
+	alarmSkipLast = 3;
+	CHECK(syncHistory());
+	historyPlayed(0, 0);
+	historyPlayed(2, 1);
+	historyPlayed(5, 6);
+	CHECK_EQ(checkDistribution("favourites, skipping 3"), 0);
+
+	// A fourth play lets the oldest of those back in, with its favourite weight
+	historyPlayed(3, 3);
+	CHECK_EQ(checkDistribution("favourites, skipping 3 again"), 0);
+	CHECK_EQ(expectedWeight(&pools[POOL_ALBUMS], playlistEntryToGlobal(0, 0), nowMinutes()), HISTORY_FAV_WEIGHT);
+
+	// The trees as updated one play at a time match building them from scratch
+	struct pick_pool *pool = &pools[POOL_ALBUMS];
+	u32 *treeMult = malloc((pool->size + 1) * sizeof(u32));
+	memcpy(treeMult, pool->treeMult, (pool->size + 1) * sizeof(u32));
+	buildPool(pool);
+	CHECK(!memcmp(treeMult, pool->treeMult, (pool->size + 1) * sizeof(u32)));
+	free(treeMult);
+
+	// Hourly chimes, never the one just played
+	alarmPickMode = ALARM_PICK_RANDOM;
+	alarmSkipLast = 1;
+	CHECK(syncHistory());
+	historyPlayed(HOURLY_ALBUM, 2);
+	int hourly, picked = 0, repeats = 0;
+	for(int i = 0; i < 1000; i++) {
+		if(historyPickHourly(&hourly)) {
+			picked++;
+			repeats += hourly == 2;
+		}
+	}
+	CHECK_EQ(picked, 1000);
+	CHECK_EQ(repeats, 0);
+	historyFlush(1);
+}
+
+static void testReloaded() {
+	// What was played and favourited last time is still there
+	startLibraryScan();
+	waitForScan();
+	historyInit();
+	CHECK(waitLoaded());
+	CHECK(historyIsFavourite(0, 0));
+	CHECK(historyIsFavourite(3, 3));
+	CHECK(!historyIsFavourite(4, 4));
+	struct pick_pool *pool = &pools[POOL_ALBUMS];
+	CHECK_EQ(pool->recs[playlistEntryToGlobal(0, 0)].play_count, 1);
+	CHECK_EQ(pool->recs[playlistEntryToGlobal(3, 3)].play_count, 1);
+	// Played in the same minute, so in any order
+	u32 played[4] = {playlistEntryToGlobal(0, 0), playlistEntryToGlobal(2, 1), playlistEntryToGlobal(5, 6), playlistEntryToGlobal(3, 3)};
+	int inRecent = 0;
+	for(int i = 0; i < 4; i++) {
+		for(int j = 0; j < 4; j++) {
+			inRecent += pool->recent[i] == played[j];
+		}
+	}
+	CHECK_EQ(inRecent, 4);
+	CHECK_EQ(pools[POOL_HOURLY].recs[2].play_count, 1);
+}
+
+static void testLibraryChanged() {
+	// A new album shifts the numbering, the history follows the tracks by name
+	startLibraryScan();
+	waitForScan();
+	historyInit();
+	CHECK(waitLoaded());
+	CHECK_EQ(pools[POOL_ALBUMS].size, (NUM_ALBUMS + 1) * TRACKS_PER_ALBUM);
+	char favAlbum[64] = {0};
+	readFile(FAV_ALBUM_FILE, favAlbum, sizeof(favAlbum) - 1);
+	int found = 0;
+	for(int album = 0; album < num_albums; album++) {
+		if(!strcmp(albumName(album), favAlbum)) {
+			found = 1;
+			CHECK(historyIsFavourite(album, 3));
+			CHECK_EQ(pools[POOL_ALBUMS].recs[playlistEntryToGlobal(album, 3)].play_count, 1);
+		}
+	}
+	CHECK(found);
+}
+
+static void testNotOnMainThread() {
+	// The first ask only hands the load to the worker, nothing's read on the main thread
+	startLibraryScan();
+	waitForScan();
+	historyInit();
+	int album, track;
+	CHECK(!historyPickAlarm(&album, &track));
+	CHECK(records == NULL);
+	CHECK(waitLoaded());
+	CHECK(historyPickAlarm(&album, &track));
+}
+
+int main() {
+	testDirEnter("history");
+	makeAlbums(NUM_ALBUMS, TRACKS_PER_ALBUM, NUM_HOURLY);
+	runIsolated(testPicks);
+	runIsolated(testReloaded);
+	runIsolated(testNotOnMainThread);
+	makeAlbum(NUM_ALBUMS, TRACKS_PER_ALBUM);
+	runIsolated(testLibraryChanged);
+	testDirLeave();
+	return testsFinish("test_history");
+}
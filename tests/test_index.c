@@ -0,0 +1,159 @@
+// library.idx: written after a scan, trusted for unchanged dirs, ignored when corrupt
+#include <gccore.h>
+#include <unistd.h>
+#include "harness.h"
+#include "library.h"
+
+#define NUM_ALBUMS 30
+#define TRACKS 4
+
+static int sneaked;
+
+// Adds a track behind the index's back, the dir keeps its old mtime so only a rescan finds it
+static void sneakTrack(int made) {
+	char dir[256], path[300];
+	struct stat st;
+	snprintf(dir, sizeof(dir), "%s/Album %05d", ALBUMS_DIR, made);
+	stat(dir, &st);
+	snprintf(path, sizeof(path), "%s/50 Sneaky.mp3", dir);
+	writeFile(path, "sneaky", 6);
+	setMtime(dir, st.st_mtime);
+	sneaked++;
+}
+
+static void touchDir(int made) {
+	char dir[256];
+	snprintf(dir, sizeof(dir), "%s/Album %05d", ALBUMS_DIR, made);
+	setMtime(dir, time(NULL) + 100);
+}
+
+static int tracksOf(int made) {
+	char name[32];
+	snprintf(name, sizeof(name), "Album %05d", made);
+	for(int i = 0; i < num_albums; i++) {
+		if(!strcmp(albumName(i), name)) {
+			return albumNumEntries(i);
+		}
+	}
+	return -1;
+}
+
+static void scan() {
+	startLibraryScan();
+	waitForScan();
+}
+
+static void firstScan() {
+	CHECK(access(LIBRARY_INDEX_FILE, F_OK) != 0);
+	scan();
+	CHECK_EQ(num_albums, NUM_ALBUMS);
+	CHECK_EQ(num_hourly, 12);
+	CHECK(access(LIBRARY_INDEX_FILE, F_OK) == 0);
+}
+
+static void indexedScan() {
+	scan();
+	CHECK_EQ(num_albums, NUM_ALBUMS);
+	CHECK_EQ(num_tracks, NUM_ALBUMS * TRACKS);
+	CHECK_EQ(num_hourly, 12);
+	CHECK_EQ(tracksOf(3), TRACKS);		// from the index, the sneaky track isn't seen
+	// The names come back exactly as they went in
+	for(int i = 0; i < num_albums; i++) {
+		CHECK(!strncmp(albumName(i), "Album ", 6));
+		for(int j = 0; j < albumNumEntries(i); j++) {
+			CHECK(strstr(albumTrackName(i, j), " Track.mp3") != NULL);
+		}
+	}
+}
+
+static void changedScan() {
+	scan();
+	CHECK_EQ(tracksOf(3), TRACKS + 1);		// its mtime moved so it was reread
+	CHECK_EQ(tracksOf(4), TRACKS);			// this one's still from the index
+	CHECK_EQ(num_tracks, NUM_ALBUMS * TRACKS + 1);
+}
+
+static void fullScan() {
+	scan();
+	CHECK_EQ(num_albums, NUM_ALBUMS);
+	CHECK_EQ(tracksOf(3), TRACKS + 1);
+	CHECK_EQ(tracksOf(4), TRACKS + 1);		// read from the dir, not the index
+	CHECK_EQ(num_tracks, NUM_ALBUMS * TRACKS + sneaked);
+	CHECK_EQ(num_hourly, 12);
+}
+
+static void rewrittenScan() {
+	scan();
+	CHECK_EQ(tracksOf(4), TRACKS + 1);		// what the full scan found
+	CHECK_EQ(tracksOf(5), TRACKS);			// sneaked in since
+	CHECK_EQ(num_tracks, NUM_ALBUMS * TRACKS + sneaked - 1);
+}
+
+static void deletedScan() {
+	scan();
+	CHECK_EQ(num_albums, NUM_ALBUMS - 1);
+	CHECK_EQ(tracksOf(7), -1);
+}
+
+// Damages the index file at offset, which is from the end if negative
+static void damageIndex(long offset, int truncate) {
+	u8 buf[1 << 16];
+	size_t len = readFile(LIBRARY_INDEX_FILE, buf, sizeof(buf));
+	CHECK(len > 64 && len < sizeof(buf));
+	if(truncate) {
+		len = offset;
+	}
+	else {
+		buf[offset < 0 ? len + offset : offset] ^= 0x5A;
+	}
+	writeFile(LIBRARY_INDEX_FILE, buf, len);
+}
+
+static void removeAlbum(int made) {
+	char dir[256], path[300];
+	snprintf(dir, sizeof(dir), "%s/Album %05d", ALBUMS_DIR, made);
+	for(int i = 0; i < TRACKS; i++) {
+		snprintf(path, sizeof(path), "%s/%02d Track.mp3", dir, i);
+		remove(path);
+	}
+	rmdir(dir);
+}
+
+int main() {
+	testDirEnter("index");
+	makeAlbums(NUM_ALBUMS, TRACKS, 12);
+	runIsolated(firstScan);
+
+	// Unchanged dirs come from the index
+	sneakTrack(3);
+	sneakTrack(4);
+	runIsolated(indexedScan);
+	runIsolated(indexedScan);
+
+	// Only the dir whose mtime changed is reread
+	touchDir(3);
+	runIsolated(changedScan);
+
+	// A flipped bit anywhere in the data and the whole thing is rescanned
+	damageIndex(-3, 0);
+	runIsolated(fullScan);
+	// and the rewritten index is good again
+	sneakTrack(5);
+	runIsolated(rewrittenScan);
+
+	// Bad magic, cut short or emptied are all a full rescan too
+	damageIndex(0, 0);
+	sneakTrack(6);
+	runIsolated(fullScan);
+	damageIndex(40, 1);
+	runIsolated(fullScan);
+	writeFile(LIBRARY_INDEX_FILE, "", 0);
+	runIsolated(fullScan);
+
+	// An album that's gone drops out of the rewritten index
+	removeAlbum(7);
+	runIsolated(deletedScan);
+	runIsolated(deletedScan);
+	testDirLeave();
+	return testsFinish("test_index");
+}
@@ -0,0 +1,154 @@
+// Scanning album trees and opening tracks from the album table
+#include <gccore.h>
+#include <unistd.h>
+#include "harness.h"
+#include "library.h"
+
+#define NUM_ALBUMS 40
+#define ALBUM_TRACKS(i) ((i) % 7 + 1)
+
+static int madeNum(int albumNum) {
+	return atoi(albumName(albumNum) + 6);
+}
+
+static void checkEntry(int albumNum, int entryNum) {
+	char name[256];
+	FILE *fp = getEntryFromIndex(albumNum, entryNum, name);
+	if(!CHECK(fp != NULL)) {
+		return;
+	}
+	char contents[64] = {0}, expected[64];
+	fread(contents, 1, sizeof(contents) - 1, fp);
+	fclose(fp);
+	// The file says which album and track it is, the name is NN Track.mp3
+	snprintf(expected, sizeof(expected), "album %d track %d", albumNum == HOURLY_ALBUM ? -1 : madeNum(albumNum), atoi(name));
+	if(albumNum == HOURLY_ALBUM) {
+		CHECK(!strcmp(contents, "chime"));
+	}
+	else {
+		CHECK(!strcmp(contents, expected));
+	}
+	CHECK(!strcmp(name, albumTrackName(albumNum, entryNum)));
+}
+
+static void testScan() {
+	startLibraryScan();
+	waitForScan();
+	CHECK_EQ(libraryScanState, LIBRARY_SCAN_DONE);
+	CHECK_EQ(num_albums, NUM_ALBUMS);
+	CHECK_EQ(num_hourly, 24);
+	int tracks = 0;
+	for(int i = 0; i < num_albums; i++) {
+		CHECK_EQ(albumNumEntries(i), ALBUM_TRACKS(madeNum(i)));
+		tracks += albumNumEntries(i);
+		for(int j = 0; j < albumNumEntries(i); j++) {
+			checkEntry(i, j);
+		}
+	}
+	CHECK_EQ(num_tracks, tracks);
+	CHECK_EQ(albumCoverType(0), COVER_NONE);
+	checkEntry(HOURLY_ALBUM, 5);
+	// Past the end of the album opens its last track
+	char name[256];
+	FILE *fp = getEntryFromIndex(0, albumNumEntries(0) + 3, name);
+	CHECK(fp != NULL);
+	if(fp) {
+		fclose(fp);
+		CHECK(!strcmp(name, albumTrackName(0, albumNumEntries(0) - 1)));
+	}
+}
+
+static void testOnlyMusic() {
+	// Covers are noted, anything else is skipped, empty dirs aren't albums
+	mkdir(ALBUMS_DIR "/Empty", 0755);
+	mkdir(ALBUMS_DIR "/Covered", 0755);
+	writeFile(ALBUMS_DIR "/Covered/Cover.JPG", "jpg", 3);
+	writeFile(ALBUMS_DIR "/Covered/notes.txt", "txt", 3);
+	writeFile(ALBUMS_DIR "/Covered/01 Loud.MP3", "album 0 track 1", 15);
+	writeFile(ALBUMS_DIR "/stray.mp3", "stray", 5);
+	startLibraryScan();
+	waitForScan();
+	CHECK_EQ(num_albums, NUM_ALBUMS + 1);
+	int found = 0;
+	for(int i = 0; i < num_albums; i++) {
+		if(!strcmp(albumName(i), "Covered")) {
+			found = 1;
+			CHECK_EQ(albumNumEntries(i), 1);
+			CHECK_EQ(albumCoverType(i), COVER_JPG);
+			CHECK(!strcmp(albumTrackName(i, 0), "01 Loud.MP3"));
+		}
+	}
+	CHECK(found);
+}
+
+static void testChangedAlbum() {
+	// A track added after the scan turns up when the album's next opened
+	startLibraryScan();
+	waitForScan();
+	int album = 0;
+	int before = albumNumEntries(album);
+	int tracksBefore = num_tracks;
+	char path[256];
+	snprintf(path, sizeof(path), "%s/%s/99 Track.mp3", ALBUMS_DIR, albumName(album));
+	writeFile(path, "album 0 track 99", 16);
+	snprintf(path, sizeof(path), "%s/%s", ALBUMS_DIR, albumName(album));
+	setMtime(path, time(NULL) + 10);
+	char name[256];
+	FILE *fp = getEntryFromIndex(album, 0, name);
+	CHECK(fp != NULL);
+	if(fp) {
+		fclose(fp);
+	}
+	CHECK_EQ(albumNumEntries(album), before + 1);
+	CHECK_EQ(num_tracks, tracksBefore + 1);
+}
+
+static void testEmptiedAlbum() {
+	// Nothing's opened from an album that's lost all its tracks, least of all the
+	// last track of the album before it
+	startLibraryScan();
+	waitForScan();
+	char name[256];
+	CHECK(getEntryFromIndex(2, -1, name) == NULL);
+	int album = 1;
+	char path[256];
+	for(int i = 0; i < albumNumEntries(album); i++) {
+		snprintf(path, sizeof(path), "%s/%s/%s", ALBUMS_DIR, albumName(album), albumTrackName(album, i));
+		unlink(path);
+	}
+	int tracksBefore = num_tracks;
+	int entries = albumNumEntries(album);
+	snprintf(path, sizeof(path), "%s/%s", ALBUMS_DIR, albumName(album));
+	setMtime(path, time(NULL) + 20);
+	CHECK(getEntryFromIndex(album, 0, name) == NULL);
+	CHECK_EQ(albumNumEntries(album), 0);
+	CHECK_EQ(num_tracks, tracksBefore - entries);
+	CHECK(getEntryFromIndex(album, 0, name) == NULL);
+	CHECK(getEntryFromIndex(album, 3, name) == NULL);
+}
+
+static void testNoLibrary() {
+	startLibraryScan();
+	waitForScan();
+	CHECK_EQ(libraryScanState, LIBRARY_NOT_FOUND);
+	CHECK_EQ(num_albums, 0);
+}
+
+int main() {
+	testDirEnter("library");
+	for(int i = 0; i < NUM_ALBUMS; i++) {
+		makeAlbum(i, ALBUM_TRACKS(i));
+	}
+	makeAlbums(0, 0, 24);
+	runIsolated(testScan);
+	runIsolated(testOnlyMusic);
+	runIsolated(testChangedAlbum);
+	runIsolated(testEmptiedAlbum);
+	testDirLeave();
+
+	testDirEnter("nolibrary");
+	rmdir(ALBUMS_DIR);
+	runIsolated(testNoLibrary);
+	testDirLeave();
+	return testsFinish("test_library");
+}
@@ -0,0 +1,427 @@
+// Gapless playback: LAME delay/padding trimming and the gap between tracks as it comes out
+// of the voice. The decoder here is a stand in that turns each frame into samples saying
+// which track they're from and which sample of it they are, libmad isn't needed.
+#define _GNU_SOURCE		// fopencookie
+#include <gccore.h>
+#include <unistd.h>
+#include <asndlib.h>
+#include "harness.h"
+#include "player.h"
+#include "decoder.h"
+
+#define FRAME_LEN 417					// MPEG-1 layer III, 128kbps at 44.1kHz
+#define FRAME_SAMPLES 1152
+#define ID3_SIZE 100
+
+// Frames carry their track, number, and the track's encoder delay and length. Samples in the
+// delay or padding come out as -track, the rest as track and the sample's number plus one.
+struct fake_state {
+	decoder_reader_t reader;
+	void *cbdata;
+	u8 buf[4096];
+	u32 len;
+	u32 bufPos;
+	int eof;
+};
+
+static int decodersOpened;
+
+static void* fakeOpen(decoder_reader_t reader, void *cbdata) {
+	struct fake_state *dec = calloc(1, sizeof(struct fake_state));
+	decodersOpened++;
+	dec->reader = reader;
+	dec->cbdata = cbdata;
+	return dec;
+}
+
+static void fakeClose(void *dec) {
+	free(dec);
+}
+
+static void fakeConsume(struct fake_state *dec, u32 n) {
+	memmove(dec->buf, dec->buf + n, dec->len - n);
+	dec->len -= n;
+	dec->bufPos += n;
+}
+
+static void fakeSeek(void *state, u32 streamPos) {
+	struct fake_state *dec = state;
+	dec->len = 0;
+	dec->bufPos = streamPos;
+	dec->eof = 0;
+}
+
+static volatile u32 framesDecoded;
+
+static int fakeDecode(void *state, struct decoder_pcm *pcm) {
+	struct fake_state *dec = state;
+	while(1) {
+		while(dec->len < FRAME_LEN && !dec->eof) {
+			s32 got = dec->reader(dec->cbdata, dec->buf + dec->len, sizeof(dec->buf) - dec->len);
+			if(got <= 0) {
+				dec->eof = 1;
+			}
+			else {
+				dec->len += got;
+			}
+		}
+		if(dec->len < FRAME_LEN) {
+			return 0;
+		}
+		const u8 *f = dec->buf;
+		if(f[0] != 0xFF || f[1] != 0xFB) {
+			fakeConsume(dec, 1);
+			continue;
+		}
+		if(!memcmp(f + 36, "Info", 4)) {
+			fakeConsume(dec, FRAME_LEN);
+			continue;
+		}
+		int track = f[4];
+		u32 frame = (f[5] << 8) | f[6];
+		u32 delay = (f[7] << 8) | f[8];
+		u32 length = (f[9] << 8) | f[10];
+		for(u32 j = 0; j < FRAME_SAMPLES; j++) {
+			s32 i = (s32)(frame * FRAME_SAMPLES + j) - (s32)delay;
+			int valid = i >= 0 && i < length;
+			pcm->samples[j*2] = valid ? track : -track;
+			pcm->samples[j*2 + 1] = valid ? i + 1 : -1;
+		}
+		pcm->count = FRAME_SAMPLES;
+		pcm->sampleRate = 44100;
+		pcm->streamPos = dec->bufPos;
+		fakeConsume(dec, FRAME_LEN);
+		framesDecoded++;
+		return 1;
+	}
+}
+
+static const struct decoder_backend fakeBackend = {
+	"fake", 0, fakeOpen, fakeDecode, fakeSeek, fakeClose
+};
+
+const struct decoder_backend* decoderGet(int which) {
+	return &fakeBackend;
+}
+
+struct fake_track {
+	int track;
+	u32 frames;
+	u32 delay;
+	u32 padding;
+	int lame;							// 0 for an Info frame without the LAME part
+	int id3;
+};
+
+static u32 trackLength(const struct fake_track *t) {
+	return t->frames * FRAME_SAMPLES - t->delay - t->padding;
+}
+
+static u32 frameOffset(const struct fake_track *t, u32 frame) {
+	return (t->id3 ? 10 + ID3_SIZE : 0) + (frame + 1) * FRAME_LEN;
+}
+
+static u8* makeTrack(const struct fake_track *t, u32 *size) {
+	u32 len = frameOffset(t, t->frames);
+	u8 *data = calloc(1, len);
+	u8 *p = data;
+	if(t->id3) {
+		memcpy(p, "ID3\3\0\0\0\0\0", 9);
+		p[9] = ID3_SIZE;
+		p += 10 + ID3_SIZE;
+	}
+	// Info frame: frames, bytes and TOC, then the LAME extension
+	static const u8 header[4] = {0xFF, 0xFB, 0x90, 0x00};
+	memcpy(p, header, 4);
+	u8 *x = p + 36;
+	memcpy(x, "Info", 4);
+	x[7] = 0x07;
+	x[8] = t->frames >> 24;
+	x[9] = t->frames >> 16;
+	x[10] = t->frames >> 8;
+	x[11] = t->frames;
+	x += 8 + 4 + 4 + 100;
+	if(t->lame) {
+		memcpy(x, "LAME3.100", 9);
+		x[21] = t->delay >> 4;
+		x[22] = ((t->delay & 0x0F) << 4) | (t->padding >> 8);
+		x[23] = t->padding;
+	}
+	p += FRAME_LEN;
+	u32 length = trackLength(t);
+	for(u32 n = 0; n < t->frames; n++, p += FRAME_LEN) {
+		memcpy(p, header, 4);
+		p[4] = t->track;
+		p[5] = n >> 8;
+		p[6] = n;
+		p[7] = t->delay >> 8;
+		p[8] = t->delay;
+		p[9] = length >> 8;
+		p[10] = length;
+	}
+	*size = len;
+	return data;
+}
+
+static FILE* openTrack(const struct fake_track *t) {
+	char path[64];
+	u32 size;
+	u8 *data = makeTrack(t, &size);
+	snprintf(path, sizeof(path), WAKEMII_DIR "/track%d.mp3", t->track);
+	writeFile(path, data, size);
+	free(data);
+	return fopen(path, "rb");
+}
+
+// A file that stalls for a while part way in, like a card that's gone to sleep
+struct slow_file {
+	u8 *data;
+	u32 size;
+	u32 pos;
+	int stalled;
+};
+
+static ssize_t slowRead(void *cookie, char *buf, size_t size) {
+	struct slow_file *sf = cookie;
+	// Unbuffered cookie files get read a byte at a time, so stall on getting to a frame in
+	if(sf->pos == 2 * FRAME_LEN && !sf->stalled) {
+		sf->stalled = 1;
+		usleep(300000);
+	}
+	size = MIN(size, sf->size - sf->pos);
+	memcpy(buf, sf->data + sf->pos, size);
+	sf->pos += size;
+	return size;
+}
+
+static int slowSeek(void *cookie, off64_t *offset, int whence) {
+	struct slow_file *sf = cookie;
+	if(whence == SEEK_SET) {
+		sf->pos = *offset;
+	}
+	else if(whence == SEEK_CUR) {
+		sf->pos += *offset;
+	}
+	else {
+		sf->pos = sf->size + *offset;
+	}
+	*offset = sf->pos;
+	return 0;
+}
+
+static int slowClose(void *cookie) {
+	struct slow_file *sf = cookie;
+	free(sf->data);
+	free(sf);
+	return 0;
+}
+
+static FILE* openSlowTrack(const struct fake_track *t) {
+	struct slow_file *sf = calloc(1, sizeof(struct slow_file));
+	sf->data = makeTrack(t, &sf->size);
+	cookie_io_functions_t io = {slowRead, NULL, slowSeek, slowClose};
+	return fopencookie(sf, "rb", io);
+}
+
+static void waitForEnd() {
+	for(int i = 0; i < 1000 && playerIsPlaying(); i++) {
+		usleep(10000);
+	}
+	CHECK(!playerIsPlaying());
+}
+
+// What the voice played: the tracks in order, each from sample first with nothing of its
+// delay or padding (junk, if it was untrimmed, is counted instead), and the silence between
+// the last two.
+struct heard {
+	u32 samples[4];
+	u32 first[4];
+	u32 junk[4];
+	u32 gap;
+	int inOrder;
+};
+
+static void listen(struct heard *h) {
+	memset(h, 0, sizeof(struct heard));
+	h->inOrder = 1;
+	int current = 0;
+	u32 expect = 0;
+	u32 zeros = 0;
+	for(u32 n = 0; n < asndHostOutputCount; n++) {
+		s16 track = asndHostOutput[n*2];
+		s16 sample = asndHostOutput[n*2 + 1];
+		if(!track && !sample) {
+			zeros++;
+			continue;
+		}
+		if(track < 0) {
+			h->junk[-track]++;
+			continue;
+		}
+		if(track != current) {
+			if(track < current || track > 3) {
+				h->inOrder = 0;
+				continue;
+			}
+			if(current) {
+				h->gap = zeros;
+			}
+			current = track;
+			h->first[track] = sample - 1;
+			expect = sample - 1;
+		}
+		if(sample - 1 != expect) {
+			h->inOrder = 0;
+		}
+		expect++;
+		h->samples[track]++;
+		zeros = 0;
+	}
+}
+
+static void testGapless() {
+	struct fake_track a = {1, 12, 576, 1300, 1, 1};
+	struct fake_track b = {2, 9, 576, 700, 1, 0};
+	struct heard h;
+	asndHostReset();
+	playerPrime(openTrack(&a));
+	playerQueueNext(openTrack(&b));
+	CHECK_EQ(playerStartPrimed(), 0);
+	waitForEnd();
+	CHECK(playerTrackChanged());
+	CHECK(!playerTrackChanged());
+	listen(&h);
+	CHECK(h.inOrder);
+	CHECK_EQ(h.samples[1], trackLength(&a));
+	CHECK_EQ(h.samples[2], trackLength(&b));
+	CHECK_EQ(h.first[1], 0);
+	CHECK_EQ(h.first[2], 0);
+	CHECK_EQ(h.junk[1] + h.junk[2], 0);
+	CHECK_EQ(h.gap, 0);
+	CHECK_EQ(playerLastGapSamples(), h.gap);
+}
+
+static void testUntrimmed() {
+	// No LAME tag on the first, so its delay and padding get played
+	struct fake_track a = {1, 10, 576, 1000, 0, 0};
+	struct fake_track b = {2, 6, 576, 900, 1, 1};
+	struct heard h;
+	asndHostReset();
+	playerPrime(openTrack(&a));
+	playerQueueNext(openTrack(&b));
+	playerStartPrimed();
+	waitForEnd();
+	CHECK(playerTrackChanged());
+	listen(&h);
+	CHECK(h.inOrder);
+	CHECK_EQ(h.samples[1], trackLength(&a));
+	CHECK_EQ(h.junk[1], a.delay + a.padding);
+	CHECK_EQ(h.samples[2], trackLength(&b));
+	CHECK_EQ(h.junk[2], 0);
+	CHECK_EQ(playerLastGapSamples(), 0);
+}
+
+static void testUnderrun() {
+	// The second track's data turns up late, so the voice runs dry between them
+	struct fake_track a = {1, 8, 576, 1100, 1, 0};
+	struct fake_track b = {2, 8, 576, 1100, 1, 0};
+	struct heard h;
+	asndHostReset();
+	playerPrime(openTrack(&a));
+	playerQueueNext(openSlowTrack(&b));
+	playerStartPrimed();
+	waitForEnd();
+	listen(&h);
+	CHECK(h.inOrder);
+	CHECK_EQ(h.samples[1], trackLength(&a));
+	CHECK_EQ(h.samples[2], trackLength(&b));
+	CHECK(h.gap > 0);
+	CHECK_EQ(playerLastGapSamples(), h.gap);
+}
+
+static void testPartWay() {
+	// Starting mid track there's no trimming, the padding at the end gets played
+	struct fake_track a = {1, 10, 576, 1000, 1, 1};
+	struct heard h;
+	asndHostReset();
+	playerPlayFrom(openTrack(&a), frameOffset(&a, 3));
+	waitForEnd();
+	listen(&h);
+	CHECK(h.inOrder);
+	CHECK_EQ(h.first[1], 3 * FRAME_SAMPLES - a.delay);
+	CHECK_EQ(h.samples[1], trackLength(&a) - h.first[1]);
+	CHECK_EQ(h.junk[1], a.padding);
+}
+
+static void testPrimed() {
+	// Priming decodes the first frames and holds them, nothing's heard until it's started
+	struct fake_track a = {1, 20, 576, 1000, 1, 1};
+	struct heard h;
+	asndHostReset();
+	framesDecoded = 0;
+	playerPrime(openTrack(&a));
+	for(int i = 0; i < 100 && framesDecoded < PLAYER_PRIME_FRAMES; i++) {
+		usleep(10000);
+	}
+	usleep(50000);
+	CHECK_EQ(framesDecoded, PLAYER_PRIME_FRAMES);
+	CHECK_EQ(asndHostOutputCount, 0);
+	CHECK(playerIsPrimed());
+	CHECK(!playerIsPlaying());
+	CHECK_EQ(playerStartPrimed(), 0);
+	CHECK(playerIsPlaying());
+	waitForEnd();
+	listen(&h);
+	CHECK(h.inOrder);
+	CHECK_EQ(h.first[1], 0);
+	CHECK_EQ(h.samples[1], trackLength(&a));
+	CHECK_EQ(h.junk[1], 0);
+
+	// Stopping while it's held lets it go without a sound
+	asndHostReset();
+	framesDecoded = 0;
+	playerPrime(openTrack(&a));
+	for(int i = 0; i < 100 && framesDecoded < PLAYER_PRIME_FRAMES; i++) {
+		usleep(10000);
+	}
+	playerStop();
+	CHECK(!playerIsPrimed());
+	CHECK_EQ(playerStartPrimed(), -1);
+	usleep(50000);
+	CHECK_EQ(asndHostOutputCount, 0);
+	CHECK_EQ(framesDecoded, PLAYER_PRIME_FRAMES);
+}
+
+static void testStop() {
+	struct fake_track a = {1, 200, 576, 1000, 1, 0};
+	asndHostReset();
+	playerPlay(openTrack(&a));
+	usleep(100000);
+	CHECK(playerIsPlaying());
+	u32 position = playerPosition();
+	CHECK(position > frameOffset(&a, 0) && position < frameOffset(&a, a.frames));
+	playerStop();
+	CHECK(!playerIsPlaying());
+	// Nothing more comes out, not even silence
+	u32 heard = asndHostOutputCount;
+	usleep(100000);
+	CHECK_EQ(asndHostOutputCount, heard);
+	CHECK(heard < trackLength(&a));
+}
+
+int main() {
+	testDirEnter("player");
+	asndHostSpeed = 4;
+	playerInit();
+	playerVolume(255);
+	testGapless();
+	testUntrimmed();
+	testUnderrun();
+	testPartWay();
+	testPrimed();
+	testStop();
+	// Every stream after the first seeked the same decoder back to the start
+	CHECK_EQ(decodersOpened, 1);
+	testDirLeave();
+	return testsFinish("test_player");
+}
@@ -0,0 +1,88 @@
+// Moving between tracks and albums, and numbering the whole library
+#include <gccore.h>
+#include "harness.h"
+#include "library.h"
+#include "playlist.h"
+
+// Album i has (i % 5) + 1 tracks
+#define NUM_ALBUMS 23
+#define ALBUM_TRACKS(i) ((i) % 5 + 1)
+
+static void testStepping() {
+	startLibraryScan();
+	waitForScan();
+	CHECK_EQ(num_albums, NUM_ALBUMS);
+	// Albums come in readdir order, the name says which one it is
+	for(int i = 0; i < num_albums; i++) {
+		CHECK_EQ(albumNumEntries(i), ALBUM_TRACKS(atoi(albumName(i) + 6)));
+	}
+
+	// Forwards through everything comes back round to the start, one track at a time
+	int album = 0, track = 0, steps = 0;
+	do {
+		stepEntry(1, &album, &track);
+		CHECK(track >= 0 && track < albumNumEntries(album));
+		steps++;
+	} while((album || track) && steps <= num_tracks);
+	CHECK_EQ(steps, num_tracks);
+
+	// Backwards off the start lands on the last track of the last album
+	album = 0;
+	track = 0;
+	stepEntry(-1, &album, &track);
+	CHECK_EQ(album, NUM_ALBUMS - 1);
+	CHECK_EQ(track, albumNumEntries(NUM_ALBUMS - 1) - 1);
+	stepEntry(1, &album, &track);
+	CHECK_EQ(album, 0);
+	CHECK_EQ(track, 0);
+
+	// Albums always start at their first track and wrap at both ends
+	album = 3;
+	track = 2;
+	stepAlbum(1, &album, &track);
+	CHECK_EQ(album, 4);
+	CHECK_EQ(track, 0);
+	stepAlbum(-5, &album, &track);
+	CHECK_EQ(album, NUM_ALBUMS - 1);
+	stepAlbum(1, &album, &track);
+	CHECK_EQ(album, 0);
+}
+
+static void testGlobalNumbering() {
+	startLibraryScan();
+	waitForScan();
+	int numAlbums;
+	u32 generation;
+	u32 total = playlistMapTracks(&numAlbums, &generation);
+	CHECK_EQ(total, num_tracks);
+	CHECK_EQ(numAlbums, NUM_ALBUMS);
+
+	// Global numbers run in album then track order with no gaps
+	u32 expected = 0;
+	for(int i = 0; i < NUM_ALBUMS; i++) {
+		for(int j = 0; j < albumNumEntries(i); j++) {
+			CHECK_EQ(playlistEntryToGlobal(i, j), expected);
+			int album, track;
+			playlistGlobalToEntry(expected, &album, &track);
+			CHECK_EQ(album, i);
+			CHECK_EQ(track, j);
+			expected++;
+		}
+	}
+
+	// Nothing changed, same numbering
+	u32 again;
+	playlistMapTracks(NULL, &again);
+	CHECK_EQ(again, generation);
+}
+
+int main() {
+	testDirEnter("playlist");
+	for(int i = 0; i < NUM_ALBUMS; i++) {
+		makeAlbum(i, ALBUM_TRACKS(i));
+	}
+	runIsolated(testStepping);
+	runIsolated(testGlobalNumbering);
+	testDirLeave();
+	return testsFinish("test_playlist");
+}
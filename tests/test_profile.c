@@ -0,0 +1,107 @@
+// Profiler percentiles over the sample ring, and its Gecko records picked back out of the
+// log they're mixed in with by tool_profile's parser.
+#include <unistd.h>
+#define main profileToolMain
+#include "tool_profile.c"
+#undef main
+#include "harness.h"
+
+static void setSamples(enum profile_section section, u32 count) {
+	// Shuffled, so the sort is what puts them in order
+	numSamples[section] = 0;
+	for(u32 i = 0; i < count; i++) {
+		samples[section][numSamples[section]++ & (PROFILE_HISTORY-1)] = ((i * 37) % count) + 1;
+	}
+}
+
+static void testPercentiles() {
+	u32 p50, p99, max;
+	percentiles(PROF_RENDER, &p50, &p99, &max);
+	CHECK_EQ(p50 + p99 + max, 0);
+
+	setSamples(PROF_ENTRY_OPEN, 100);
+	percentiles(PROF_ENTRY_OPEN, &p50, &p99, &max);
+	CHECK_EQ(p50, 50);
+	CHECK_EQ(p99, 99);
+	CHECK_EQ(max, 100);
+
+	// Only the last PROFILE_HISTORY count, 1 to 256 are gone
+	numSamples[PROF_COVER_LOAD] = 0;
+	for(u32 i = 1; i <= PROFILE_HISTORY + 256; i++) {
+		samples[PROF_COVER_LOAD][numSamples[PROF_COVER_LOAD]++ & (PROFILE_HISTORY-1)] = i;
+	}
+	percentiles(PROF_COVER_LOAD, &p50, &p99, &max);
+	CHECK_EQ(p50, 256 + 128);
+	CHECK_EQ(p99, 256 + 253);
+	CHECK_EQ(max, 512);
+
+	setSamples(PROF_DRAW, 1);
+	percentiles(PROF_DRAW, &p50, &p99, &max);
+	CHECK(p50 == 1 && p99 == 1 && max == 1);
+
+	// A real timing lands where it should
+	numSamples[PROF_PLAYER_START] = 0;
+	u64 start = profileBegin();
+	usleep(20000);
+	profileEnd(PROF_PLAYER_START, start);
+	percentiles(PROF_PLAYER_START, &p50, &p99, &max);
+	CHECK(max >= 20000 && max < 200000);
+	CHECK_EQ(frameTotals[PROF_PLAYER_START], max);
+}
+
+static void testRecords() {
+	geckoHostCapture = 1;
+	geckoHostReset();
+	memset(frameTotals, 0, sizeof(frameTotals));
+	frameCount = 0;
+
+	// Nothing's sent while the overlay's down
+	profileFrameEnd();
+	CHECK_EQ(geckoHostOutputLen, 0);
+
+	profileToggle();
+	CHECK(profileShown());
+	u32 first = frameCount;
+	for(u32 i = 0; i < 10; i++) {
+		print_gecko("Frame %u\r\n", i);
+		frameTotals[PROF_DRAW] = 1000 + i;
+		// Bytes that look like the start of a record inside one
+		frameTotals[PROF_RENDER] = 0xFF500106;
+		frameTotals[PROF_ENTRY_OPEN] = i & 1 ? 0x12345678 : 0;
+		profileFrameEnd();
+	}
+	profileToggle();
+	profileFrameEnd();
+	CHECK_EQ(geckoHostOutputLen, 10 * PROFILE_RECORD_SIZE + 10 * strlen("Frame 0\r\n"));
+
+	struct frame_record rec;
+	u32 pos = 0, n = 0;
+	int ok = 1;
+	while(nextRecord(geckoHostOutput, geckoHostOutputLen, &pos, &rec)) {
+		ok &= rec.frame == first + n;
+		ok &= rec.us[PROF_DRAW] == 1000 + n;
+		ok &= rec.us[PROF_RENDER] == 0xFF500106;
+		ok &= rec.us[PROF_ENTRY_OPEN] == (n & 1 ? 0x12345678 : 0);
+		n++;
+	}
+	CHECK_EQ(n, 10);
+	CHECK(ok);
+	// Big endian whatever the host is
+	CHECK_EQ(geckoHostOutput[strlen("Frame 0\r\n") + 8 + PROF_DRAW * 4 + 2], 1000 >> 8);
+
+	// A record cut off at the end of the capture isn't read
+	pos = 0;
+	n = 0;
+	while(nextRecord(geckoHostOutput, geckoHostOutputLen - 1, &pos, &rec)) {
+		n++;
+	}
+	CHECK_EQ(n, 9);
+	geckoHostCapture = 0;
+}
+
+int main() {
+	profileInit();
+	testPercentiles();
+	testRecords();
+	return testsFinish("test_profile");
+}
@@ -0,0 +1,124 @@
+// resume.dat: what gets saved straight away, the journal written round in place by the
+// worker, and carrying on from it after a reboot (a fresh process)
+#include "resume.c"
+#include <sys/stat.h>
+#include <unistd.h>
+#include "harness.h"
+
+static void scan() {
+	startLibraryScan();
+	waitForScan();
+	resumeInit();
+}
+
+// Until the worker's written and synced everything it's been given
+static void waitSaved() {
+	LWP_MutexLock(resumeMutex);
+	while(doneSeq != current.seq) {
+		LWP_CondWait(resumeCond, resumeMutex);
+	}
+	LWP_MutexUnlock(resumeMutex);
+}
+
+static void playThenStop() {
+	scan();
+	resumeUpdate(1, 2, 1000, 200, 1);
+	CHECK_EQ(changed, 0);
+	// A start's synced without being asked
+	waitSaved();
+	struct stat before, after;
+	CHECK(!stat(RESUME_FILE, &before));
+	CHECK_EQ(before.st_size, RESUME_SLOTS * RESUME_SLOT_SIZE);
+
+	// Just the position moving on waits for RESUME_SAVE_SECS
+	resumeUpdate(1, 2, 5000, 200, 1);
+	CHECK_EQ(changed, 1);
+	// Stopping doesn't
+	resumeUpdate(1, 2, 5000, 200, 0);
+	CHECK_EQ(changed, 0);
+	waitSaved();
+	CHECK_EQ(nextSlot, 2);
+	CHECK(resumeFile != NULL);
+
+	// Round the journal a couple of times, always the same file. Track changes are
+	// handed over as they come, the worker may only get to the newest of them.
+	for(int i = 0; i < 2 * RESUME_SLOTS + 3; i++) {
+		resumeUpdate(2, i % 5, 0, 150, 1);
+		if(i % 3 == 0) {
+			usleep(2000);
+		}
+	}
+	resumeUpdate(3, 1, 4321, 180, 1);
+	CHECK_EQ(changed, 0);
+	// Written but left for RESUME_SYNC_SECS, a flush doesn't wait that long
+	usleep(100000);
+	CHECK(!pendingValid);
+	CHECK(doneSeq != current.seq);
+	resumeFlush();
+	CHECK_EQ(doneSeq, current.seq);
+	CHECK(!stat(RESUME_FILE, &after));
+	CHECK_EQ(after.st_size, RESUME_SLOTS * RESUME_SLOT_SIZE);
+	CHECK_EQ(after.st_ino, before.st_ino);
+}
+
+static void carryOn() {
+	scan();
+	int volume = 0;
+	CHECK(resumeVolume(&volume));
+	CHECK_EQ(volume, 180);
+	int album, track;
+	u32 offset;
+	CHECK_EQ(resumeFind(&album, &track, &offset), RESUME_FOUND);
+	CHECK_EQ(album, 3);
+	CHECK_EQ(track, 1);
+	CHECK_EQ(offset, 4321);
+	CHECK_EQ(resumeFind(&album, &track, &offset), RESUME_NONE);
+
+	// Stopped with no resumeFlush(), like the power going right after
+	resumeUpdate(0, 4, 777, 90, 1);
+	waitSaved();
+	resumeUpdate(0, 4, 800, 90, 0);
+	waitSaved();
+}
+
+static void stayStopped() {
+	scan();
+	int volume = 0;
+	CHECK(resumeVolume(&volume));
+	CHECK_EQ(volume, 90);
+	int album, track;
+	u32 offset;
+	CHECK_EQ(resumeFind(&album, &track, &offset), RESUME_NONE);
+	CHECK_EQ(saved.album_num, 0);
+	CHECK_EQ(saved.track_num, 4);
+	CHECK_EQ(saved.offset, 800);
+}
+
+static void tornSave() {
+	// The newest slot cut short falls back to the one before
+	scan();
+	int last = (nextSlot + RESUME_SLOTS - 1) % RESUME_SLOTS;
+	FILE *fp = fopen(RESUME_FILE, "r+b");
+	fseek(fp, last * RESUME_SLOT_SIZE + offsetof(struct resume_record, offset), SEEK_SET);
+	fputc(0x55, fp);
+	fclose(fp);
+	savedValid = 0;
+	resumeInit();
+	int album, track;
+	u32 offset;
+	CHECK_EQ(resumeFind(&album, &track, &offset), RESUME_FOUND);
+	CHECK_EQ(album, 0);
+	CHECK_EQ(track, 4);
+	CHECK_EQ(offset, 777);
+}
+
+int main() {
+	testDirEnter("resume");
+	makeAlbums(4, 5, 0);
+	runIsolated(playThenStop);
+	runIsolated(carryOn);
+	runIsolated(stayStopped);
+	runIsolated(tornSave);
+	testDirLeave();
+	return testsFinish("test_resume");
+}
@@ -0,0 +1,238 @@
+// Seeking on synthetic tracks whose every frame offset is known: CBR and VBR through a
+// built index (and again from its cache), and VBR through a Xing TOC and a VBRI table.
+// Frames are only headers and noise, nothing is decoded.
+#include "seek.c"
+#include <math.h>
+#include <unistd.h>
+#include "harness.h"
+
+#define MAX_FRAMES 8000
+#define FRAME_MS (1152 * 1000.0 / 44100)
+#define TAG_FRAME_LEN 417				// 128kbps, where the Xing or VBRI header goes
+#define VBRI_FRAMES_PER_ENTRY 100
+
+enum track_kind {
+	TRACK_CBR,
+	TRACK_VBR,
+	TRACK_XING,
+	TRACK_VBRI
+};
+
+static const char *trackFiles[] = {"01 cbr.mp3", "02 vbr.mp3", "03 xing.mp3", "04 vbri.mp3"};
+
+// What the scan numbered each kind of track as
+static int tracks[4];
+
+// Where each frame of the track last made starts
+static u32 frameOffsets[MAX_FRAMES];
+static u32 numFrames;
+
+static void putBE32(u8 *p, u32 v) {
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static void putFrameHeader(u8 *p, int bitrate, int padding) {
+	p[0] = 0xFF;
+	p[1] = 0xFB;					// MPEG1 layer III
+	p[2] = (bitrate << 4) | (padding << 1);	// 44.1kHz
+	p[3] = 0;
+}
+
+static void makeTrack(const char *path, enum track_kind kind, u32 seed) {
+	u8 *data = malloc(MAX_FRAMES * SEEK_MAX_FRAME + 4096);
+	u32 len = 0;
+	srand(seed);
+	// ID3v2 to skip at the start
+	memcpy(data, "ID3\3\0\0\0\0\x07\x68", 10);
+	len = 10 + 1000;
+	for(u32 i = 10; i < len; i++) {
+		data[i] = rand();
+	}
+	u32 tagFrame = len;
+	if(kind >= TRACK_XING) {
+		memset(data + len, 0, TAG_FRAME_LEN);
+		putFrameHeader(data + len, 9, 0);
+		len += TAG_FRAME_LEN;
+	}
+	numFrames = 5000 + rand() % 3000;
+	for(u32 i = 0; i < numFrames; i++) {
+		int bitrate = kind == TRACK_CBR ? 9 : 1 + rand() % 14;
+		int padding = kind == TRACK_CBR ? i % 3 != 0 : rand() & 1;
+		u32 frameLen = 144000 * bitratesMpeg1[bitrate] / 44100 + padding;
+		frameOffsets[i] = len;
+		putFrameHeader(data + len, bitrate, padding);
+		for(u32 j = 4; j < frameLen; j++) {
+			data[len + j] = rand();
+		}
+		len += frameLen;
+	}
+	u32 end = len;
+	u8 *x = data + tagFrame + 4 + 32;
+	if(kind == TRACK_XING) {
+		// Frames, bytes and the TOC, each entry the 256ths through the bytes a percent in
+		u32 bytes = end - tagFrame;
+		memcpy(x, "Xing\0\0\0\x07", 8);
+		putBE32(x + 8, numFrames);
+		putBE32(x + 12, bytes);
+		for(int i = 0; i < 100; i++) {
+			x[16 + i] = (u64)(frameOffsets[i * numFrames / 100] - tagFrame) * 256 / bytes;
+		}
+	}
+	else if(kind == TRACK_VBRI) {
+		// Two byte entries at scale 1, each the bytes in its VBRI_FRAMES_PER_ENTRY frames
+		u32 entries = (numFrames + VBRI_FRAMES_PER_ENTRY - 1) / VBRI_FRAMES_PER_ENTRY;
+		memcpy(x, "VBRI", 4);
+		putBE32(x + 14, numFrames);
+		x[18] = entries >> 8;
+		x[19] = entries;
+		x[21] = 1;
+		x[23] = 2;
+		x[25] = VBRI_FRAMES_PER_ENTRY;
+		for(u32 e = 0; e < entries; e++) {
+			u32 next = (e + 1) * VBRI_FRAMES_PER_ENTRY;
+			u32 size = (next < numFrames ? frameOffsets[next] : end) - frameOffsets[e * VBRI_FRAMES_PER_ENTRY];
+			x[26 + e * 2] = size >> 8;
+			x[27 + e * 2] = size;
+		}
+	}
+	// And an ID3v1 tag at the end
+	memcpy(data + len, "TAG", 3);
+	memset(data + len + 3, 'x', 125);
+	len += 128;
+	writeFile(path, data, len);
+	free(data);
+}
+
+static int findFrameAt(u32 offset) {
+	u32 lo = 0;
+	u32 hi = numFrames;
+	while(lo < hi) {
+		u32 mid = (lo + hi) / 2;
+		if(frameOffsets[mid] < offset) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+	return lo < numFrames && frameOffsets[lo] == offset ? lo : -1;
+}
+
+static void waitForSeek(int albumNum, int trackNum) {
+	seekPrepare(albumNum, trackNum);
+	for(int i = 0; i < 500 && !seekReady(albumNum, trackNum); i++) {
+		usleep(10000);
+	}
+}
+
+// Every ms through the track lands on a real frame. The target is within a frame of where
+// that frame starts for an index, within a TOC step for Xing. frameMs and seekTimeAt()
+// say when the frame starts, near enough for the display.
+static void checkSeeks(enum track_kind kind, double targetErr, double timeErr) {
+	waitForSeek(0, tracks[kind]);
+	CHECK(seekReady(0, tracks[kind]));
+	CHECK(abs((int)seekDuration() - (int)(numFrames * FRAME_MS)) <= 1);
+	u32 offFrame = 0;
+	double worstTarget = 0;
+	double worstTime = 0;
+	for(u32 ms = 0; ms < seekDuration(); ms += 997) {
+		u32 frameMs;
+		u32 offset = seekOffsetAt(ms, &frameMs);
+		int frame = findFrameAt(offset);
+		if(frame < 0) {
+			offFrame++;
+			continue;
+		}
+		worstTarget = MAX(worstTarget, fabs(frame * FRAME_MS - ms));
+		worstTime = MAX(worstTime, fabs(frame * FRAME_MS - frameMs));
+		worstTime = MAX(worstTime, fabs(frame * FRAME_MS - seekTimeAt(offset)));
+	}
+	printf("%s: %u frames, worst target %.1f ms, worst time %.1f ms\n", trackFiles[kind], numFrames, worstTarget, worstTime);
+	CHECK_EQ(offFrame, 0);
+	CHECK(worstTarget <= targetErr);
+	CHECK(worstTime <= timeErr);
+}
+
+static int trackNumOf(int albumNum, const char *file) {
+	for(int i = 0; i < albumNumEntries(albumNum); i++) {
+		if(!strcmp(albumTrackName(albumNum, i), file)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static void testSeeks() {
+	startLibraryScan();
+	waitForScan();
+	seekInit();
+	CHECK_EQ(num_albums, 1);
+	CHECK(!seekReady(0, 0));
+	for(int i = 0; i < 4; i++) {
+		tracks[i] = trackNumOf(0, trackFiles[i]);
+		CHECK(tracks[i] >= 0);
+	}
+
+	// Built, a frame apart at worst and SEEK_INDEX_FRAMES frames between entries
+	struct stat st;
+	char cachePath[256];
+	makeTrack(ALBUMS_DIR "/Seek/01 cbr.mp3", TRACK_CBR, 1);
+	checkSeeks(TRACK_CBR, FRAME_MS + 0.5, FRAME_MS + 1);
+	getCachePath(cachePath, 0, tracks[TRACK_CBR]);
+	CHECK(!stat(cachePath, &st));
+	makeTrack(ALBUMS_DIR "/Seek/02 vbr.mp3", TRACK_VBR, 2);
+	checkSeeks(TRACK_VBR, FRAME_MS + 0.5, SEEK_INDEX_FRAMES * FRAME_MS);
+
+	// Going back to it comes from the cache, without the frames being read again
+	u32 vbrFrames = numFrames;
+	CHECK(!stat(ALBUMS_DIR "/Seek/02 vbr.mp3", &st));
+	u8 *zeros = calloc(1, st.st_size);
+	writeFile(ALBUMS_DIR "/Seek/02 vbr.mp3", zeros, st.st_size);
+	free(zeros);
+	setMtime(ALBUMS_DIR "/Seek/02 vbr.mp3", st.st_mtime);
+	seekPrepare(0, tracks[TRACK_CBR]);
+	waitForSeek(0, tracks[TRACK_VBR]);
+	CHECK(seekReady(0, tracks[TRACK_VBR]));
+	CHECK_EQ(info.num_frames, vbrFrames);
+	CHECK(abs((int)seekDuration() - (int)(vbrFrames * FRAME_MS)) <= 1);
+	// Unless the file's changed since
+	setMtime(ALBUMS_DIR "/Seek/02 vbr.mp3", st.st_mtime + 10);
+	seekPrepare(0, tracks[TRACK_CBR]);
+	waitForSeek(0, tracks[TRACK_VBR]);
+	CHECK(!seekReady(0, tracks[TRACK_VBR]));
+
+	// Xing only knows where each percent starts
+	makeTrack(ALBUMS_DIR "/Seek/03 xing.mp3", TRACK_XING, 3);
+	checkSeeks(TRACK_XING, numFrames * FRAME_MS / 100, numFrames * FRAME_MS / 100);
+	CHECK_EQ(mode, SEEK_TOC);
+	makeTrack(ALBUMS_DIR "/Seek/04 vbri.mp3", TRACK_VBRI, 4);
+	checkSeeks(TRACK_VBRI, FRAME_MS + 0.5, VBRI_FRAMES_PER_ENTRY * FRAME_MS);
+	CHECK_EQ(info.frames_per_entry, VBRI_FRAMES_PER_ENTRY);
+
+	// Asking for another track while one's being built only ever ends up with the last
+	seekPrepare(0, tracks[TRACK_CBR]);
+	seekPrepare(0, tracks[TRACK_XING]);
+	CHECK(!seekReady(0, tracks[TRACK_CBR]));
+	waitForSeek(0, tracks[TRACK_XING]);
+	CHECK(seekReady(0, tracks[TRACK_XING]));
+	CHECK(!seekReady(0, tracks[TRACK_CBR]));
+	CHECK_EQ(mode, SEEK_TOC);
+}
+
+int main() {
+	testDirEnter("seek");
+	mkdir(ALBUMS_DIR "/Seek", 0755);
+	mkdir(COVER_CACHE_DIR, 0755);		// coverLoadInit() makes it at boot
+	// Only the names are needed for the scan, the tracks are made as they're tested
+	for(int i = 0; i < 4; i++) {
+		char path[256];
+		snprintf(path, sizeof(path), "%s/Seek/%s", ALBUMS_DIR, trackFiles[i]);
+		writeFile(path, "", 0);
+	}
+	runIsolated(testSeeks);
+	testDirLeave();
+	return testsFinish("test_seek");
+}
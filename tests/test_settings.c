@@ -0,0 +1,177 @@
+// settings.cfg saving, loading and recovering from interrupted saves
+#include <gccore.h>
+#include <unistd.h>
+#include "harness.h"
+#include "settings.h"
+
+static void setAll(int base) {
+	continuousPlayOn = base & 1;
+	continuousPlayType = base & 1 ? CONT_PLAY_TYPE_SHUFFLE : CONT_PLAY_TYPE_SEQUENTIAL;
+	for(int i = 0; i < MAX_ALARMS; i++) {
+		alarms[i].on = (base + i) & 1;
+		alarms[i].hrs = (base + i) % 24;
+		alarms[i].mins = (base * 7 + i) % 60;
+		alarms[i].days = (base + i * 13) & ALARM_EVERY_DAY;
+	}
+	snoozeMins = 1 + base % 60;
+	standbyMode = base % 3;
+	hourlyAlarmOn = base & 1;
+	shutdownAfterAlarm = (base >> 1) & 1;
+	alarmPickMode = base % 3;
+	alarmSkipLast = base;
+	debugLogOn = (base >> 2) & 1;
+	decoderBackend = base % 2;
+}
+
+static void checkAll(int base) {
+	CHECK_EQ(continuousPlayOn, base & 1);
+	CHECK_EQ(continuousPlayType, base & 1 ? CONT_PLAY_TYPE_SHUFFLE : CONT_PLAY_TYPE_SEQUENTIAL);
+	for(int i = 0; i < MAX_ALARMS; i++) {
+		CHECK_EQ(alarms[i].on, (base + i) & 1);
+		CHECK_EQ(alarms[i].hrs, (base + i) % 24);
+		CHECK_EQ(alarms[i].mins, (base * 7 + i) % 60);
+		CHECK_EQ(alarms[i].days, (base + i * 13) & ALARM_EVERY_DAY);
+	}
+	CHECK_EQ(snoozeMins, 1 + base % 60);
+	CHECK_EQ(standbyMode, base % 3);
+	CHECK_EQ(hourlyAlarmOn, base & 1);
+	CHECK_EQ(shutdownAfterAlarm, (base >> 1) & 1);
+	CHECK_EQ(alarmPickMode, base % 3);
+	CHECK_EQ(alarmSkipLast, base);
+	CHECK_EQ(debugLogOn, (base >> 2) & 1);
+	CHECK_EQ(decoderBackend, base % 2);
+}
+
+static void testRoundTrip() {
+	for(int base = 0; base < 8; base++) {
+		setAll(base * 5 + 3);
+		CHECK(saveSettings());
+		CHECK(access(SETTINGS_TMP_FILE, F_OK) != 0);
+		setAll(0);
+		loadSettings();
+		checkAll(base * 5 + 3);
+	}
+}
+
+static void testHandEdited() {
+	static const char cfg[] =
+		"# edited by hand, no checksum\r\n"
+		"Snooze Minutes=99999\r\n"
+		"Alarm Hour=6\r\n"
+		"Alarm Minute=-5\r\n"
+		"Alarm Days=mon,fri\r\n"
+		"Alarm Pick=favourites\r\n"
+		"Standby Screen=sideways\r\n"
+		"Something Else=yes\r\n"
+		"No equals sign here\n"
+		"Decoder=lite\r\n"
+		"Debug Log=yes";
+	setAll(0);
+	writeFile(SETTINGS_FILE, cfg, sizeof(cfg) - 1);
+	loadSettings();
+	CHECK_EQ(snoozeMins, 24*60);
+	CHECK_EQ(alarms[0].hrs, 6);
+	CHECK_EQ(alarms[0].mins, 0);
+	CHECK_EQ(alarms[0].days, (1 << 1) | (1 << 5));
+	CHECK_EQ(alarmPickMode, ALARM_PICK_FAVOURITES);
+	CHECK_EQ(standbyMode, 0);			// unknown choices leave it alone
+	CHECK_EQ(debugLogOn, 1);
+	CHECK_EQ(decoderBackend, DECODER_LITE);
+}
+
+static void testAfterChecksum() {
+	// Keys added to the end of a saved settings.cfg by hand still count
+	setAll(6);
+	CHECK(saveSettings());
+	FILE *fp = fopen(SETTINGS_FILE, "ab");
+	fputs("Snooze Minutes=42\r\nAlarm 2 Hour=13\r\n", fp);
+	fclose(fp);
+	setAll(0);
+	loadSettings();
+	CHECK_EQ(snoozeMins, 42);
+	CHECK_EQ(alarms[1].hrs, 13);
+	CHECK_EQ(alarms[0].hrs, 6 % 24);
+	CHECK_EQ(alarmSkipLast, 6);
+
+	// But a settings.tmp with more after its checksum isn't a finished save
+	char buf[4096];
+	setAll(7);
+	CHECK(saveSettings());
+	size_t len = readFile(SETTINGS_FILE, buf, sizeof(buf));
+	setAll(3);
+	CHECK(saveSettings());
+	len += sprintf(buf + len, "Snooze Minutes=5\r\n");
+	writeFile(SETTINGS_TMP_FILE, buf, len);
+	setAll(0);
+	loadSettings();
+	checkAll(3);
+	CHECK(access(SETTINGS_TMP_FILE, F_OK) != 0);
+}
+
+static void testLongLines() {
+	char cfg[2048];
+	int len = sprintf(cfg, "# ");
+	memset(cfg + len, 'x', 1000);
+	len += 1000;
+	len += sprintf(cfg + len, "\r\nSnooze Minutes=17\r\n");
+	setAll(0);
+	writeFile(SETTINGS_FILE, cfg, len);
+	loadSettings();
+	CHECK_EQ(snoozeMins, 17);
+}
+
+static void testInterruptedSave() {
+	// A finished settings.tmp beats settings.cfg
+	setAll(11);
+	CHECK(saveSettings());
+	CHECK(rename(SETTINGS_FILE, WAKEMII_DIR "/newer.cfg") == 0);
+	setAll(4);
+	CHECK(saveSettings());
+	CHECK(rename(WAKEMII_DIR "/newer.cfg", SETTINGS_TMP_FILE) == 0);
+	setAll(0);
+	loadSettings();
+	checkAll(11);
+	CHECK(access(SETTINGS_TMP_FILE, F_OK) != 0);
+
+	// One cut off before its checksum is thrown away
+	char buf[4096];
+	setAll(21);
+	CHECK(saveSettings());
+	size_t len = readFile(SETTINGS_FILE, buf, sizeof(buf));
+	CHECK(len > 20);
+	setAll(11);
+	CHECK(saveSettings());
+	writeFile(SETTINGS_TMP_FILE, buf, len / 2);
+	setAll(0);
+	loadSettings();
+	checkAll(11);
+	CHECK(access(SETTINGS_TMP_FILE, F_OK) != 0);
+
+	// And so is one whose checksum doesn't match
+	char *last = strstr(buf, "Snooze Minutes=");
+	CHECK(last != NULL);
+	last[15] = last[15] == '9' ? '8' : '9';
+	writeFile(SETTINGS_TMP_FILE, buf, len);
+	setAll(0);
+	loadSettings();
+	checkAll(11);
+}
+
+static void testMissing() {
+	remove(SETTINGS_FILE);
+	setAll(9);
+	loadSettings();
+	checkAll(9);
+}
+
+int main() {
+	testDirEnter("settings");
+	testRoundTrip();
+	testHandEdited();
+	testAfterChecksum();
+	testLongLines();
+	testInterruptedSave();
+	testMissing();
+	testDirLeave();
+	return testsFinish("test_settings");
+}
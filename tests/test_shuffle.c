@@ -0,0 +1,248 @@
+// The shuffle order: every track once per round whatever size its album, the
+// same order back and forth and after a reboot, and rngBounded() unbiased
+#include "shuffle.c"
+#include <math.h>
+#include <sys/stat.h>
+#include "harness.h"
+
+// Lots of single track albums next to big ones, the old album-then-track pick favoured the singles
+#define NUM_ALBUMS 12
+#define ALBUM_TRACKS(i) ((i) % 3 ? 1 : 20)
+#define DRAWS 1000000
+#define SEQ_FILE WAKEMII_DIR "/seq.bin"
+
+// Chi-squared critical values at p = 0.001
+#define CHI2_2 13.82
+#define CHI2_6 22.46
+
+static double chiSquared(const u32 *counts, int buckets, const double *expected) {
+	double chi2 = 0;
+	for(int i = 0; i < buckets; i++) {
+		double d = counts[i] - expected[i];
+		chi2 += d * d / expected[i];
+	}
+	return chi2;
+}
+
+// Critical value for more degrees of freedom than there's a table entry for (Wilson-Hilferty)
+static double chiCritical(int dof) {
+	double z = 3.09;	// p = 0.001
+	double a = 2.0 / (9 * dof);
+	double c = 1 - a + z * sqrt(a);
+	return dof * c * c * c;
+}
+
+static void makeLibrary() {
+	for(int i = 0; i < NUM_ALBUMS; i++) {
+		makeAlbum(i, ALBUM_TRACKS(i));
+	}
+}
+
+static void testRngBounded() {
+	struct rng_state a, b;
+	rngSeed(&a, 1234);
+	rngSeed(&b, 1234);
+	int same = 1;
+	for(int i = 0; i < 1000; i++) {
+		same &= rngNext(&a) == rngNext(&b);
+	}
+	CHECK(same);
+
+	// A small range
+	u32 counts[7] = {0};
+	double expected[7];
+	u32 outOfRange = 0;
+	for(int i = 0; i < DRAWS; i++) {
+		u32 v = rngBounded(&a, 7);
+		outOfRange += v >= 7;
+		counts[v % 7]++;
+	}
+	CHECK_EQ(outOfRange, 0);
+	for(int i = 0; i < 7; i++) {
+		expected[i] = DRAWS / 7.0;
+	}
+	double chi2 = chiSquared(counts, 7, expected);
+	printf("rngBounded(7): chi2 %.2f\n", chi2);
+	CHECK(chi2 < CHI2_6);
+
+	// A range where a plain modulo would land in the bottom third twice as often
+	u32 range = 3u << 30;
+	u32 thirds[3] = {0}, modThirds[3] = {0};
+	for(int i = 0; i < DRAWS; i++) {
+		thirds[rngBounded(&a, range) >> 30]++;
+		modThirds[(rngNext(&a) % range) >> 30]++;
+	}
+	double third[3] = {DRAWS / 3.0, DRAWS / 3.0, DRAWS / 3.0};
+	chi2 = chiSquared(thirds, 3, third);
+	printf("rngBounded(3<<30): chi2 %.2f, plain modulo %.2f\n", chi2, chiSquared(modThirds, 3, third));
+	CHECK(chi2 < CHI2_2);
+	CHECK(chiSquared(modThirds, 3, third) > CHI2_2);
+
+	CHECK_EQ(rngBounded(&a, 1), 0);
+}
+
+static u32 globalOf(int album, int track) {
+	return playlistEntryToGlobal(album, track);
+}
+
+static void testRound() {
+	makeLibrary();
+	startLibraryScan();
+	waitForScan();
+	shuffleInit();
+	int album, track;
+	CHECK(!shufflePrev(&album, &track));
+	u32 *seq = malloc(num_tracks * sizeof(u32));
+	u8 *seen = calloc(num_tracks, 1);
+	int repeats = 0;
+	for(int i = 0; i < num_tracks; i++) {
+		int peekAlbum, peekTrack;
+		CHECK(shufflePeek(&peekAlbum, &peekTrack));
+		CHECK(shuffleNext(&album, &track));
+		CHECK(peekAlbum == album && peekTrack == track);
+		seq[i] = globalOf(album, track);
+		repeats += seen[seq[i]]++;
+	}
+	// A whole round is every track once
+	CHECK_EQ(repeats, 0);
+
+	// Back through it in reverse, to the first and no further
+	int backOk = 1;
+	for(int i = num_tracks - 2; i >= 0; i--) {
+		backOk &= shufflePrev(&album, &track) && globalOf(album, track) == seq[i];
+	}
+	CHECK(backOk);
+	CHECK(!shufflePrev(&album, &track));
+	// And forward again the same way
+	int forwardOk = 1;
+	for(int i = 1; i < num_tracks; i++) {
+		forwardOk &= shuffleNext(&album, &track) && globalOf(album, track) == seq[i];
+	}
+	CHECK(forwardOk);
+
+	// The next round is a different order
+	int differs = 0;
+	for(int i = 0; i < num_tracks; i++) {
+		shuffleNext(&album, &track);
+		differs |= globalOf(album, track) != seq[i];
+	}
+	CHECK(differs);
+	free(seq);
+	free(seen);
+}
+
+static void testFirstPicks() {
+	// Over a million rounds every track comes first equally often, singles included
+	makeLibrary();
+	startLibraryScan();
+	waitForScan();
+	shuffleInit();
+	int album, track;
+	CHECK(shufflePeek(&album, &track));
+	u32 *counts = calloc(num_tracks, sizeof(u32));
+	double *expected = malloc(num_tracks * sizeof(double));
+	for(u32 i = 0; i < DRAWS; i++) {
+		startRound(i * 0x9E3779B9, 0);
+		drawNext();
+		counts[order[0]]++;
+	}
+	u32 singles = 0;
+	for(int i = 0; i < num_tracks; i++) {
+		expected[i] = (double)DRAWS / num_tracks;
+		playlistGlobalToEntry(i, &album, &track);
+		if(albumNumEntries(album) == 1) {
+			singles += counts[i];
+		}
+	}
+	double chi2 = chiSquared(counts, num_tracks, expected);
+	printf("shuffle first picks over %d tracks: chi2 %.2f, critical %.2f\n", num_tracks, chi2, chiCritical(num_tracks - 1));
+	CHECK(chi2 < chiCritical(num_tracks - 1));
+	// Picking an album then a track would give the singles two thirds of the picks
+	int numSingles = NUM_ALBUMS - (NUM_ALBUMS + 2) / 3;
+	CHECK(fabs(singles / (double)DRAWS - numSingles / (double)num_tracks) < 0.005);
+	free(counts);
+	free(expected);
+}
+
+// Plays 40 tracks, goes back 15 and "reboots"
+static void playThenReboot() {
+	startLibraryScan();
+	waitForScan();
+	shuffleInit();
+	int album, track;
+	u32 seq[40];
+	struct stat before, after;
+	for(int i = 0; i < 40; i++) {
+		CHECK(shuffleNext(&album, &track));
+		seq[i] = globalOf(album, track);
+		if(i == 0) {
+			shuffleFlush(1);
+			CHECK(!stat(SHUFFLE_STATE_FILE, &before));
+		}
+	}
+	for(int i = 0; i < 15; i++) {
+		CHECK(shufflePrev(&album, &track));
+	}
+	// Moving only marks it, the write waits for SHUFFLE_SAVE_SECS or a forced flush
+	struct shuffle_state_file state;
+	shuffleFlush(0);
+	CHECK_EQ(readFile(SHUFFLE_STATE_FILE, &state, sizeof(state)), sizeof(state));
+	CHECK_EQ(state.pos, 1);
+	firstDirtyTime -= secs_to_ticks(SHUFFLE_SAVE_SECS);
+	shuffleFlush(0);
+	CHECK_EQ(readFile(SHUFFLE_STATE_FILE, &state, sizeof(state)), sizeof(state));
+	CHECK_EQ(state.pos, 25);
+	CHECK(!stateDirty);
+	// Rewritten in place, never truncated or recreated
+	CHECK(!stat(SHUFFLE_STATE_FILE, &after));
+	CHECK_EQ(after.st_size, sizeof(struct shuffle_state_file));
+	CHECK_EQ(after.st_ino, before.st_ino);
+	writeFile(SEQ_FILE, seq, sizeof(seq));
+}
+
+static void carryOn() {
+	startLibraryScan();
+	waitForScan();
+	shuffleInit();
+	u32 seq[40];
+	CHECK_EQ(readFile(SEQ_FILE, seq, sizeof(seq)), sizeof(seq));
+	int album, track;
+	int same = 1;
+	for(int i = 25; i < 40; i++) {
+		same &= shuffleNext(&album, &track) && globalOf(album, track) == seq[i];
+	}
+	CHECK(same);
+}
+
+static void libraryChanged() {
+	startLibraryScan();
+	waitForScan();
+	shuffleInit();
+	int album, track;
+	CHECK(shuffleNext(&album, &track));
+	// A fresh round, not position 26 of the old one
+	CHECK_EQ(pos, 1);
+	CHECK_EQ(orderSize, num_tracks);
+}
+
+static void testResume() {
+	makeLibrary();
+	runIsolated(playThenReboot);
+	runIsolated(carryOn);
+	makeAlbum(NUM_ALBUMS, 3);
+	runIsolated(libraryChanged);
+}
+
+int main() {
+	testRngBounded();
+	testDirEnter("shuffle");
+	runIsolated(testRound);
+	testDirLeave();
+	testDirEnter("shuffle");
+	runIsolated(testFirstPicks);
+	testDirLeave();
+	testDirEnter("shuffle");
+	testResume();
+	testDirLeave();
+	return testsFinish("test_shuffle");
+}
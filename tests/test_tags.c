@@ -0,0 +1,325 @@
+// ID3v2.2 to v2.4 and ID3v1 parsing, embedded pictures, and tags.dat keeping what was read
+#include "tags.c"
+#include <unistd.h>
+#include "harness.h"
+
+#define TAGS_ALBUM_DIR ALBUMS_DIR "/Tagged"
+
+// An ID3v2 tag built up a frame at a time
+struct tag_builder {
+	u8 data[4096];
+	u32 len;
+	int version;
+};
+
+static void putSize(u8 *p, u32 size, int safe) {
+	int shift = safe ? 7 : 8;
+	for(int i = 3; i >= 0; i--, size >>= shift) {
+		p[i] = size & (safe ? 0x7F : 0xFF);
+	}
+}
+
+static void tagBegin(struct tag_builder *b, int version, u8 flags) {
+	memcpy(b->data, "ID3", 3);
+	b->data[3] = version;
+	b->data[4] = 0;
+	b->data[5] = flags;
+	b->len = 10;
+	b->version = version;
+}
+
+static void tagFrame(struct tag_builder *b, const char *id, const void *payload, u32 size, u8 flags) {
+	u8 *p = b->data + b->len;
+	if(b->version == 2) {
+		memcpy(p, id, 3);
+		p[3] = size >> 16;
+		p[4] = size >> 8;
+		p[5] = size;
+		b->len += 6;
+	}
+	else {
+		memcpy(p, id, 4);
+		putSize(p + 4, size, b->version == 4);
+		p[8] = 0;
+		p[9] = flags;
+		b->len += 10;
+	}
+	memcpy(b->data + b->len, payload, size);
+	b->len += size;
+}
+
+#define TAG_FRAME(b, id, payload, flags) tagFrame(b, id, payload, sizeof(payload) - 1, flags)
+
+// Latin-1 text
+static void tagText(struct tag_builder *b, const char *id, const char *text) {
+	u8 payload[512];
+	payload[0] = 0;
+	u32 len = strlen(text);
+	memcpy(payload + 1, text, len);
+	tagFrame(b, id, payload, len + 1, 0);
+}
+
+// Writes the tag with some padding after it, a few frames of audio and maybe an ID3v1 tag
+static void writeTrack(const char *name, struct tag_builder *b, const u8 *v1) {
+	u8 file[8192];
+	u32 len = 0;
+	if(b) {
+		memcpy(file, b->data, b->len);
+		memset(file + b->len, 0, 100);
+		putSize(file + 6, b->len + 100 - 10, 1);
+		len = b->len + 100;
+	}
+	for(int i = 0; i < 4; i++, len += 417) {
+		memset(file + len, 0x55, 417);
+		memcpy(file + len, "\xFF\xFB\x90\x00", 4);
+	}
+	if(v1) {
+		memcpy(file + len, v1, 128);
+		len += 128;
+	}
+	char path[256];
+	snprintf(path, sizeof(path), "%s/%s", TAGS_ALBUM_DIR, name);
+	writeFile(path, file, len);
+}
+
+static void makeV1(u8 *v1, const char *title, const char *artist, const char *album, u8 track) {
+	memset(v1, 0, 128);
+	memcpy(v1, "TAG", 3);
+	memset(v1 + 3, ' ', 90);
+	memcpy(v1 + 3, title, strlen(title));
+	memcpy(v1 + 33, artist, strlen(artist));
+	memcpy(v1 + 63, album, strlen(album));
+	v1[126] = track;
+}
+
+static void makeTracks() {
+	struct tag_builder b;
+	u8 v1[128];
+	mkdir(TAGS_ALBUM_DIR, 0755);
+	mkdir(WAKEMII_DIR "/cache", 0755);
+
+	// v2.3, with frames that aren't wanted and one that's compressed in between
+	tagBegin(&b, 3, 0);
+	tagText(&b, "TXXX", "something else");
+	tagText(&b, "TIT2", "Three Title");
+	TAG_FRAME(&b, "TPE1", "\0Squashed", 0x80);
+	tagText(&b, "TPE1", "Three Artist");
+	tagText(&b, "TALB", "Three Album");
+	tagText(&b, "TRCK", "7/12");
+	tagText(&b, "TLEN", "183000");
+	writeTrack("v23.mp3", &b, NULL);
+
+	// v2.4: UTF-8, UTF-16 both ways round, a data length indicator and an unsynchronised frame
+	tagBegin(&b, 4, 0);
+	TAG_FRAME(&b, "TIT2", "\3Caf\xC3\xA9 \xE2\x82\xAC", 0);
+	TAG_FRAME(&b, "TPE1", "\1\xFF\xFE" "A\0r\0t\0\xE9\0", 0);
+	TAG_FRAME(&b, "TALB", "\0\0\0\x09" "\0Al\xFF\0bum", 0x03);
+	TAG_FRAME(&b, "TRCK", "\2\0" "4", 0);
+	writeTrack("v24.mp3", &b, NULL);
+
+	// v2.2's three letter frames
+	tagBegin(&b, 2, 0);
+	tagText(&b, "TT2", "Two Title");
+	tagText(&b, "TP1", "Two Artist");
+	tagText(&b, "TAL", "Two Album");
+	tagText(&b, "TRK", "2");
+	writeTrack("v22.mp3", &b, NULL);
+
+	// ID3v1.1 on its own
+	makeV1(v1, "One Title", "One Artist", "One Album", 9);
+	writeTrack("v1.mp3", NULL, v1);
+
+	// ID3v2 for the title, v1 for the rest, and a v2.3 extended header to get past
+	tagBegin(&b, 3, 0x40);
+	memcpy(b.data + 10, "\0\0\0\6\0\0\0\0\0\0", 10);
+	b.len += 10;
+	tagText(&b, "TIT2", "Mixed");
+	makeV1(v1, "Not This", "V1 Artist", "V1 Album", 3);
+	writeTrack("mixed.mp3", &b, v1);
+
+	// Nothing at all, and a title too long to keep
+	writeTrack("none.mp3", NULL, NULL);
+	char longTitle[200];
+	memset(longTitle, 'L', sizeof(longTitle) - 1);
+	longTitle[sizeof(longTitle) - 1] = 0;
+	tagBegin(&b, 3, 0);
+	tagText(&b, "TIT2", longTitle);
+	writeTrack("long.mp3", &b, NULL);
+
+	// Pictures: a back cover then the front, v2.2's PIC, and one behind a UTF-16 description
+	tagBegin(&b, 3, 0);
+	TAG_FRAME(&b, "APIC", "\0image/jpeg\0\4back\0BACKDATA", 0);
+	TAG_FRAME(&b, "APIC", "\0image/png\0\3front\0FRONTDATA!", 0);
+	tagText(&b, "TIT2", "Pictures");
+	writeTrack("apic.mp3", &b, NULL);
+	tagBegin(&b, 2, 0);
+	TAG_FRAME(&b, "PIC", "\0JPG\3\0PICDATA", 0);
+	writeTrack("pic.mp3", &b, NULL);
+	tagBegin(&b, 4, 0);
+	TAG_FRAME(&b, "APIC", "\1image/jpeg\0\3\xFF\xFEx\0\0\0WIDE", 0);
+	writeTrack("wide.mp3", &b, NULL);
+	// Unsynchronised pictures can't be read straight out of the file
+	tagBegin(&b, 3, 0x80);
+	TAG_FRAME(&b, "APIC", "\0image/jpeg\0\3\0UNSYNCED", 0);
+	writeTrack("unsync.mp3", &b, NULL);
+}
+
+static int trackNum(const char *name) {
+	for(int i = 0; i < albumNumEntries(0); i++) {
+		if(!strcmp(albumTrackName(0, i), name)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static struct track_tags readTags(const char *name) {
+	struct track_tags tags;
+	readTrackTags(0, trackNum(name), &tags);
+	return tags;
+}
+
+static void testParse() {
+	startLibraryScan();
+	waitForScan();
+	loadStore();
+	CHECK_EQ(storeRecords, 0);
+
+	struct track_tags t = readTags("v23.mp3");
+	CHECK(!strcmp(t.title, "Three Title"));
+	CHECK(!strcmp(t.artist, "Three Artist"));
+	CHECK(!strcmp(t.album, "Three Album"));
+	CHECK_EQ(t.track, 7);
+	CHECK_EQ(t.duration_ms, 183000);
+
+	t = readTags("v24.mp3");
+	CHECK(!strcmp(t.title, "Caf\xE9 ?"));
+	CHECK(!strcmp(t.artist, "Art\xE9"));
+	CHECK(!strcmp(t.album, "Al\xFF" "bum"));
+	CHECK_EQ(t.track, 4);
+
+	t = readTags("v22.mp3");
+	CHECK(!strcmp(t.title, "Two Title"));
+	CHECK(!strcmp(t.artist, "Two Artist"));
+	CHECK(!strcmp(t.album, "Two Album"));
+	CHECK_EQ(t.track, 2);
+
+	t = readTags("v1.mp3");
+	CHECK(!strcmp(t.title, "One Title"));
+	CHECK(!strcmp(t.artist, "One Artist"));
+	CHECK(!strcmp(t.album, "One Album"));
+	CHECK_EQ(t.track, 9);
+
+	t = readTags("mixed.mp3");
+	CHECK(!strcmp(t.title, "Mixed"));
+	CHECK(!strcmp(t.artist, "V1 Artist"));
+	CHECK(!strcmp(t.album, "V1 Album"));
+	CHECK_EQ(t.track, 3);
+
+	t = readTags("none.mp3");
+	CHECK(!t.title[0] && !t.artist[0] && !t.album[0] && !t.track && !t.duration_ms);
+	t = readTags("long.mp3");
+	CHECK_EQ(strlen(t.title), TAGS_FIELD_SIZE - 1);
+}
+
+static void checkPicture(const char *name, const char *data) {
+	char path[256];
+	snprintf(path, sizeof(path), "%s/%s", TAGS_ALBUM_DIR, name);
+	FILE *fp = fopen(path, "rb");
+	u32 size = 0;
+	u32 offset = tagsFindPicture(fp, &size);
+	char got[32] = {0};
+	if(data) {
+		CHECK_EQ(size, strlen(data));
+		fseek(fp, offset, SEEK_SET);
+		CHECK_EQ(fread(got, 1, MIN(size, sizeof(got) - 1), fp), strlen(data));
+		CHECK(!strcmp(got, data));
+	}
+	else {
+		CHECK_EQ(offset, 0);
+	}
+	fclose(fp);
+}
+
+static void testPictures() {
+	checkPicture("apic.mp3", "FRONTDATA!");
+	checkPicture("pic.mp3", "PICDATA");
+	checkPicture("wide.mp3", "WIDE");
+	checkPicture("unsync.mp3", NULL);
+	checkPicture("v23.mp3", NULL);
+	checkPicture("none.mp3", NULL);
+}
+
+// A fresh boot, everything read last time comes out of tags.dat
+static void testStore() {
+	startLibraryScan();
+	waitForScan();
+	loadStore();
+	CHECK_EQ(storeRecords, 7);
+
+	// The file's not even opened past a stat, garbage of the same size and time still reads
+	struct stat st;
+	CHECK(!stat(TAGS_ALBUM_DIR "/v23.mp3", &st));
+	u8 *zeros = calloc(1, st.st_size);
+	writeFile(TAGS_ALBUM_DIR "/v23.mp3", zeros, st.st_size);
+	free(zeros);
+	setMtime(TAGS_ALBUM_DIR "/v23.mp3", st.st_mtime);
+	struct track_tags t = readTags("v23.mp3");
+	CHECK(!strcmp(t.title, "Three Title"));
+	CHECK_EQ(storeRecords, 7);
+
+	// Changed since, read again and added on
+	setMtime(TAGS_ALBUM_DIR "/v23.mp3", st.st_mtime + 10);
+	t = readTags("v23.mp3");
+	CHECK(!t.title[0]);
+	CHECK_EQ(storeRecords, 8);
+
+	// A record cut short by the power going is written over
+	CHECK(!stat(TAGS_STORE_FILE, &st));
+	truncate(TAGS_STORE_FILE, st.st_size - 10);
+}
+
+static void testTornStore() {
+	startLibraryScan();
+	waitForScan();
+	loadStore();
+	CHECK_EQ(storeRecords, 7);
+	struct track_tags t = readTags("v1.mp3");
+	CHECK(!strcmp(t.title, "One Title"));
+	t = readTags("v23.mp3");
+	CHECK(!t.title[0]);
+	CHECK_EQ(storeRecords, 8);
+	struct stat st;
+	CHECK(!stat(TAGS_STORE_FILE, &st));
+	CHECK_EQ(st.st_size, sizeof(struct tags_store_header) + 8 * sizeof(struct tags_record));
+}
+
+// Through the worker the way the main screen asks
+static void testWorker() {
+	startLibraryScan();
+	waitForScan();
+	tagsInit();
+	int num = trackNum("v22.mp3");
+	CHECK(tagsGet(0, num) == NULL);
+	const struct track_tags *t = NULL;
+	for(int i = 0; i < 500 && !t; i++) {
+		usleep(10000);
+		tagsUpdate();
+		t = tagsGet(0, num);
+	}
+	CHECK(t != NULL);
+	CHECK(t && !strcmp(t->title, "Two Title"));
+	CHECK(tagsGet(-1, 0) == NULL);
+}
+
+int main() {
+	testDirEnter("tags");
+	makeTracks();
+	runIsolated(testParse);
+	runIsolated(testPictures);
+	runIsolated(testStore);
+	runIsolated(testTornStore);
+	runIsolated(testWorker);
+	testDirLeave();
+	return testsFinish("test_tags");
+}
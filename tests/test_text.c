@@ -0,0 +1,192 @@
+// The batched text against GRRLIB_Printf drawing it a tile at a time, and the
+// laid out lines being kept from one frame to the next
+#include "text.c"
+#include <math.h>
+#include "harness.h"
+
+#define FONT_TILE_W 12
+#define FONT_TILE_H 16
+
+static struct gx_vertex expected[GX_HOST_VERTICES];
+static u32 num_expected;
+
+static GRRLIB_texImg* makeFont(int handlex, int handley, int offsetx, int offsety) {
+	// 16x6 tiles from ' ', like the BMfont sets
+	GRRLIB_texImg *font = GRRLIB_CreateEmptyTexture(FONT_TILE_W * 16, FONT_TILE_H * 6);
+	GRRLIB_InitTileSet(font, FONT_TILE_W, FONT_TILE_H, 32);
+	font->handlex = handlex;
+	font->handley = handley;
+	font->offsetx = offsetx;
+	font->offsety = offsety;
+	return font;
+}
+
+static int sameVertex(const struct gx_vertex *a, const struct gx_vertex *b) {
+	return fabsf(a->x - b->x) < 0.001f && fabsf(a->y - b->y) < 0.001f && a->color == b->color
+		&& fabsf(a->s - b->s) < 0.00001f && fabsf(a->t - b->t) < 0.00001f;
+}
+
+struct call {
+	f32 x;
+	f32 y;
+	GRRLIB_texImg *font;
+	u32 color;
+	f32 zoom;
+	const char *text;
+};
+
+// Draws calls both ways and checks every glyph came out the same, in the same order within each font
+static void compare(const struct call *calls, int num, GRRLIB_texImg **fonts, int num_fonts) {
+	gxStatsReset();
+	for(int f = 0; f < num_fonts; f++) {
+		for(int i = 0; i < num; i++) {
+			if(calls[i].font == fonts[f]) {
+				GRRLIB_Printf(calls[i].x, calls[i].y, calls[i].font, calls[i].color, calls[i].zoom, "%s", calls[i].text);
+			}
+		}
+	}
+	num_expected = gxStats.vertices;
+	memcpy(expected, gxVertices, num_expected * sizeof(struct gx_vertex));
+	u32 tileBegins = gxStats.begins;
+
+	gxStatsReset();
+	for(int i = 0; i < num; i++) {
+		textPrintf(calls[i].x, calls[i].y, calls[i].font, calls[i].color, calls[i].zoom, "%s", calls[i].text);
+	}
+	textFlush();
+	CHECK_EQ(gxStats.vertices, num_expected);
+	CHECK_EQ(tileBegins, num_expected / 4);
+	// One texture setup and one batch per font
+	CHECK_EQ(gxStats.begins, num_fonts);
+	CHECK_EQ(gxStats.texLoads, num_fonts);
+	u32 mismatched = 0;
+	for(u32 i = 0; i < num_expected; i++) {
+		if(!sameVertex(&gxVertices[i], &expected[i])) {
+			if(!mismatched) {
+				printf("vertex %u: (%f,%f %08X %f,%f) vs GRRLIB (%f,%f %08X %f,%f)\n", i, gxVertices[i].x, gxVertices[i].y, gxVertices[i].color,
+					gxVertices[i].s, gxVertices[i].t, expected[i].x, expected[i].y, expected[i].color, expected[i].s, expected[i].t);
+			}
+			mismatched++;
+		}
+	}
+	CHECK_EQ(mismatched, 0);
+}
+
+static void testPlacement() {
+	GRRLIB_texImg *plain = makeFont(0, 0, 0, 0);
+	GRRLIB_texImg *handled = makeFont(5, 7, 2, 3);
+	GRRLIB_texImg *fonts[2] = {plain, handled};
+	const struct call calls[] = {
+		{50, 25, plain, GRRLIB_WHITE, 1, "WAKEMII"},
+		{280, 44, handled, GRRLIB_WHITE, 1, "v1.1"},
+		{100, 420, plain, 0xFF8000FF, 1, "Album: Some Album ~ [Disc 2]"},
+		{100.5f, 440.25f, handled, 0x00FF00C0, 1.5f, "Track: Artist - Title (Remix) *"},
+		{12, 300, plain, GRRLIB_WHITE, 0.75f, "07:30 AM  Mon Tue Wed Thu Fri"},
+		{-20, -8, handled, GRRLIB_WHITE, 2, "edge"},
+	};
+	compare(calls, sizeof(calls) / sizeof(calls[0]), fonts, 2);
+	GRRLIB_FreeTexture(plain);
+	GRRLIB_FreeTexture(handled);
+}
+
+static struct text_line* cachedLine(const char *text) {
+	for(int i = 0; i < TEXT_CACHE_LINES; i++) {
+		if(lines[i].font && lines[i].len == strlen(text) && !memcmp(lines[i].text, text, lines[i].len)) {
+			return &lines[i];
+		}
+	}
+	return NULL;
+}
+
+static void testKeptBetweenFrames() {
+	GRRLIB_texImg *font = makeFont(0, 0, 0, 0);
+	textPrintf(100, 420, font, GRRLIB_WHITE, 1, "Album: %s", "First");
+	textPrintf(100, 440, font, GRRLIB_WHITE, 1, "Track: %02d", 1);
+	textFlush();
+	struct text_line *album = cachedLine("Album: First");
+	struct text_line *track = cachedLine("Track: 01");
+	CHECK(album != NULL && track != NULL);
+	if(!album || !track) {
+		return;
+	}
+	struct glyph_quad *albumGlyphs = album->glyphs;
+
+	// Same text next frame, nothing laid out again
+	textPrintf(100, 420, font, GRRLIB_WHITE, 1, "Album: %s", "First");
+	textPrintf(100, 440, font, GRRLIB_WHITE, 1, "Track: %02d", 1);
+	textFlush();
+	CHECK(cachedLine("Album: First") == album);
+	CHECK(album->glyphs == albumGlyphs);
+
+	// Only the line that changed is
+	textPrintf(100, 420, font, GRRLIB_WHITE, 1, "Album: %s", "First");
+	textPrintf(100, 440, font, GRRLIB_WHITE, 1, "Track: %02d", 2);
+	textFlush();
+	CHECK(cachedLine("Album: First") == album);
+	CHECK(album->glyphs == albumGlyphs);
+	CHECK(cachedLine("Track: 02") != NULL);
+
+	// Same text somewhere else or in another colour is its own line
+	gxStatsReset();
+	textPrintf(100, 420, font, GRRLIB_WHITE, 1, "Album: First");
+	textPrintf(100, 400, font, GRRLIB_WHITE, 1, "Album: First");
+	textPrintf(100, 420, font, 0xFF0000FF, 1, "Album: First");
+	textFlush();
+	CHECK_EQ(gxStats.vertices, 3 * 12 * 4);
+	CHECK(gxVertices[0].y != gxVertices[48].y);
+	CHECK_EQ(gxVertices[96].color, 0xFF0000FF);
+	GRRLIB_FreeTexture(font);
+}
+
+static void testManyLines() {
+	// More lines in a frame than there are cache slots, they all still get drawn in order
+	GRRLIB_texImg *font = makeFont(0, 0, 0, 0);
+	GRRLIB_texImg *fonts[1] = {font};
+	struct call calls[TEXT_CACHE_LINES * 2];
+	char texts[TEXT_CACHE_LINES * 2][16];
+	for(int i = 0; i < TEXT_CACHE_LINES * 2; i++) {
+		sprintf(texts[i], "Line %d", i);
+		struct call c = {10, i * 4, font, GRRLIB_WHITE, 1, texts[i]};
+		calls[i] = c;
+	}
+	gxStatsReset();
+	for(int i = 0; i < TEXT_CACHE_LINES * 2; i++) {
+		GRRLIB_Printf(calls[i].x, calls[i].y, font, GRRLIB_WHITE, 1, "%s", calls[i].text);
+	}
+	num_expected = gxStats.vertices;
+	memcpy(expected, gxVertices, num_expected * sizeof(struct gx_vertex));
+	gxStatsReset();
+	for(int i = 0; i < TEXT_CACHE_LINES * 2; i++) {
+		textPrintf(calls[i].x, calls[i].y, font, GRRLIB_WHITE, 1, "%s", calls[i].text);
+	}
+	textFlush();
+	CHECK_EQ(gxStats.vertices, num_expected);
+	CHECK(gxStats.begins >= 2);
+	u32 mismatched = 0;
+	for(u32 i = 0; i < num_expected; i++) {
+		mismatched += !sameVertex(&gxVertices[i], &expected[i]);
+	}
+	CHECK_EQ(mismatched, 0);
+	// Still right once the cache has turned over
+	compare(calls, 8, fonts, 1);
+	GRRLIB_FreeTexture(font);
+}
+
+static void testNothingToDraw() {
+	GRRLIB_texImg *font = makeFont(0, 0, 0, 0);
+	gxStatsReset();
+	textPrintf(0, 0, font, GRRLIB_WHITE, 1, "%s", "");
+	textPrintf(0, 0, NULL, GRRLIB_WHITE, 1, "text");
+	textFlush();
+	CHECK_EQ(gxStats.begins, 0);
+	CHECK_EQ(gxStats.texLoads, 0);
+	GRRLIB_FreeTexture(font);
+}
+
+int main() {
+	testPlacement();
+	testKeptBetweenFrames();
+	testManyLines();
+	testNothingToDraw();
+	return testsFinish("test_text");
+}
@@ -0,0 +1,54 @@
+// Converts every album's cover on a card (or a copy of one) into the texture
+// cache on Linux, so the Wii starts with them all done, and times loading
+// them from the covers themselves against loading them from the cache.
+//   tool_cover <dir holding wakemii/>
+#include "covers.c"
+#include <unistd.h>
+#include <ogc/lwp_watchdog.h>
+#include "harness.h"
+
+static void loadAll(const char *what) {
+	int found = 0;
+	double slowest = 0;
+	u64 start = gettime();
+	for(int i = 0; i < num_albums; i++) {
+		u64 albumStart = gettime();
+		GRRLIB_texImg *tex = getCoverFromIdx(i);
+		double ms = elapsedMs(albumStart);
+		if(ms > slowest) {
+			slowest = ms;
+		}
+		if(tex) {
+			found++;
+			GRRLIB_FreeTexture(tex);
+		}
+	}
+	char label[64];
+	snprintf(label, sizeof(label), "%s, all albums", what);
+	benchReport(label, elapsedMs(start), "ms");
+	snprintf(label, sizeof(label), "%s, slowest album", what);
+	benchReport(label, slowest, "ms");
+	printf("%d of %d albums have a cover\n", found, num_albums);
+}
+
+static void convert() {
+	startLibraryScan();
+	waitForScan();
+	coverLoadInit();
+	// The first pass decodes whatever isn't cached yet (or changed since), the second is all cache
+	loadAll("decoding");
+	loadAll("cached");
+}
+
+int main(int argc, char **argv) {
+	if(argc != 2) {
+		fprintf(stderr, "usage: %s <dir holding wakemii/>\n", argv[0]);
+		return 2;
+	}
+	if(chdir(argv[1])) {
+		perror(argv[1]);
+		return 2;
+	}
+	runIsolated(convert);
+	return testsFinish("tool_cover");
+}
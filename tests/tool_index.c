@@ -0,0 +1,110 @@
+// Builds library.idx for a card (or a copy of one) on Linux, checks every
+// indexed dir against what's on disk, and times a boot scan with and without it.
+//   tool_index <dir holding wakemii/>
+#include "library.c"
+#include <unistd.h>
+#include "harness.h"
+
+static void buildIndex() {
+	LWP_MutexInit(&poolMutex, false);
+	LWP_MutexInit(&libraryMutex, false);
+	u64 start = gettime();
+	scanHourly();
+	if(!scanAlbums()) {
+		fprintf(stderr, "%s not found\n", ALBUMS_DIR);
+		exit(1);
+	}
+	benchReport("full scan", elapsedMs(start), "ms");
+	printf("%d albums, %d tracks, %d hourly, %u bytes of names\n", num_albums, num_tracks, num_hourly, poolUsed);
+	libraryDirty = 1;
+	saveLibraryIndex();
+}
+
+static void bootScan() {
+	u64 start = gettime();
+	startLibraryScan();
+	waitForScan();
+	benchReport("scan with library.idx", elapsedMs(start), "ms");
+}
+
+static int verifyDir(struct indexed_dir *indexed) {
+	char path[1024];
+	if(indexed == indexedHourly) {
+		strcpy(path, HOURLY_DIR);
+	}
+	else {
+		snprintf(path, sizeof(path), "%s/%s", ALBUMS_DIR, indexed->name);
+	}
+	struct stat st;
+	if(stat(path, &st)) {
+		printf("%s: in the index but not on disk\n", path);
+		return 0;
+	}
+	struct album album;
+	readAlbumDir(path, &album, &scanScratch);
+	u32 size = 0;
+	for(u32 i = 0; i < indexed->num_entries; i++) {
+		size += strlen(indexed->tracks + size) + 1;
+	}
+	if(indexed->mtime != (u32)st.st_mtime) {
+		printf("%s: mtime changed, would be rescanned\n", path);
+	}
+	else if(album.num_entries != indexed->num_entries || scanScratch.used != size
+		|| memcmp(scanScratch.buf, indexed->tracks, size)
+		|| (indexed != indexedHourly && album.cover_type != indexed->cover_type)) {
+		printf("%s: tracks or cover differ from the index\n", path);
+		return 0;
+	}
+	return 1;
+}
+
+static void verifyIndex() {
+	loadLibraryIndex();
+	if(!indexData) {
+		printf("library.idx didn't load\n");
+		CHECK(0);
+		return;
+	}
+	int bad = 0;
+	for(int i = 0; i < num_indexedDirs; i++) {
+		bad += !verifyDir(&indexedDirs[i]);
+	}
+	// Every album dir with tracks in it should be there
+	dir_scan scan;
+	struct dirent *entry;
+	if(dirScanOpen(&scan, ALBUMS_DIR, DIRSCAN_DIRS)) {
+		while((entry = dirScanNext(&scan, NULL)) != NULL) {
+			int found = 0;
+			for(int i = 0; i < num_indexedDirs && !found; i++) {
+				found = &indexedDirs[i] != indexedHourly && !strcmp(indexedDirs[i].name, entry->d_name);
+			}
+			char path[1024];
+			struct album album;
+			snprintf(path, sizeof(path), "%s/%s", ALBUMS_DIR, entry->d_name);
+			readAlbumDir(path, &album, &scanScratch);
+			if(!found && album.num_entries) {
+				printf("%s: on disk but not in the index\n", path);
+				bad++;
+			}
+		}
+		dirScanClose(&scan);
+	}
+	printf("library.idx: %d dirs checked, %d bad\n", num_indexedDirs, bad);
+	CHECK_EQ(bad, 0);
+	freeLibraryIndex();
+}
+
+int main(int argc, char **argv) {
+	if(argc != 2) {
+		fprintf(stderr, "usage: %s <dir holding wakemii/>\n", argv[0]);
+		return 2;
+	}
+	if(chdir(argv[1])) {
+		perror(argv[1]);
+		return 2;
+	}
+	runIsolated(buildIndex);
+	runIsolated(verifyIndex);
+	runIsolated(bootScan);
+	return testsFinish("tool_index");
+}
@@ -0,0 +1,117 @@
+// Picks the profiler's binary records out of a USB Gecko capture (the raw bytes, log
+// lines and all), prints p50/p99/max of each section's per frame totals and writes
+// every frame out as CSV if asked.
+//   tool_profile <capture> [frames.csv]
+#include "profile.c"
+
+struct frame_record {
+	u32 frame;
+	u32 us[PROF_NUM_SECTIONS];
+};
+
+static u32 getBE32(const u8 *p) {
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+// Finds the next record at or after *pos, skipping the log text around it. 0 once there
+// are no more whole ones.
+static int nextRecord(const u8 *data, u32 len, u32 *pos, struct frame_record *rec) {
+	for(u32 i = *pos; i + 8 <= len; i++) {
+		// Text never has 0xFF in it, a record cut short by a full log queue is passed over
+		if(data[i] != 0xFF || data[i+1] != 'P' || data[i+2] != PROFILE_RECORD_VERSION || data[i+3] != PROF_NUM_SECTIONS) {
+			continue;
+		}
+		if(i + PROFILE_RECORD_SIZE > len) {
+			break;
+		}
+		rec->frame = getBE32(data + i + 4);
+		for(int s = 0; s < PROF_NUM_SECTIONS; s++) {
+			rec->us[s] = getBE32(data + i + 8 + s * 4);
+		}
+		*pos = i + PROFILE_RECORD_SIZE;
+		return 1;
+	}
+	*pos = len;
+	return 0;
+}
+
+// Only frames a section ran in count towards its percentiles
+static void summarise(struct frame_record *recs, u32 n) {
+	u32 *sorted = malloc(MAX(n, 1) * sizeof(u32));
+	printf("%-6s %7s %8s %8s %8s\n", "ms", "frames", "p50", "p99", "max");
+	for(int s = 0; s < PROF_NUM_SECTIONS; s++) {
+		u32 count = 0;
+		for(u32 i = 0; i < n; i++) {
+			if(recs[i].us[s]) {
+				sorted[count++] = recs[i].us[s];
+			}
+		}
+		if(!count) {
+			printf("%-6s %7u %8s %8s %8s\n", sectionNames[s], 0, "-", "-", "-");
+			continue;
+		}
+		qsort(sorted, count, sizeof(u32), compareU32);
+		printf("%-6s %7u %8.2f %8.2f %8.2f\n", sectionNames[s], count, sorted[(count - 1) / 2] / 1000.0,
+			sorted[((count - 1) * 99) / 100] / 1000.0, sorted[count - 1] / 1000.0);
+	}
+	free(sorted);
+}
+
+static void writeCsv(const char *path, struct frame_record *recs, u32 n) {
+	FILE *fp = fopen(path, "w");
+	if(!fp) {
+		fprintf(stderr, "Couldn't write %s\n", path);
+		exit(1);
+	}
+	fprintf(fp, "frame");
+	for(int s = 0; s < PROF_NUM_SECTIONS; s++) {
+		fprintf(fp, ",%s_us", sectionNames[s]);
+	}
+	fprintf(fp, "\n");
+	for(u32 i = 0; i < n; i++) {
+		fprintf(fp, "%u", recs[i].frame);
+		for(int s = 0; s < PROF_NUM_SECTIONS; s++) {
+			fprintf(fp, ",%u", recs[i].us[s]);
+		}
+		fprintf(fp, "\n");
+	}
+	fclose(fp);
+}
+
+int main(int argc, char **argv) {
+	if(argc < 2) {
+		fprintf(stderr, "usage: %s <gecko capture> [frames.csv]\n", argv[0]);
+		return 1;
+	}
+	FILE *fp = fopen(argv[1], "rb");
+	if(!fp) {
+		fprintf(stderr, "Couldn't read %s\n", argv[1]);
+		return 1;
+	}
+	fseek(fp, 0, SEEK_END);
+	u32 len = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	u8 *data = malloc(MAX(len, 1));
+	len = fread(data, 1, len, fp);
+	fclose(fp);
+	u32 n = 0, size = 1024, missing = 0, pos = 0;
+	struct frame_record *recs = malloc(size * sizeof(struct frame_record));
+	while(nextRecord(data, len, &pos, &recs[n])) {
+		if(n && recs[n].frame != recs[n-1].frame + 1) {
+			// Dropped when the log queue was full, or the overlay was off for a while
+			missing += recs[n].frame - recs[n-1].frame - 1;
+		}
+		if(++n == size) {
+			size *= 2;
+			recs = realloc(recs, size * sizeof(struct frame_record));
+		}
+	}
+	printf("%u frames, %u missing between them\n", n, missing);
+	summarise(recs, n);
+	if(argc > 2) {
+		writeCsv(argv[2], recs, n);
+	}
+	free(recs);
+	free(data);
+	return 0;
+}